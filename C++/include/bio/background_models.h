@@ -24,8 +24,8 @@ struct DnaModel
     /** Return the per base likelihood under this model of the given sequence. */
     virtual prob_t get_likelihood(const seq_t & sequence) = 0;
 
-    /** Train on multiple sequences concurrently. */
-    virtual void train(const SequenceCollection & sequences) = 0;
+    /** Train on multiple sequences concurrently using num_threads threads (0 for one per core). */
+    virtual void train(const SequenceCollection & sequences, unsigned num_threads = 1) = 0;
 
     /** Return the per base likelihood under this model of the given sequences. */
     virtual prob_t get_likelihood(const SequenceCollection & sequences) = 0;
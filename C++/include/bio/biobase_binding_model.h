@@ -73,6 +73,10 @@ private:
 	BindingModel & get_underlying_model() const;
 };
 
+/** So that BiobaseBindingModel parameters can be used as keys in hashed containers. */
+std::size_t
+hash_value( const BiobaseBindingModel::parameter_t & parameters );
+
 
 struct Link2BiobaseBindingModel
 {
@@ -14,6 +14,8 @@
 #include "bio/singleton.h"
 
 #include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
 
 BIO_NS_START
 
@@ -23,6 +25,16 @@ template <TransData type>
 struct DataTraits {
 };
 
+/** Makes sure a table is deserialised or parsed only once when many threads ask for it at once. */
+struct BiobaseTableLoad
+	: boost::noncopyable
+{
+	boost::atomic< bool > loaded;
+	boost::mutex mutex;
+
+	BiobaseTableLoad() : loaded( false ) { }
+};
+
 
 
 /** Contains all the tables in biobase. */
@@ -47,39 +59,56 @@ protected:
 	Pathway::map_t pathways;
 	Molecule::map_t molecules;
 
+	//the tables are loaded the first time they are asked for, from whichever thread asks first
+	mutable BiobaseTableLoad matrices_load;
+	mutable BiobaseTableLoad sites_load;
+	mutable BiobaseTableLoad factors_load;
+	mutable BiobaseTableLoad fragments_load;
+	mutable BiobaseTableLoad genes_load;
+	mutable BiobaseTableLoad compels_load;
+	mutable BiobaseTableLoad evidences_load;
+	mutable BiobaseTableLoad pathways_load;
+	mutable BiobaseTableLoad molecules_load;
+
 public:
 	BiobaseTableEntry * get_entry(const TableLink & link) const;
 	BiobaseTablePssmEntry * get_pssm_entry(const TableLink & link) const;
 
+	/* The getters load the table the first time they are called from any thread, parsing its file with
+	up to num_threads threads (0 for one per core) if it has not been archived. */
 	Matrix::map_t & get_matrices();
-	const Matrix::map_t & get_matrices() const;
+	const Matrix::map_t & get_matrices( unsigned num_threads = 0 ) const;
 
 	Site::map_t & get_sites();
-	const Site::map_t & get_sites() const;
+	const Site::map_t & get_sites( unsigned num_threads = 0 ) const;
 
 	Factor::map_t & get_factors();
-	const Factor::map_t & get_factors() const;
+	const Factor::map_t & get_factors( unsigned num_threads = 0 ) const;
 
 	Fragment::map_t & get_fragments();
-	const Fragment::map_t & get_fragments() const;
+	const Fragment::map_t & get_fragments( unsigned num_threads = 0 ) const;
 
 	Gene::map_t & get_genes();
-	const Gene::map_t & get_genes() const;
+	const Gene::map_t & get_genes( unsigned num_threads = 0 ) const;
 
 	Compel::map_t & get_compels();
-	const Compel::map_t & get_compels() const;
+	const Compel::map_t & get_compels( unsigned num_threads = 0 ) const;
 
 	Evidence::map_t & get_evidences();
-	const Evidence::map_t & get_evidences() const;
+	const Evidence::map_t & get_evidences( unsigned num_threads = 0 ) const;
 	Pathway::map_t & get_pathways();
-	const Pathway::map_t & get_pathways() const;
+	const Pathway::map_t & get_pathways( unsigned num_threads = 0 ) const;
 
 	Molecule::map_t & get_molecules();
-	const Molecule::map_t & get_molecules() const;
+	const Molecule::map_t & get_molecules( unsigned num_threads = 0 ) const;
 
 
-	/** Make sure all tables are loaded. */
-	void load_all() const;
+	/**
+	Make sure all tables are loaded using up to num_threads threads (0 for one per core). They are divided
+	between the tables deserialised or parsed at once and the chunks of each table's file. Logs how long
+	each table took.
+	*/
+	void load_all( unsigned num_threads = 0 ) const;
 
 
 	template <TransData data_type>
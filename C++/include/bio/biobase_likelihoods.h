@@ -5,8 +5,10 @@
 #include "bio/sequence.h"
 #include "bio/biobase_match.h"
 #include "bio/singleton.h"
+#include "bio/cache.h"
 
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <string>
 #include <vector>
@@ -85,8 +87,24 @@ get_biobase_quantised_scores(
 
 
 
+class LikelihoodsCache;
+
+/** Calculates one of the kinds of likelihoods a LikelihoodsCache holds. The result is null if they cannot be calculated. */
+struct ScoreLikelihoodsMaker
+	: std::unary_function< TableLink, boost::shared_ptr< BiobaseLikelihoods > >
+{
+	LikelihoodsCache * owner;
+	bool background;
+	bool or_better;
+
+	ScoreLikelihoodsMaker( LikelihoodsCache * owner = 0, bool background = false, bool or_better = false );
+
+	boost::shared_ptr< BiobaseLikelihoods > operator()( const TableLink & key ) const;
+};
+
+
 /** Stores and persists quantised counts for pssms indexed by key. Can generate Ott normalisations and likelihoods
-generated from these counts on demand. */
+generated from these counts on demand. The likelihoods can be requested from many threads at once. */
 class LikelihoodsCache
 	: public Singleton< LikelihoodsCache >
 {
@@ -111,15 +129,19 @@ private:
 
 protected:
 	typedef std::map< key_t, BiobaseCounts > count_map_t;
-	typedef std::map< key_t, BiobaseLikelihoods > likelihood_map_t;
+	typedef ConcurrentCache< ScoreLikelihoodsMaker > likelihood_map_t;
 
+	mutable boost::mutex counts_mutex;
 	count_map_t counts;
 	likelihood_map_t background_likelihoods;
 	likelihood_map_t background_likelihoods_or_better;
 	likelihood_map_t binding_likelihoods;
 	likelihood_map_t binding_likelihoods_or_better;
 
+	likelihood_map_t & get_likelihood_map( bool background, bool or_better );
+
 public:
+	LikelihoodsCache();
 
 	/** Quantise counts for all pssms in the iterators. */
 	template <class PssmIt>
@@ -144,6 +166,10 @@ public:
 	unsigned
 	get_total_counts( const key_t & key ) const;
 
+	/** Copies the counts for the given key into result. Returns false if there are none. */
+	bool
+	copy_counts( const key_t & key, BiobaseCounts & result ) const;
+
 	/** Gets the likelihoods of particular scores in a background random or a binding sequence for the named pssm.
 	 * Calculates them if needed. Returns 0 if cannot.
 	 * @param key Name of the pssm */
@@ -229,7 +255,7 @@ LikelihoodsCache::quantise_counts(
 	{
 		BiobaseCounts * counts = get_counts( pssm_begin->first );
 
-		quantise_scores( make_pssm(pssm_begin->second), seq.begin(), seq.end(), *counts );
+		quantise_scores( CompiledPssm( make_pssm(pssm_begin->second) ), seq.begin(), seq.end(), *counts );
 	}
 }
 
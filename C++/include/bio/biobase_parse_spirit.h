@@ -13,6 +13,7 @@
 
 #include "bio/biobase_data_traits.h"
 #include "bio/biobase_db.h"
+#include "bio/parallel.h"
 #include "bio/serialisable.h"
 #include <bio/spirit/transfac_qi.h>
 
@@ -29,40 +30,36 @@
 
 
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 
 BIO_NS_START
 namespace spirit {
 
 
+/**
+Parse TRANSFAC text into the map. The text must start with a version section. line_offset is added
+to the line numbers in error messages for text that does not start at the top of its file.
+*/
 template< TransData type >
 void
-parse(
+parse_text(
     typename DataTraits< type >::entry_t::map_t & map,
-    const std::string & biobase_file = DataTraits< type >::get_biobase_file()
+    const std::string & text,
+    const std::string & biobase_file,
+    size_t line_offset = 0
 )
 {
     using namespace std;
     using namespace BIO_NS::spirit;
 
     typedef typename DataTraits< type >::entry_t entry_t;
-    typedef typename entry_t::map_t map_t;
-
-    ifstream input( biobase_file.c_str() );
-    if( ! input ) {
-        throw std::logic_error(
-            BIO_MAKE_STRING( "Could not open file: \"" << biobase_file << "\"" ) );
-    }
-    input.unsetf( std::ios::skipws ); // disable skipping of whitespace
 
-    // iterate over stream input using boost::spirit forward iterator for streams
-    typedef boost::spirit::istream_iterator base_iterator_type;
-    base_iterator_type input_begin( input );
+    // wrap the text's iterator with position iterator, to record the position
+    typedef boost::spirit::line_pos_iterator< std::string::const_iterator > iterator_type;
 
-    // wrap forward iterator with position iterator, to record the position
-    typedef boost::spirit::line_pos_iterator< base_iterator_type > iterator_type;
-
-    iterator_type begin( input_begin );
-    iterator_type end;
+    iterator_type begin( text.begin() );
+    iterator_type end( text.end() );
 
     try
     {
@@ -72,7 +69,6 @@ parse(
         using namespace qi;
         using qi::ascii::blank;
 
-        boost::timer timer;
         iterator_type i = begin;
         qi::parse(
             i,
@@ -80,16 +76,11 @@ parse(
             table,
             map
         );
-        std::cout
-            << "Parsed " << map.size()
-            << " entries from \""
-            << biobase_file << "\" - "
-            << timer.elapsed() << "s\n";
 
         if( end != i ) {
             throw std::logic_error(
-                BIO_MAKE_STRING( "Did not parse all input: Got to line "
-                    << boost::spirit::get_line( i )
+                BIO_MAKE_STRING( "Did not parse all of \"" << biobase_file << "\": Got to line "
+                    << boost::spirit::get_line( i ) + line_offset
                     << ", column " << boost::spirit::get_column( begin, i ) ) );
         }
 
@@ -97,26 +88,193 @@ parse(
         iterator_type last = std::find( e.first, e.last, '\n' );
         const std::string error_msg =
             BIO_MAKE_STRING(
-                "Parsed " << map.size() << " entries.\n"
+                "Parsed " << map.size() << " entries from \"" << biobase_file << "\".\n"
                 << "expected: " << e.what()
                 << "got: \"" << std::string( e.first, last ) << '"' << "\n"
-                << "on line: " << boost::spirit::get_line( e.first ) << "\n"
+                << "on line: " << boost::spirit::get_line( e.first ) + line_offset << "\n"
                 << "column: " << boost::spirit::get_column( begin, e.first ) << "\n"
             );
         throw std::logic_error( error_msg );
     }
 }
 
+
+/** Part of a TRANSFAC file that can be parsed on its own. */
+struct biobase_chunk
+{
+    std::string text;       ///< The file's version section followed by whole entries.
+    size_t line_offset;     ///< What to add to line numbers in the text to get line numbers in the file.
+
+    biobase_chunk() : line_offset( 0 ) { }
+};
+
+
+namespace detail {
+
+/** The position after the first line at or after pos that starts with "//", or the end of the text. */
+inline
+size_t
+end_of_entry_line( const std::string & text, size_t pos )
+{
+    if( 0 != pos && pos < text.size() ) {
+        --pos; // so we find a "//" line that starts at pos
+    }
+    const size_t terminator = text.find( "\n//", pos );
+    if( std::string::npos == terminator ) {
+        return text.size();
+    }
+    const size_t eol = text.find( '\n', terminator + 1 );
+    return std::string::npos == eol ? text.size() : eol + 1;
+}
+
+} // namespace detail
+
+
+/**
+Split the text of a TRANSFAC file into at most num_chunks chunks of whole entries, splitting at the
+"//" lines that end them. Each chunk is given a copy of the version section so it can be parsed on its own.
+*/
+inline
+void
+split_biobase_text(
+    const std::string & text,
+    size_t num_chunks,
+    std::vector< biobase_chunk > & chunks
+)
+{
+    chunks.clear();
+
+    // the version section is terminated by the first "//" line
+    const size_t body_begin = detail::end_of_entry_line( text, 0 );
+    const std::string version_section = text.substr( 0, body_begin );
+    const size_t version_lines = std::count( version_section.begin(), version_section.end(), '\n' );
+
+    num_chunks = std::max< size_t >( 1, num_chunks );
+    size_t begin = body_begin;
+    size_t lines_before_begin = version_lines;
+    for( size_t c = 0; num_chunks != c && text.size() != begin; ++c ) {
+        const size_t target = body_begin + ( c + 1 ) * ( text.size() - body_begin ) / num_chunks;
+        const size_t end = num_chunks == c + 1 ? text.size() : detail::end_of_entry_line( text, std::max( target, begin ) );
+
+        chunks.push_back( biobase_chunk() );
+        biobase_chunk & chunk = chunks.back();
+        if( 0 == c ) {
+            chunk.text = text.substr( 0, end );
+        } else {
+            chunk.text = version_section;
+            chunk.text.append( text, begin, end - begin );
+            chunk.line_offset = lines_before_begin - version_lines;
+        }
+
+        lines_before_begin += std::count( text.begin() + begin, text.begin() + end, '\n' );
+        begin = end;
+    }
+
+    if( chunks.empty() ) {
+        chunks.push_back( biobase_chunk() );
+        chunks.back().text = text;
+    }
+}
+
+
+namespace detail {
+
+/** Parses one chunk of a TRANSFAC file into its own map. */
+template< TransData type >
+struct chunk_parser
+{
+    typedef typename DataTraits< type >::entry_t::map_t map_t;
+
+    const std::vector< biobase_chunk > & chunks;
+    std::vector< map_t > & maps;
+    const std::string & biobase_file;
+
+    chunk_parser(
+        const std::vector< biobase_chunk > & chunks,
+        std::vector< map_t > & maps,
+        const std::string & biobase_file
+    )
+    : chunks( chunks )
+    , maps( maps )
+    , biobase_file( biobase_file )
+    { }
+
+    void operator()( size_t c ) const {
+        parse_text< type >( maps[ c ], chunks[ c ].text, biobase_file, chunks[ c ].line_offset );
+    }
+};
+
+} // namespace detail
+
+
+/**
+Parse a TRANSFAC file into the map. The file is split into chunks of whole entries that are parsed on
+up to num_threads threads (0 for one per core). The result is the same as parsing the whole file at once.
+*/
+template< TransData type >
+void
+parse(
+    typename DataTraits< type >::entry_t::map_t & map,
+    const std::string & biobase_file = DataTraits< type >::get_biobase_file(),
+    unsigned num_threads = 0
+)
+{
+    typedef typename DataTraits< type >::entry_t::map_t map_t;
+
+    std::ifstream input( biobase_file.c_str(), std::ios::binary );
+    if( ! input ) {
+        throw std::logic_error(
+            BIO_MAKE_STRING( "Could not open file: \"" << biobase_file << "\"" ) );
+    }
+
+    namespace pt = boost::posix_time;
+    const pt::ptime start = pt::microsec_clock::universal_time();
+    std::string text;
+    {
+        std::ostringstream contents;
+        contents << input.rdbuf();
+        text = contents.str();
+    }
+
+    num_threads = resolve_num_threads( num_threads );
+    std::vector< biobase_chunk > chunks;
+    split_biobase_text( text, num_threads, chunks );
+    std::string().swap( text );
+
+    std::vector< map_t > maps( chunks.size() );
+    parallel_for( chunks.size(), num_threads, detail::chunk_parser< type >( chunks, maps, biobase_file ) );
+
+    // in chunk order so that of any entries with the same accession number the first in the file is kept
+    map.clear();
+    BOOST_FOREACH( const map_t & chunk_map, maps ) {
+        map.insert( chunk_map.begin(), chunk_map.end() );
+    }
+
+    std::cout
+        << "Parsed " << map.size()
+        << " entries from \""
+        << biobase_file << "\" in "
+        << chunks.size() << " chunks - "
+        << ( pt::microsec_clock::universal_time() - start ).total_milliseconds() / 1000.0 << "s\n";
+}
+
 } // namespace spirit
 
 
 
 
 
+/**
+Deserialise the table into the map if it is empty. If there is no archive, parse the TRANSFAC file using
+up to num_threads threads (0 for one per core) and archive it for next time. The table is loaded once
+however many threads ask for it at once: the others wait for it.
+*/
 template< TransData type >
 typename DataTraits< type >::entry_t::map_t &
 get_deserialise_or_parse(
-    const typename DataTraits< type >::entry_t::map_t & map )
+    const typename DataTraits< type >::entry_t::map_t & map,
+    BiobaseTableLoad & load,
+    unsigned num_threads = 0 )
 {
     namespace fs = boost::filesystem;
 
@@ -125,6 +283,13 @@ get_deserialise_or_parse(
         const_cast< typename DataTraits< type >::entry_t::map_t & >( map )
         ;
 
+    //once loaded we do not need to lock
+    if( load.loaded.load( boost::memory_order_acquire ) )
+    {
+        return non_const_map;
+    }
+
+    boost::lock_guard< boost::mutex > lock( load.mutex );
     if( map.empty() )
     {
         const fs::path serialised_file( DataTraits< type >::get_serialised_binary_file() );
@@ -135,10 +300,12 @@ get_deserialise_or_parse(
             boost::bind(
                 spirit::parse< type >,
                 boost::ref( non_const_map ),
-                DataTraits< type >::get_biobase_file()
+                DataTraits< type >::get_biobase_file(),
+                num_threads
             )
         );
     }
+    load.loaded.store( true, boost::memory_order_release );
 
     return non_const_map;
 }
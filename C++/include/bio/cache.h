@@ -4,6 +4,12 @@
 
 #include "bio/defs.h"
 
+#include <boost/atomic.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
+
 BIO_NS_START
 
 
@@ -87,6 +93,212 @@ public:
 
 
 
+/**
+A Cache that can be used from many threads at once. Elements are spread over NumShards
+independently locked maps by the hash of their keys. When an element is missing, the first
+thread to ask for it creates it without holding any shard lock and other threads asking for
+the same key wait for it, so each element is created once. If the creator throws, the
+waiting threads try again.
+
+Copies share the same elements. References to elements stay valid until they are erased
+or the cache is cleared.
+*/
+template<
+	typename ElementCreator,											// creates elements not already in the cache
+	typename Key = typename ElementCreator::argument_type,				// indexes elements in the cache
+	typename Element = typename ElementCreator::result_type,			// the element type
+	std::size_t NumShards = 16											// how many independently locked maps to use
+>
+struct ConcurrentCache
+	: std::unary_function< Key, Element >
+{
+public:
+	typedef ElementCreator element_creator_t;
+	typedef Key key_t;
+	typedef Element element_t;
+	typedef ConcurrentCache< element_creator_t, key_t, element_t, NumShards > cache_t;
+	typedef std::map< key_t, element_t > map_t;
+
+protected:
+	/** An element and whether it has been created yet. */
+	struct entry
+	{
+		enum state_t { CREATING, CREATED, FAILED };
+
+		boost::atomic< int > state;
+		boost::optional< element_t > element;
+		boost::mutex mutex;
+		boost::condition_variable state_changed;
+
+		entry() : state( CREATING ) { }
+		entry( const element_t & element ) : state( CREATED ), element( element ) { }
+
+		void set_state( state_t new_state )
+		{
+			boost::lock_guard< boost::mutex > lock( mutex );
+			state.store( new_state, boost::memory_order_release );
+			state_changed.notify_all();
+		}
+
+		/** Wait until the element has been created or creation failed. */
+		int wait()
+		{
+			boost::unique_lock< boost::mutex > lock( mutex );
+			while( CREATING == state.load( boost::memory_order_acquire ) )
+			{
+				state_changed.wait( lock );
+			}
+			return state.load( boost::memory_order_acquire );
+		}
+	};
+	typedef boost::shared_ptr< entry > entry_ptr;
+
+	struct shard
+	{
+		boost::mutex mutex;
+		std::map< key_t, entry_ptr > entries;
+	};
+	typedef boost::array< shard, NumShards > shards_t;
+
+	boost::shared_ptr< shards_t > shards;
+	element_creator_t element_creator;
+
+	shard & get_shard( const key_t & key ) const
+	{
+		return ( *shards )[ boost::hash< key_t >()( key ) % NumShards ];
+	}
+
+	/** Creates the element for the entry, which must be in the creating state. */
+	element_t & create( shard & s, const key_t & key, const entry_ptr & e ) const
+	{
+		try
+		{
+			e->element = element_creator( key );
+		}
+		catch( ... )
+		{
+			// remove the entry so the next request tries again
+			{
+				boost::lock_guard< boost::mutex > lock( s.mutex );
+				typename std::map< key_t, entry_ptr >::iterator i = s.entries.find( key );
+				if( s.entries.end() != i && e == i->second )
+				{
+					s.entries.erase( i );
+				}
+			}
+			e->set_state( entry::FAILED );
+			throw;
+		}
+		e->set_state( entry::CREATED );
+		return *( e->element );
+	}
+
+public:
+	ConcurrentCache(
+		const element_creator_t & element_creator = element_creator_t()
+	)
+	: shards( new shards_t )
+	, element_creator( element_creator )
+	{
+	}
+
+	element_t & operator()( const key_t & key ) const
+	{
+		shard & s = get_shard( key );
+		while( true )
+		{
+			entry_ptr e;
+			bool create_it = false;
+			{
+				boost::lock_guard< boost::mutex > lock( s.mutex );
+				entry_ptr & found = s.entries[ key ];
+				if( ! found )
+				{
+					found.reset( new entry );
+					create_it = true;
+				}
+				e = found;
+			}
+
+			if( create_it )
+			{
+				return create( s, key, e );
+			}
+
+			if( entry::CREATED == e->state.load( boost::memory_order_acquire ) || entry::CREATED == e->wait() )
+			{
+				return *( e->element );
+			}
+			// creation failed in another thread so try again
+		}
+	}
+
+	/** Has the element for the key been created? */
+	bool contains( const key_t & key ) const
+	{
+		shard & s = get_shard( key );
+		boost::lock_guard< boost::mutex > lock( s.mutex );
+		typename std::map< key_t, entry_ptr >::const_iterator i = s.entries.find( key );
+		return s.entries.end() != i && entry::CREATED == i->second->state.load( boost::memory_order_acquire );
+	}
+
+	/** Insert an element into the cache, if not already there. Returns true if element inserted. */
+	bool insert( const key_t & key, const element_t & element )
+	{
+		shard & s = get_shard( key );
+		boost::lock_guard< boost::mutex > lock( s.mutex );
+		return s.entries.insert( std::make_pair( key, entry_ptr( new entry( element ) ) ) ).second;
+	}
+
+	/** Insert all the elements in the map that are not already in the cache. */
+	void insert( const map_t & elements )
+	{
+		BOOST_FOREACH( const typename map_t::value_type & element, elements )
+		{
+			insert( element.first, element.second );
+		}
+	}
+
+	/** Remove the element, if any. Use with caution: references to it become invalid. */
+	void erase( const key_t & key )
+	{
+		shard & s = get_shard( key );
+		boost::lock_guard< boost::mutex > lock( s.mutex );
+		s.entries.erase( key );
+	}
+
+	/** A copy of all the elements that have been created. */
+	map_t get_elements() const
+	{
+		map_t result;
+		BOOST_FOREACH( shard & s, *shards )
+		{
+			boost::lock_guard< boost::mutex > lock( s.mutex );
+			typedef typename std::map< key_t, entry_ptr >::value_type value_t;
+			BOOST_FOREACH( const value_t & e, s.entries )
+			{
+				if( entry::CREATED == e.second->state.load( boost::memory_order_acquire ) )
+				{
+					result.insert( typename map_t::value_type( e.first, *( e.second->element ) ) );
+				}
+			}
+		}
+		return result;
+	}
+
+	/** Use with caution. */
+	void clear()
+	{
+		BOOST_FOREACH( shard & s, *shards )
+		{
+			boost::lock_guard< boost::mutex > lock( s.mutex );
+			s.entries.clear();
+		}
+	}
+};
+
+
+
 
 BIO_NS_END
 
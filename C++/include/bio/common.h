@@ -112,6 +112,17 @@ private:
 typedef std::vector<TableLink> TableLinkVec;
 TableLink parse_table_link_accession_number(const std::string & accession_number);
 
+/** So that TableLinks can be used as keys in hashed containers. */
+inline
+std::size_t
+hash_value(const TableLink & tl)
+{
+	std::size_t seed = 0;
+	boost::hash_combine(seed, int(tl.table_id));
+	boost::hash_combine(seed, tl.entry_idx);
+	return seed;
+}
+
 std::ostream &
 operator<<(std::ostream & os, const TableLink & tl);
 
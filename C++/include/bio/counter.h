@@ -33,7 +33,7 @@ struct Counter : public std::map< Key, unsigned >
 	/** Sets count to 0 unless it already exists. */
 	void initialise(const Key & key)
 	{
-		insert(value_type(key, 0));
+		base_t::insert(typename base_t::value_type(key, 0));
 	}
 
 	/** Increment the count by one. */
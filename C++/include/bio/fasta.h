@@ -27,6 +27,31 @@ std::string parse_fasta_2(
 
 
 
+/** Receives the sequences in a fasta stream a chunk at a time. */
+struct FastaChunkHandler
+{
+	virtual ~FastaChunkHandler() { }
+
+	/** Called at the start of each sequence with its identifier line (without the '>'). */
+	virtual void begin_sequence(const std::string & id) = 0;
+
+	/** Called with consecutive parts of the current sequence. */
+	virtual void handle_chunk(const seq_t & chunk) = 0;
+
+	/** Called at the end of each sequence. */
+	virtual void end_sequence() = 0;
+};
+
+/** Parses fasta in the same way as parse_fasta_2() but hands each sequence to the handler in chunks of
+at least chunk_size bases (except the last of each sequence) so that sequences of any length can be
+processed in bounded memory. */
+void parse_fasta_in_chunks(
+	std::istream & stream,
+	FastaChunkHandler & handler,
+	size_t chunk_size);
+
+
+
 BIO_NS_END
 
 
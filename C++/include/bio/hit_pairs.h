@@ -0,0 +1,68 @@
+#ifndef BIO_HIT_PAIRS_H_
+#define BIO_HIT_PAIRS_H_
+
+#include "bio/defs.h"
+
+#include <boost/assert.hpp>
+
+#include <vector>
+#include <algorithm>
+
+
+BIO_NS_START
+
+
+/**
+Calls fn( h1, h2 ) for each pair of hits where h2 starts between min_gap and max_gap bases (inclusive)
+after the end of h1. The hits must be ordered by position and min_gap must not be negative, so h2
+always comes after h1.
+
+The hits' positions and ends are read once up front and the first h2 for each h1 is found by binary
+search, so only the pairs that are within range are visited rather than every pair of hits. The pairs
+are visited in the same order as comparing each hit with those after it would.
+*/
+template< typename HitIt, typename Fn >
+Fn
+for_each_hit_pair(
+	HitIt hits_begin,
+	HitIt hits_end,
+	int min_gap,
+	int max_gap,
+	Fn fn )
+{
+	BOOST_ASSERT( 0 <= min_gap );
+
+	std::vector< HitIt > hits;
+	std::vector< int > positions;
+	std::vector< int > ends;
+	for( ; hits_end != hits_begin; ++hits_begin )
+	{
+		hits.push_back( hits_begin );
+		positions.push_back( hits_begin->get_position() );
+		ends.push_back( hits_begin->get_end() );
+	}
+
+	if( max_gap < min_gap )
+	{
+		return fn;
+	}
+
+	const size_t num_hits = hits.size();
+	for( size_t i = 0; num_hits != i; ++i )
+	{
+		const int last_start = ends[ i ] + max_gap;
+		for( size_t j = std::lower_bound( positions.begin() + i + 1, positions.end(), ends[ i ] + min_gap ) - positions.begin();
+			num_hits != j && positions[ j ] <= last_start;
+			++j )
+		{
+			fn( *hits[ i ], *hits[ j ] );
+		}
+	}
+
+	return fn;
+}
+
+
+BIO_NS_END
+
+#endif //BIO_HIT_PAIRS_H_
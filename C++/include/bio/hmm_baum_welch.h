@@ -2,6 +2,7 @@
 #define BIO_BAUM_WELCH_H_
 
 #include "bio/hmm_forward_backward.h"
+#include "bio/parallel.h"
 
 #include <algorithm>
 #include <limits>
@@ -19,8 +20,8 @@ BIO_NS_START
 
 
 
-template< bool use_scaling >
-struct BaumWelchAlgorithm : public ForwardBackwardAlgorithm< use_scaling >
+/** The estimates the Baum-Welch algorithm makes from one sequence. */
+struct BaumWelchEstimates
 {
 	/** Numerator of the estimate of the transition probablities. */
 	prob_matrix_t xi_sum_t;
@@ -37,6 +38,131 @@ struct BaumWelchAlgorithm : public ForwardBackwardAlgorithm< use_scaling >
 	/** The initial estimates to update to. */
 	prob_vector_t pi;
 
+	template <class HMM>
+	void update(HMM & hmm)
+	{
+		const size_t num_states = hmm.states.size();
+		const size_t alphabet_size = AlphabetTraits<typename HMM::alphabet_t>::get_size();
+
+		//for each state
+		for (size_t i = 0; i != num_states; ++i)
+		{
+			//update initial probs
+			hmm.states[i].initial_prob = pi[i];
+
+			//only update transition probs if we have something to update with
+			if (! transition_probs[i].empty())
+			{
+				//can update transition probs here as well
+				for (size_t j = 0; j < num_states; ++j)
+				{
+					hmm.states[i].transition_probs[j] = transition_probs[i][j];
+				}
+			}
+
+			//only update emission probs if we visited the state
+			if (gamma_sum[i] != 0.0)
+			{
+				for (size_t k = 0; k < alphabet_size; ++k)
+				{
+					const prob_t new_emission_prob = gamma_sum_obs_v[i][k] / gamma_sum[i];
+					if (! BIO_FINITE(new_emission_prob))
+					{
+						throw std::logic_error( "Overflow" );
+					}
+					hmm.states[i].emission_probs[k] = new_emission_prob;
+
+				} //for each alphabet symbol, k
+			}
+		}
+	}
+
+protected:
+	/** Resize the estimates and set them to 0. */
+	void
+	reset_estimates(size_t num_states, size_t alphabet_size)
+	{
+		xi_sum_t.resize(num_states);
+		gamma_sum_obs_v.resize(num_states);
+		for (size_t i = 0; i < num_states; ++i)
+		{
+			xi_sum_t[i].resize(num_states);
+			std::fill(xi_sum_t[i].begin(), xi_sum_t[i].end(), 0.0);
+			gamma_sum_obs_v[i].resize(alphabet_size);
+			std::fill(gamma_sum_obs_v[i].begin(), gamma_sum_obs_v[i].end(), 0.0);
+		}
+		gamma_sum.resize(num_states);
+		std::fill(gamma_sum.begin(), gamma_sum.end(), 0.0);
+
+		//stores the newly calculated transition probabilities
+		transition_probs.clear();
+		transition_probs.resize(num_states);
+
+		//only estimated if the sequence is not empty
+		pi.clear();
+	}
+
+	/** Estimate the initial probabilities from gamma at the first observation. */
+	void
+	estimate_pi(prob_vector_t & gamma)
+	{
+		const prob_t initial_prob_sum = std::accumulate(gamma.begin(), gamma.end(), 0.0);
+		if (0.0 == initial_prob_sum)
+		{
+			//if sum(gamma[i]) is 0 then distribute the initial states evenly
+			std::fill(gamma.begin(), gamma.end(), 1.0 / gamma.size());
+		}
+		else if (0.999 > initial_prob_sum || initial_prob_sum > 1.001)
+		{
+			//normalise
+			std::transform(
+				gamma.begin(),
+				gamma.end(),
+				gamma.begin(),
+				std::bind1st(std::multiplies<prob_t>(), 1.0 / initial_prob_sum));
+		}
+
+		pi.assign(gamma.begin(), gamma.end());
+	}
+
+	/** Save the transition probabilities once we have got to T-1. */
+	void
+	estimate_transition_probs()
+	{
+		const size_t num_states = gamma_sum.size();
+		for (size_t i = 0; i < num_states; ++i)
+		{
+			if (gamma_sum[i] == 0.0)
+			{
+				//no reason to update emission or transition probs as we have not been in state i
+				//we leave the i'th vector in 'a' empty as a marker of this fact.
+			}
+			else
+			{
+				//transition probs
+				for (size_t j = 0; j < num_states; ++j)
+				{
+					const prob_t new_transition_prob = xi_sum_t[i][j] / gamma_sum[i];
+					if (! BIO_FINITE(new_transition_prob))
+					{
+						throw std::logic_error( "Overflow" );
+					}
+					transition_probs[i].push_back(new_transition_prob);
+
+				} //for each state, j
+
+			}
+		}
+	}
+};
+
+
+
+template< bool use_scaling >
+struct BaumWelchAlgorithm
+	: public ForwardBackwardAlgorithm< use_scaling >
+	, public BaumWelchEstimates
+{
 	/**
 	HMM is a hidden markov model
 	ObsIt is an iterator over the observed sequence
@@ -102,29 +228,16 @@ struct BaumWelchAlgorithm : public ForwardBackwardAlgorithm< use_scaling >
 		//stores the probability of a pair of consecutive states
 		prob_matrix_t xi_t; //for current t
 		xi_t.resize(num_states);
-		xi_sum_t.resize(num_states);
-		for (size_t i = 0; i < num_states; ++i) //resize and initialise matrices
+		for (size_t i = 0; i < num_states; ++i)
 		{
 			xi_t[i].resize(num_states);
-			xi_sum_t[i].resize(num_states);
-			std::fill(xi_sum_t[i].begin(), xi_sum_t[i].end(), 0.0);
 		}
 
 		//stores the sum of a row of xi
 		prob_vector_t gamma; //gamma for current t
 		gamma.resize(num_states);
-		gamma_sum.resize(num_states);
-		std::fill(gamma_sum.begin(), gamma_sum.end(), 0.0);
-		gamma_sum_obs_v.resize(num_states);
-		for (size_t i = 0; i < num_states; ++i)
-		{
-			gamma_sum_obs_v[i].resize(alphabet_size);
-			std::fill(gamma_sum_obs_v[i].begin(), gamma_sum_obs_v[i].end(), 0.0);
-		}
 
-		//stores the newly calculated transition probabilities
-		transition_probs.clear();
-		transition_probs.resize(num_states);
+		reset_estimates(num_states, alphabet_size);
 
 		//for each observation
 		ObsIt o = o_begin;
@@ -205,28 +318,7 @@ struct BaumWelchAlgorithm : public ForwardBackwardAlgorithm< use_scaling >
 			//if it is the first observation we can estimate the initial probabilities
 			if (0 == t)
 			{
-				const prob_t initial_prob_sum = std::accumulate(gamma.begin(), gamma.end(), 0.0);
-				if (0.0 == initial_prob_sum)
-				{
-					//if sum(gamma[i]) is 0 then distribute the initial states evenly
-					std::fill(gamma.begin(), gamma.end(), 1.0 / gamma.size());
-				}
-				else if (0.999 > initial_prob_sum || initial_prob_sum > 1.001)
-				{
-					//normalise
-					std::transform(
-						gamma.begin(),
-						gamma.end(),
-						gamma.begin(),
-						std::bind1st(std::multiplies<prob_t>(), 1.0 / initial_prob_sum));
-				}
-
-				pi.clear();
-				for (size_t i = 0; i < num_states; ++i)
-				{
-					pi.push_back(gamma[i]);
-				} //for each state, i
-
+				estimate_pi(gamma);
 			}
 
 			++t;
@@ -234,84 +326,295 @@ struct BaumWelchAlgorithm : public ForwardBackwardAlgorithm< use_scaling >
 			//if we have got to T-1 save the transition probabilities
 			if (t == num_obs - 1)
 			{
-				for (size_t i = 0; i < num_states; ++i)
+				estimate_transition_probs();
+			}
+
+		} //for each time, t
+	}
+};
+
+
+
+/**
+BaumWelchAlgorithm on a CompiledHmm. Makes the same estimates but reuses its matrices from one
+sequence to the next and only needs the observations once.
+*/
+template< bool use_scaling >
+struct CompiledBaumWelchAlgorithm
+	: public CompiledForwardBackwardAlgorithm< use_scaling >
+	, public BaumWelchEstimates
+{
+	/** Stores the probability of a pair of consecutive states for the current t, row i holds the transitions from i. */
+	prob_vector_t xi_t;
+
+	/** Stores the sum of a row of xi for the current t. */
+	prob_vector_t gamma;
+
+	/**
+	HMM is a hidden markov model
+	ObsIt is an iterator over the observed sequence
+	*/
+	template <
+		class HMM,
+		class ObsIt>
+	void
+	run(
+		HMM & hmm,
+		ObsIt o_begin,
+		ObsIt o_end)
+	{
+		if (o_begin != o_end)
+		{
+			calculate_estimates(
+				CompiledHmm<typename HMM::alphabet_t>(hmm),
+				o_begin,
+				o_end);
+
+			update(hmm);
+		}
+	}
+
+	template <
+		class Alphabet,
+		class ObsIt>
+	void
+	calculate_estimates(
+		const CompiledHmm<Alphabet> & hmm,
+		ObsIt o_begin,
+		ObsIt o_end)
+	{
+		const size_t num_states = hmm.num_states;
+
+		CompiledForwardBackwardAlgorithm< use_scaling >::template forward(
+			hmm,
+			o_begin,
+			o_end);
+
+		CompiledForwardBackwardAlgorithm< use_scaling >::template backward(hmm);
+
+		const size_t num_obs = this->alpha.size();
+		assert(this->beta.size() == num_obs);
+
+		xi_t.resize(num_states * num_states);
+		gamma.resize(num_states);
+		reset_estimates(num_states, hmm.alphabet_size);
+
+		//for each observation
+		size_t t;
+		for (t = 0; t != num_obs; )
+		{
+			const unsigned symbol = this->symbols[t];
+			const prob_t * alpha_t = this->alpha[t];
+			const prob_t * beta_t = this->beta[t];
+			const prob_t * emissions = hmm.emissions_of(symbol);
+
+			prob_t xi_sum = 0.0;
+			std::fill(gamma.begin(), gamma.end(), 0.0);
+
+			//for each state, i
+			for (size_t i = 0; i < num_states; ++i)
+			{
+				const prob_t p_state_i_at_t = alpha_t[i];
+				const prob_t p_observe_o = emissions[i];
+				const prob_t * transitions = hmm.transitions_from(i);
+				prob_t * xi_t_i = &xi_t[i * num_states];
+
+				//for each state, j
+				for (size_t j = 0; j < num_states; ++j)
 				{
-					if (gamma_sum[i] == 0.0)
+					xi_t_i[j] =
+						p_state_i_at_t
+						* transitions[j]
+						* p_observe_o
+						* beta_t[j];
+
+					xi_sum += xi_t_i[j];
+				} //for each state, j
+
+			} //for each state, i
+			BOOST_ASSERT(BIO_FINITE(xi_sum));
+
+			//deal with zero denominator
+			if (0.0 == xi_sum)
+			{
+				//a sequence might legitimately have 0 likelihood
+				xi_sum = std::numeric_limits<prob_t>::min();
+			}
+
+			//divide each element by the sum and update xi_sum_t
+			for (size_t i = 0; i < num_states; ++i)
+			{
+				prob_t * xi_t_i = &xi_t[i * num_states];
+				prob_vector_t & xi_sum_t_i = xi_sum_t[i];
+				for (size_t j = 0; j < num_states; ++j)
+				{
+
+					xi_t_i[j] /= xi_sum;
+					if (! BIO_FINITE(xi_t_i[j]))
 					{
-						//no reason to update emission or transition probs as we have not been in state i
-						//we leave the i'th vector in 'a' empty as a marker of this fact.
+						throw std::logic_error( "Overflow" );
 					}
-					else
-					{
-						//transition probs
-						for (size_t j = 0; j < num_states; ++j)
-						{
-							const prob_t new_transition_prob = xi_sum_t[i][j] / gamma_sum[i];
-							if (! BIO_FINITE(new_transition_prob))
-							{
-								throw std::logic_error( "Overflow" );
-							}
-							transition_probs[i].push_back(new_transition_prob);
-
-						} //for each state, j
 
-					}
-				}
+					xi_sum_t_i[j] += xi_t_i[j];
+					gamma[i] += xi_t_i[j];
+
+				} //for each state, j
+
+				//update gamma_sum and gamma_sum_obs_v
+				gamma_sum[i] += gamma[i];
+				gamma_sum_obs_v[i][symbol] += gamma[i];
+
+			} //for each state, i
+
+			//if it is the first observation we can estimate the initial probabilities
+			if (0 == t)
+			{
+				estimate_pi(gamma);
+			}
+
+			++t;
+
+			//if we have got to T-1 save the transition probabilities
+			if (t == num_obs - 1)
+			{
+				estimate_transition_probs();
 			}
 
 		} //for each time, t
 	}
+};
 
-	template <class HMM>
-	void update(HMM & hmm)
+
+
+/**
+The sufficient statistics that BaumWelchMultipleAlgorithm needs from the single sequence estimates
+of some of the sequences. Lets us forget each sequence's alpha and beta matrices once we have them.
+*/
+struct BaumWelchStatistics
+{
+	/** Sum of the initial probability estimates. */
+	prob_vector_t pi_sum;
+
+	/** Number of sequences with initial probability estimates, i.e. non-empty ones. */
+	unsigned pi_count;
+
+	/** Sum of the transition probability estimates from each state. */
+	prob_matrix_t transition_sum;
+
+	/** Number of sequences with transition probability estimates from each state. */
+	std::vector<unsigned> transition_count;
+
+	/** Sum of gamma_sum_obs_v, the numerators of the emission probability estimates. */
+	prob_matrix_t gamma_sum_obs_v;
+
+	/** Sum of gamma_sum, the denominators of the emission probability estimates. */
+	prob_vector_t gamma_sum;
+
+	BaumWelchStatistics()
+		: pi_count(0)
 	{
-		const size_t num_states = hmm.states.size();
-		const size_t alphabet_size = AlphabetTraits<typename HMM::alphabet_t>::get_size();
+	}
 
-		//for each state
-		for (size_t i = 0; i != num_states; ++i)
+	/** Set all the statistics to 0. */
+	void
+	reset(size_t num_states, size_t alphabet_size)
+	{
+		pi_sum.assign(num_states, 0.0);
+		pi_count = 0;
+		transition_sum.assign(num_states, prob_vector_t(num_states, 0.0));
+		transition_count.assign(num_states, 0);
+		gamma_sum_obs_v.assign(num_states, prob_vector_t(alphabet_size, 0.0));
+		gamma_sum.assign(num_states, 0.0);
+	}
+
+	/** Add the estimates from one sequence. */
+	void
+	add(const BaumWelchEstimates & alg)
+	{
+		const size_t num_states = pi_sum.size();
+
+		if (! alg.pi.empty()) //can be empty if empty test sequence
 		{
-			//update initial probs
-			hmm.states[i].initial_prob = pi[i];
+			for (size_t i = 0; i < num_states; ++i)
+			{
+				pi_sum[i] += alg.pi[i];
+			}
+			++pi_count;
+		}
 
-			//only update transition probs if we have something to update with
-			if (! transition_probs[i].empty())
+		for (size_t i = 0; i < num_states; ++i)
+		{
+			//were we in this state in this sequence?
+			if (! alg.transition_probs[i].empty())
 			{
-				//can update transition probs here as well
 				for (size_t j = 0; j < num_states; ++j)
 				{
-					hmm.states[i].transition_probs[j] = transition_probs[i][j];
+					transition_sum[i][j] += alg.transition_probs[i][j];
 				}
+				++transition_count[i];
 			}
 
-			//only update emission probs if we visited the state
-			if (gamma_sum[i] != 0.0)
+			if (0 != alg.gamma_sum[i])
 			{
-				for (size_t k = 0; k < alphabet_size; ++k)
+				for (size_t l = 0; l < gamma_sum_obs_v[i].size(); ++l)
 				{
-					const prob_t new_emission_prob = gamma_sum_obs_v[i][k] / gamma_sum[i];
-					if (! BIO_FINITE(new_emission_prob))
-					{
-						throw std::logic_error( "Overflow" );
-					}
-					hmm.states[i].emission_probs[k] = new_emission_prob;
+					gamma_sum_obs_v[i][l] += alg.gamma_sum_obs_v[i][l];
+				}
+				gamma_sum[i] += alg.gamma_sum[i];
+			}
+		}
+	}
 
-				} //for each alphabet symbol, k
+	/** Add the statistics from other sequences. */
+	void
+	add(const BaumWelchStatistics & other)
+	{
+		const size_t num_states = pi_sum.size();
+
+		for (size_t i = 0; i < num_states; ++i)
+		{
+			pi_sum[i] += other.pi_sum[i];
+			for (size_t j = 0; j < num_states; ++j)
+			{
+				transition_sum[i][j] += other.transition_sum[i][j];
+			}
+			transition_count[i] += other.transition_count[i];
+			for (size_t l = 0; l < gamma_sum_obs_v[i].size(); ++l)
+			{
+				gamma_sum_obs_v[i][l] += other.gamma_sum_obs_v[i][l];
 			}
+			gamma_sum[i] += other.gamma_sum[i];
 		}
+		pi_count += other.pi_count;
 	}
 };
 
 
 
-/** Executes the baum welch algorithm for the multiple sequence case. */
+/**
+Executes the baum welch algorithm for the multiple sequence case.
+
+The sequences are split into one contiguous block per thread. Each thread runs forward-backward on
+the sequences in its block one at a time on a CompiledHmm that is shared by all the threads and adds
+their estimates to the block's statistics, so memory use does not grow with the number of sequences. The blocks' statistics are summed in order
+so the estimates only depend on the number of threads through rounding.
+*/
 template <bool use_scaling>
 struct BaumWelchMultipleAlgorithm
 {
-	typedef BaumWelchAlgorithm<use_scaling> alg_t;
-	typedef std::vector<alg_t> alg_vec;
+	typedef CompiledBaumWelchAlgorithm<use_scaling> alg_t;
+
+	/** How many threads to use, 0 for one per core. */
+	unsigned num_threads;
+
+	/** The statistics summed over all the sequences. */
+	BaumWelchStatistics statistics;
+
 
-	alg_vec algs;
+	BaumWelchMultipleAlgorithm(unsigned num_threads = 1)
+		: num_threads(num_threads)
+	{
+	}
 
 
 	template <
@@ -338,18 +641,28 @@ struct BaumWelchMultipleAlgorithm
 		SeqIt seq_begin,
 		SeqIt seq_end)
 	{
-		//construct a vector of single sequence baum welch algorithms
-		for (SeqIt s = seq_begin;
-			seq_end != s;
-			++s)
+		const size_t num_states = hmm.states.size();
+		const size_t alphabet_size = AlphabetTraits<typename HMM::alphabet_t>::get_size();
+
+		//the sequences might not be random access
+		std::vector<SeqIt> seqs;
+		for (SeqIt s = seq_begin; seq_end != s; ++s)
 		{
-			algs.push_back(alg_t());
-			algs.rbegin()->calculate_estimates(
-				hmm,
-				s->begin(),
-				s->end(),
-				s->rbegin(),
-				s->rend());
+			seqs.push_back(s);
+		}
+
+		const size_t num_blocks = std::max<size_t>(1, std::min<size_t>(resolve_num_threads(num_threads), seqs.size()));
+		const CompiledHmm<typename HMM::alphabet_t> compiled(hmm);
+		std::vector<BaumWelchStatistics> block_statistics(num_blocks);
+		parallel_for(
+			num_blocks,
+			num_threads,
+			block_estimator<typename HMM::alphabet_t, SeqIt>(compiled, seqs, block_statistics));
+
+		statistics.reset(num_states, alphabet_size);
+		for (size_t b = 0; num_blocks != b; ++b)
+		{
+			statistics.add(block_statistics[b]);
 		}
 	}
 
@@ -366,48 +679,18 @@ struct BaumWelchMultipleAlgorithm
 		for (size_t i = 0; i < num_states; ++i)
 		{
 			//the initial probs
-			prob_t initial_prob = 0;
-			unsigned num_samples = 0;
-			for (typename alg_vec::const_iterator a = algs.begin();
-				algs.end() != a;
-				++a)
+			if (0 != statistics.pi_count)
 			{
-				if (! a->pi.empty()) //can be empty if empty test sequence
-				{
-					initial_prob += a->pi[i];
-					++num_samples;
-				}
-			}
-			if (0 != num_samples)
-			{
-				hmm.states[i].initial_prob = initial_prob / num_samples;
+				hmm.states[i].initial_prob = statistics.pi_sum[i] / statistics.pi_count;
 			}
 
 
-			//transition probs
-			for (size_t j = 0; j < num_states; ++j)
+			//transition probs - the average of the estimates from the sequences we were in this state in
+			if (0 != statistics.transition_count[i])
 			{
-				prob_t numerator = 0.0;
-				unsigned num_samples = 0;
-
-				for (typename alg_vec::const_iterator a = algs.begin();
-					algs.end() != a;
-					++a)
-				{
-					//were we in this state in this sequence?
-					if (a->transition_probs[i].empty())
-					{
-						//no - so there is no contribution from this sequence to this state
-						continue;
-					}
-
-					numerator += a->transition_probs[i][j];
-					++num_samples;
-				}
-
-				if (0.0 != num_samples)
+				for (size_t j = 0; j < num_states; ++j)
 				{
-					hmm.states[i].transition_probs[j] = numerator / num_samples;
+					hmm.states[i].transition_probs[j] = statistics.transition_sum[i][j] / statistics.transition_count[i];
 					if (! BIO_FINITE(hmm.states[i].transition_probs[j]))
 					{
 						throw std::logic_error( "Overflow" );
@@ -416,56 +699,79 @@ struct BaumWelchMultipleAlgorithm
 			}
 
 			//emission probs
-			for (size_t l = 0; l < alphabet_size; ++l)
+			if (0.0 != statistics.gamma_sum[i])
 			{
-				prob_t numerator = 0.0;
-				prob_t denominator = 0.0;
-
-				for (typename alg_vec::const_iterator a = algs.begin();
-					algs.end() != a;
-					++a)
-				{
-					//were we in this state in this sequence?
-					if (0 == a->gamma_sum[i])
-					{
-						//no - so there is no contribution from this sequence to this state
-						continue;
-					}
-
-					numerator += a->gamma_sum_obs_v[i][l];
-					denominator += a->gamma_sum[i];
-				}
-
-				if (0.0 != denominator)
+				for (size_t l = 0; l < alphabet_size; ++l)
 				{
-					hmm.states[i].emission_probs[l] = numerator / denominator;
+					hmm.states[i].emission_probs[l] = statistics.gamma_sum_obs_v[i][l] / statistics.gamma_sum[i];
 					if (! BIO_FINITE(hmm.states[i].emission_probs[l]))
 					{
 						throw std::logic_error( "Overflow" );
 					}
-				}
-			} //for each alphabet symbol, l
+				} //for each alphabet symbol, l
+			}
 		}
 	}
+
+
+protected:
+	/** Estimates the statistics for one block of the sequences. */
+	template <
+		class Alphabet,
+		class SeqIt>
+	struct block_estimator
+	{
+		const CompiledHmm<Alphabet> & hmm;
+		const std::vector<SeqIt> & seqs;
+		std::vector<BaumWelchStatistics> & block_statistics;
+
+		block_estimator(
+			const CompiledHmm<Alphabet> & hmm,
+			const std::vector<SeqIt> & seqs,
+			std::vector<BaumWelchStatistics> & block_statistics)
+			: hmm(hmm)
+			, seqs(seqs)
+			, block_statistics(block_statistics)
+		{
+		}
+
+		void operator()(size_t b)
+		{
+			const size_t num_blocks = block_statistics.size();
+			BaumWelchStatistics & stats = block_statistics[b];
+			stats.reset(hmm.num_states, hmm.alphabet_size);
+
+			//reuse the algorithm's matrices for each sequence in the block
+			alg_t alg;
+			for (size_t s = b * seqs.size() / num_blocks; (b + 1) * seqs.size() / num_blocks != s; ++s)
+			{
+				alg.calculate_estimates(
+					hmm,
+					seqs[s]->begin(),
+					seqs[s]->end());
+				stats.add(alg);
+			}
+		}
+	};
 };
 
+/** The reversed sequence is no longer needed but is kept in the signature for existing callers. */
 template <class HMM, class SeqIt, class SeqRIt>
 void
-baum_welch_single(HMM & hmm, SeqIt seq_begin, SeqIt seq_end, SeqRIt seq_rbegin, SeqRIt seq_rend)
+baum_welch_single(HMM & hmm, SeqIt seq_begin, SeqIt seq_end, SeqRIt, SeqRIt)
 {
-	BaumWelchAlgorithm<true>().run(
+	CompiledBaumWelchAlgorithm<true>().run(
 		hmm,
 		seq_begin,
-		seq_end,
-		seq_rbegin,
-		seq_rend);
+		seq_end);
 }
 
+/** num_threads is how many threads to use in the E-step, 0 for one per core. */
 template <class HMM, class SeqListIt>
 void
-baum_welch_multiple(HMM & hmm, SeqListIt seq_list_begin, SeqListIt seq_list_end)
+baum_welch_multiple(HMM & hmm, SeqListIt seq_list_begin, SeqListIt seq_list_end, unsigned num_threads = 1)
 {
-	BaumWelchMultipleAlgorithm<true>().run(
+	BaumWelchMultipleAlgorithm<true>(num_threads).run(
 		hmm,
 		seq_list_begin,
 		seq_list_end);
@@ -0,0 +1,159 @@
+#ifndef BIO_HMM_COMPILED_H_
+#define BIO_HMM_COMPILED_H_
+
+#include "bio/hidden_markov_model.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+BIO_NS_START
+
+
+/**
+A matrix of values indexed by time then state, held in one contiguous buffer. Resizing it does not
+free its storage so one can be reused for sequences of different lengths without reallocating.
+*/
+template <class T>
+struct HmmMatrix
+{
+	typedef std::vector<T> value_vector_t;
+
+	value_vector_t values;
+	size_t num_obs;
+	size_t num_states;
+
+	HmmMatrix() : num_obs(0), num_states(0) { }
+
+	void
+	resize(size_t new_num_obs, size_t new_num_states)
+	{
+		num_obs = new_num_obs;
+		num_states = new_num_states;
+		values.resize(num_obs * num_states);
+	}
+
+	/** The number of observations. */
+	size_t size() const { return num_obs; }
+
+	/** The values for all the states at time t. */
+	T * operator[](size_t t) { return &values[0] + t * num_states; }
+	const T * operator[](size_t t) const { return &values[0] + t * num_states; }
+};
+
+
+
+/**
+The parameters of a HiddenMarkovModel laid out for the inner loops of the compiled forward, backward,
+Baum-Welch and Viterbi algorithms. Rows are contiguous so those loops run over the states:
+
+- transitions_from(i)[j] and transitions_into(j)[i] are both the probability of i -> j.
+- emissions_of(v)[i] is the probability state i emits symbol v.
+
+The logs of the parameters, which Viterbi with logs uses, are only calculated by compile_logs().
+The model must be compiled again whenever the HiddenMarkovModel changes.
+*/
+template <class Alphabet>
+struct CompiledHmm
+{
+	typedef Alphabet alphabet_t;
+
+	size_t num_states;
+	size_t alphabet_size;
+	prob_vector_t initial_probs;
+	prob_vector_t transition_probs; /**< num_states x num_states, row i holds the transitions from i. */
+	prob_vector_t transposed_transition_probs; /**< num_states x num_states, row j holds the transitions into j. */
+	prob_vector_t emission_probs; /**< alphabet_size x num_states, row v holds each state's probability of emitting v. */
+	prob_vector_t log_initial_probs;
+	prob_vector_t log_transition_probs;
+	prob_vector_t log_emission_probs;
+
+	CompiledHmm() : num_states(0), alphabet_size(0) { }
+
+	template <class HMM>
+	explicit
+	CompiledHmm(const HMM & hmm)
+	{
+		compile(hmm);
+	}
+
+	template <class HMM>
+	void
+	compile(const HMM & hmm)
+	{
+		num_states = hmm.states.size();
+		alphabet_size = AlphabetTraits<alphabet_t>::get_size();
+
+		initial_probs.resize(num_states);
+		transition_probs.resize(num_states * num_states);
+		transposed_transition_probs.resize(num_states * num_states);
+		emission_probs.resize(alphabet_size * num_states);
+		for (size_t i = 0; num_states != i; ++i)
+		{
+			initial_probs[i] = hmm.states[i].initial_prob;
+			for (size_t j = 0; num_states != j; ++j)
+			{
+				transition_probs[i * num_states + j] = hmm.states[i].transition_probs[j];
+				transposed_transition_probs[j * num_states + i] = hmm.states[i].transition_probs[j];
+			}
+			for (size_t v = 0; alphabet_size != v; ++v)
+			{
+				emission_probs[v * num_states + i] = hmm.states[i].emission_probs[v];
+			}
+		}
+
+		log_initial_probs.clear();
+		log_transition_probs.clear();
+		log_emission_probs.clear();
+	}
+
+	/** Calculate the logs of the parameters. */
+	void
+	compile_logs()
+	{
+		log_initial_probs.resize(initial_probs.size());
+		std::transform(initial_probs.begin(), initial_probs.end(), log_initial_probs.begin(), log_of());
+		log_transition_probs.resize(transition_probs.size());
+		std::transform(transition_probs.begin(), transition_probs.end(), log_transition_probs.begin(), log_of());
+		log_emission_probs.resize(emission_probs.size());
+		std::transform(emission_probs.begin(), emission_probs.end(), log_emission_probs.begin(), log_of());
+	}
+
+	bool has_logs() const { return log_initial_probs.size() == num_states; }
+
+	const prob_t * transitions_from(size_t i) const { return &transition_probs[0] + i * num_states; }
+	const prob_t * transitions_into(size_t j) const { return &transposed_transition_probs[0] + j * num_states; }
+	const prob_t * emissions_of(size_t v) const { return &emission_probs[0] + v * num_states; }
+	const prob_t * log_transitions_from(size_t i) const { return &log_transition_probs[0] + i * num_states; }
+	const prob_t * log_emissions_of(size_t v) const { return &log_emission_probs[0] + v * num_states; }
+
+	/** Convert the observations to indices into the alphabet. */
+	template <class ObsIt>
+	void
+	get_symbols(ObsIt o_begin, ObsIt o_end, std::vector<unsigned> & symbols) const
+	{
+		symbols.clear();
+		for ( ; o_end != o_begin; ++o_begin)
+		{
+			const unsigned idx = unsigned(AlphabetTraits<alphabet_t>::get_index(*o_begin));
+			if (idx >= alphabet_size)
+			{
+				throw std::logic_error( "Index out of range" );
+			}
+			symbols.push_back(idx);
+		}
+	}
+
+protected:
+	struct log_of
+	{
+		prob_t operator()(prob_t p) const { return std::log(p); }
+	};
+};
+
+
+BIO_NS_END
+
+#endif //BIO_HMM_COMPILED_H_
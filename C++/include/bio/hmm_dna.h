@@ -61,6 +61,8 @@ public:
 	typedef DnaHmmAlphabet< order > alphabet_t;
 	typedef MarkovState<alphabet_t> state_t;
 	typedef HiddenMarkovModel<alphabet_t> model_t;
+	typedef CompiledHmm<alphabet_t> compiled_model_t;
+	typedef CompiledForwardBackwardAlgorithm<true> forward_t;
 	typedef HmmSequenceGenerator<alphabet_t> seq_gen_t;
 	typedef std::vector<alphabet_t> emission_seq_t;
 	typedef std::list<emission_seq_t> emission_seq_list_t;
@@ -96,8 +98,8 @@ public:
 	/** Return the per base likelihood under this model of the given sequence. */
 	virtual prob_t get_likelihood(const seq_t & sequence);
 
-	/** Train on multiple sequences concurrently. */
-	virtual void train(const SequenceCollection & sequences);
+	/** Train on multiple sequences concurrently using num_threads threads (0 for one per core). */
+	virtual void train(const SequenceCollection & sequences, unsigned num_threads = 1);
 
 	/** Return the per base likelihood under this model of the given sequences. */
 	virtual prob_t get_likelihood(const SequenceCollection & sequences);
@@ -120,6 +122,9 @@ protected:
 	static void convert_to_emission(const seq_t & seq, emission_seq_t & emission_seq);
 	static void convert_to_emission(const SequenceCollection & seq_list, emission_seq_list_t & emission_seq_list);
 	static void convert_to_dna(const emission_seq_t & emission_seq, seq_t & seq);
+
+	/** The per base likelihood of the sequence, reusing the compiled model and forward algorithm's workspace. */
+	static prob_t get_likelihood(const compiled_model_t & compiled, forward_t & forward, emission_seq_t & emission_seq, const seq_t & sequence);
 };
 
 
@@ -178,15 +183,14 @@ DnaHmm< order >::train(const seq_t & sequence)
 
 template< unsigned order >
 prob_t
-DnaHmm< order >::get_likelihood(const seq_t & sequence)
+DnaHmm< order >::get_likelihood(const compiled_model_t & compiled, forward_t & forward, emission_seq_t & emission_seq, const seq_t & sequence)
 {
-	emission_seq_t emission_seq;
 	convert_to_emission(sequence, emission_seq);
 
 	const prob_t log_prob =
-		ForwardBackwardAlgorithm<true>()
+		forward
 			.forward(
-				model,
+				compiled,
 				emission_seq.begin(),
 				emission_seq.end()).get_log_probability();
 
@@ -196,14 +200,23 @@ DnaHmm< order >::get_likelihood(const seq_t & sequence)
 			: std::exp(log_prob / (emission_seq.size() * (order + 1)));
 }
 
+template< unsigned order >
+prob_t
+DnaHmm< order >::get_likelihood(const seq_t & sequence)
+{
+	emission_seq_t emission_seq;
+	forward_t forward;
+	return get_likelihood(compiled_model_t(model), forward, emission_seq, sequence);
+}
+
 template< unsigned order >
 void
-DnaHmm< order >::train(const SequenceCollection & sequences)
+DnaHmm< order >::train(const SequenceCollection & sequences, unsigned num_threads)
 {
 	emission_seq_list_t emission_seq_list;
 	convert_to_emission(sequences, emission_seq_list);
 
-	BaumWelchMultipleAlgorithm<true> baum_welch;
+	BaumWelchMultipleAlgorithm<true> baum_welch(num_threads);
 	baum_welch.run(
 		model,
 		emission_seq_list.begin(),
@@ -214,10 +227,14 @@ template< unsigned order >
 prob_t
 DnaHmm< order >::get_likelihood(const SequenceCollection & sequences)
 {
+	//compile the model once and reuse the workspace for every sequence
+	const compiled_model_t compiled(model);
+	forward_t forward;
+	emission_seq_t emission_seq;
 	prob_t prob_sum = 0;
 	for (unsigned i = 0; sequences.num_sequences() != i; ++i)
 	{
-		prob_sum += get_likelihood(sequences.get_sequence(i));
+		prob_sum += get_likelihood(compiled, forward, emission_seq, sequences.get_sequence(i));
 	}
 	return (0 == sequences.num_sequences()) ? 1.0 : prob_sum / sequences.num_sequences();
 }
@@ -432,13 +449,13 @@ struct DnaHmmOrderNumStateMap
 		return i->second;
 	}
 
-	/** Train all the HMMs on the given sequences. */
-	void train_all(const SequenceCollection & seq_list)
+	/** Train all the HMMs on the given sequences using num_threads threads (0 for one per core). */
+	void train_all(const SequenceCollection & seq_list, unsigned num_threads = 1)
 	{
 		std::for_each(
 			models.begin(),
 			models.end(),
-			ModelTrainer(seq_list));
+			ModelTrainer(seq_list, num_threads));
 	}
 
 	void
@@ -476,15 +493,17 @@ struct DnaHmmOrderNumStateMap
 	struct ModelTrainer
 	{
 		const SequenceCollection & training_data;
+		unsigned num_threads;
 
-		ModelTrainer(const SequenceCollection & training_data)
+		ModelTrainer(const SequenceCollection & training_data, unsigned num_threads = 1)
 			: training_data(training_data)
+			, num_threads(num_threads)
 		{
 		}
 
 		void operator()(model_map_t::value_type model)
 		{
-			model.second->train(training_data);
+			model.second->train(training_data, num_threads);
 		}
 	};
 
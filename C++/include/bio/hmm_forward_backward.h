@@ -2,6 +2,7 @@
 #define BIO_FORWARD_BACKWARD_H_
 
 #include "bio/hidden_markov_model.h"
+#include "bio/hmm_compiled.h"
 
 #include <deque>
 #include <algorithm>
@@ -250,14 +251,174 @@ struct ForwardBackwardAlgorithm
 	}
 };
 
+/**
+ForwardBackwardAlgorithm on a CompiledHmm. Gives the same results but keeps alpha and beta in
+contiguous matrices that are reused from one sequence to the next and runs its inner loops over the
+states.
+*/
+template <bool use_scaling>
+struct CompiledForwardBackwardAlgorithm
+{
+	std::vector<unsigned> symbols; //the observations as indices into the alphabet
+	HmmMatrix<prob_t> alpha; //forward matrix
+	HmmMatrix<prob_t> beta; //backward matrix
+	prob_vector_t c; //scaling coefficients
+
+	template <
+		class Alphabet,
+		class ObsIt
+	>
+	CompiledForwardBackwardAlgorithm< use_scaling > &
+	forward(
+		const CompiledHmm<Alphabet> & hmm,
+		ObsIt o_begin,
+		ObsIt o_end)
+	{
+		hmm.get_symbols(o_begin, o_end, symbols);
+
+		const size_t num_obs = symbols.size();
+		const size_t num_states = hmm.num_states;
+		alpha.resize(num_obs, num_states);
+		c.clear();
+
+		//do we have anything to do?
+		if (0 == num_obs) {
+			return *this;
+		}
+
+		//initialisation
+		const prob_t * emissions = hmm.emissions_of(symbols[0]);
+		prob_t * alpha_t = alpha[0];
+		for (size_t i = 0; num_states != i; ++i) {
+			alpha_t[i] = hmm.initial_probs[i] * emissions[i];
+		}
+		if (use_scaling) {
+			c.push_back(1.0);
+		}
+
+		//induction - i.e. for each observation
+		for (size_t t = 1; num_obs != t; ++t) {
+
+			const prob_t * alpha_last = alpha[t-1];
+			alpha_t = alpha[t];
+			std::fill(alpha_t, alpha_t + num_states, 0.0);
+			for (size_t i = 0; num_states != i; ++i) {
+				const prob_t alpha_last_i = alpha_last[i];
+				const prob_t * transitions = hmm.transitions_from(i);
+				for (size_t j = 0; num_states != j; ++j) {
+					alpha_t[j] += alpha_last_i * transitions[j];
+				}
+			}
+			emissions = hmm.emissions_of(symbols[t]);
+			for (size_t j = 0; num_states != j; ++j) {
+				alpha_t[j] *= emissions[j];
+			}
+
+			if (use_scaling)
+			{
+				//scale if necessary for floating point precision
+				const prob_t sum = std::accumulate(alpha_t, alpha_t + num_states, 0.0);
+				if (0.0 != sum && sum < 0.001) //do we want to scale?
+				{
+					c.push_back(1.0 / sum);
+					assert(BIO_FINITE(c[t]));
+					for (size_t i = 0; i < num_states; ++i) {
+						alpha_t[i] *= c[t];
+					}
+				} else {
+					//no scaling
+					c.push_back(1.0);
+				}
+			}
+
+		} //for each observation
+
+		return *this;
+	}
+
+	/** Run backward on the observations given to forward. */
+	template <class Alphabet>
+	void
+	backward(const CompiledHmm<Alphabet> & hmm)
+	{
+		const size_t num_obs = symbols.size();
+		const size_t num_states = hmm.num_states;
+		beta.resize(num_obs, num_states);
+
+		//do we have anything to do?
+		if (0 == num_obs) {
+			return;
+		}
+
+		std::fill(beta[num_obs - 1], beta[num_obs - 1] + num_states, 1.0); //beta[T-1] is an array of 1's
+
+		//induction - as ForwardBackwardAlgorithm we use the emission from state i of observation t+1
+		for (size_t t = num_obs - 1; 0 != t--; ) {
+
+			const prob_t * beta_next = beta[t+1];
+			const prob_t * emissions = hmm.emissions_of(symbols[t+1]);
+			prob_t * beta_t = beta[t];
+			std::fill(beta_t, beta_t + num_states, 0.0);
+			for (size_t j = 0; num_states != j; ++j) {
+				const prob_t beta_next_j = beta_next[j];
+				const prob_t * transitions = hmm.transitions_into(j);
+				for (size_t i = 0; num_states != i; ++i) {
+					beta_t[i] += transitions[i] * emissions[i] * beta_next_j;
+				}
+			}
+
+			if (use_scaling)
+			{
+				assert(BIO_FINITE(c[t]));
+				for (size_t i = 0; i < num_states; ++i)
+				{
+					beta_t[i] *= c[t]; //use scaling factor
+					if (! BIO_FINITE(beta_t[i]))
+					{
+						throw std::logic_error( "Overflow" );
+					}
+				}
+			}
+
+		} //for each observation
+	}
+
+	/** get the log probability of the sequence used to run the forward algorithm. */
+	prob_t
+	get_log_probability() const
+	{
+		if (0 == alpha.size())
+		{
+			//empty sequences have probability 1
+			return std::log(1.0);
+		}
+
+		//termination
+		const prob_t * alpha_last = alpha[alpha.size() - 1];
+		const prob_t unscaled_result = std::accumulate(alpha_last, alpha_last + alpha.num_states, 0.0);
+
+		prob_t result = std::log(unscaled_result);
+		if (use_scaling)
+		{
+			for (prob_vector_t::const_iterator i = c.begin(); c.end() != i; ++i)
+			{
+				assert(BIO_FINITE(*i));
+
+				result -= std::log(*i);
+			}
+		}
+		return result;
+	}
+};
+
 /** Get the log likelihood of a sequence given the hmm. */
 template <class HMM, class SeqIt>
 prob_t
 get_log_likelihood(const HMM & hmm, SeqIt seq_begin, SeqIt seq_end)
 {
-	return ForwardBackwardAlgorithm<true>()
+	return CompiledForwardBackwardAlgorithm<true>()
 		.forward(
-			hmm,
+			CompiledHmm<typename HMM::alphabet_t>(hmm),
 			seq_begin,
 			seq_end).get_log_probability();
 }
@@ -3,6 +3,7 @@
 
 #include "bio/defs.h"
 #include "bio/hidden_markov_model.h"
+#include "bio/hmm_compiled.h"
 USING_BIO_NS
 
 #include <vector>
@@ -135,6 +136,108 @@ struct ViterbiAlgorithm
 };
 
 
+/** ViterbiAlgorithm on a CompiledHmm. Finds the same path but reuses its matrices and runs its inner loop over the states. */
+template <bool use_logs>
+struct CompiledViterbiAlgorithm
+{
+	std::vector<unsigned> symbols;
+	HmmMatrix<size_t> psi;
+	HmmMatrix<prob_t> delta;
+
+	/**
+	ObsIt is an iterator over the observed sequence
+	InsIt is a front_insert_iterator for the most likely sequence of states
+	If use_logs the logs of the hmm must have been compiled.
+	*/
+	template <
+		class Alphabet,
+		class ObsIt,
+		class InsIt>
+	void viterbi(
+		const CompiledHmm<Alphabet> & hmm,
+		ObsIt o_begin,
+		ObsIt o_end,
+		InsIt state_insert_it)
+	{
+		BOOST_ASSERT(! use_logs || hmm.has_logs());
+
+		hmm.get_symbols(o_begin, o_end, symbols);
+
+		const size_t num_obs = symbols.size();
+		const size_t num_states = hmm.num_states;
+		delta.resize(num_obs, num_states);
+		psi.resize(num_obs, num_states);
+
+		//do we have anything to do?
+		if (0 == num_obs) {
+			//no
+			return;
+		}
+
+		//initialisation
+		const prob_t * emissions = use_logs ? hmm.log_emissions_of(symbols[0]) : hmm.emissions_of(symbols[0]);
+		prob_t * delta_t = delta[0];
+		for (size_t i = 0; num_states != i; ++i) {
+			delta_t[i] =
+				use_logs
+					? hmm.log_initial_probs[i] + emissions[i]
+					: hmm.initial_probs[i] * emissions[i];
+		}
+		std::fill(psi[0], psi[0] + num_states, 0);
+
+		//recursion - for each observed emission
+		for (size_t t = 1; num_obs != t; ++t) {
+
+			const prob_t * delta_last = delta[t-1];
+			delta_t = delta[t];
+			size_t * psi_t = psi[t];
+
+			//find the maximums over all the states for every j at once
+			std::fill(delta_t, delta_t + num_states, -std::numeric_limits<prob_t>::max());
+			std::fill(psi_t, psi_t + num_states, 0);
+			for (size_t i = 0; num_states != i; ++i) {
+				const prob_t delta_last_i = delta_last[i];
+				const prob_t * transitions = use_logs ? hmm.log_transitions_from(i) : hmm.transitions_from(i);
+				for (size_t j = 0; num_states != j; ++j) {
+					const prob_t new_prob =
+						use_logs
+							? delta_last_i + transitions[j]
+							: delta_last_i * transitions[j];
+					if (new_prob > delta_t[j]) {
+						delta_t[j] = new_prob;
+						psi_t[j] = i;
+					}
+				}
+			}
+
+			emissions = use_logs ? hmm.log_emissions_of(symbols[t]) : hmm.emissions_of(symbols[t]);
+			for (size_t j = 0; num_states != j; ++j) {
+				delta_t[j] =
+					use_logs
+						? delta_t[j] + emissions[j]
+						: delta_t[j] * emissions[j];
+			}
+		}
+
+		//termination
+		const prob_t * delta_last = delta[num_obs-1];
+		size_t q_star = 0;
+		for (size_t i = 1; i < num_states; ++i) {
+			if (delta_last[i] > delta_last[q_star]) {
+				q_star = i;
+			}
+		}
+		*state_insert_it++ = q_star;
+
+		//path (state sequence) backtracking - as ViterbiAlgorithm this ends with psi[0], i.e. state 0
+		for (size_t t = num_obs; t != 0; --t) {
+			q_star = psi[t-1][q_star];
+			*state_insert_it++ = q_star;
+		}
+	}
+};
+
+
 BIO_NS_END
 
 #endif //BIO_VITERBI_H_
@@ -53,7 +53,7 @@ struct MatchBindingModel
 	};
 
 	parameter_t parameters;
-	Pssm pssm;
+	CompiledPssm pssm;
 	double threshold;
 
 	MatchBindingModel( const MatchBindingModel::parameter_t & parameters = parameter_t() );
@@ -77,6 +77,10 @@ struct MatchBindingModel
 		BindingModelContext * context) const;
 };
 
+/** So that MatchBindingModel parameters can be used as keys in hashed containers. */
+std::size_t
+hash_value( const MatchBindingModel::parameter_t & parameters );
+
 
 struct Link2MatchBindingModel
 {
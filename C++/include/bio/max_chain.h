@@ -16,10 +16,17 @@ Copyright John Reid 2006, 2007, 2008, 2009, 2010, 2011, 2012, 2013
 
 #include "bio/defs.h"
 #include "bio/max_chain_boxes.h"
+#include "bio/max_chain_stats.h"
 #include "bio/log.h"
 
 #include <boost/array.hpp>
 #include <boost/preprocessor/iteration/local.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+/** The number of boxes the first run of the max chain algorithm uses when there is a time budget. */
+#ifndef BIO_MAX_CHAIN_INITIAL_BOX_BUDGET
+# define BIO_MAX_CHAIN_INITIAL_BOX_BUDGET 1000
+#endif //BIO_MAX_CHAIN_INITIAL_BOX_BUDGET
 
 
 BIO_NS_START
@@ -765,6 +772,294 @@ struct check_tree
 	}
 };
 
+/** The range tree built from nested nodes. */
+template<
+	unsigned d,					/**< Dimension of the range tree. */
+	typename traits,			/**< The traits of the problem. */
+	unsigned k					/**< k is the tree dimension. */
+>
+struct nested_range_tree
+{
+	typedef typename traits::weight weight;
+	typedef typename traits::point point;
+	typedef std::pair< point, weight > heaviest_point;
+	typedef typename create_tree< d, traits, k >::tree tree;
+
+	tree _root;
+
+	nested_range_tree( unsigned dimensions = k ) { }
+
+	template<
+		typename PointsRange
+	>
+	void build( const PointsRange & points )
+	{
+		create_tree< d, traits, k >()( _root, points );
+	}
+
+	void insert( point p, weight w )
+	{
+		insert_point< d, traits, k >()( _root, p, w );
+	}
+
+	heaviest_point max_weight( point p )
+	{
+		return range_tree_ns::max_weight< d, traits, k >()( _root, p );
+	}
+
+	void check()
+	{
+		visit_tree< d, traits, k >()( _root, check_tree< d, traits, k >() );
+	}
+};
+
+
+/**
+A range tree with the same shape and results as nested_range_tree that keeps the nodes of the tree
+and of all its sub-trees in one arena. A tree of n points occupies 2n - 1 consecutive nodes in
+pre-order: the left child of node i is i + 1 and the right child is i + 2 * ( n / 2 ). Neither the
+number of points under a node nor its children are stored: they are worked out on the way down.
+The dimension of the tree is only needed at run time.
+*/
+template<
+	typename traits				/**< The traits of the problem. */
+>
+class flat_range_tree
+{
+public:
+	typedef typename traits::weight weight;
+	typedef typename traits::point point;
+	typedef std::pair< point, weight > heaviest_point;
+
+	struct node
+	{
+		point _point;				/**< Only for leaf nodes. */
+		point _split;				/**< Smallest point in the right child. Only for internal nodes. */
+		weight _max_weight;			/**< Maximum weight of any sub-node. */
+		size_t _sub_tree;			/**< Index of the sub-tree's root. Only for internal nodes with k > 1. */
+	};
+	typedef std::vector< node > node_vec;
+
+	flat_range_tree( unsigned k )
+		: _k( k )
+		, _size( 0 )
+	{
+	}
+
+	template<
+		typename PointsRange
+	>
+	void build( const PointsRange & points )
+	{
+		BOOST_ASSERT( 0 < _k );
+
+		_nodes.clear();
+		_size = boost::size( points );
+		if( 0 == _size )
+		{
+			return;
+		}
+
+		node_count_map counts;
+		_nodes.reserve( count_nodes( _size, _k, counts ) );
+
+		_scratch.resize( _k );
+		point_vec & sorted = _scratch[ _k - 1 ];
+		sorted.assign( boost::begin( points ), boost::end( points ) );
+		std::sort( sorted.begin(), sorted.end(), typename traits::point_less_k( _k - 1 ) );
+		//we can't have any duplicate elements...
+		BOOST_ASSERT( std::adjacent_find( sorted.begin(), sorted.end(), typename traits::point_equal() ) == sorted.end() );
+
+		build_tree( sorted.begin(), _size, _k );
+		BOOST_ASSERT( _nodes.size() == _nodes.capacity() );
+		_scratch.clear();
+	}
+
+	void insert( point p, weight w )
+	{
+		insert( 0, _size, _k, p, w );
+	}
+
+	/** Returns traits::always_dominated_point() if no point in tree dominated by p. */
+	heaviest_point max_weight( point p ) const
+	{
+		return max_weight( 0, _size, _k, p );
+	}
+
+	void check() const
+	{
+#ifdef _DEBUG
+		BOOST_ASSERT( ( 0 == _size ) == _nodes.empty() );
+#endif //_DEBUG
+	}
+
+	/** The number of nodes in the tree and all its sub-trees. */
+	size_t num_nodes() const { return _nodes.size(); }
+
+protected:
+	typedef std::vector< point > point_vec;
+	typedef typename point_vec::const_iterator point_it;
+	typedef std::map< std::pair< size_t, unsigned >, size_t > node_count_map;
+
+	unsigned _k;
+	size_t _size;
+	node_vec _nodes;
+	std::vector< point_vec > _scratch;		/**< Points sorted for the sub-trees in each dimension being built. */
+
+	/** The number of nodes a tree of n points in k dimensions needs. Most sizes recur so we remember them. */
+	static size_t count_nodes( size_t n, unsigned k, node_count_map & counts )
+	{
+		if( n < 2 )
+		{
+			return n;
+		}
+		const typename node_count_map::key_type key( n, k );
+		typename node_count_map::const_iterator i = counts.find( key );
+		if( counts.end() != i )
+		{
+			return i->second;
+		}
+		const size_t left = n / 2;
+		const size_t result =
+			1
+			+ ( 1 < k ? count_nodes( n, k - 1, counts ) : 0 )
+			+ count_nodes( left, k, counts )
+			+ count_nodes( n - left, k, counts );
+		counts[ key ] = result;
+		return result;
+	}
+
+	/** Builds the tree for the n points sorted in dimension k - 1. Returns the index of its root. */
+	size_t build_tree( point_it begin, size_t n, unsigned k )
+	{
+		//all the nodes at this level first so they are contiguous...
+		const size_t root = _nodes.size();
+		_nodes.resize( root + 2 * n - 1 );
+		build_nodes( root, begin, n );
+
+		//...then the sub-trees
+		if( 1 < k )
+		{
+			build_sub_trees( root, begin, n, k );
+		}
+		return root;
+	}
+
+	void build_nodes( size_t i, point_it begin, size_t n )
+	{
+		node & t = _nodes[ i ];
+		t._max_weight = weight( 0.0 );
+		t._sub_tree = 0;
+		if( 1 == n )
+		{
+			t._point = t._split = *begin;
+		}
+		else
+		{
+			const size_t left = n / 2;
+			t._point = 0;
+			t._split = *( begin + left );
+			build_nodes( i + 1, begin, left );
+			build_nodes( i + 2 * left, begin + left, n - left );
+		}
+	}
+
+	void build_sub_trees( size_t i, point_it begin, size_t n, unsigned k )
+	{
+		if( 1 == n )
+		{
+			return;
+		}
+
+		const size_t left = n / 2;
+		{
+			point_vec & sorted = _scratch[ k - 2 ];
+			sorted.assign( begin, begin + n );
+			std::sort( sorted.begin(), sorted.end(), typename traits::point_less_k( k - 2 ) );
+			const size_t sub_tree = build_tree( sorted.begin(), n, k - 1 );
+			_nodes[ i ]._sub_tree = sub_tree;
+		}
+		build_sub_trees( i + 1, begin, left, k );
+		build_sub_trees( i + 2 * left, begin + left, n - left, k );
+	}
+
+	void insert( size_t i, size_t n, unsigned k, point p, weight w )
+	{
+		node & t = _nodes[ i ];
+
+		//update if new maximum
+		if( w > t._max_weight )
+		{
+			t._max_weight = w;
+		}
+
+		//is this a leaf node?
+		if( 1 == n )
+		{
+			//yes - so the points must be equal
+			BOOST_ASSERT( typename traits::point_equal()( t._point, p ) );
+			return;
+		}
+
+		const size_t left = n / 2;
+		if( typename traits::point_less_k( k - 1 )( p, t._split ) )
+		{
+			insert( i + 1, left, k, p, w );
+		}
+		else
+		{
+			insert( i + 2 * left, n - left, k, p, w );
+		}
+
+		//also update sub-tree
+		if( 1 < k )
+		{
+			insert( t._sub_tree, n, k - 1, p, w );
+		}
+	}
+
+	heaviest_point max_weight( size_t i, size_t n, unsigned k, point p ) const
+	{
+		heaviest_point result( traits::always_dominated_point(), weight( 0.0 ) );
+
+		//do we have a tree?
+		if( 0 == n )
+		{
+			return result;
+		}
+
+		const node & t = _nodes[ i ];
+
+		//is it a leaf node?
+		if( 1 == n )
+		{
+			//need to check our point dominates it or is the same
+			if( typename traits::point_dominate()( p, t._point ) )
+			{
+				result.first = t._point;
+				result.second = t._max_weight;
+			}
+			return result;
+		}
+
+		//descend the tree looking for our point, breaking ties as max_weight does
+		const size_t left = n / 2;
+		if( typename traits::point_less_k( k - 1 )( p, t._split ) )
+		{
+			return max_weight( i + 1, left, k, p );
+		}
+
+		const heaviest_point sub_tree_result =
+			( 1 == k || 1 == left )
+				? max_weight( i + 1, left, k, p )
+				: max_weight( _nodes[ i + 1 ]._sub_tree, left, k - 1, p );
+		const heaviest_point child_result = max_weight( i + 2 * left, n - left, k, p );
+
+		return child_result.second > sub_tree_result.second ? child_result : sub_tree_result;
+	}
+};
+
+
 template<
 	unsigned d,					/**< Dimension of the range tree. */
 	typename traits				/**< The traits of the problem. */
@@ -792,11 +1087,16 @@ using range_tree_ns::RangeTree;
 namespace max_chain_ns {
 
 
+/** Used as the dimension of the problem when it is only known at run time. */
+const unsigned run_time_dimensions = unsigned( -1 );
+
+
 template<
 	unsigned d,				/**< Dimensions of the problem. */
 	typename BoxT,				/**< Box type. */
 	typename BoxTraits,			/**< Methods/typedefs to access box properties. */
-	unsigned k
+	unsigned k,
+	typename RangeTreeT = range_tree_ns::nested_range_tree< d, BoxTraits, d - 1 >	/**< The range tree over the first d - 1 dimensions. */
 >
 struct build_tree
 {
@@ -827,7 +1127,7 @@ struct build_tree
 	typedef std::map< box_ptr, box_ptr > box_to_box_map;
 
 	typedef RangeTree< d - 1, box_traits > range_tree;
-	typedef typename range_tree_ns::create_tree< d, box_traits, d - 1 >::tree tree;
+	typedef RangeTreeT tree;
 
 	point_set_equality points;
 	point_set_equality end_points;
@@ -838,7 +1138,14 @@ struct build_tree
 	point_to_box_map end_point_to_maximal_box;			/**< Points to the box that ends the maximal chain to this point. */
 	typename box_traits::box_ptr_list & maximal_chain;
 
-	build_tree( typename box_traits::box_ptr_list & mc ) : maximal_chain( mc ) { }
+	unsigned dimensions;								/**< d unless the dimensions are only known at run time. */
+
+	build_tree( typename box_traits::box_ptr_list & mc, unsigned dimensions = d )
+		: t( dimensions - 1 )
+		, maximal_chain( mc )
+		, dimensions( dimensions )
+	{
+	}
 
 	template<
 		typename BoxRange
@@ -874,13 +1181,8 @@ struct build_tree
 			}
 		}
 
-		range_tree_ns::template create_tree< d, box_traits, d - 1 >()( t, end_points );
-		//range_tree_ns::visit_tree< d, box_traits, d - 1 >()( t, range_tree_ns::print_point< d, box_traits, d - 1 >() );
-		range_tree_ns::template visit_tree< d, box_traits, d - 1 >()(
-			t,
-			range_tree_ns::template check_tree< d, box_traits, d - 1 >() );
-
-		range_tree_ns::template insert_point< d, box_traits, d - 1 > point_inserter;
+		t.build( end_points );
+		t.check();
 
 		//for each point (ordered in the d'th dimension)
 		coord last_dth_coord = std::numeric_limits< coord >::min();
@@ -889,11 +1191,11 @@ struct build_tree
 			//range_tree_ns::print_point< d >().print( p );
 
 			//check points actually are ordered in d'th dimension...
-			if( last_dth_coord > ( *p )[ d - 1 ] )
+			if( last_dth_coord > ( *p )[ dimensions - 1 ] )
 			{
 				throw std::logic_error( "box_traits::point_less must order points based on d'th dimension" );
 			}
-			last_dth_coord = ( *p )[ d - 1 ];
+			last_dth_coord = ( *p )[ dimensions - 1 ];
 
 			//get the heaviest point dominated by this point
 			typename range_tree::heaviest_point max_weight_dominated_by_p = get_heaviest_point( p );
@@ -905,7 +1207,7 @@ struct build_tree
 				//our best box so far for this end point is the box that ends at the previous
 				//heaviest point
 				box_ptr prev_box = get_maximal_box_for( max_weight_dominated_by_p.first );
-				point_inserter( t, p, max_weight_dominated_by_p.second );
+				t.insert( p, max_weight_dominated_by_p.second );
 				if( 0 != prev_box )
 				{
 					end_point_to_maximal_box[ p ] = prev_box;
@@ -929,7 +1231,7 @@ struct build_tree
 					if( max_weight_dominated_by_p.second < box_maximal_weight )
 					{
 						//yes so update this point as having the weight of this box's maximal chain
-						point_inserter( t, p, box_maximal_weight );
+						t.insert( p, box_maximal_weight );
 
 						//update our record of the heaviest box for this point
 						max_weight_dominated_by_p.second = box_maximal_weight;
@@ -939,7 +1241,7 @@ struct build_tree
 						end_point_to_maximal_box[ p ] = b;
 
 #ifdef _DEBUG
-						BOOST_ASSERT( ( typename range_tree_ns::max_weight< d, box_traits, d - 1 >()( t, p ).second == box_maximal_weight ) );
+						BOOST_ASSERT( t.max_weight( p ).second == box_maximal_weight );
 						//check the weight of the maximal chain to the point agrees with the weight in the tree.
 						check_maximal_chain_weight( max_weight_dominated_by_p.second, max_weight_dominated_by_p.first );
 #endif //_DEBUG
@@ -1080,7 +1382,7 @@ struct build_tree
 	get_heaviest_point( point p )
 	{
 		//get the heaviest point dominated by this point
-		const typename range_tree::heaviest_point heavy_point = range_tree_ns::template max_weight< d, box_traits, d - 1 >()( t, p );
+		const typename range_tree::heaviest_point heavy_point = t.max_weight( p );
 
 #ifdef _DEBUG
 		//check the weight of the maximal chain from the point agrees with the weight in the tree.
@@ -1107,9 +1409,10 @@ struct build_tree
 template<
 	unsigned d,				/**< Dimensions of the problem. */
 	typename BoxT,				/**< Box type. */
-	typename BoxTraits			/**< Methods/typedefs to access box properties. */
+	typename BoxTraits,			/**< Methods/typedefs to access box properties. */
+	typename RangeTreeT
 >
-struct build_tree< d, BoxT, BoxTraits, 1 >
+struct build_tree< d, BoxT, BoxTraits, 1, RangeTreeT >
 {
 	typedef typename BoxTraits::weight weight;
 
@@ -1131,9 +1434,10 @@ struct build_tree< d, BoxT, BoxTraits, 1 >
 template<
 	unsigned d,				/**< Dimensions of the problem. */
 	typename BoxT,				/**< Box type. */
-	typename BoxTraits			/**< Methods/typedefs to access box properties. */
+	typename BoxTraits,			/**< Methods/typedefs to access box properties. */
+	typename RangeTreeT
 >
-struct build_tree< d, BoxT, BoxTraits, 0 >
+struct build_tree< d, BoxT, BoxTraits, 0, RangeTreeT >
 {
 	typedef typename BoxTraits::weight weight;
 
@@ -1154,7 +1458,8 @@ struct build_tree< d, BoxT, BoxTraits, 0 >
 template<
 	unsigned d,				/**< Dimensions of the problem. */
 	typename BoxT,				/**< Box type. */
-	typename BoxTraits			/**< Methods/typedefs to access box properties. */
+	typename BoxTraits,			/**< Methods/typedefs to access box properties. */
+	typename RangeTreeT = range_tree_ns::nested_range_tree< d, BoxTraits, d - 1 >	/**< The range tree implementation. */
 >
 struct MaxChain
 {
@@ -1201,7 +1506,7 @@ struct MaxChain
 			throw std::invalid_argument( "Wrong number of dimensions" );
 		}
 
-		build_tree< d, box, box_traits, d > tree_builder( maximal_chain );
+		build_tree< d, box, box_traits, d, RangeTreeT > tree_builder( maximal_chain );
 		maximal_weight = tree_builder( boxes );
 	}
 
@@ -1251,6 +1556,50 @@ struct MaxChain
 };
 
 
+/**
+The max chain algorithm for problems whose dimensions are only known at run time. It always uses
+the flat range tree as the nested tree's dimension is a template parameter.
+*/
+template<
+	typename BoxT,				/**< Box type. */
+	typename BoxTraits			/**< Methods/typedefs to access box properties. */
+>
+struct DynamicMaxChain
+{
+	typedef BoxT box;
+	typedef BoxTraits box_traits;
+	typedef typename box_traits::box_ptr box_ptr;
+	typedef typename box_traits::weight weight;
+
+	typename box_traits::box_ptr_list maximal_chain;
+	weight maximal_weight;
+
+	template<
+		typename BoxRange
+	>
+	DynamicMaxChain( const BoxRange & boxes, unsigned dimensions )
+	: maximal_weight( 0.0 )
+	{
+		if( dimensions < 2 || BIO_MAX_CHAIN_DYNAMIC_MAX_SEQUENCES < dimensions )
+		{
+			throw
+				std::invalid_argument(
+					BIO_MAKE_STRING(
+						"Max chain algorithm not implemented for " << dimensions << " sequences. Limit is " << BIO_MAX_CHAIN_DYNAMIC_MAX_SEQUENCES ) );
+		}
+
+		build_tree<
+			run_time_dimensions,
+			box,
+			box_traits,
+			run_time_dimensions,
+			range_tree_ns::flat_range_tree< box_traits >
+		> tree_builder( maximal_chain, dimensions );
+		maximal_weight = tree_builder( boxes );
+	}
+};
+
+
 /**
 Generic box type for use with max chain algorithm.
 */
@@ -1311,7 +1660,234 @@ struct MaxChainBox
 };
 
 
+/**
+Box type for use with the max chain algorithm when the dimensions are only known at run time.
+*/
+template<
+	typename Data,
+	typename Coord,
+	typename Weight
+>
+struct DynamicMaxChainBox
+{
+	struct traits
+		: dynamic_point_traits< Coord >
+	{
+		typedef typename dynamic_point_traits< Coord >::point point;
+		typedef typename dynamic_point_traits< Coord >::coord_array coord_array;
+		typedef typename dynamic_point_traits< Coord >::coord coord;
 
+		typedef Weight weight;
+		typedef Data data;
+		typedef DynamicMaxChainBox< data, coord, weight > box;
+		typedef const box * box_ptr;
+		typedef std::vector< box > box_vec;					/**< Vector of boxes. */
+		typedef std::list< box_ptr > box_ptr_list;			/**< List of box pointers. */
+
+		static box make_box( data _d, weight w, const coord_array & s, const coord_array & e ) { return box( _d, w, s, e ); }
+		static weight get_weight( const box & b ) { return b._weight; }
+		static data get_data( const box & b ) { return b._data; }
+		static point get_start( const box & b ) { return boost::addressof( b._start ); }
+		static point get_end( const box & b ) { return boost::addressof( b._end ); }
+	};
+
+
+	DynamicMaxChainBox(
+		typename traits::data _d,
+		typename traits::weight w,
+		const typename traits::coord_array & s,
+		const typename traits::coord_array & e )
+		: _data( _d )
+		, _weight( w )
+		, _start( s )
+		, _end( e )
+	{
+	}
+
+	typename traits::data _data;
+	typename traits::weight _weight;
+	typename traits::coord_array _start;
+	typename traits::coord_array _end;
+
+};
+
+
+
+
+
+/** Runs a max chain algorithm that is constructed from the boxes. */
+template<
+	typename Algorithm
+>
+struct run_max_chain
+{
+	template<
+		typename BoxVec,
+		typename BoxPtrList
+	>
+	typename Algorithm::weight
+	operator()( const BoxVec & boxes, BoxPtrList & chain ) const
+	{
+		Algorithm alg( boxes );
+		chain.swap( alg.maximal_chain );
+		return alg.maximal_weight;
+	}
+};
+
+
+/** Counts the values and the boxes they would make. */
+template<
+	typename MapByChar
+>
+void
+count_values_and_boxes(
+	const MapByChar & values_by_char,
+	unsigned & num_values,
+	double & num_boxes )
+{
+	num_values = 0;
+	num_boxes = 0.;
+	BOOST_FOREACH( const typename MapByChar::value_type & values, values_by_char )
+	{
+		double num_boxes_for_char = 1.;
+		BOOST_FOREACH( const typename MapByChar::mapped_type::element_type::value_type & vs, *values.second )
+		{
+			num_values += unsigned( vs.size() );
+			num_boxes_for_char *= vs.size();
+		}
+		num_boxes += num_boxes_for_char;
+	}
+}
+
+
+/**
+Runs the max chain algorithm on the values with increasing numbers of boxes until it runs out of
+budget and outputs the heaviest chain it found. Each run thresholds the values, as box_generator
+does, to at most twice as many boxes as the last run. The thresholds are raised again while there
+are still too many boxes as one pass of num_boxes_bounder only approximately meets its limit. The
+first run uses max_num_boxes boxes, or BIO_MAX_CHAIN_INITIAL_BOX_BUDGET if there is a time budget. The next run is only started if, taking
+it to be 4 times slower than the last, it would finish within max_seconds.
+A max_num_boxes or max_seconds of 0 means no limit. No run uses fewer boxes than there are
+characters.
+*/
+template<
+	typename ValueTraits,
+	typename BoxTraits,
+	typename Runner,
+	typename ValueSequenceRange,
+	typename OutputIt
+>
+max_chain_stats
+max_chain_within_budget_using(
+	Runner runner,
+	const ValueSequenceRange & hits,
+	OutputIt output_it,
+	unsigned max_num_boxes,
+	double max_seconds )
+{
+	typedef box_generator< ValueTraits > generator;
+	typedef typename generator::map_by_char map_by_char;
+	typedef typename generator::value_vec_vec value_vec_vec;
+	typedef typename BoxTraits::box_vec box_vec;
+	typedef typename BoxTraits::box_ptr_list box_ptr_list;
+	typedef typename BoxTraits::weight weight;
+	namespace pt = boost::posix_time;
+
+	const pt::ptime start = pt::microsec_clock::universal_time();
+	max_chain_stats stats;
+	stats.num_sequences = unsigned( boost::size( hits ) );
+
+	map_by_char all_values;
+	generator::organise_values_by_character( hits, all_values );
+	count_values_and_boxes( all_values, stats.num_values, stats.num_possible_boxes );
+	stats.num_characters = unsigned( all_values.size() );
+
+	//the values, boxes and chain of the heaviest run so far
+	map_by_char best_values;
+	box_vec best_boxes;
+	box_ptr_list best_chain;
+	weight best_weight = weight( 0.0 );
+
+	//num_boxes_bounder keeps a value in each sequence for each character so cannot go below this
+	const double min_num_boxes = std::min( double( stats.num_characters ), stats.num_possible_boxes );
+	const double box_limit = max_num_boxes ? std::min( std::max( double( max_num_boxes ), min_num_boxes ), stats.num_possible_boxes ) : stats.num_possible_boxes;
+	double num_boxes = max_seconds > 0. ? std::min( std::max( double( BIO_MAX_CHAIN_INITIAL_BOX_BUDGET ), min_num_boxes ), box_limit ) : box_limit;
+	while( ! all_values.empty() )
+	{
+		//the box generator prunes the values in place so copy them
+		map_by_char values;
+		BOOST_FOREACH( const typename map_by_char::value_type & v, all_values )
+		{
+			values[ v.first ].reset( new value_vec_vec( *v.second ) );
+		}
+		const bool pruned = num_boxes < stats.num_possible_boxes;
+		unsigned num_values_used = stats.num_values;
+		double num_boxes_used = stats.num_possible_boxes;
+		for( unsigned pass = 0; num_boxes_used > num_boxes && 10 != pass; ++pass )
+		{
+			if( pass )
+			{
+				//the bounder shuffles the values it thins out but needs them sorted by weight
+				BOOST_FOREACH( const typename map_by_char::value_type & v, values )
+				{
+					BOOST_FOREACH( typename value_vec_vec::value_type & vs, *v.second )
+					{
+						std::sort( vs.begin(), vs.end(), typename generator::weight_less_than() );
+					}
+				}
+			}
+			typename generator::num_boxes_bounder bounder( values, unsigned( num_boxes ) );
+			bounder();
+			const double last_num_boxes = num_boxes_used;
+			count_values_and_boxes( values, num_values_used, num_boxes_used );
+			if( last_num_boxes == num_boxes_used )
+			{
+				break; //cannot get any closer
+			}
+		}
+		box_vec boxes;
+		generator::template get_boxes_for< BoxTraits >( values, std::back_inserter( boxes ) );
+
+		const pt::ptime run_start = pt::microsec_clock::universal_time();
+		box_ptr_list chain;
+		const weight w = runner( boxes, chain );
+		const double run_seconds = double( ( pt::microsec_clock::universal_time() - run_start ).total_microseconds() ) / 1e6;
+		++stats.num_runs;
+		log_stream() << "Max chain run " << stats.num_runs << ": # boxes = " << boxes.size() << ", weight = " << w << ", took " << run_seconds << "s" << std::endl;
+
+		if( 1 == stats.num_runs || w > best_weight )
+		{
+			best_values.swap( values );
+			best_boxes.swap( boxes );
+			best_chain.swap( chain );
+			best_weight = w;
+			stats.num_values_used = num_values_used;
+			stats.num_boxes_used = unsigned( best_boxes.size() );
+			stats.pruned = pruned;
+		}
+
+		//have we used all our boxes or time?
+		if( num_boxes >= box_limit )
+		{
+			break;
+		}
+		const double seconds_so_far = double( ( pt::microsec_clock::universal_time() - start ).total_microseconds() ) / 1e6;
+		if( max_seconds > 0. && seconds_so_far + 4. * run_seconds > max_seconds )
+		{
+			break;
+		}
+		num_boxes = std::min( 2. * num_boxes, box_limit );
+	}
+
+	BOOST_FOREACH( typename BoxTraits::box_ptr b, best_chain )
+	{
+		*output_it = b;
+		++output_it;
+	}
+	stats.seconds = double( ( pt::microsec_clock::universal_time() - start ).total_microseconds() ) / 1e6;
+
+	return stats;
+}
 
 
 template<
@@ -1334,6 +1910,33 @@ struct max_chain_algorithm
 		typename box::traits
 	> algorithm;
 
+	typedef MaxChain<
+		d,
+		box,
+		typename box::traits,
+		range_tree_ns::flat_range_tree< typename box::traits >
+	> flat_algorithm;
+
+	template<
+		typename Algorithm,
+		typename BoxVec,
+		typename OutputIt
+	>
+	static
+	void
+	run(
+		const BoxVec & boxes,
+		OutputIt output_it )
+	{
+		Algorithm alg( boxes );
+
+		BOOST_FOREACH( typename Algorithm::box_ptr b, alg.maximal_chain )
+		{
+			*output_it = b;
+			++output_it;
+		}
+	}
+
 
 
 	template<
@@ -1344,7 +1947,8 @@ struct max_chain_algorithm
 	operator()(
 		const ValueSequenceRange & hits,
 		OutputIt output_it,
-		unsigned box_limit = 0 ) const
+		unsigned box_limit = 0,
+		bool use_flat_range_tree = false ) const
 	{
 	    //
 	    // Calculate the boxes from the values
@@ -1364,18 +1968,133 @@ struct max_chain_algorithm
 		//do we have a limit or do we have fewer boxes than it?
 		if( ! box_limit || boxes.size() < box_limit )
 		{
-			algorithm alg( boxes );
-
-			BOOST_FOREACH( typename algorithm::box_ptr b, alg.maximal_chain )
+			if( use_flat_range_tree )
+			{
+				run< flat_algorithm >( boxes, output_it );
+			}
+			else
 			{
-				*output_it = b;
-				++output_it;
+				run< algorithm >( boxes, output_it );
 			}
 			ran_algorithm = true;
 		}
 
 		return ran_algorithm;
 	}
+
+	template<
+		typename ValueSequenceRange,
+		typename OutputIt
+	>
+	max_chain_stats
+	within_budget(
+		const ValueSequenceRange & hits,
+		OutputIt output_it,
+		unsigned max_num_boxes,
+		double max_seconds,
+		bool use_flat_range_tree ) const
+	{
+		return
+			use_flat_range_tree
+				? max_chain_within_budget_using< value_traits, typename box::traits >( run_max_chain< flat_algorithm >(), hits, output_it, max_num_boxes, max_seconds )
+				: max_chain_within_budget_using< value_traits, typename box::traits >( run_max_chain< algorithm >(), hits, output_it, max_num_boxes, max_seconds );
+	}
+};
+
+
+
+/**
+The max chain algorithm on values for any number of sequences.
+*/
+template<
+	typename value_traits
+>
+struct dynamic_max_chain_algorithm
+{
+	typedef DynamicMaxChainBox<
+		typename value_traits::data,
+		typename value_traits::coord,
+		typename value_traits::weight
+	> box;
+
+	typedef DynamicMaxChain<
+		box,
+		typename box::traits
+	> algorithm;
+
+	template<
+		typename ValueSequenceRange,
+		typename OutputIt
+	>
+	bool
+	operator()(
+		const ValueSequenceRange & hits,
+		OutputIt output_it,
+		unsigned box_limit = 0 ) const
+	{
+		typedef typename box::traits box_traits;
+		typedef typename box_traits::box_vec box_vec;
+		box_vec boxes;
+		auto values = box_generator< value_traits >::template boxes_from_sequences< box_traits >(
+			hits,
+			std::back_inserter( boxes ),
+			box_limit
+		);
+		log_stream() << "Calculating max chain: # boxes = " << boxes.size() << std::endl;
+
+		//do we have a limit or do we have fewer boxes than it?
+		if( box_limit && boxes.size() >= box_limit )
+		{
+			return false;
+		}
+
+		algorithm alg( boxes, unsigned( boost::size( hits ) ) );
+		BOOST_FOREACH( typename algorithm::box_ptr b, alg.maximal_chain )
+		{
+			*output_it = b;
+			++output_it;
+		}
+		return true;
+	}
+
+	/** Runs the algorithm for a fixed number of dimensions. */
+	struct runner
+	{
+		unsigned dimensions;
+		runner( unsigned dimensions ) : dimensions( dimensions ) { }
+
+		template<
+			typename BoxVec,
+			typename BoxPtrList
+		>
+		typename algorithm::weight
+		operator()( const BoxVec & boxes, BoxPtrList & chain ) const
+		{
+			algorithm alg( boxes, dimensions );
+			chain.swap( alg.maximal_chain );
+			return alg.maximal_weight;
+		}
+	};
+
+	template<
+		typename ValueSequenceRange,
+		typename OutputIt
+	>
+	max_chain_stats
+	within_budget(
+		const ValueSequenceRange & hits,
+		OutputIt output_it,
+		unsigned max_num_boxes,
+		double max_seconds ) const
+	{
+		return
+			max_chain_within_budget_using< value_traits, typename box::traits >(
+				runner( unsigned( boost::size( hits ) ) ),
+				hits,
+				output_it,
+				max_num_boxes,
+				max_seconds );
+	}
 };
 
 
@@ -1405,13 +2124,17 @@ A macro for each branch of the switch on the problem dimension.
 			max_chain_algorithm< n, ValueTraits >()(  \
 				hits,  \
 				output_it, \
-				num_boxes_limit );
+				num_boxes_limit, \
+				use_flat_range_tree );
 
 #define BOOST_PP_LOCAL_LIMITS (2, BIO_MAX_CHAIN_MAX_SEQUENCES)
 
 
 /**
 Calculates the maximal chain that is a subsequence of each sequence of hits in the HitSequenceRange.
+The flat range tree gives the same chain as the nested one but is faster on large problems.
+Up to BIO_MAX_CHAIN_MAX_SEQUENCES sequences are handled by code compiled for each number of
+sequences, more than that by the slower code that handles any number.
 */
 template<
 	typename ValueTraits,
@@ -1422,7 +2145,8 @@ bool
 max_chain(
 	const ValueSequenceRange & hits,
 	OutputIt output_it,
-	unsigned num_boxes_limit = 0 )
+	unsigned num_boxes_limit = 0,
+	bool use_flat_range_tree = false )
 {
 	using namespace boost::lambda;
 	using boost::lambda::_1;
@@ -1440,23 +2164,81 @@ max_chain(
 
 #include BOOST_PP_LOCAL_ITERATE() //expands to fill in cases for range defined above
 
-	default: //too many sequences to handle
+	default: //too many sequences to compile code for
+		return
+			dynamic_max_chain_algorithm< ValueTraits >()(
+				hits,
+				output_it,
+				num_boxes_limit );
+	}
+}
+
+#undef BIO_max_chain_case_instance
+
+
+#define BOOST_PP_LOCAL_MACRO(n) \
+	case n: \
+		return \
+			max_chain_algorithm< n, ValueTraits >().within_budget(  \
+				hits,  \
+				output_it, \
+				max_num_boxes, \
+				max_seconds, \
+				use_flat_range_tree );
+
+#define BOOST_PP_LOCAL_LIMITS (2, BIO_MAX_CHAIN_MAX_SEQUENCES)
+
+
+/**
+Calculates the maximal chain like max_chain() but rather than giving up when there would be too
+many boxes, it prunes them to fit within max_num_boxes and max_seconds (0 for no limit) and always
+outputs the heaviest chain it found. See max_chain_within_budget_using().
+*/
+template<
+	typename ValueTraits,
+	typename ValueSequenceRange,
+	typename OutputIt
+>
+max_chain_stats
+max_chain_within_budget(
+	const ValueSequenceRange & hits,
+	OutputIt output_it,
+	unsigned max_num_boxes,
+	double max_seconds = 0.,
+	bool use_flat_range_tree = true )
+{
+	switch( boost::size( hits ) )
+	{
+	case 0:
+		return max_chain_stats(); //nothing to do if we don't have any sequences
+
+	case 1: //cannot handle single sequences yet
 		throw
 			std::logic_error(
 				BIO_MAKE_STRING(
-					"Max chain algorithm not implemented for " << boost::size( hits ) << " sequences. Limit is " << BIO_MAX_CHAIN_MAX_SEQUENCES ) );
+					"Max chain algorithm not implemented for " << boost::size( hits ) << " sequences." ) );
+
+#include BOOST_PP_LOCAL_ITERATE() //expands to fill in cases for range defined above
+
+	default: //too many sequences to compile code for
+		return
+			dynamic_max_chain_algorithm< ValueTraits >().within_budget(
+				hits,
+				output_it,
+				max_num_boxes,
+				max_seconds );
 	}
 }
 
-#undef BIO_max_chain_case_instance
-
 
 
 
 } // namespace max_chain_ns
 
 using max_chain_ns::max_chain;
+using max_chain_ns::max_chain_within_budget;
 using max_chain_ns::MaxChain;
+using max_chain_ns::DynamicMaxChain;
 
 
 BIO_NS_END
@@ -37,6 +37,11 @@ Copyright John Reid 2013
 # define BIO_MAX_CHAIN_MAX_SEQUENCES 5
 #endif //BIO_MAX_CHAIN_MAX_SEQUENCES
 
+/** More sequences than BIO_MAX_CHAIN_MAX_SEQUENCES and up to this many are handled at run time. */
+#ifndef BIO_MAX_CHAIN_DYNAMIC_MAX_SEQUENCES
+# define BIO_MAX_CHAIN_DYNAMIC_MAX_SEQUENCES 64
+#endif //BIO_MAX_CHAIN_DYNAMIC_MAX_SEQUENCES
+
 
 BIO_NS_START
 
@@ -224,6 +229,147 @@ struct point_traits
 
 
 
+/**
+ * Traits for points whose dimensions are only known at run time. Points are compared in the
+ * dimensions they share. The extreme points have BIO_MAX_CHAIN_DYNAMIC_MAX_SEQUENCES dimensions
+ * so they compare correctly with points of any dimension up to that.
+ */
+template<
+    typename Coord         /**< The coordinate type of the points. */
+>
+struct dynamic_point_traits
+{
+    typedef Coord coord;
+    typedef std::vector< coord > coord_array;
+    typedef const coord_array * point;
+
+    static unsigned shared_dimensions( point lhs, point rhs )
+    {
+        return unsigned( std::min( lhs->size(), rhs->size() ) );
+    }
+
+    struct point_equal
+    {
+        bool operator()( point lhs, point rhs ) const
+        {
+            const unsigned d = shared_dimensions( lhs, rhs );
+            for( unsigned k = 0; d != k; ++k )
+            {
+                if( ( *lhs )[ k ] != ( *rhs )[ k ] )
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    /** Compare 2 points one dimension at a time. Equal points dominate themselves. */
+    struct point_dominate
+    {
+        bool operator()( point dominatrix, point slave ) const
+        {
+            const unsigned d = shared_dimensions( dominatrix, slave );
+            for( unsigned k = 0; d != k; ++k )
+            {
+                if( ( *dominatrix )[ k ] < ( *slave )[ k ] )
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    /** Compare 2 points one dimension at a time. Use d'th dimension as first to check. */
+    struct point_less
+    {
+        bool operator()( point lhs, point rhs ) const
+        {
+            for( unsigned k = shared_dimensions( lhs, rhs ); 0 != k; --k )
+            {
+                if( ( *lhs )[ k - 1 ] == ( *rhs )[ k - 1 ] )
+                {
+                    continue;
+                }
+                else
+                {
+                    return ( *lhs )[ k - 1 ] < ( *rhs )[ k - 1 ];
+                }
+            }
+            return false; //they are equal
+        }
+    };
+
+    /** Compares 2 points just in dimension k, then k+1%d, then k+2%d, etc... */
+    struct point_less_k
+    {
+        unsigned _k;
+        point_less_k( unsigned k ) : _k( k ) { }
+        bool operator()( point lhs, point rhs ) const
+        {
+            const unsigned d = shared_dimensions( lhs, rhs );
+            for( unsigned i = 0; d != i; ++i )
+            {
+                const unsigned j = ( i + _k ) % d;
+                if( ( *lhs )[ j ] == ( *rhs )[ j ] )
+                {
+                    continue;
+                }
+                return ( *lhs )[ j ] < ( *rhs )[ j ];
+            }
+            return false; //are equal
+        }
+    };
+
+    /**< A point that is dominated by all others. */
+    static point always_dominated_point()
+    {
+        static const coord_array a( BIO_MAX_CHAIN_DYNAMIC_MAX_SEQUENCES, std::numeric_limits< coord >::min() );
+        return &a;
+    }
+
+    /**< A point that dominates all others. */
+    static point always_dominates_point()
+    {
+        static const coord_array a( BIO_MAX_CHAIN_DYNAMIC_MAX_SEQUENCES, std::numeric_limits< coord >::max() );
+        return &a;
+    }
+};
+
+
+
+/**
+ * Checks a fixed size coordinate array has the right number of dimensions.
+ */
+template<
+    typename Coord,
+    std::size_t d
+>
+void
+init_coord_array( boost::array< Coord, d > & a, unsigned dimensions )
+{
+    if( d != dimensions )
+    {
+        throw std::invalid_argument(
+            BIO_MAKE_STRING( "Wrong # of input sequences: " << unsigned( d ) << " != " << dimensions ) );
+    }
+}
+
+/**
+ * Sizes a run-time coordinate array to the number of dimensions.
+ */
+template<
+    typename Coord
+>
+void
+init_coord_array( std::vector< Coord > & a, unsigned dimensions )
+{
+    a.resize( dimensions );
+}
+
+
+
 /**
  * This code has been re-factored into the box_generator class below...
  */
@@ -896,7 +1042,7 @@ struct box_generator {
                     // has lower values than the next highest
                     //
                     if( num_boxes_per_char.end() != next_highest ) {
-                        BOOST_ASSERT( i->get< 0 >() > next_highest->get< 0 >() );
+                        BOOST_ASSERT( can_remove()( *i ) > can_remove()( *next_highest ) );
                         to_remove = std::min(
                             ( can_remove()( *i ) - can_remove()( *next_highest ) ) * counts_to_reduce,
                             to_remove
@@ -943,9 +1089,15 @@ struct box_generator {
                 sequence_vec & sequences = seqs[ c ];
                 const double a = log( count.template get< 0 >() ); // log desired num boxes
                 const double ldot = log( count.template get< 3 >() ); // log num boxes at lower threshold
-                const double udot = log( std::max( unsigned( sequences.size() ), count.template get< 2 >() ) ); // log num boxes at upper threshold - must keep at least one per sequence
+                //
+                // Log num boxes at upper threshold. Sum the logs over the sequences just as we interpolate each
+                // sequence below so that the numbers of values we keep multiply to no more than the desired number.
+                //
+                double udot = 0.;
+                BOOST_FOREACH( const sequence & seq, sequences ) {
+                    udot += log( double( std::max( 1, int( seq.values->end() - seq.upper ) ) ) ); // must keep at least one value per sequence
+                }
                 BOOST_ASSERT( ldot >= a    );
-                BOOST_ASSERT( a    >  udot );
                 if( ldot > a ) {
 
                     //
@@ -971,11 +1123,12 @@ struct box_generator {
                         if( seq.upper != seq.lower ) {
                             const double ls = std::log( seq.values->end() - seq.lower );
                             const double us = std::log( std::max( 1, int( seq.values->end() - seq.upper ) ) ); // we need at least one value in each sequence
-                            const double astars = ( ls - us ) / ( ldot - udot ) * ( a - udot ) + us;
-                            const unsigned num_to_keep = exp( astars );
-                            BOOST_ASSERT( num_to_keep > 0 );
+                            const double astars = a < udot
+                                ? ( udot > 0. ? us * a / udot : 0. ) // fewer boxes than at the upper threshold so shrink every sequence
+                                : ( ls - us ) / ( ldot - udot ) * ( a - udot ) + us;
+                            const unsigned num_to_keep = std::max( 1u, unsigned( exp( astars ) ) );
                             typename value_vec::iterator erase_up_to = seq.values->end() - num_to_keep;
-                            BOOST_ASSERT( erase_up_to <= seq.upper );
+                            BOOST_ASSERT( a < udot || erase_up_to - seq.upper <= 1 ); // allow for rounding
                             BOOST_ASSERT( seq.lower <= erase_up_to );
                             seq.values->erase( seq.values->begin(), erase_up_to );
                         } else {
@@ -996,7 +1149,15 @@ struct box_generator {
                             unsigned( 1 ),
                             std::multiplies< unsigned >()
                         ) <= count.template get< 0 >()
+                        || a < udot
                     );
+                } else {
+                    //
+                    // We want all the boxes at the lower threshold (perhaps none) so just ignore every value worse than it
+                    //
+                    BOOST_FOREACH( const sequence & seq, sequences ) {
+                        seq.values->erase( seq.values->begin(), seq.values->begin() + ( seq.lower - seq.values->begin() ) );
+                    }
                 }
             }
         }
@@ -1051,11 +1212,10 @@ struct box_generator {
         // Check that the dimensions of our boxes match the size of the values collection
         //
         const unsigned dimensions = size( values );
-        if( point::static_size != dimensions )
-        {
-            throw std::invalid_argument(
-                BIO_MAKE_STRING( "Wrong # of input sequences: " << unsigned( point::static_size ) << " != " << dimensions ) );
-        }
+        point start;
+        point end;
+        init_coord_array( start, dimensions );
+        init_coord_array( end, dimensions );
 
         //
         // Iterate over every combination of values from each sequence
@@ -1065,8 +1225,6 @@ struct box_generator {
             //
             // calculate the box for this combination
             //
-            point start;
-            point end;
             weight w = weight( 0.0 );
             for( unsigned d = 0; dimensions != d; ++d ) { // for each dimension
 
@@ -0,0 +1,52 @@
+/**
+@file
+
+Copyright John Reid 2013
+
+*/
+
+#ifndef BIO_MAX_CHAIN_STATS_H_
+#define BIO_MAX_CHAIN_STATS_H_
+
+#ifdef _MSC_VER
+# pragma once
+#endif //_MSC_VER
+
+#include "bio/defs.h"
+
+BIO_NS_START
+
+
+/**
+What a run of the max chain algorithm within a budget did and how much it pruned.
+*/
+struct max_chain_stats
+{
+	unsigned num_sequences;
+	unsigned num_characters;			/**< Characters with values in every sequence. */
+	unsigned num_values;				/**< Values of those characters in all the sequences. */
+	double num_possible_boxes;			/**< Boxes without pruning. A double as it can be huge. */
+	unsigned num_runs;					/**< How many times the algorithm was run with more boxes. */
+	unsigned num_values_used;			/**< Values left after pruning in the run that found the chain. */
+	unsigned num_boxes_used;			/**< Boxes in the run that found the chain. */
+	bool pruned;						/**< Were any boxes pruned in the run that found the chain? */
+	double seconds;						/**< Wall-clock time taken. */
+
+	max_chain_stats()
+		: num_sequences( 0 )
+		, num_characters( 0 )
+		, num_values( 0 )
+		, num_possible_boxes( 0. )
+		, num_runs( 0 )
+		, num_values_used( 0 )
+		, num_boxes_used( 0 )
+		, pruned( false )
+		, seconds( 0. )
+	{
+	}
+};
+
+
+BIO_NS_END
+
+#endif //BIO_MAX_CHAIN_STATS_H_
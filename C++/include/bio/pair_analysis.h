@@ -7,6 +7,8 @@
 #include "bio/score_map.h"
 #include "bio/iterator.h"
 #include "bio/math.h"
+#include "bio/hit_pairs.h"
+#include "bio/parallel.h"
 
 #include <boost/operators.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
@@ -63,6 +65,9 @@ struct PairStatistics
 		HitIt results_end,
 		unsigned seq_length );
 
+	/** Add the counts from other statistics gathered with the same distance. */
+	PairStatistics & operator+=( const PairStatistics & rhs );
+
 	double get_pair_log_likelihood_ratio( unsigned pair_count, unsigned f1_count, unsigned f2_count, double p );
 
 	void analyse( unsigned num_output );
@@ -71,6 +76,34 @@ struct PairStatistics
 	void analyse_singles( unsigned num_output );
 
 protected:
+	/** Counts a pair of hits. */
+	struct pair_counter
+	{
+		PairStatistics & statistics;
+		unsigned seq_length;
+
+		pair_counter( PairStatistics & statistics, unsigned seq_length )
+			: statistics( statistics ), seq_length( seq_length )
+		{
+		}
+
+		void operator()( const hit_t & h1, const hit_t & h2 ) const
+		{
+			const unsigned distance = statistics.distance;
+
+			//count them
+			const binder_pair_t pair( h1.get_binder(), h2.get_binder() );
+			statistics.pair_counts.increment( pair );
+
+			//are we analysing the distances and we are not too close to the start or end of the sequence
+			//to skew the distribution?
+			if ( h2.get_position() >= int( distance ) && h1.get_end() + distance < seq_length)
+			{
+				statistics.distances_map[ pair ].increment( h2.get_position() - ( h1.get_position() + h1.get_length() ) );
+			}
+		}
+	};
+
 	friend class boost::serialization::access;
     template< typename Archive >
     void serialize( Archive & ar, const unsigned int version )
@@ -157,38 +190,110 @@ void PairStatistics< Binder >::add_hits(
 		sequence_counts[ h1->get_binder() ].increment( sequence_group_name );
 
 		binder_counts.increment( h1->get_binder() );
+	}
 
-		//look for other hits ahead of h1 but inside the distance
-		for( HitIt h2 = boost::next( h1 );
-			results_end != h2;
-			++h2)
-		{
-			//check h2 is ahead of end of h1
-			if( h2->get_position() < h1->get_end() )
-			{
-				//it isn't
-				continue;
-			}
+	//count the pairs where the second hit starts at or after the end of the first but inside the distance
+	for_each_hit_pair( results_begin, results_end, 0, int( distance ) - 1, pair_counter( *this, seq_length ) );
+}
 
-			//check h2 is not too far ahead, i.e. inside the distance
-			if( h2->get_position() >= h1->get_end() + int( distance ) )
-			{
-				//it is too far ahead
-				break;
-			}
+template< typename Binder >
+PairStatistics< Binder > &
+PairStatistics< Binder >::operator+=( const PairStatistics & rhs )
+{
+	if( distance != rhs.distance )
+	{
+		throw std::logic_error( "Cannot add pair statistics gathered with different distances" );
+	}
 
-			//count them
-			const binder_pair_t pair( h1->get_binder(), h2->get_binder() );
-			pair_counts.increment( pair );
+	binder_counts += rhs.binder_counts;
+	pair_counts += rhs.pair_counts;
+	for( typename distances_map_t::const_iterator d = rhs.distances_map.begin(); rhs.distances_map.end() != d; ++d )
+	{
+		distances_map[ d->first ] += d->second;
+	}
+	for( typename sequence_counts_map_t::const_iterator c = rhs.sequence_counts.begin(); rhs.sequence_counts.end() != c; ++c )
+	{
+		sequence_counts[ c->first ] += c->second;
+	}
+	for( seq_lengths_map_t::const_iterator l = rhs.seq_lengths.begin(); rhs.seq_lengths.end() != l; ++l )
+	{
+		seq_lengths[ l->first ] += l->second;
+	}
+	num_remos += rhs.num_remos;
+	num_bases += rhs.num_bases;
 
-			//are we analysing the distances and we are not too close to the start or end of the sequence
-			//to skew the distribution?
-			if ( h2->get_position() >= int( distance ) && h1->get_end() + distance < seq_length)
-			{
-				distances_map[ pair ].increment( h2->get_position() - ( h1->get_position() + h1->get_length() ) );
-			}
+	return *this;
+}
+
+
+
+/** The hits in one remo, ordered by position, to add to pair statistics. */
+template< typename HitIt >
+struct RemoHits
+{
+	std::string sequence_group_name;
+	HitIt results_begin;
+	HitIt results_end;
+	unsigned seq_length;
+
+	RemoHits( const std::string & sequence_group_name, HitIt results_begin, HitIt results_end, unsigned seq_length )
+		: sequence_group_name( sequence_group_name )
+		, results_begin( results_begin )
+		, results_end( results_end )
+		, seq_length( seq_length )
+	{
+	}
+};
+
+namespace detail {
+
+/** Adds the hits in a block of remos to that block's statistics. */
+template< typename Binder, typename HitIt >
+struct add_remo_hits_block
+{
+	const std::vector< RemoHits< HitIt > > & remos;
+	std::vector< PairStatistics< Binder > > & block_statistics;
+
+	add_remo_hits_block( const std::vector< RemoHits< HitIt > > & remos, std::vector< PairStatistics< Binder > > & block_statistics )
+		: remos( remos ), block_statistics( block_statistics )
+	{
+	}
+
+	void operator()( size_t b, size_t begin, size_t end ) const
+	{
+		for( size_t r = begin; end != r; ++r )
+		{
+			block_statistics[ b ].add_hits( remos[ r ].sequence_group_name, remos[ r ].results_begin, remos[ r ].results_end, remos[ r ].seq_length );
 		}
 	}
+};
+
+} //namespace detail
+
+/**
+Add the hits in each remo to the statistics using up to num_threads threads (0 for one per core). Each
+thread counts a contiguous block of remos into statistics of its own which are then added together, so
+the counts are the same as adding the remos one at a time. The hits must be safe to read from many threads.
+*/
+template< typename Binder, typename HitIt >
+void
+add_remo_hits(
+	PairStatistics< Binder > & statistics,
+	const std::vector< RemoHits< HitIt > > & remos,
+	unsigned num_threads = 0 )
+{
+	const size_t num_blocks = num_parallel_blocks( remos.size(), num_threads );
+	std::vector< PairStatistics< Binder > > block_statistics( num_blocks, PairStatistics< Binder >( statistics.distance ) );
+	parallel_for_blocks(
+		remos.size(),
+		num_blocks,
+		num_threads,
+		detail::add_remo_hits_block< Binder, HitIt >( remos, block_statistics ) );
+
+	BOOST_FOREACH( const PairStatistics< Binder > & s, block_statistics )
+	{
+		statistics += s;
+	}
 }
 
 /** Get log likelihood ratio for counts of pair of transcription factors. */
@@ -248,19 +353,19 @@ void PairStatistics< Binder >::analyse_singles(unsigned num_output)
 			seq_lengths.end() != s;
 			++s)
 		{
-			sequence_counter_t::const_iterator c = counts.find(s->first);
+			typename sequence_counter_t::const_iterator c = counts.find(s->first);
 			obs.push_back(counts.end() == c ? 0 : c->second);
 		}
 
 		const double uniform_evidence = calc_ln_multinomial_evidence(obs.begin(), obs.end(), alpha.begin(), alpha.begin());
-		scores.insert( single_evidences_map_t::value_type( p->first, uniform_evidence ));
+		scores.insert( typename single_evidences_map_t::value_type( p->first, uniform_evidence ));
 	}
 
 	std::cout << "Printing sequence scores...\n";
 	unsigned i = 0;
 	BOOST_FOREACH(
 		const typename ScoreMap< const binder_t * >::value_type & evidence,
-		scores.get< ScoreMap< const binder_t * >::score >() )
+		scores.template get< typename ScoreMap< const binder_t * >::score >() )
 	{
 		std::cout << evidence.score << "\t" << evidence.key << "\n";
 		sequence_counts[ evidence.key ].print( true, std::cout, "Sequence", false, 20, 0, true );
@@ -284,12 +389,12 @@ void PairStatistics< Binder >::analyse_clusters(unsigned num_output)
 
 	//look for evidence that they cluster together...
 	pair_evidences_map_t evidences;
-	for (pair_counter_t::const_iterator c = pair_counts.begin();
+	for (typename pair_counter_t::const_iterator c = pair_counts.begin();
 		pair_counts.end() != c;
 		++c)
 	{
-		const unsigned count_1 = binder_counts.get_count( c->first.get< 0 >() );
-		const unsigned count_2 = binder_counts.get_count( c->first.get< 1 >() );
+		const unsigned count_1 = binder_counts.get_count( c->first.template get< 0 >() );
+		const unsigned count_2 = binder_counts.get_count( c->first.template get< 1 >() );
 		const unsigned pair_count = c->second;
 
 		const double evidence =
@@ -299,20 +404,20 @@ void PairStatistics< Binder >::analyse_clusters(unsigned num_output)
 				count_2,
 				p);
 
-		evidences.insert( pair_evidences_map_t::value_type( c->first, evidence ) );
+		evidences.insert( typename pair_evidences_map_t::value_type( c->first, evidence ) );
 	}
 
 	//print the most interesting...
 	unsigned i = 0;
-	for (pair_evidences_map_t::const_iterator e = evidences.begin();
+	for (typename pair_evidences_map_t::const_iterator e = evidences.begin();
 		evidences.end() != e && num_output != i;
 		++e, ++i)
 	{
 		std::cout
 			<< e->score
 			<< "\t" << pair_counts.get_count( e->key )
-			<< "\t" << binder_counts.get_count( e->key.get< 0 >() )
-			<< "\t" << binder_counts.get_count( e->key.get< 1 >() )
+			<< "\t" << binder_counts.get_count( e->key.template get< 0 >() )
+			<< "\t" << binder_counts.get_count( e->key.template get< 1 >() )
 			<< "\t" << e->key
 			<< "\n";
 	}
@@ -324,7 +429,7 @@ void PairStatistics< Binder >::analyse_distances( unsigned num_output )
 	pair_evidences_map_t evidences;
 	double alpha = 1.0;
 
-	for (distances_map_t::const_iterator d = distances_map.begin();
+	for (typename distances_map_t::const_iterator d = distances_map.begin();
 		distances_map.end() != d;
 		++d)
 	{
@@ -341,12 +446,12 @@ void PairStatistics< Binder >::analyse_distances( unsigned num_output )
 				distance_counts.end(),
 				single_value_iterator< double >(alpha));
 
-		evidences.insert( pair_evidences_map_t::value_type( d->first, uniform_evidence ) );
+		evidences.insert( typename pair_evidences_map_t::value_type( d->first, uniform_evidence ) );
 	}
 
 	//print the most interesting...
 	unsigned i = 0;
-	BOOST_FOREACH( const ScoreMap< binder_pair_t >::value_type & evidence, evidences.get< ScoreMap< binder_pair_t >::score >() )
+	BOOST_FOREACH( const typename ScoreMap< binder_pair_t >::value_type & evidence, evidences.template get< typename ScoreMap< binder_pair_t >::score >() )
 	{
 		std::cout << distances_map[ evidence.key ].get_total() << " " << evidence.score << " " << evidence.key << "\n";
 		for( unsigned j = 0; distance != j; ++j )
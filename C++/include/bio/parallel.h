@@ -0,0 +1,205 @@
+#ifndef BIO_PARALLEL_H_
+#define BIO_PARALLEL_H_
+
+#include "bio/defs.h"
+#include "bio/useradmin.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <exception>
+#include <algorithm>
+
+BIO_NS_START
+
+
+/**
+The number of threads to use when asked for num_threads: 0 means one per core.
+*/
+inline
+unsigned
+resolve_num_threads( unsigned num_threads )
+{
+	if( 0 == num_threads )
+	{
+		num_threads = boost::thread::hardware_concurrency();
+	}
+	return std::max( 1u, num_threads );
+}
+
+
+/**
+Divides num_threads threads (0 for one per core) between num_tasks tasks that use threads of their own:
+up to tasks_at_once tasks run at once with threads_per_task threads each, so that together they use
+no more threads than were asked for.
+*/
+inline
+void
+divide_num_threads( unsigned num_threads, size_t num_tasks, unsigned & tasks_at_once, unsigned & threads_per_task )
+{
+	num_threads = resolve_num_threads( num_threads );
+	tasks_at_once = unsigned( std::max< size_t >( 1, std::min< size_t >( num_threads, num_tasks ) ) );
+	threads_per_task = num_threads / tasks_at_once;
+}
+
+
+namespace detail {
+
+/** State shared between the workers of parallel_for(). */
+struct parallel_for_state
+{
+	boost::mutex mutex;
+	size_t next;
+	size_t end;
+	std::exception_ptr error;
+
+	parallel_for_state( size_t end ) : next( 0 ), end( end ) { }
+
+	/** Get the next index to process. Returns false when there are none left or a worker has failed. */
+	bool take( size_t & i )
+	{
+		boost::lock_guard< boost::mutex > lock( mutex );
+		if( error || next == end )
+		{
+			return false;
+		}
+		i = next++;
+		return true;
+	}
+
+	void fail()
+	{
+		boost::lock_guard< boost::mutex > lock( mutex );
+		if( ! error )
+		{
+			error = std::current_exception();
+		}
+	}
+};
+
+template< typename Fn >
+struct parallel_for_worker
+{
+	parallel_for_state & state;
+	Fn & fn;
+	std::string user;
+
+	parallel_for_worker( parallel_for_state & state, Fn & fn, const std::string & user )
+		: state( state ), fn( fn ), user( user )
+	{
+	}
+
+	void operator()()
+	{
+		try
+		{
+			// act on behalf of the calling thread's user so we see the same UserSingletons
+			user_admin::userSet( user.c_str() );
+
+			size_t i;
+			while( state.take( i ) )
+			{
+				fn( i );
+			}
+		}
+		catch( ... )
+		{
+			state.fail();
+		}
+	}
+};
+
+} //namespace detail
+
+
+/**
+Calls fn( i ) for each i in [0, n) using up to num_threads threads (0 for one per core).
+Indices are handed out one at a time so the order they are processed in is not
+deterministic: fn is shared by all the workers and should write its results to a
+slot for i. With one thread, fn is
+called in order on the calling thread. The first exception thrown by fn is rethrown
+on the calling thread once the workers have stopped.
+*/
+template< typename Fn >
+void
+parallel_for( size_t n, unsigned num_threads, Fn fn )
+{
+	num_threads = unsigned( std::min< size_t >( resolve_num_threads( num_threads ), n ) );
+	if( num_threads <= 1 )
+	{
+		for( size_t i = 0; n != i; ++i )
+		{
+			fn( i );
+		}
+		return;
+	}
+
+	detail::parallel_for_state state( n );
+	const std::string user = user_admin::userGet();
+	boost::thread_group threads;
+	for( unsigned t = 0; num_threads != t; ++t )
+	{
+		threads.create_thread( detail::parallel_for_worker< Fn >( state, fn, user ) );
+	}
+	threads.join_all();
+
+	if( state.error )
+	{
+		std::rethrow_exception( state.error );
+	}
+}
+
+
+
+/**
+The number of contiguous blocks to split n items into for parallel_for_blocks(): one per thread but
+no more than there are items and at least one.
+*/
+inline
+size_t
+num_parallel_blocks( size_t n, unsigned num_threads )
+{
+	return std::max< size_t >( 1, std::min< size_t >( resolve_num_threads( num_threads ), n ) );
+}
+
+
+namespace detail {
+
+template< typename Fn >
+struct parallel_for_blocks_fn
+{
+	size_t n;
+	size_t num_blocks;
+	Fn & fn;
+
+	parallel_for_blocks_fn( size_t n, size_t num_blocks, Fn & fn )
+		: n( n ), num_blocks( num_blocks ), fn( fn )
+	{
+	}
+
+	void operator()( size_t b )
+	{
+		fn( b, b * n / num_blocks, ( b + 1 ) * n / num_blocks );
+	}
+};
+
+} //namespace detail
+
+
+/**
+Splits [0, n) into num_blocks contiguous blocks and calls fn( b, begin, end ) for each block b
+using up to num_threads threads (0 for one per core). The blocks only depend on n and num_blocks,
+so results accumulated per block and then reduced in block order do not depend on the scheduling.
+*/
+template< typename Fn >
+void
+parallel_for_blocks( size_t n, size_t num_blocks, unsigned num_threads, Fn fn )
+{
+	parallel_for( num_blocks, num_threads, detail::parallel_for_blocks_fn< Fn >( n, num_blocks, fn ) );
+}
+
+
+BIO_NS_END
+
+#endif //BIO_PARALLEL_H_
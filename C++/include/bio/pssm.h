@@ -11,6 +11,8 @@
 #include <boost/utility.hpp>
 
 #include <vector>
+#include <algorithm>
+#include <stdexcept>
 
 
 BIO_NS_START
@@ -101,18 +103,95 @@ private:
 
 
 
+/**
+A Pssm laid out for scanning sequences. The normalisation constants are calculated once rather than
+for every window and each column holds a score for each of a, c, g, t and n, where n scores the
+column's minimum as Pssm::score() does. The reversed complement has its own table so that matching
+the complement also reads its columns in sequence order.
+
+The constants are summed in the order Pssm::score() sums them so the scores are identical. The Pssm
+must be compiled again whenever it changes.
+*/
+class CompiledPssm
+{
+public:
+	typedef boost::shared_ptr<CompiledPssm> ptr_t;
+	typedef float_t score_t;
+	typedef std::vector<float_t> score_vector_t;
+
+	enum { num_symbols = 5 }; /**< a, c, g, t and n. */
+
+	CompiledPssm();
+
+	explicit
+	CompiledPssm(const Pssm & pssm);
+
+	void compile(const Pssm & pssm);
+
+	/** The number of bases the pssm matches. */
+	size_t size() const { return num_bases; }
+
+	score_t
+	score(
+		seq_t::const_iterator seq_begin,
+		bool match_complement = false) const
+	{
+		const score_vector_t & table = match_complement ? complement_scores : scores;
+		float_t result = 0.0;
+		for (size_t i = 0; num_bases != i; ++i, ++seq_begin)
+		{
+			result += table[i * num_symbols + get_symbol(*seq_begin)];
+		}
+
+		//normalise into [0,1]
+		const float_t min = match_complement ? complement_min : this->min;
+		const float_t range = match_complement ? complement_range : this->range;
+		result = (float_t)((0.0 == range) ? 0.0 : (result - min) / range);
+		result = std::max(0.0f, result);
+		result = std::min(result, 1.0f);
+
+		return result;
+	}
+
+	/** The index of the base in each column's scores. */
+	static inline size_t get_symbol(char c)
+	{
+		switch (c)
+		{
+			case 'a': case 'A': return 0;
+			case 'c': case 'C': return 1;
+			case 'g': case 'G': return 2;
+			case 't': case 'T': return 3;
+			case 'n': case 'N': return 4;
+		}
+		throw std::logic_error( BIO_MAKE_STRING( "Bad char: " << c ) );
+	}
+
+protected:
+	size_t num_bases;
+	score_vector_t scores; /**< num_bases x num_symbols, row i scores the i'th base of the sequence. */
+	score_vector_t complement_scores; /**< As scores but for the reversed complement. */
+	float_t min;
+	float_t max;
+	float_t range;
+	float_t complement_min;
+	float_t complement_max;
+	float_t complement_range;
+};
+
+
+
 struct PssmScorer
 	: std::binary_function< seq_t::const_iterator, bool, float_t >
 {
-	const Pssm * pssm;
+	CompiledPssm::ptr_t pssm;
 
 	PssmScorer( const Pssm & pssm )
-		: pssm( boost::addressof( pssm ) )
+		: pssm( new CompiledPssm( pssm ) )
 	{
 	}
 
 	PssmScorer()
-		: pssm( 0 )
 	{
 	}
 
@@ -133,7 +212,7 @@ struct PssmScorer
 private:
 	void check_pointer() const
 	{
-		if( 0 == pssm )
+		if( ! pssm )
 		{
 			throw std::logic_error( "Null pointer in PssmScorer" );
 		}
@@ -23,7 +23,7 @@ struct PssmCache
 	: unary_compose<
 		Dereference< Pssm >,
 		unary_compose<
-			Cache< PssmMaker >,
+			ConcurrentCache< PssmMaker >,
 			BiobasePssmKeyTransformer
 		>
 	>
@@ -6,6 +6,9 @@
 #include "bio/biobase_likelihoods.h"
 #include "bio/biobase_db.h"
 #include "bio/singleton.h"
+#include "bio/cache.h"
+
+#include <boost/serialization/split_member.hpp>
 
 #include <string>
 
@@ -13,7 +16,15 @@
 
 BIO_NS_START
 
-/** Caches the likelihoods of biobase scores (given that they bind) for pssms. */
+/** Calculates the likelihoods of biobase scores (given that they bind) for a pssm. */
+struct PssmLikelihoodMaker
+	: std::unary_function< TableLink, BiobaseLikelihoods >
+{
+	BiobaseLikelihoods operator()( const TableLink & key ) const;
+};
+
+
+/** Caches the likelihoods of biobase scores (given that they bind) for pssms. Safe to use from many threads. */
 class PssmLikelihoodCache
 	: public Singleton< PssmLikelihoodCache >
 {
@@ -25,10 +36,19 @@ private:
     // & operator is defined similar to <<.  Likewise, when the class Archive
     // is a type of input archive the & operator is defined similar to >>.
     template< typename Archive >
-    void serialize(Archive & ar, const unsigned int version)
+    void save(Archive & ar, const unsigned int version) const
+	{
+		const likelihood_map_t::map_t elements = likelihoods.get_elements();
+        ar & elements;
+    }
+    template< typename Archive >
+    void load(Archive & ar, const unsigned int version)
 	{
-        ar & likelihoods;
+		likelihood_map_t::map_t elements;
+        ar & elements;
+		likelihoods.insert( elements );
     }
+	BOOST_SERIALIZATION_SPLIT_MEMBER()
 
 	void init_singleton();
 
@@ -36,7 +56,7 @@ public:
 	typedef TableLink key_t;
 
 protected:
-	typedef std::map< key_t, BiobaseLikelihoods > likelihood_map_t;
+	typedef ConcurrentCache< PssmLikelihoodMaker > likelihood_map_t;
 
 	BiobaseDb & biobase_db;
 	likelihood_map_t likelihoods;
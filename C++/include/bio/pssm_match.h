@@ -130,7 +130,7 @@ struct BiobaseResultCalculator
 	{
 		//get all the scores for this pssm
 		score_sequence(
-			make_pssm(&pssm),
+			CompiledPssm(make_pssm(&pssm)),
 			match_seq_begin,
 			match_seq_end,
 			true,
@@ -6,6 +6,8 @@
 #include "bio/run_match.h"
 #include "bio/binding_model.h"
 #include "bio/bifa_analysis.h"
+#include "bio/hit_pairs.h"
+#include "bio/biobase_filter.h"
 
 
 #include <sstream>
@@ -38,6 +40,22 @@ struct ReMoAnalysis
 	/** Converts a remo map to a bifa map. */
 	static void convert(map_t & remo_map, BiFaAnalysis::map_t & bifa_map);
 
+	/** Moves the analyses in from into to. Keeps the analysis already in to for any remo in both. Returns how many were not moved. */
+	static unsigned merge(map_t & from, map_t & to);
+
+	/**
+	Analyses each remo in the sequence group into the map. Its centre sequence is scored with the PSSMs
+	the filter passes and the hits are adjusted with the other sequences in the remo. Threads may analyse
+	different groups into different maps at once. Throws if the map already has analysis for a remo.
+	*/
+	static void analyse(
+		ReMoSequenceGroup & sg,
+		map_t & analysis_map,
+		const BiobasePssmFilter & filter,
+		float_t threshold,
+		float_t phylo_threshold,
+		bool masked);
+
 protected:
 	friend class boost::serialization::access;
     template<class Archive>
@@ -57,6 +75,40 @@ protected:
 
 
 
+namespace detail {
+
+/** Passes on the pairs of hits for_each_double_hit() wants. */
+template <class Fn>
+struct double_hit_visitor
+{
+	const std::string & sequence;
+	Fn & fn;
+	bool include_twins;
+
+	double_hit_visitor(const std::string & sequence, Fn & fn, bool include_twins)
+		: sequence(sequence), fn(fn), include_twins(include_twins)
+	{
+	}
+
+	void operator()(const bifa_hits_t::value_type & h1, const bifa_hits_t::value_type & h2) const
+	{
+		//check they are not the same pssm
+		if (! include_twins && h1.get_binder() == h2.get_binder())
+		{
+			//they are
+			return;
+		}
+
+		fn(sequence, h1, h2);
+	}
+};
+
+} //namespace detail
+
+/**
+Calls fn(sequence, h1, h2) for each pair of hits in a remo where h2 starts after the end of h1 but no
+more than distance bases after it.
+*/
 template <class Fn>
 void
 for_each_double_hit(
@@ -67,62 +119,28 @@ for_each_double_hit(
 {
 	unsigned num_sequences = 0;
 	unsigned num_remos = 0;
-	for (typename ReMoAnalysis::map_t::const_iterator s = analysis_map.begin();
+	for (ReMoAnalysis::map_t::const_iterator s = analysis_map.begin();
 		analysis_map.end() != s;
 		++s, ++num_sequences)
 	{
 		//for each location
-		for (typename ReMoAnalysis::location_map_t::const_iterator l = s->second.begin();
+		for (ReMoAnalysis::location_map_t::const_iterator l = s->second.begin();
 			s->second.end() != l;
 			++l)
 		{
 			//for each remo
-			for (typename ReMoAnalysis::sequence_map_t::const_iterator r = l->second.begin();
+			for (ReMoAnalysis::sequence_map_t::const_iterator r = l->second.begin();
 				l->second.end() != r;
 				++r, ++num_remos)
 			{
-				//for each hit
-				for (typename match_result_vec_t::const_iterator h1 = r->second.get()->results.begin();
-					!( ( typename match_result_vec_t::const_iterator )( r->second.get()->results.end() ) == h1 );
-					++h1)
-				{
-					const unsigned size_1 = BiobaseDb::singleton().get_pssm_entry(h1->link)->get_size();
-
-					//look for other hits ahead of h1 but inside the distance
-					for (typename match_result_vec_t::const_iterator h2 = r->second.get()->results.begin();
-						!( ( typename match_result_vec_t::const_iterator )( r->second.get()->results.end() ) == h2 );
-						++h2)
-					{
-						//check h2 is ahead of h1
-						if (h2->result.position <= h1->result.position)
-						{
-							//it isn't
-							continue;
-						}
-
-						//check h2 is not too far ahead, i.e. inside the distance
-						if (unsigned(h2->result.position - h1->result.position) > distance + size_1)
-						{
-							//it is too far ahead
-							continue;
-						}
-
-						//check they don't overlap
-						if (unsigned(h2->result.position - h1->result.position) <= size_1)
-						{
-							continue;
-						}
-
-						//check they are not the same pssm
-						if (! include_twins && h1->link == h2->link)
-						{
-							//they are
-							continue;
-						}
-
-						fn(s->first, *h1, *h2);
-					}
-				}
+				//the results are ordered by position
+				const bifa_hits_t & results = r->second.get()->results;
+				for_each_hit_pair(
+					results.begin(),
+					results.end(),
+					1,
+					int(distance),
+					detail::double_hit_visitor<Fn>(s->first, fn, include_twins));
 			}
 		}
 	}
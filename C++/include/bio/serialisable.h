@@ -11,12 +11,27 @@
 #include <boost/concept_check.hpp>
 #include <boost/bind.hpp>
 #include <boost/timer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 
 
 BIO_NS_START
 
 
+namespace detail {
+
+/** Write a line to the log stream. Safe when several threads are loading objects at once. */
+inline
+void
+log_serialisation( const std::string & line )
+{
+	static boost::mutex mutex;
+	boost::lock_guard< boost::mutex > lock( mutex );
+	*( BioEnvironment::singleton().get_log_stream() ) << line << "\n";
+}
+
+} //namespace detail
 
 
 template< bool binary, typename T>
@@ -92,31 +107,33 @@ bool try_to_deserialise(
 	{
 		if( ! boost::filesystem::exists( archive_file ) )
 		{
-			*( BioEnvironment::singleton().get_log_stream() ) << "\"" << archive_file._BOOST_FS_NATIVE() << "\" does not exist\n";
+			detail::log_serialisation( BIO_MAKE_STRING( "\"" << archive_file._BOOST_FS_NATIVE() << "\" does not exist" ) );
 		}
 		else
 		{
 			boost::timer timer;
 			BIO_NS::deserialise< binary, object_t >( object, archive_file );
-			*( BioEnvironment::singleton().get_log_stream() ) << "Deserialised \"" << archive_file._BOOST_FS_NATIVE() << "\" - " << timer.elapsed() << "s\n";
+			detail::log_serialisation( BIO_MAKE_STRING( "Deserialised \"" << archive_file._BOOST_FS_NATIVE() << "\" - " << timer.elapsed() << "s" ) );
 
 			deserialised = true;
 		}
 	}
 	catch( const std::exception & exception )
 	{
-		*( BioEnvironment::singleton().get_log_stream() )
-			<< exception.what()
-			<< ": Could not deserialise \""
-			<< archive_file._BOOST_FS_NATIVE()
-			<< "\"\n";
+		detail::log_serialisation(
+			BIO_MAKE_STRING(
+				exception.what()
+				<< ": Could not deserialise \""
+				<< archive_file._BOOST_FS_NATIVE()
+				<< "\"" ) );
 	}
 	catch(...)
 	{
-		*( BioEnvironment::singleton().get_log_stream() )
-			<< "Could not deserialise \""
-			<< archive_file._BOOST_FS_NATIVE()
-			<< "\"\n";
+		detail::log_serialisation(
+			BIO_MAKE_STRING(
+				"Could not deserialise \""
+				<< archive_file._BOOST_FS_NATIVE()
+				<< "\"" ) );
 	}
 
 	return deserialised;
@@ -144,12 +161,12 @@ void deserialise_or_init(
 
 		//if we couldn't deserialise, construct from scratch
 		init( object );
-		*( BioEnvironment::singleton().get_log_stream() ) << "Initialised \"" << archive_file._BOOST_FS_NATIVE() << "\" - " << timer.elapsed() << "s\n";
+		detail::log_serialisation( BIO_MAKE_STRING( "Initialised \"" << archive_file._BOOST_FS_NATIVE() << "\" - " << timer.elapsed() << "s" ) );
 		timer.restart();
 
 		//save for next time
 		serialise< binary, object_t >( object, archive_file );
-		*( BioEnvironment::singleton().get_log_stream() ) << "Serialised \"" << archive_file._BOOST_FS_NATIVE() << "\" - " << timer.elapsed() << "s\n";
+		detail::log_serialisation( BIO_MAKE_STRING( "Serialised \"" << archive_file._BOOST_FS_NATIVE() << "\" - " << timer.elapsed() << "s" ) );
 	}
 }
 
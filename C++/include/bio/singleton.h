@@ -5,6 +5,9 @@
 #include "bio/useradmin.h"
 
 #include <boost/utility.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 BIO_NS_START
 
@@ -19,7 +22,8 @@ BIO_NS_START
 #define ADD_STATIC_PROPERTY(CLASS,PROP) .add_static_property( #PROP, &CLASS::PROP##Get,&CLASS::PROP##Set)
 
 /**
- * Inherit from this class if you want a common singleton for all users.
+ * Inherit from this class if you want a common singleton for all users. The singleton
+ * is created on first use and this is safe to do from many threads at once.
  */
 template< typename T >
 struct Singleton
@@ -30,6 +34,16 @@ struct Singleton
 		typedef T object_t;
 		typedef boost::shared_ptr< object_t > ptr_t;
 
+		// once created we do not need to lock
+		object_t * created = instance().load( boost::memory_order_acquire );
+		if( created )
+		{
+			return *created;
+		}
+
+		// the lock is recursive so that init_singleton() can use the singleton it is initialising
+		boost::lock_guard< boost::recursive_mutex > lock( creation_mutex() );
+
 		static ptr_t _singleton;
 
 		if( 0 == _singleton )
@@ -45,12 +59,24 @@ struct Singleton
 				_singleton.reset();
 				throw;
 			}
+			instance().store( _singleton.get(), boost::memory_order_release );
 		}
 		return *_singleton;
 	}
 private:
 	void init_singleton() {}
 
+	static boost::atomic< T * > & instance()
+	{
+		static boost::atomic< T * > _instance( 0 );
+		return _instance;
+	}
+
+	static boost::recursive_mutex & creation_mutex()
+	{
+		static boost::recursive_mutex _mutex;
+		return _mutex;
+	}
 };
 
 
@@ -75,26 +101,28 @@ struct UserSingleton
 
 		typedef std::map< std::string, ptr_t > per_user_singleton_map;
 		static per_user_singleton_map _per_user_singleton;
+		static boost::recursive_mutex _mutex; // guards the map so many threads can share the singletons
 
 		const std::string username = user_admin::userGet();
 
-		// no need for find, insert only inserts when not there already
-		//typename ptrMap_t::iterator it = _singletonMap.find( username );
-		std::pair< typename per_user_singleton_map::iterator, bool > insert_result =
-				_per_user_singleton.insert(
+		boost::lock_guard< boost::recursive_mutex > lock( _mutex );
+
+		// only create the object when there is not one for this user already
+		typename per_user_singleton_map::iterator it = _per_user_singleton.find( username );
+		if( _per_user_singleton.end() == it ) {
+			it = _per_user_singleton.insert(
 				typename per_user_singleton_map::value_type(
 					username,
 					ptr_t( new object_t() )
 				)
-			);
+			).first;
 
-		// if we inserted the object, we need to initialise it
-		if( insert_result.second ) { // initialise if we inserted
-			insert_result.first->second->init_singleton();
+			// we inserted the object, we need to initialise it
+			it->second->init_singleton();
 		}
 
 		// return the object
-		return *( insert_result.first->second );
+		return *( it->second );
 	}
 
 private:
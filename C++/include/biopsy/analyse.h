@@ -14,9 +14,11 @@ Copyright John Reid 2006-2010
 
 #include "biopsy/defs.h"
 #include "biopsy/binding_hits.h"
+#include "biopsy/sequence.h"
 
 #include "bio/singleton.h"
 #include "bio/sequence.h"
+#include "bio/max_chain_stats.h"
 
 
 
@@ -34,6 +36,8 @@ Copyright John Reid 2006-2010
 namespace biopsy
 {
 
+struct scoring_context;
+
 /**
 Scores the pssm on the sequence and returns estimate that the pssm binds in at least one position.
 */
@@ -44,6 +48,41 @@ score_pssm_on_sequence(
 	double threshold,
 	binding_hit::vec_ptr result );
 
+/**
+Scores the pssm on the sequence under the scoring context and returns estimate that the pssm binds in at
+least one position.
+*/
+double
+score_pssm_on_sequence(
+	const std::string & pssm_name,
+	const sequence & seq,
+	double threshold,
+	binding_hit::vec_ptr result,
+	const scoring_context & context );
+
+/**
+Scores the pssm on the encoded sequence and returns estimate that the pssm binds in at least one position.
+Encode the sequence once when scoring many pssms on it.
+*/
+double
+score_pssm_on_sequence(
+	const std::string & pssm_name,
+	const encoded_sequence & seq,
+	double threshold,
+	binding_hit::vec_ptr result );
+
+/**
+Scores the pssm on the encoded sequence under the scoring context and returns estimate that the pssm binds
+in at least one position.
+*/
+double
+score_pssm_on_sequence(
+	const std::string & pssm_name,
+	const encoded_sequence & seq,
+	double threshold,
+	binding_hit::vec_ptr result,
+	const scoring_context & context );
+
 /**
 Generates the biobase scores for the pssm on the sequence.
 */
@@ -54,6 +93,27 @@ biobase_score_pssm_on_sequence(
 	double threshold,
 	binding_hit::vec_ptr result );
 
+/**
+Generates the biobase scores for the pssm on the encoded sequence.
+*/
+void
+biobase_score_pssm_on_sequence(
+	const std::string & pssm_name,
+	const encoded_sequence & seq,
+	double threshold,
+	binding_hit::vec_ptr result );
+
+/**
+Generates the biobase scores for the pssm on the encoded sequence under the scoring context.
+*/
+void
+biobase_score_pssm_on_sequence(
+	const std::string & pssm_name,
+	const encoded_sequence & seq,
+	double threshold,
+	binding_hit::vec_ptr result,
+	const scoring_context & context );
+
 /**
 Score a sequence.
 */
@@ -63,6 +123,39 @@ score_pssms_on_sequence(
 	const sequence & seq,
 	double threshold = BIOPSY_ANALYSE_THRESHOLD_DEFAULT );
 
+/**
+Score a sequence under the scoring context.
+*/
+binding_hit::vec_ptr
+score_pssms_on_sequence(
+	const string_vec_ptr & pssm_names,
+	const sequence & seq,
+	double threshold,
+	const scoring_context & context );
+
+
+/**
+Score each of the sequences on up to num_threads threads (0 for one per core). Returns the hits for
+each sequence in the order of the sequences.
+*/
+binding_hits_vec_ptr
+score_pssms_on_sequences(
+	const string_vec_ptr & pssm_names,
+	const sequence_vec & sequences,
+	double threshold = BIOPSY_ANALYSE_THRESHOLD_DEFAULT,
+	unsigned num_threads = 0 );
+
+/**
+Score each of the sequences under the scoring context on up to num_threads threads (0 for one per core).
+*/
+binding_hits_vec_ptr
+score_pssms_on_sequences(
+	const string_vec_ptr & pssm_names,
+	const sequence_vec & sequences,
+	double threshold,
+	unsigned num_threads,
+	const scoring_context & context );
+
 
 /**
 Score a sequence returning the biobase scores
@@ -73,6 +166,16 @@ biobase_score_pssms_on_sequence(
 	const sequence & seq,
 	double threshold = BIOPSY_BIOBASE_SCORE_THRESHOLD_DEFAULT );
 
+/**
+Score a sequence returning the biobase scores under the scoring context.
+*/
+binding_hit::vec_ptr
+biobase_score_pssms_on_sequence(
+	const string_vec_ptr & pssm_names,
+	const sequence & seq,
+	double threshold,
+	const scoring_context & context );
+
 
 
 /**
@@ -95,6 +198,53 @@ score_pssms_on_phylo_sequences(
 	bool calculate_maximal_chain = true
 );
 
+/**
+Score the pssms on the sequences under the scoring context.
+*/
+phylo_sequences_result
+score_pssms_on_phylo_sequences(
+	string_vec_ptr pssm_names,
+	sequence_vec_ptr sequences,
+	double threshold,
+	double phylo_threshold,
+	bool calculate_maximal_chain,
+	const scoring_context & context
+);
+
+
+typedef std::vector< phylo_sequences_result > phylo_sequences_result_vec;
+typedef boost::shared_ptr< phylo_sequences_result_vec > phylo_sequences_result_vec_ptr;
+
+
+/**
+Score the pssms on each set of sequences on up to num_threads threads (0 for one per core). Returns
+the results for each set in the order of the sets.
+*/
+phylo_sequences_result_vec_ptr
+score_pssms_on_phylo_sequence_sets(
+	string_vec_ptr pssm_names,
+	const std::vector< sequence_vec_ptr > & sequence_sets,
+	double threshold,
+	double phylo_threshold,
+	bool calculate_maximal_chain = true,
+	unsigned num_threads = 0
+);
+
+/**
+Score the pssms on each set of sequences under the scoring context on up to num_threads threads (0 for
+one per core).
+*/
+phylo_sequences_result_vec_ptr
+score_pssms_on_phylo_sequence_sets(
+	string_vec_ptr pssm_names,
+	const std::vector< sequence_vec_ptr > & sequence_sets,
+	double threshold,
+	double phylo_threshold,
+	bool calculate_maximal_chain,
+	unsigned num_threads,
+	const scoring_context & context
+);
+
 
 /**
 Get the maximum # of sequences for which the phylogenetic analysis algorithm
@@ -127,7 +277,21 @@ analyse_phylo(
 binding_hit::vec_ptr
 analyse_max_chain(
 	binding_hits_vec_ptr hit_array,
-	unsigned max_box_limit );
+	unsigned max_box_limit,
+	bool use_flat_range_tree = true );
+
+/**
+ * Calculate the maximal chain across the hit vectors within a budget of boxes and seconds (0 for no
+ * limit). Rather than giving up when there are too many boxes, raises the thresholds on the hits
+ * until they fit and returns the best chain found in time. Fills in stats.
+ */
+binding_hit::vec_ptr
+analyse_max_chain_within_budget(
+	binding_hits_vec_ptr hit_array,
+	unsigned max_box_limit,
+	double max_seconds,
+	BIO_NS::max_chain_stats & stats,
+	bool use_flat_range_tree = true );
 
 /**
 Find the pathway associated with a pssm
@@ -76,6 +76,7 @@ struct variational_model
 	array log_p_x_given_r;
 	array p_x_given_r;
 	vector_vec nu; /**< Variational parameters for start positions of sites. */
+	unsigned num_threads; /**< How many threads to update the sequences on, 0 for one per core. */
 
 	//methods
 	variational_model( 
@@ -99,6 +100,15 @@ protected:
 	void update_lambda();
 	void update_omega();
 
+	/** Add the statistics from sequences [n_begin, n_end) to log_h. */
+	void update_mu_nu_eta_block( const std::vector< vector * > & log_h, size_t b, size_t n_begin, size_t n_end );
+
+	/** Add the statistics from sequences [n_begin, n_end) to omega. */
+	void update_omega_block( const std::vector< array * > & omega, size_t b, size_t n_begin, size_t n_end ) const;
+
+	/** The log likelihood of sequences [n_begin, n_end). */
+	void log_likelihood_block( vector & log_likelihoods, size_t b, size_t n_begin, size_t n_end ) const;
+
 	template< typename fn >
 	fn
 	generate_combinations( 
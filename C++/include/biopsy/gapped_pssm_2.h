@@ -78,6 +78,7 @@ struct variational_model
 	variational_distribution	var_dist;				/**< The variational distribution. */
 	double_array				p_x_given_r;			/**< p(x|r) cached for efficiency. */
 	double_array				log_p_x_given_r;		/**< log p(x|r) cached for efficiency. */
+	unsigned					num_threads;			/**< How many threads to update the sequences on, 0 for one per core. */
 
 	variational_model( const observed_data & data );
 
@@ -92,6 +93,15 @@ struct variational_model
 
 protected:
 	void update_p_x_given_r_expectations();
+
+	/** Update the sequences [n_begin, n_end), adding their statistics to log_eta[b] and omega[b] and their log likelihood to LL[b]. */
+	void update_block(
+		const std::vector< double_vector * > & log_eta,
+		const std::vector< double_array * > & omega,
+		double_vector & LL,
+		size_t b,
+		size_t n_begin,
+		size_t n_end );
 };
 
 inline
@@ -172,9 +182,9 @@ variational_model::generate_combinations(
 						//index into pssm
 						const unsigned r = calc_r( data.K, e, i - a, bool( b ), bool( c ) );
 
-						//is the base complemented?
+						//is the base complemented? an 'n' (4) is its own complement
 						const unsigned x =
-							c
+							c && 4 != data.X[ n ][ i ]
 								? 3 - data.X[ n ][ i ] //yes
 								: data.X[ n ][ i ] //no
 							;
@@ -186,11 +186,18 @@ struct model
 
 	model( observed_data::ptr data );
 
-	/** Update the variational distribution parameters. Returns log likelihood. */
+	/**
+	Update the variational distribution parameters. Returns log likelihood.
+
+	If sparse_transitions, only the possible transitions in predecessor_states are visited and the
+	constant contribution of the impossible ones is summed in closed form. This is O(S) rather than
+	O(S^2) per base and gives the same results up to rounding.
+	*/
 	double update(
 		bool update_rho = true, 
 		bool update_eta = true, 
-		bool update_tau = true );
+		bool update_tau = true,
+		bool sparse_transitions = true );
 };
 
 
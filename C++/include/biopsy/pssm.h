@@ -15,6 +15,7 @@ Copyright John Reid 2006, 2013
 
 
 #include "biopsy/defs.h"
+#include "biopsy/sequence.h"
 
 #include "bio/singleton.h"
 #include "bio/pssm.h"
@@ -111,6 +112,18 @@ score_complement(
     const pssm & pssm,
     sequence::const_iterator s_begin );
 
+/** Score the pssm on an encoded sequence. */
+double
+score(
+    const pssm & pssm,
+    const encoded_sequence::code * codes );
+
+/** Score the pssm on the reverse complement of an encoded sequence. */
+double
+score_complement(
+    const pssm & pssm,
+    const encoded_sequence::code * codes );
+
 
 /**
 A vector quantising the probabilities of any given score in [0,1].
@@ -121,7 +134,33 @@ typedef boost::shared_ptr< likelihoods > likelihoods_ptr;
 /**
 Get an index into a likelihoods vector given a score.
 */
-unsigned get_likelihood_index( unsigned size, double score );
+inline
+unsigned get_likelihood_index( unsigned size, double score )
+{
+    if (size == 0)
+    {
+        throw std::logic_error( "size == 0" );
+    }
+
+    if (0.0 > score)
+    {
+        throw std::logic_error( BIOPSY_MAKE_STRING( "Score < 0: " << score ) );
+    }
+
+    if (score * 2 * size > 2 * size + 1)
+    {
+        throw std::logic_error( BIOPSY_MAKE_STRING( "Score > 1 and a bit: " << score ) );
+    }
+
+    unsigned idx = ( unsigned )(score * size);
+    if( size == idx ) //cater for a perfect match
+    {
+        --idx;
+    }
+    BOOST_ASSERT( 0 <= idx && idx < size );
+
+    return idx;
+}
 
 
 /**
@@ -181,6 +220,86 @@ calculate_pssm_likelihoods(
     bool verbose = false );
 
 
+/**
+Calculates the same likelihoods as calculate_pssm_likelihoods() but rounds each row's scores onto a lattice
+of lattice_size steps across the possible range of total scores and convolves dense arrays row by row.
+Much faster than calculate_pssm_likelihoods() for long pssms.
+*/
+void
+calculate_pssm_likelihoods_on_lattice(
+    const pssm & pssm,
+    const nucleo_dist::vec & distribution,
+    likelihoods & result,
+    const size_t lattice_size );
+
+
+
+
+struct pssm_info;
+struct pssm_parameters;
+
+/**
+The pssm_parameters that scoring PSSMs on sequences depends on. Functions that take one read all their
+settings from it rather than from the pssm_parameters singleton, so calls with different settings can run
+at the same time. It is a plain copy: changing the singleton afterwards does not change it. The functions
+that do not take one use scoring_context::current().
+*/
+struct scoring_context
+{
+    double binding_background_odds_prior;  ///< The prior odds of binding.
+    bool use_cumulative_dists;             ///< Use cumulative score distributions as opposed to exact.
+    bool use_p_value;                      ///< Use a p-value based scoring method.
+    bool use_score;                        ///< Use a PSSM scoring based scheme rather than the BiFA algorithm.
+    bool avg_phylo_bayes;                  ///< Average Bayes factors instead of probabilities for phylogenetic sequences.
+    double min_related_evidence_fraction;  ///< The fraction of the central evidence that is the minimum for related sequences.
+    bool use_vectorised_scan;              ///< Score many windows at once with the SIMD kernel.
+    bool use_lookahead;                    ///< Stop scoring a window as soon as it cannot reach the threshold.
+    unsigned num_threads;                  ///< The number of threads to score PSSMs with. 0 for one per core.
+    unsigned max_chain_num_boxes_limit;    ///< Limit on number of boxes used to calculate the maximal chain.
+    bool max_chain_flat_range_tree;        ///< Use the flat range tree to calculate the maximal chain.
+    bool max_chain_use_budget;             ///< Prune hits to fit the maximal chain within its budget.
+    double max_chain_max_seconds;          ///< Time budget for the maximal chain. 0 for no limit.
+
+    /** Copy the settings from the parameters. */
+    explicit scoring_context( const pssm_parameters & params );
+
+    /** The settings of the pssm_parameters singleton as they are now. */
+    static scoring_context current();
+};
+
+
+/**
+p(binding) for each quantised score of a PSSM under the scoring_context it was built with. Lets hot
+loops map a score to p(binding) with one lookup.
+*/
+struct p_binding_table
+{
+    typedef boost::shared_ptr< const p_binding_table > ptr;
+    typedef std::vector< ptr > vec;
+    typedef boost::shared_ptr< const vec > vec_ptr;
+
+    /** The most tables kept for one PSSM, for the scoring contexts asked for most recently. */
+    static const size_t max_tables_per_pssm = 8;
+
+    std::vector< double > p_binding;       ///< Indexed by get_likelihood_index(). Empty if the distributions have different sizes.
+    double binding_background_odds_prior;  ///< The parameters the table was built with.
+    bool use_cumulative_dists;
+    bool use_p_value;
+
+    p_binding_table( const pssm_info & info, const scoring_context & context );
+
+    /** Was the table built with these settings? */
+    bool matches( const scoring_context & context ) const;
+
+    /** Can the table be used? */
+    bool usable() const { return ! p_binding.empty(); }
+
+    /** p(binding) given the score. Gives the same result as get_p_binding_from_score(). */
+    double operator()( double score ) const
+    {
+        return p_binding[ get_likelihood_index( unsigned( p_binding.size() ), score ) ];
+    }
+};
 
 
 /**
@@ -204,6 +323,7 @@ struct pssm_info
     mutable likelihoods_ptr   _cumulative_binding_dist;
     mutable likelihoods_ptr   _cumulative_background_dist;
     mutable matrix_ptr        _log_likelihoods;
+    mutable p_binding_table::vec_ptr _p_binding_tables;  ///< Never changed once shared, only replaced.
 
     pssm_info(
         const nucleo_dist::vec & counts = nucleo_dist::vec(),
@@ -218,6 +338,15 @@ struct pssm_info
     /// Get the log likelihoods used in the BiFa algorithm
     const matrix_t & get_log_likelihoods() const;
 
+    /// Calculate the members that are otherwise calculated lazily so that the info can be read from many threads at once
+    void calculate_derived() const;
+
+    /// Get the table of p(binding) by score for the current pssm_parameters, rebuilding it if they have changed. Safe to call from many threads.
+    p_binding_table::ptr get_p_binding_table() const;
+
+    /// Get the table of p(binding) by score for the scoring context. A table is kept for each of the contexts asked for most recently so calls with different contexts do not rebuild each other's. Safe to call from many threads.
+    p_binding_table::ptr get_p_binding_table( const scoring_context & context ) const;
+
     friend class boost::serialization::access;
     template< typename  Archive >
     void serialize( Archive & ar, const unsigned int version )
@@ -237,6 +366,7 @@ struct pssm_info
 /**
 Creates/gets a PSSM (and its info) based on its id. This should match the following regex for
 a transfac pssm... [MR][0-9][0-9][0-9][0-9][0-9]
+Safe to call from many threads. The returned info is valid until the cache is cleared.
 */
 const pssm_info &
 get_pssm( const std::string & id );
@@ -277,6 +407,16 @@ get_p_binding_from_score(
     double score );
 
 
+/**
+Calculate p(binding) given the pssm score under the scoring context.
+*/
+double
+get_p_binding_from_score(
+    const pssm_info & p,
+    double score,
+    const scoring_context & context );
+
+
 
 /**
 Scores a pssm on the sequence and adjusts for distributions.
@@ -296,6 +436,24 @@ get_p_binding_on_reverse_complement(
     sequence::const_iterator s_begin );
 
 
+/**
+Scores a pssm on an encoded sequence and adjusts for distributions.
+*/
+double
+get_p_binding_on_sequence(
+    const pssm_info & p,
+    const encoded_sequence::code * codes );
+
+
+/**
+Scores a pssm on the reverse complement of an encoded sequence and adjusts for distributions.
+*/
+double
+get_p_binding_on_reverse_complement(
+    const pssm_info & p,
+    const encoded_sequence::code * codes );
+
+
 
 /**
 Add a pssm to the cache.
@@ -311,6 +469,54 @@ void
 save_pssm_cache_state( );
 
 
+/**
+Writes the pssm cache in the memory-mapped binary format. When the binary cache exists it is used instead
+of the serialised pssm cache and PSSMs are decoded from it as they are asked for.
+*/
+void
+save_pssm_cache_binary_state( );
+
+
+/**
+Builds the PSSM information for each of the ids that is not already in the pssm cache using num_threads
+threads (0 for one per core). Each new entry is appended to a journal next to the cache file as soon as
+it is built so an interrupted run keeps its progress. The journal is read when the cache is loaded and
+folded into the cache file by save_pssm_cache_state(). Returns the number of new entries.
+*/
+unsigned
+precompute_pssm_cache(
+    const string_vec & ids,
+    unsigned num_threads = 0 );
+
+
+/**
+The PSSMs read from a journal, in the order they were appended.
+*/
+typedef std::vector< std::pair< std::string, pssm_info > > pssm_journal_entries;
+
+
+/**
+Appends a PSSM to a journal. Each record is the length and CRC-32 of a text archive of the id and the
+PSSM information followed by the archive itself so that a record torn by an interrupted run is detected.
+*/
+void
+append_to_pssm_journal(
+    const std::string & journal_file,
+    const std::string & name,
+    const pssm_info & info );
+
+
+/**
+Reads the complete records of a journal in order. If the journal ends with a torn or corrupt record it is
+truncated after the last good one, so records appended later are not hidden behind it. Returns the
+number of records read.
+*/
+unsigned
+read_pssm_journal(
+    const std::string & journal_file,
+    pssm_journal_entries & entries );
+
+
 /**
  * Clears the pssm cache. We may want to use this when testing parameter values.
  */
@@ -335,6 +541,14 @@ struct pssm_parameters
     ADD_STATIC_SINGLETON_VARIABLE( bool,      avg_phylo_bayes ) ///< Average Bayes factors instead of probabilities when adjusting for phylogenetic sequences.
     ADD_STATIC_SINGLETON_VARIABLE( unsigned, max_chain_num_boxes_limit ) ///< Limit on number of boxes used to calculate the maximal chain.
     ADD_STATIC_SINGLETON_VARIABLE( double,    min_related_evidence_fraction ) ///< The fraction of the evidence for binding from the central sequence that acts as a minimum for the related sequences.
+    ADD_STATIC_SINGLETON_VARIABLE( bool,      use_vectorised_scan ) ///< Score many windows at once with the SIMD kernel when using the BiFA algorithm.
+    ADD_STATIC_SINGLETON_VARIABLE( unsigned,  num_threads ) ///< The number of threads to score PSSMs with. 0 for one per core.
+    ADD_STATIC_SINGLETON_VARIABLE( bool,      use_lookahead ) ///< Stop scoring a window as soon as it cannot reach the threshold. Does not change the hits.
+    ADD_STATIC_SINGLETON_VARIABLE( bool,      use_likelihoods_lattice ) ///< Calculate PSSM score likelihoods on a lattice rather than with a map.
+    ADD_STATIC_SINGLETON_VARIABLE( unsigned,  likelihoods_lattice_size ) ///< The number of lattice steps used to calculate PSSM score likelihoods.
+    ADD_STATIC_SINGLETON_VARIABLE( bool,      max_chain_flat_range_tree ) ///< Use the flat range tree to calculate the maximal chain. Does not change the chain.
+    ADD_STATIC_SINGLETON_VARIABLE( bool,      max_chain_use_budget ) ///< Prune hits to fit the maximal chain within max_chain_num_boxes_limit and max_chain_max_seconds rather than skipping it.
+    ADD_STATIC_SINGLETON_VARIABLE( double,    max_chain_max_seconds ) ///< Time budget for the maximal chain when max_chain_use_budget is set. 0 for no limit.
 
     pssm_parameters();
 };
@@ -0,0 +1,80 @@
+/**
+@file
+
+Copyright John Reid 2013
+
+A flat binary file of pssm_infos that is memory-mapped and decoded one entry at a time.
+*/
+
+#ifndef BIOPSY_PSSM_BINARY_CACHE_H_
+#define BIOPSY_PSSM_BINARY_CACHE_H_
+
+#ifdef _MSC_VER
+# pragma once
+#endif //_MSC_VER
+
+#include "biopsy/defs.h"
+#include "biopsy/pssm.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <map>
+
+
+namespace biopsy {
+
+
+/**
+A read-only, memory-mapped file of pssm_infos indexed by PSSM id. Opening it only reads the header;
+entries are decoded when asked for. Processes that open the same file share one copy of its pages.
+
+The file holds a header, each entry's counts, scores and likelihoods as contiguous blocks of doubles,
+the ids and an index sorted by id. It is written in the native byte order and is rejected on a
+machine with a different one.
+*/
+class pssm_binary_cache
+    : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr< pssm_binary_cache > ptr;
+    typedef std::map< std::string, pssm_info > map_t;
+
+    /** Map the file. Throws if it is not a valid binary PSSM cache. */
+    explicit pssm_binary_cache( const boost::filesystem::path & file );
+
+    /** The number of PSSMs in the file. */
+    size_t size() const;
+
+    /** Is the PSSM in the file? */
+    bool contains( const std::string & id ) const;
+
+    /** Decode the PSSM into info. Only the persisted members are set. Returns false if the PSSM is not in the file. */
+    bool get( const std::string & id, pssm_info & info ) const;
+
+    /** The ids of the PSSMs in the file. */
+    string_vec_ptr get_ids() const;
+
+    /** Write the PSSMs to a file in the binary format. */
+    static void write( const boost::filesystem::path & file, const map_t & infos );
+
+protected:
+    struct header;
+    struct index_entry;
+
+    boost::interprocess::file_mapping _mapping;
+    boost::interprocess::mapped_region _region;
+    const char * _begin;
+    const index_entry * _index_begin;
+    const index_entry * _index_end;
+
+    /** The index entry for the id or 0 if none. */
+    const index_entry * find( const std::string & id ) const;
+};
+
+
+} //namespace biopsy
+
+#endif //BIOPSY_PSSM_BINARY_CACHE_H_
@@ -0,0 +1,141 @@
+/**
+@file
+
+Copyright John Reid 2013
+
+Vectorised kernel to score PSSM log-likelihoods on many windows of an encoded sequence at once.
+*/
+
+#ifndef BIOPSY_PSSM_SCAN_H_
+#define BIOPSY_PSSM_SCAN_H_
+
+#ifdef _MSC_VER
+# pragma once
+#endif //_MSC_VER
+
+#include "biopsy/defs.h"
+#include "biopsy/sequence.h"
+#include "biopsy/pssm.h"
+
+
+namespace biopsy {
+
+
+/**
+A PSSM's log-likelihoods laid out flat, one column of 4 bases after another, for
+both strands. The negative strand table holds the reverse complement so that both
+strands are scored by reading the sequence forwards.
+*/
+struct pssm_scan_table
+{
+    typedef std::vector< double > table_t;
+
+    size_t size;        ///< The number of columns in the PSSM.
+    table_t positive;   ///< positive[ 4 * column + base ]
+    table_t negative;   ///< negative[ 4 * column + base ], the reverse complement.
+
+    explicit pssm_scan_table( const pssm_info::matrix_t & log_likelihoods );
+};
+
+
+/**
+The instruction sets the scanning kernel can use.
+*/
+enum pssm_scan_kernel {
+    PSSM_SCAN_SCALAR,
+    PSSM_SCAN_SSE2,
+    PSSM_SCAN_AVX2
+};
+
+
+/**
+The best kernel this CPU supports.
+*/
+pssm_scan_kernel
+best_pssm_scan_kernel();
+
+
+/**
+The name of the kernel.
+*/
+const char *
+pssm_scan_kernel_name( pssm_scan_kernel kernel );
+
+
+/**
+Score num_windows consecutive windows starting at codes on both strands. Each window's
+scores are summed column by column in the same order as bifa::score_word so the results
+are identical to the scalar path. Windows that contain unknown bases are scored as if
+the bases were 'a': callers should skip them.
+*/
+void
+scan_pssm_log_likelihoods(
+    const pssm_scan_table & table,
+    const encoded_sequence::code * codes,
+    size_t num_windows,
+    double * positive_scores,
+    double * negative_scores,
+    pssm_scan_kernel kernel = best_pssm_scan_kernel() );
+
+
+/**
+A PSSM's columns in decreasing order of information content, for each strand, with the best score
+achievable from each column onwards. Scoring a window in this order can stop as soon as the best
+possible remaining score cannot reach the minimum a hit needs, as most windows cannot.
+*/
+struct pssm_lookahead_table
+{
+    typedef std::vector< double > table_t;
+    typedef std::vector< unsigned > order_t;
+
+    size_t size;                ///< The number of columns in the PSSM.
+    order_t positive_order;     ///< The window offsets in the order they are scored on the positive strand.
+    order_t negative_order;     ///< The window offsets in the order they are scored on the negative strand.
+    table_t positive;           ///< positive[ 4 * k + base ] scores the k'th offset scored.
+    table_t negative;           ///< negative[ 4 * k + base ] scores the k'th offset scored on the reverse complement.
+    table_t positive_bound;     ///< positive_bound[ k ] is the best score from the k'th offset scored onwards.
+    table_t negative_bound;     ///< negative_bound[ k ] is the best score from the k'th offset scored onwards.
+    double slack;               ///< Allows for rounding differences between this order and the PSSM's order.
+
+    /** For the BiFa log-likelihoods. */
+    pssm_lookahead_table( const pssm_info::matrix_t & log_likelihoods, const nucleo_dist::vec & dists );
+
+    /** For the PSSM's scores. */
+    pssm_lookahead_table( const pssm & _pssm, const nucleo_dist::vec & dists );
+
+    /**
+    Could the window starting at codes score at least min_score on the strand? Only false if
+    it definitely cannot.
+    */
+    bool
+    may_reach( const encoded_sequence::code * codes, bool positive_strand, double min_score ) const
+    {
+        if( 0 == size )
+        {
+            return 0. >= min_score - slack;
+        }
+        const unsigned * order = positive_strand ? &positive_order[ 0 ] : &negative_order[ 0 ];
+        const double * scores = positive_strand ? &positive[ 0 ] : &negative[ 0 ];
+        const double * bound = positive_strand ? &positive_bound[ 0 ] : &negative_bound[ 0 ];
+        const double target = min_score - slack;
+        double partial = 0.;
+        for( size_t k = 0; size != k; ++k )
+        {
+            partial += scores[ 4 * k + codes[ order[ k ] ] ];
+            if( partial + bound[ k + 1 ] < target )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+protected:
+    /** scores[ 4 * column + base ] for the positive strand. */
+    void init( const table_t & scores, const nucleo_dist::vec & dists );
+};
+
+
+} //namespace biopsy
+
+#endif //BIOPSY_PSSM_SCAN_H_
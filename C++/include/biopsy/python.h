@@ -60,6 +60,21 @@ BIOPSY_EXPORT_FN_SPEC void export_transfac_2();
 BIOPSY_EXPORT_FN_SPEC void export_transfac_3();
 
 
+/**
+Releases the GIL for its lifetime so other Python threads can run while C++ works. No Python objects
+may be touched while it is in scope.
+*/
+class release_gil
+	: boost::noncopyable
+{
+	PyThreadState * _state;
+
+public:
+	release_gil() : _state( PyEval_SaveThread() ) { }
+	~release_gil() { PyEval_RestoreThread( _state ); }
+};
+
+
 void std_exception_translator( std::logic_error const & x );
 void c_string_translator( const char * x );
 void string_translator( const std::string & x );
@@ -14,6 +14,7 @@ Copyright John Reid 2006
 
 #include "biopsy/defs.h"
 
+#include <boost/thread/mutex.hpp>
 
 
 namespace biopsy {
@@ -342,6 +343,12 @@ make_gene_alignment_map(
 
 
 
+typedef boost::tuple< module::ptr, aligned_sequence_set::ptr > remo_locator;
+typedef std::vector< remo_locator > remo_locator_list;
+typedef boost::shared_ptr< remo_locator_list > remo_locator_list_ptr;
+
+struct remo_index;
+
 /**
 A space of ReMos. Maps aligned sequences to lists of remos.
 */
@@ -358,19 +365,89 @@ struct remome
 	module::list_ptr get_remos_for( aligned_sequence_set::ptr ) const;
 	void remove_remos_for( aligned_sequence_set::ptr );
 
+	/** The index of the remos. Built the first time it is asked for and kept until invalidate_index() is called. */
+	boost::shared_ptr< const remo_index > get_index() const;
+
+	/** Must be called if _remos is changed other than by remove_remos_for(). */
+	void invalidate_index();
+
 	static remome::ptr deserialise( const std::string & path );
 	void serialise( const std::string & path ) const;
+
+protected:
+	mutable boost::shared_ptr< const remo_index > _index;
+	mutable boost::mutex _index_mutex;
 };
 
+
+/**
+Indexes the remos in a remome by their location in their centre sequence and by the genes of their
+sequences so they can be found without scanning the whole remome. Locations are inclusive.
+*/
+struct remo_index
+	: boost::noncopyable
+{
+	/** A remo and the location of its centre sequence. */
+	struct entry
+	{
+		location _location;
+		remo_locator _locator;
+
+		entry( const location & l, const remo_locator & locator );
+
+		bool operator<( const entry & rhs ) const;
+	};
+
+	/** The remos for one centre sequence sorted by location. */
+	struct centre_sequence_entries
+	{
+		std::vector< entry > _entries;
+		int _max_length;	/**< The longest location, bounds how far back an overlapping remo can start. */
+
+		centre_sequence_entries( );
+	};
+
+	typedef std::map< alignment_sequence_id::ptr, centre_sequence_entries, smart_ptr_less_than_value > centre_sequence_map;
+	typedef std::map< ensembl_id, remo_locator_list > gene_map;
+
+	centre_sequence_map _by_centre_sequence;
+	gene_map _by_gene;
+
+	explicit remo_index( const remome::remo_map & remos );
+
+	/** The remo whose centre sequence is at the location. Its module is null if there is none. */
+	remo_locator find( alignment_sequence_id::ptr centre_sequence, const location & l ) const;
+
+	/** The remos with a sequence from the gene. */
+	remo_locator_list_ptr get_remos_for_gene( const ensembl_id & gene ) const;
+
+	/** The remos whose locations in the centre sequence overlap the interval. */
+	remo_locator_list_ptr get_remos_overlapping( alignment_sequence_id::ptr centre_sequence, const location & interval ) const;
+};
+
+/** Write one set of aligned sequences and its remos to the stream as a binary archive. */
+void serialise_remos( std::ostream & stream, aligned_sequence_set::ptr aligned_seqs, module::list_ptr remos );
+
+/** Read a set of aligned sequences and its remos written by serialise_remos(). */
+remome::remo_map::value_type deserialise_remos( std::istream & stream );
+
 remome::ptr load_remome_from_file( const std::string & filename );
 
 remome::ptr parse_remome_from_file( const std::string & filename );
 
 std::string get_remo_id( aligned_sequence_set::ptr aligned_seqs, module::ptr _remo );
 
-typedef boost::tuple< module::ptr, aligned_sequence_set::ptr > remo_locator;
+/** Parse a remo id into the centre sequence and the location of the remo in it. */
+void parse_remo_id( const std::string & id, alignment_sequence_id::ptr & centre_sequence, location & l );
+
 remo_locator get_remo_from_id( remome::ptr _remome, const std::string & id );
 
+/** The remos with a sequence from the gene. */
+remo_locator_list_ptr get_remos_for_gene( remome::ptr _remome, const ensembl_id & gene );
+
+/** The remos whose locations in the centre sequence overlap the interval. */
+remo_locator_list_ptr get_remos_overlapping( remome::ptr _remome, alignment_sequence_id::ptr centre_sequence, const location & interval );
+
 sequence_vec_ptr get_sequences_for_remo( aligned_sequence_set::ptr aligned_seqs, module::ptr _remo );
 
 
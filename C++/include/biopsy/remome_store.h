@@ -0,0 +1,92 @@
+/**
+@file
+
+Copyright John Reid 2013
+
+A flat binary file of a remome that is memory-mapped and decoded one set of aligned sequences at a time.
+*/
+
+#ifndef BIOPSY_REMOME_STORE_H_
+#define BIOPSY_REMOME_STORE_H_
+
+#ifdef _MSC_VER
+# pragma once
+#endif //_MSC_VER
+
+#include "biopsy/defs.h"
+#include "biopsy/remo.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/noncopyable.hpp>
+
+
+namespace biopsy {
+namespace remo {
+
+
+/**
+A read-only, memory-mapped remome. Opening it only reads the header; each set of aligned sequences
+and its remos is decoded when asked for. Processes that open the same file share one copy of its pages.
+
+The file holds a header, one record per set of aligned sequences, the ids of their centre sequences
+and an index sorted by those ids. Each record is a binary archive written by serialise_remos().
+It is written in the native byte order and is rejected on a machine with a different one.
+*/
+class remome_store
+    : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr< remome_store > ptr;
+
+    /** Map the file. Throws if it is not a valid remome store. */
+    explicit remome_store( const std::string & path );
+
+    /** The number of sets of aligned sequences in the file. */
+    size_t size() const;
+
+    /** The ids of the centre sequences of the sets of aligned sequences in the file, sorted. */
+    string_vec_ptr get_centre_sequence_ids() const;
+
+    /** A remome of the sets of aligned sequences in the file with the centre sequence. It is empty if there are none. */
+    remome::ptr get_remome_for( alignment_sequence_id::ptr centre_sequence ) const;
+
+    /** Decode just the set of aligned sequences that holds the remo. Throws if it is not in the file. */
+    remo_locator get_remo_from_id( const std::string & id ) const;
+
+    /** Decode the whole remome. Equal sequence ids in different sets of aligned sequences are not shared. */
+    remome::ptr load() const;
+
+    /**
+    Write the remome to a file in the store format. It is written next to the file and renamed over it,
+    so processes that have the old store mapped keep reading it and a failed write leaves it untouched.
+    */
+    static void write( const std::string & path, const remome & r );
+
+protected:
+    struct header;
+    struct index_entry;
+
+    boost::interprocess::file_mapping _mapping;
+    boost::interprocess::mapped_region _region;
+    const char * _begin;
+    const index_entry * _index_begin;
+    const index_entry * _index_end;
+
+    std::string get_key( const index_entry * e ) const;
+
+    /** Write the store format straight into the file. */
+    static void write_file( const std::string & path, const remome & r );
+
+    /** The first index entry for the centre sequence or the end of the index if none. */
+    const index_entry * find( const std::string & key ) const;
+
+    /** Decode the record the index entry points to and add it to the remo map. */
+    void decode( const index_entry * e, remome::remo_map & remos ) const;
+};
+
+
+} //namespace remo
+} //namespace biopsy
+
+#endif //BIOPSY_REMOME_STORE_H_
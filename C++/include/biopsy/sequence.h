@@ -61,6 +61,47 @@ struct is_known_sequence
 };
 
 
+/**
+A sequence encoded once into base codes (one 2-bit code per byte: 0 for 'a', 1 for 'c',
+2 for 'g' and 3 for 't') so that scanning many PSSMs over it does not decode every
+character for every PSSM. Unknown bases ('n') are encoded as 0 and masked in a separate bitmap.
+*/
+struct encoded_sequence
+{
+	typedef unsigned char code;
+	typedef std::vector< code > code_vec;
+	typedef std::vector< bool > mask;
+
+	code_vec codes;   ///< The code for each base.
+	mask unknown;     ///< True where the base is unknown.
+
+	encoded_sequence();
+
+	/** Encodes the sequence. Throws if it contains anything other than 'a', 'c', 'g', 't' and 'n'. */
+	explicit encoded_sequence( const sequence & seq );
+
+	size_t size() const { return codes.size(); }
+
+	/** The position of the first unknown base at or after pos, size() if there is none. */
+	size_t next_unknown( size_t pos ) const;
+
+	/** Are all the bases in [pos, pos + length) known? */
+	bool is_known( size_t pos, size_t length ) const;
+};
+
+
+/**
+The code of the complement of an encoded base.
+*/
+inline
+encoded_sequence::code
+complement_code( encoded_sequence::code c )
+{
+	return encoded_sequence::code( 3 - c );
+}
+
+
+
 /**
 Generates a random sequence. The seed must be non-zero.
 */
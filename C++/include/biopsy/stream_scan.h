@@ -0,0 +1,84 @@
+/**
+@file
+
+Copyright John Reid 2013
+
+Scans PSSMs over fasta streams of any length (e.g. whole chromosomes) in bounded memory.
+*/
+
+#ifndef BIOPSY_STREAM_SCAN_H_
+#define BIOPSY_STREAM_SCAN_H_
+
+#ifdef _MSC_VER
+# pragma once
+#endif //_MSC_VER
+
+#include "biopsy/defs.h"
+#include "biopsy/analyse.h"
+
+#include "bio/chromosomes_file_set.h"
+
+#include <boost/function.hpp>
+
+#ifndef BIOPSY_STREAM_SCAN_BATCH_SIZE_DEFAULT
+# define BIOPSY_STREAM_SCAN_BATCH_SIZE_DEFAULT ( 1 << 20 )
+#endif //BIOPSY_STREAM_SCAN_BATCH_SIZE_DEFAULT
+
+
+
+namespace biopsy
+{
+
+/**
+Receives each hit with the identifier of the fasta sequence it is in. The hit's position is relative
+to the start of that sequence.
+*/
+typedef boost::function< void ( const std::string & sequence_id, const binding_hit & hit ) > binding_hit_sink;
+
+
+/**
+What a stream scan saw.
+*/
+struct stream_scan_stats
+{
+	size_t num_sequences;
+	size_t num_bases;
+	size_t num_batches;
+	size_t num_hits;
+
+	stream_scan_stats();
+};
+
+
+/**
+Scores the pssms on each sequence in the fasta stream, passing the hits to the sink in order of batch.
+
+The sequences are read and scored in batches of about batch_size bases. Each batch is prefixed with
+the last (longest pssm length - 1) bases of the previous one so that no window is missed, and hits
+in windows that were scored in the previous batch are dropped, so each hit is seen exactly once.
+Memory use is proportional to batch_size, not to the length of the sequences.
+*/
+stream_scan_stats
+score_pssms_on_fasta_stream(
+	const string_vec_ptr & pssm_names,
+	std::istream & stream,
+	const binding_hit_sink & sink,
+	double threshold = BIOPSY_ANALYSE_THRESHOLD_DEFAULT,
+	size_t batch_size = BIOPSY_STREAM_SCAN_BATCH_SIZE_DEFAULT );
+
+
+/**
+Scores the pssms on each fasta file in the set in turn. See score_pssms_on_fasta_stream().
+*/
+stream_scan_stats
+score_pssms_on_chromosomes(
+	const string_vec_ptr & pssm_names,
+	const BIO_NS::ChromosomesFileSet & chromosomes,
+	const binding_hit_sink & sink,
+	double threshold = BIOPSY_ANALYSE_THRESHOLD_DEFAULT,
+	size_t batch_size = BIOPSY_STREAM_SCAN_BATCH_SIZE_DEFAULT );
+
+
+} //namespace biopsy
+
+#endif //BIOPSY_STREAM_SCAN_H_
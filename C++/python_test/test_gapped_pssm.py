@@ -295,6 +295,38 @@ m, v = test_rho_simple()
 
 
 
+def test_sparse_transitions():
+    "Test that the sparse update gives the same results as the dense one."
+    K = 3
+    sequences = [
+            'tgacgtcaag',
+            'gtcat',
+            'aacgtgacgtt',
+    ]
+    dense = create_model( K, sequences, psi, theta, phi, upsilon )
+    sparse = create_model( K, sequences, psi, theta, phi, upsilon )
+    sparse.var_dist.eta = dense.var_dist.eta # eta is drawn at random
+    sparse.var_dist.tau = dense.var_dist.tau
+
+    def assert_close( a, b ):
+        a = numpy.asarray( a )
+        b = numpy.asarray( b )
+        assert numpy.abs( a - b ).max() <= 1e-9 * max( 1., numpy.abs( a ).max() ), (a, b)
+
+    print 'Updating'
+    for i in xrange( 20 ):
+        ll_dense = dense.update( sparse_transitions = False )
+        ll_sparse = sparse.update( sparse_transitions = True )
+        assert_close( ll_dense, ll_sparse )
+        for rho_dense, rho_sparse in zip( dense.var_dist.rho, sparse.var_dist.rho ):
+            assert_close( rho_dense, rho_sparse )
+        assert_close( dense.var_dist.eta, sparse.var_dist.eta )
+        assert_close( dense.var_dist.tau, sparse.var_dist.tau )
+    return dense, sparse
+dense, sparse = test_sparse_transitions()
+
+
+
 
 def test_simple():
     K = 2
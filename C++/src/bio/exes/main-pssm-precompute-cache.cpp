@@ -0,0 +1,89 @@
+/**
+@file
+
+Copyright John Reid 2013
+*/
+
+#include "bio-pch.h"
+
+
+#include "bio/application.h"
+#include "bio/biobase_filter.h"
+
+#include "biopsy/pssm.h"
+#include "biopsy/custom_pssm.h"
+#include "biopsy/transfac.h"
+
+
+USING_BIO_NS;
+using namespace biopsy;
+using namespace boost;
+using namespace std;
+
+
+/**
+Builds the PSSM cache entries for the ids provided or for all TRANSFAC and custom PSSMs. New entries
+are journalled as they are built so the run can be interrupted and restarted.
+*/
+struct PrecomputePssmCacheApp : Application
+{
+	vector< string > ids;
+	unsigned num_threads;
+	bool save;
+	bool save_binary;
+
+	PrecomputePssmCacheApp()
+		: num_threads( 0 )
+		, save( false )
+		, save_binary( false )
+	{
+		namespace po = boost::program_options;
+
+		get_options().add_options()
+			( "pssms", po::value( &ids ), "PSSM ids, all TRANSFAC and custom PSSMs if none given" )
+			( "threads,j", po::value( &num_threads ), "number of threads, 0 for one per core" )
+			( "save,s", po::value( &save ), "rewrite the whole PSSM cache file afterwards" )
+			( "binary,b", po::value( &save_binary ), "write the memory-mapped binary PSSM cache afterwards" )
+			;
+
+		get_positional_options().add( "pssms", -1 );
+	}
+
+	int task()
+	{
+		if( ids.empty() )
+		{
+			string_vec_ptr transfac_ids = get_transfac_pssm_accessions( BiobasePssmFilter::get_all_pssms_filter() );
+			string_vec_ptr custom_ids = get_all_custom_pssms();
+			ids.insert( ids.end(), transfac_ids->begin(), transfac_ids->end() );
+			ids.insert( ids.end(), custom_ids->begin(), custom_ids->end() );
+		}
+
+		cout << "Precomputing " << ids.size() << " PSSMs\n";
+		const unsigned num_built = precompute_pssm_cache( ids, num_threads );
+		cout << "Built " << num_built << " new PSSMs\n";
+
+		if( save )
+		{
+			save_pssm_cache_state();
+		}
+
+		if( save_binary )
+		{
+			save_pssm_cache_binary_state();
+		}
+
+		return 0;
+	}
+};
+
+
+
+
+int
+main(
+	int argc,
+	char * argv[] )
+{
+	return PrecomputePssmCacheApp().main( argc, argv );
+}
@@ -0,0 +1,370 @@
+/* Copyright John Reid 2007
+*/
+
+#include "bio-pch.h"
+
+
+
+
+#include "bio/application.h"
+#include "bio/remo_analysis.h"
+#include "bio/biobase_db.h"
+#include "bio/parallel.h"
+USING_BIO_NS
+
+#include <boost/progress.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/foreach.hpp>
+using namespace boost;
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <iterator>
+using namespace std;
+
+
+
+
+
+/** The analyses of the sequence groups in one shard, written to its own archive. */
+struct ReMoAnalysisShard
+{
+	size_t begin; /**< The first sequence group in the shard. */
+	size_t end; /**< One past the last sequence group in the shard. */
+	fs::path file;
+
+	/** Has a previous run already written this shard? */
+	bool is_complete() const
+	{
+		return fs::exists(file);
+	}
+
+	/** Write to a temporary file and rename it so the shard is only ever seen complete. */
+	void serialise(const ReMoAnalysis::map_t & analysis_map) const
+	{
+		const fs::path tmp_file(file._BOOST_FS_NATIVE() + ".tmp");
+		{
+			fs::ofstream stream(tmp_file, std::ios::binary);
+			boost::archive::binary_oarchive(stream) << analysis_map;
+			if (! stream)
+			{
+				throw std::runtime_error(BIO_MAKE_STRING("Could not write shard to \"" << tmp_file._BOOST_FS_NATIVE() << "\""));
+			}
+		}
+		fs::rename(tmp_file, file);
+	}
+
+	void deserialise(ReMoAnalysis::map_t & analysis_map) const
+	{
+		fs::ifstream stream(file, std::ios::binary);
+		if (! stream)
+		{
+			throw std::runtime_error(BIO_MAKE_STRING("Could not read shard from \"" << file._BOOST_FS_NATIVE() << "\""));
+		}
+		boost::archive::binary_iarchive(stream) >> analysis_map;
+	}
+};
+
+
+
+struct AnalyseReMoExtractionApp : Application
+{
+	typedef std::vector< ReMoSequenceGroup::ptr_t > sequence_group_vec;
+
+	std::string remo_extraction_filename;
+	std::string results_filename;
+	float_t threshold;
+	float_t phylo_threshold;
+	bool masked;
+	bool use_consensus_sequences;
+	bool output_bifa_analysis;
+	string species_filter;
+	string matrix_regex;
+	unsigned num_threads;
+	unsigned shard_size;
+	string shard_dir;
+
+	boost::scoped_ptr< BiobasePssmFilter > filter;
+	boost::scoped_ptr< boost::progress_display > show_progress;
+	boost::mutex output_mutex; /**< Guards the progress display and error messages. */
+
+	AnalyseReMoExtractionApp()
+	{
+		get_options().add_options()
+			("remo,r", po::value(&remo_extraction_filename)->default_value("remo_space.bin"), "remo extraction file")
+			("output,o", po::value(&results_filename)->default_value("remo_analysis.bin"), "results file")
+			("threshold,t", po::value(&threshold)->default_value(0.05f), "threshold for hits")
+			("phylo_threshold,p", po::value(&phylo_threshold)->default_value(0.05f), "threshold for phylogenetic sequences")
+			("species_filter", po::value(&species_filter)->default_value("V"), "species filter")
+			("consensus,c", po::value(&use_consensus_sequences)->default_value(true), "use consensus_sequences")
+			("matrix_regex,m", po::value(&matrix_regex)->default_value("."), "RegEx to match matrix names")
+			("masked", po::value(&masked)->default_value(true), "use masked remos")
+			("output_bifa_analysis,b", po::value(&output_bifa_analysis)->default_value(false), "output in bifa analysis format")
+			("threads,j", po::value(&num_threads)->default_value(1), "number of threads to analyse sequence groups with, 0 for one per core")
+			("shard_size,s", po::value(&shard_size)->default_value(0), "sequence groups per shard archive, 0 for no shards")
+			("shard_dir", po::value(&shard_dir)->default_value(""), "directory for the shard archives, defaults to the output file with .shards appended")
+			;
+	}
+
+	/** Analyse the remos in the sequence group. Errors are reported and the rest of the group is skipped. */
+	void analyse_sequence_group(ReMoSequenceGroup & sg, ReMoAnalysis::map_t & analysis_map)
+	{
+		try
+		{
+			ReMoAnalysis::analyse(sg, analysis_map, *filter, threshold, phylo_threshold, masked);
+		}
+		catch (const std::exception & ex)
+		{
+			boost::lock_guard< boost::mutex > lock( output_mutex );
+			cerr << "Error: " << ex.what() << endl;
+		}
+		catch (const string & msg)
+		{
+			boost::lock_guard< boost::mutex > lock( output_mutex );
+			cerr << "Error: " << msg << endl;
+		}
+		catch (const char * msg)
+		{
+			boost::lock_guard< boost::mutex > lock( output_mutex );
+			cerr << "Error: " << msg << endl;
+		}
+		catch (...)
+		{
+			boost::lock_guard< boost::mutex > lock( output_mutex );
+			cerr << "Undefined error" << endl;
+		}
+	}
+
+	void show_groups_done(size_t num_groups)
+	{
+		boost::lock_guard< boost::mutex > lock( output_mutex );
+		*show_progress += num_groups;
+	}
+
+	/** Analyses the i'th sequence group into its own map. */
+	struct analyse_one_group
+	{
+		AnalyseReMoExtractionApp & app;
+		const sequence_group_vec & groups;
+		std::vector< ReMoAnalysis::map_t > & analysis_maps;
+
+		analyse_one_group(AnalyseReMoExtractionApp & app, const sequence_group_vec & groups, std::vector< ReMoAnalysis::map_t > & analysis_maps)
+			: app(app), groups(groups), analysis_maps(analysis_maps)
+		{
+		}
+
+		void operator()(size_t i) const
+		{
+			app.analyse_sequence_group(*groups[i], analysis_maps[i]);
+			app.show_groups_done(1);
+		}
+	};
+
+	/** Analyses the sequence groups in the i'th shard and writes them to its archive unless a previous run did. */
+	struct analyse_one_shard
+	{
+		AnalyseReMoExtractionApp & app;
+		const sequence_group_vec & groups;
+		const std::vector< ReMoAnalysisShard > & shards;
+
+		analyse_one_shard(AnalyseReMoExtractionApp & app, const sequence_group_vec & groups, const std::vector< ReMoAnalysisShard > & shards)
+			: app(app), groups(groups), shards(shards)
+		{
+		}
+
+		void operator()(size_t i) const
+		{
+			const ReMoAnalysisShard & shard = shards[i];
+			if (! shard.is_complete())
+			{
+				ReMoAnalysis::map_t analysis_map;
+				for (size_t g = shard.begin; shard.end != g; ++g)
+				{
+					app.analyse_sequence_group(*groups[g], analysis_map);
+				}
+				shard.serialise(analysis_map);
+			}
+			app.show_groups_done(shard.end - shard.begin);
+		}
+	};
+
+	/** The settings that the shards' contents depend on. A restarted run must use the same ones. */
+	std::string get_shard_manifest(size_t num_groups) const
+	{
+		return BIO_MAKE_STRING(
+			"remo " << remo_extraction_filename << "\n"
+			<< "sequence groups " << num_groups << "\n"
+			<< "shard size " << shard_size << "\n"
+			<< "threshold " << threshold << "\n"
+			<< "phylo threshold " << phylo_threshold << "\n"
+			<< "masked " << masked << "\n"
+			<< "consensus " << use_consensus_sequences << "\n"
+			<< "species filter " << species_filter << "\n"
+			<< "matrix regex " << matrix_regex << "\n" );
+	}
+
+	/** Create the shard directory or check one left by a previous run was made with the same settings. */
+	void prepare_shard_dir(const fs::path & dir, size_t num_groups) const
+	{
+		const fs::path manifest_file = dir / "manifest.txt";
+		const std::string manifest = get_shard_manifest(num_groups);
+		if (fs::exists(manifest_file))
+		{
+			fs::ifstream stream(manifest_file);
+			const std::string existing((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+			if (existing != manifest)
+			{
+				throw std::runtime_error(BIO_MAKE_STRING(
+					"Shards in \"" << dir._BOOST_FS_NATIVE() << "\" were made with different settings. Remove them or use another --shard_dir" ));
+			}
+		}
+		else
+		{
+			fs::create_directories(dir);
+			fs::ofstream stream(manifest_file);
+			stream << manifest;
+		}
+	}
+
+	int task()
+	{
+		cout << "Reading remos from " << remo_extraction_filename << endl;
+		cout << "Using threshold of " << threshold << endl;
+		cout << "Using phylo threshold of " << phylo_threshold << endl;
+		cout << "Analysing " << (masked ? "masked" : "unmasked") << " remos\n";
+		cout << "Using species filter: " << species_filter << "\n";
+		cout << "Using matrix regex: " << matrix_regex << "\n";
+		cout << (use_consensus_sequences ? "Using" : "Not using") << " consensus sequences\n";
+		cout << (masked ? "Using" : "Not using") << " masked remos\n";
+		cout << "Output will be in " << (output_bifa_analysis ? "bifa" : "remo") << " format\n";
+		cout << "Using " << resolve_num_threads(num_threads) << " thread(s)\n";
+
+
+		//deserialise the binary remo archive
+		ReMoExtraction::ptr_t remo;
+		{
+			fs::path remo_extraction_archive( remo_extraction_filename );
+			cout << "Deserialising remo extraction from \"" << remo_extraction_archive._BOOST_FS_NATIVE() << "\"\n";
+			boost::progress_timer timer;
+			remo = ReMoExtraction::deserialise(remo_extraction_archive);
+		}
+		const sequence_group_vec groups(remo->sequence_groups.begin(), remo->sequence_groups.end());
+
+
+		//create the predicates to choose which matrices and sites we use
+		filter.reset(
+			new BiobasePssmFilter(
+				use_consensus_sequences,
+				species_filter,
+				matrix_regex ) );
+
+		//load the tables up front so the workers do not wait for each other to load them
+		BiobaseDb::singleton().load_all(num_threads);
+
+		//do the analysis on each remo
+		ReMoAnalysis::map_t analysis_map;
+		if (0 == shard_size)
+		{
+			const size_t num_groups = groups.size();
+			cout << "Analysing remos (" << num_groups << " sequence groups)\n";
+			show_progress.reset(new boost::progress_display(num_groups));
+			boost::progress_timer timer;
+
+			std::vector< ReMoAnalysis::map_t > analysis_maps(num_groups);
+			parallel_for(num_groups, num_threads, analyse_one_group(*this, groups, analysis_maps));
+
+			//merge in the order of the sequence groups so the result does not depend on the number of threads
+			BOOST_FOREACH(ReMoAnalysis::map_t & group_analysis, analysis_maps)
+			{
+				merge_analysis(group_analysis, analysis_map);
+			}
+			cout << "Got analysis for " << analysis_map.size() << " remos\n";
+		}
+		else
+		{
+			const fs::path dir(shard_dir.empty() ? results_filename + ".shards" : shard_dir);
+			prepare_shard_dir(dir, groups.size());
+
+			std::vector< ReMoAnalysisShard > shards;
+			size_t num_complete = 0;
+			for (size_t begin = 0; groups.size() > begin; begin += shard_size)
+			{
+				ReMoAnalysisShard shard;
+				shard.begin = begin;
+				shard.end = std::min(groups.size(), begin + shard_size);
+				shard.file = dir / BIO_MAKE_STRING("shard-" << std::setw(6) << std::setfill('0') << shards.size() << ".bin");
+				if (shard.is_complete())
+				{
+					++num_complete;
+				}
+				shards.push_back(shard);
+			}
+
+			{
+				cout << "Analysing remos (" << groups.size() << " sequence groups in " << shards.size() << " shards in \"" << dir._BOOST_FS_NATIVE() << "\")\n";
+				cout << num_complete << " shards are complete from a previous run\n";
+				show_progress.reset(new boost::progress_display(groups.size()));
+				boost::progress_timer timer;
+				parallel_for(shards.size(), num_threads, analyse_one_shard(*this, groups, shards));
+			}
+
+			{
+				cout << "Merging " << shards.size() << " shards\n";
+				boost::progress_timer timer;
+				BOOST_FOREACH(const ReMoAnalysisShard & shard, shards)
+				{
+					ReMoAnalysis::map_t shard_analysis;
+					shard.deserialise(shard_analysis);
+					merge_analysis(shard_analysis, analysis_map);
+				}
+			}
+			cout << "Got analysis for " << analysis_map.size() << " remos\n";
+		}
+
+		//serialise
+		{
+			cout << "Serialising remo analysis to \"" << results_filename << "\"\n";
+			std::ofstream stream(results_filename.c_str(), std::ios::binary);
+			if (output_bifa_analysis)
+			{
+				BiFaAnalysis::map_t bifa_map;
+				ReMoAnalysis::convert(analysis_map, bifa_map);
+				boost::archive::binary_oarchive(stream) << const_cast<const BiFaAnalysis::map_t &>(bifa_map);
+			}
+			else
+			{
+				boost::archive::binary_oarchive(stream) << const_cast<const ReMoAnalysis::map_t &>(analysis_map);
+			}
+		}
+
+		return 0;
+	}
+
+	/** Merge the analysis of some sequence groups into the whole analysis, reporting remos analysed twice. */
+	static void merge_analysis(ReMoAnalysis::map_t & from, ReMoAnalysis::map_t & to)
+	{
+		const unsigned num_duplicates = ReMoAnalysis::merge(from, to);
+		if (num_duplicates)
+		{
+			cerr << "Error: Already have analysis for " << num_duplicates << " remos\n";
+		}
+	}
+};
+
+int
+main(int argc, char * argv[])
+{
+	return AnalyseReMoExtractionApp().main(argc, argv);
+}
+
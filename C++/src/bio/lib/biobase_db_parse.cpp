@@ -0,0 +1,168 @@
+/* Copyright John Reid 2007
+*/
+
+#include "bio-pch.h"
+
+
+#include "bio/defs.h"
+
+
+#include "bio/biobase_db.h"
+#include "bio/biobase_data_traits.h"
+#include "bio/environment.h"
+#include "bio/parallel.h"
+
+#include <boost/function.hpp>
+USING_BIO_NS
+
+using namespace boost;
+using namespace boost::archive;
+
+using namespace std;
+
+
+
+BIO_NS_START
+
+
+
+
+BiobaseTablePssmEntry *
+BiobaseDb::get_pssm_entry( const TableLink & link ) const
+{
+	switch(link.table_id)
+	{
+		case SITE_DATA:
+			//site
+			return get_entry< SITE_DATA >( link ) ;
+
+		case MATRIX_DATA:
+			//matrix
+			return get_entry< MATRIX_DATA >( link );
+		default: throw std::logic_error( "Bad table index" );
+	}
+}
+
+BiobaseTableEntry *
+BiobaseDb::get_entry(const TableLink & link) const
+{
+	switch(link.table_id) {
+		case MOLECULE_DATA:
+			//molecule
+			return get_entry<MOLECULE_DATA>(link);
+
+		case PATHWAY_DATA:
+			//pathway
+			return get_entry<PATHWAY_DATA>(link);
+
+		case FRAGMENT_DATA:
+			//fragment
+			return get_entry<FRAGMENT_DATA>(link);
+
+		case GENE_DATA:
+			//gene
+			return get_entry<GENE_DATA>(link);
+
+		case FACTOR_DATA:
+			//factor
+			return get_entry<FACTOR_DATA>(link);
+
+		case SITE_DATA:
+			//site
+			return get_entry<SITE_DATA>(link);
+
+		case MATRIX_DATA:
+			//matrix
+			return get_entry<MATRIX_DATA>(link);
+		default: throw std::logic_error( "Bad table index" );
+	}
+}
+
+
+
+namespace detail {
+
+/** Loads one table of the biobase db and times it. */
+struct biobase_table_load
+{
+	typedef boost::function< size_t ( unsigned num_threads ) > load_fn;
+
+	std::string name;
+	load_fn load;
+	size_t size;
+	double seconds;
+
+	biobase_table_load( const std::string & name, load_fn load )
+		: name( name ), load( load ), size( 0 ), seconds( 0.0 )
+	{
+	}
+};
+
+template< typename Map >
+size_t
+load_biobase_table( const BiobaseDb & db, const Map & ( BiobaseDb::* get )( unsigned ) const, unsigned num_threads )
+{
+	return ( db.*get )( num_threads ).size();
+}
+
+template< typename Map >
+biobase_table_load
+make_biobase_table_load( const std::string & name, const BiobaseDb & db, const Map & ( BiobaseDb::* get )( unsigned ) const )
+{
+	return biobase_table_load( name, boost::bind( load_biobase_table< Map >, boost::cref( db ), get, _1 ) );
+}
+
+struct biobase_table_loader
+{
+	std::vector< biobase_table_load > & tables;
+	unsigned num_threads;	///< To parse each table's file with.
+
+	biobase_table_loader( std::vector< biobase_table_load > & tables, unsigned num_threads )
+		: tables( tables ), num_threads( num_threads )
+	{
+	}
+
+	void operator()( size_t i ) const
+	{
+		namespace pt = boost::posix_time;
+		const pt::ptime start = pt::microsec_clock::universal_time();
+		tables[ i ].size = tables[ i ].load( num_threads );
+		tables[ i ].seconds = ( pt::microsec_clock::universal_time() - start ).total_milliseconds() / 1000.0;
+	}
+};
+
+} //namespace detail
+
+
+void
+BiobaseDb::load_all( unsigned num_threads ) const 
+{
+	std::vector< detail::biobase_table_load > tables;
+	tables.push_back( detail::make_biobase_table_load( "matrices", *this, &BiobaseDb::get_matrices ) );
+	tables.push_back( detail::make_biobase_table_load( "sites", *this, &BiobaseDb::get_sites ) );
+	tables.push_back( detail::make_biobase_table_load( "factors", *this, &BiobaseDb::get_factors ) );
+	tables.push_back( detail::make_biobase_table_load( "genes", *this, &BiobaseDb::get_genes ) );
+	tables.push_back( detail::make_biobase_table_load( "compels", *this, &BiobaseDb::get_compels ) );
+	tables.push_back( detail::make_biobase_table_load( "evidences", *this, &BiobaseDb::get_evidences ) );
+	//tables.push_back( detail::make_biobase_table_load( "fragments", *this, &BiobaseDb::get_fragments ) );
+	//tables.push_back( detail::make_biobase_table_load( "pathways", *this, &BiobaseDb::get_pathways ) );
+	//tables.push_back( detail::make_biobase_table_load( "molecules", *this, &BiobaseDb::get_molecules ) );
+
+	//the tables are independent so each can be loaded on its own thread. Each table's file is also parsed
+	//in chunks on several threads, so the threads are divided between the tables loaded at once
+	unsigned tables_at_once;
+	unsigned threads_per_table;
+	divide_num_threads( num_threads, tables.size(), tables_at_once, threads_per_table );
+	parallel_for( tables.size(), tables_at_once, detail::biobase_table_loader( tables, threads_per_table ) );
+
+	std::ostream & log = *( BioEnvironment::singleton().get_log_stream() );
+	BOOST_FOREACH( const detail::biobase_table_load & table, tables )
+	{
+		log << "Loaded " << table.size << " " << table.name << " - " << table.seconds << "s\n";
+	}
+}
+
+
+
+
+BIO_NS_END
@@ -0,0 +1,140 @@
+/* Copyright John Reid 2007
+*/
+
+#include "bio-pch.h"
+
+
+#include "bio/defs.h"
+
+
+
+//#define BOOST_NO_ARGUMENT_DEPENDENT_LOOKUP
+
+#include "bio/biobase_db.h"
+#include "bio/pssm_likelihood_cache.h"
+#include "bio/biobase_filter.h"
+#include "bio/biobase_data_traits.h"
+#include "bio/pssm_likelihood.h"
+#include "bio/biobase_match.h"
+#include "bio/environment.h"
+#include "bio/serialisable.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/progress.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/filesystem/path.hpp>
+using namespace boost;
+namespace fs = boost::filesystem;
+
+#include <fstream>
+using namespace std;
+
+
+
+
+BIO_NS_START
+
+void
+PssmLikelihoodCache::populate_from_biobase()
+{
+	BiobasePssmFilter pssm_filter = BiobasePssmFilter::get_all_pssms_filter();
+
+	//for each site
+	for( site_filter_it i = get_sites_begin( pssm_filter );
+		get_sites_end( pssm_filter ) != i;
+		++i)
+	{
+		if( is_matchable( i->second ) )
+		{
+			try
+			{
+				cout << i->first << ": " << i->second->get_name() << endl;
+				get_likelihoods( i->first );
+			}
+			catch( const std::exception & ex )
+			{
+				cout << "Could not calculate likelihoods for: " << i->first << ": " << ex.what() << "\n";
+			}
+			catch( const char * ex )
+			{
+				cout << "Could not calculate likelihoods for: " << i->first << ": " << ex << "\n";
+			}
+		}
+	}
+
+	//for each matrix
+	for( matrix_filter_it i = get_matrices_begin( pssm_filter );
+		get_matrices_end( pssm_filter ) != i;
+		++i)
+	{
+		if( is_matchable( i->second ) )
+		{
+			try
+			{
+				cout << i->first << ": " << i->second->get_name() << endl;
+				get_likelihoods( i->first );
+			}
+			catch( const std::exception & ex )
+			{
+				cout << "Could not calculate likelihoods for: " << i->first << ": " << ex.what() << "\n";
+			}
+			catch( const char * ex )
+			{
+				cout << "Could not calculate likelihoods for: " << i->first << ": " << ex << "\n";
+			}
+		}
+	}
+}
+
+
+void
+PssmLikelihoodCache::init_singleton()
+{
+	try_to_deserialise< false >(
+		*this,
+		fs::path(
+			BioEnvironment::singleton().get_pssm_likelihoods_cache_file()
+		)
+	);
+}
+
+PssmLikelihoodCache::PssmLikelihoodCache(BiobaseDb & biobase_db)
+: biobase_db(biobase_db)
+{
+}
+
+
+BiobaseLikelihoods
+PssmLikelihoodMaker::operator()(const TableLink & key) const
+{
+	boost::progress_timer timer;
+	std::cout << "Calculating pssm likelihoods for: " << key << "\n";
+
+	//calculate the pssm likelihoods
+	BiobaseLikelihoods pssm_likelihoods(BioEnvironment::singleton().num_normalisation_quanta);
+
+	pssm_likelihood(
+		make_pssm( key ),
+		BioEnvironment::singleton().max_pssm_likelihood_map_size,
+		pssm_likelihoods );
+
+	return pssm_likelihoods;
+}
+
+
+const BiobaseLikelihoods *
+PssmLikelihoodCache::get_likelihoods(const PssmLikelihoodCache::key_t & key)
+{
+	return &likelihoods( key );
+}
+
+bool
+PssmLikelihoodCache::operator==(const PssmLikelihoodCache & rhs) const
+{
+	return likelihoods.get_elements() == rhs.likelihoods.get_elements();
+}
+
+
+
+BIO_NS_END
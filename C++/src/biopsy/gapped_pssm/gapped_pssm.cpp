@@ -8,6 +8,11 @@ Copyright John Reid 2006
 #include <biopsy/gapped_pssm.h>
 #include <biopsy/gsl.h>
 
+#include <bio/parallel.h>
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+
 #include <vector>
 #include <sstream>
 
@@ -139,6 +144,7 @@ variational_model::variational_model(
 	, log_p_x_given_r( boost::extents[ K+1 ][ 5 ] )
 	, p_x_given_r( boost::extents[ K+1 ][ 4 ] )
 	, nu( seqs.size() )
+	, num_threads( 1 )
 {
 	initialise_variational_params();
 }
@@ -288,8 +294,36 @@ struct update_mu_nu_eta_fn
 void
 variational_model::update_mu_nu_eta()
 {
+	//each block of sequences adds to its own log_h, the first block to the one we keep
+	const size_t num_blocks = BIO_NS::num_parallel_blocks( seqs.size(), num_threads );
 	vector log_h( eta.size(), 0.0 );
-	for( unsigned n = 0; seqs.size() != n; ++n )
+	vector_vec block_log_h( num_blocks - 1, vector( eta.size(), 0.0 ) );
+	std::vector< vector * > targets( 1, &log_h );
+	for( unsigned b = 0; block_log_h.size() != b; ++b ) targets.push_back( &block_log_h[b] );
+
+	BIO_NS::parallel_for_blocks(
+		seqs.size(),
+		num_blocks,
+		num_threads,
+		boost::bind( &variational_model::update_mu_nu_eta_block, this, boost::cref( targets ), _1, _2, _3 ) );
+
+	//reduce in block order so the result does not depend on the scheduling
+	for( unsigned b = 0; block_log_h.size() != b; ++b )
+	{
+		for( unsigned h = 0; log_h.size() != h; ++h )
+		{
+			log_h[h] += block_log_h[b][h];
+		}
+	}
+
+	// update eta
+	probabilities_from_logs( log_h, eta );
+}
+
+void
+variational_model::update_mu_nu_eta_block( const std::vector< vector * > & log_h, size_t b, size_t n_begin, size_t n_end )
+{
+	for( size_t n = n_begin; n_end != n; ++n )
 	{
 		vector log_g( 2 );
 		log_g[0] = expectation_log_gamma();
@@ -298,7 +332,7 @@ variational_model::update_mu_nu_eta()
 		generate_combinations(
 			n,
 			update_mu_nu_eta_fn(
-				log_h,
+				*log_h[b],
 				log_s,
 				log_g,
 				log_p_x_given_r ) );
@@ -311,9 +345,6 @@ variational_model::update_mu_nu_eta()
 		// update nu
 		probabilities_from_logs( log_s, nu[n] );
 	}
-
-	// update eta
-	probabilities_from_logs( log_h, eta );
 }
 
 void
@@ -374,17 +405,46 @@ variational_model::update_omega()
 			omega[j][x] = (0 == j) ? varphi[x] : phi[x];
 		}
 	}
-	for( unsigned n = 0; seqs.size() != n; ++n )
+
+	//each block of sequences adds to its own omega, the first block to the one we keep
+	const size_t num_blocks = BIO_NS::num_parallel_blocks( seqs.size(), num_threads );
+	std::vector< array > block_omega( num_blocks - 1, array( boost::extents[ K+1 ][ 4 ] ) );
+	std::vector< array * > targets( 1, &omega );
+	for( unsigned b = 0; block_omega.size() != b; ++b ) targets.push_back( &block_omega[b] );
+
+	BIO_NS::parallel_for_blocks(
+		seqs.size(),
+		num_blocks,
+		num_threads,
+		boost::bind( &variational_model::update_omega_block, this, boost::cref( targets ), _1, _2, _3 ) );
+
+	//reduce in block order so the result does not depend on the scheduling
+	for( unsigned b = 0; block_omega.size() != b; ++b )
 	{
-		generate_combinations(
-			n,
-			update_omega_fn( omega ) );
+		for( unsigned j = 0; K + 1 != j; ++j )
+		{
+			for( unsigned x = 0; 4 != x; ++x )
+			{
+				omega[j][x] += block_omega[b][j][x];
+			}
+		}
 	}
 		
 	// update cached values
 	recalc_after_omega_changes();
 }
 
+void
+variational_model::update_omega_block( const std::vector< array * > & omega, size_t b, size_t n_begin, size_t n_end ) const
+{
+	for( size_t n = n_begin; n_end != n; ++n )
+	{
+		generate_combinations(
+			n,
+			update_omega_fn( *omega[b] ) );
+	}
+}
+
 struct log_likelihood_fn
 {
 	typedef variational_model::array array;
@@ -443,16 +503,34 @@ struct log_likelihood_fn
 double 
 variational_model::log_likelihood() const
 {
+	const size_t num_blocks = BIO_NS::num_parallel_blocks( seqs.size(), num_threads );
+	vector block_ll( num_blocks, 0.0 );
+	BIO_NS::parallel_for_blocks(
+		seqs.size(),
+		num_blocks,
+		num_threads,
+		boost::bind( &variational_model::log_likelihood_block, this, boost::ref( block_ll ), _1, _2, _3 ) );
+
+	//sum in block order so the result does not depend on the scheduling
 	double total_ll = 0.0;
-	for( unsigned n = 0; seqs.size() != n; ++n )
+	for( unsigned b = 0; num_blocks != b; ++b )
+	{
+		total_ll += block_ll[b];
+	}
+	return total_ll;
+}
+
+void
+variational_model::log_likelihood_block( vector & log_likelihoods, size_t b, size_t n_begin, size_t n_end ) const
+{
+	for( size_t n = n_begin; n_end != n; ++n )
 	{
-		total_ll +=
+		log_likelihoods[b] +=
 			generate_combinations(
 				n,
 				log_likelihood_fn( seqs[n].size(), p_x_given_r ),
 				true ).log_likelihood( seqs[n] );
 	}
-	return total_ll;
 }
 
 
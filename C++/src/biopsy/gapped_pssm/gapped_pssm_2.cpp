@@ -10,6 +10,11 @@ Copyright John Reid 2006
 #include <biopsy/gapped_pssm_2.h>
 #include <biopsy/gsl.h>
 
+#include <bio/parallel.h>
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+
 #include <gsl/gsl_sf_psi.h>
 #include <gsl/gsl_sf_exp.h>
 #include <gsl/gsl_sf_log.h>
@@ -210,6 +215,7 @@ variational_model::variational_model( const observed_data & data )
 , var_dist( data )
 , p_x_given_r( boost::extents[ data.K + 1 ][ 4 ] )
 , log_p_x_given_r( boost::extents[ data.K + 1 ][ 5 ] )
+, num_threads( 1 )
 {
 	update_p_x_given_r_expectations();
 }
@@ -312,15 +318,81 @@ struct update_fn
 double
 variational_model::update()
 {
-	static const double log_quarter = gsl_sf_log( 0.25 );
+	//initialise log eta array
+	double_vector log_eta( var_dist.eta.size(), 0.0 );
 
+	//initialise omega to update
+	for( unsigned j = 0; data.K + 1 != j; ++j )
+	{
+		if( 0 == j ) for( unsigned x = 0; 4 != x; ++x ) var_dist.omega[j][x] = data.V[x]; //init from V
+		else for( unsigned x = 0; 4 != x; ++x ) var_dist.omega[j][x] = data.W[x]; //init from W
+	}
+
+	//each block of sequences adds to its own statistics, the first block to the ones we keep
+	const size_t num_blocks = BIO_NS::num_parallel_blocks( data.N(), num_threads );
+	double_vector_vec block_log_eta( num_blocks - 1, double_vector( log_eta.size(), 0.0 ) );
+	std::vector< double_array > block_omega( num_blocks - 1, double_array( boost::extents[ data.K + 1 ][ 4 ] ) );
+	std::vector< double_vector * > log_eta_targets( 1, &log_eta );
+	std::vector< double_array * > omega_targets( 1, &var_dist.omega );
+	for( unsigned b = 0; num_blocks - 1 != b; ++b )
+	{
+		log_eta_targets.push_back( &block_log_eta[b] );
+		omega_targets.push_back( &block_omega[b] );
+	}
+	double_vector block_LL( num_blocks, 0.0 );
+
+	BIO_NS::parallel_for_blocks(
+		data.N(),
+		num_blocks,
+		num_threads,
+		boost::bind(
+			&variational_model::update_block,
+			this,
+			boost::cref( log_eta_targets ),
+			boost::cref( omega_targets ),
+			boost::ref( block_LL ),
+			_1, _2, _3 ) );
+
+	//reduce in block order so the result does not depend on the scheduling
 	double LL = 0.0;
+	for( unsigned b = 0; num_blocks != b; ++b )
+	{
+		LL += block_LL[b];
+		if( 0 == b ) continue;
+		for( unsigned e = 0; log_eta.size() != e; ++e )
+		{
+			log_eta[e] += block_log_eta[b-1][e];
+		}
+		for( unsigned j = 0; data.K + 1 != j; ++j )
+		{
+			for( unsigned x = 0; 4 != x; ++x )
+			{
+				var_dist.omega[j][x] += block_omega[b-1][j][x];
+			}
+		}
+	}
 
-	//initialise log eta array
-	double_vector log_eta( var_dist.eta.size(), 0.0 );
+	impl::probabilities_from_logs_of_choose( log_eta, var_dist.eta );
+
+	//omega has changed so...
+	update_p_x_given_r_expectations();
+
+	return LL;
+}
+
+void
+variational_model::update_block(
+	const std::vector< double_vector * > & log_eta,
+	const std::vector< double_array * > & omega,
+	double_vector & LL,
+	size_t b,
+	size_t n_begin,
+	size_t n_end )
+{
+	static const double log_quarter = gsl_sf_log( 0.25 );
 
 	//for each sequence
-	for( unsigned n = 0; data.N() != n; ++n )
+	for( size_t n = n_begin; n_end != n; ++n )
 	{
 		//initialise log alpha array
 		double_array log_alpha( boost::extents[ var_dist.alpha[ n ].size() ][ 2 ] );
@@ -335,36 +407,22 @@ variational_model::update()
 		double_array log_gamma( boost::extents[ var_dist.gamma[ n ].size() ][ 2 ] );
 		impl::initialise_bernoulli_log_array_empty( log_gamma );
 
-		//initialise omega to update
-		for( unsigned j = 0; data.K + 1 != j; ++j )
-		{
-			if( 0 == j ) for( unsigned x = 0; 4 != x; ++x ) var_dist.omega[j][x] = data.V[x]; //init from V
-			else for( unsigned x = 0; 4 != x; ++x ) var_dist.omega[j][x] = data.W[x]; //init from W
-		}
-
 		//go through each combination
-		LL += generate_combinations( 
+		LL[b] += generate_combinations( 
 			n,
 			update_fn( 
 				log_p_x_given_r, 
 				log_alpha, 
 				log_beta, 
 				log_gamma, 
-				log_eta, 
-				var_dist.omega ) ).LL;
+				*log_eta[b], 
+				*omega[b] ) ).LL;
 
 		//convert logs back to probabilities
 		impl::probabilities_from_logs_of_bernoulli( log_alpha, var_dist.alpha[ n ] );
 		impl::probabilities_from_logs_of_bernoulli( log_beta, var_dist.beta[ n ] );
 		impl::probabilities_from_logs_of_bernoulli( log_gamma, var_dist.gamma[ n ] );
 	}
-
-	impl::probabilities_from_logs_of_choose( log_eta, var_dist.eta );
-
-	//omega has changed so...
-	update_p_x_given_r_expectations();
-
-	return LL;
 }
 
 } //namespace gapped_pssm_2
@@ -9,8 +9,11 @@ Copyright John Reid 2006
 #include <biopsy/gsl.h>
 #include <biopsy/log_probs.h>
 
+#include <boost/foreach.hpp>
+
 #include <vector>
 #include <sstream>
+#include <numeric>
 
 #include <gsl/gsl_sf_psi.h>
 #include <gsl/gsl_sf_exp.h>
@@ -410,6 +413,38 @@ calculate_log_p_x_given_r( unsigned K, unsigned S, const variational_distributio
 	}
 }
 
+/** The log probability the variational update gives transitions that are not possible. */
+const double impossible_transition_log_prob = -10.0;
+
+/** Add the expected counts of a possible transition to tau. */
+inline
+void
+update_tau_for_transition(
+	unsigned K,
+	const state_map & map,
+	const transition_parameters & params,
+	unsigned pre_s,
+	double p_transition,
+	variational_distribution & var_dist )
+{
+	const bool c_pre_s = map.c( pre_s );
+	const unsigned k_pre_s = map.k( pre_s );
+
+	//we don't want to update tau for sure thing transitions from gap bases
+	if( ! map.g( pre_s ) )
+	{
+		//or from the last base
+		if( ! (c_pre_s && 1 == k_pre_s) && ! (! c_pre_s && K == k_pre_s) )
+		{
+			const double a = params.get<1>();
+			const double b = params.get<2>();
+			const unsigned t_k = params.get<3>();
+			var_dist.tau[ t_k ][ 0 ] += p_transition * a;
+			var_dist.tau[ t_k ][ 1 ] += p_transition * ( a + b );
+		}
+	}
+}
+
 model::model( observed_data::ptr data )
 : data( data )
 , var_dist( new variational_distribution( *data ) )
@@ -423,7 +458,8 @@ double
 model::update(
 	bool update_rho, 
 	bool update_eta, 
-	bool update_tau )
+	bool update_tau,
+	bool sparse_transitions )
 {
 	double LL = 0.0;
 
@@ -511,7 +547,7 @@ model::update(
 					var_dist->eta[ m_s ][ c_s ? 3 - x : x ] += p_s;
 				}
 
-				if( 0 != i ) //if we're not at the beginning of the sequence (because we can't look at transition to first base)
+				if( 0 != i && ! sparse_transitions ) //if we're not at the beginning of the sequence (because we can't look at transition to first base)
 				{
 					/**
 					double_vector p_s_given_pre( S, 0.0 );
@@ -534,7 +570,7 @@ model::update(
 						const unsigned k_pre_s = map.k( pre_s );
 						const unsigned m_pre_s = map.m( pre_s );
 
-						const double log_p_r_given_pre = params.get<0>() ? log_p_r_given_predecessor[ pre_s ][ s ] : -10.0 ;
+						const double log_p_r_given_pre = params.get<0>() ? log_p_r_given_predecessor[ pre_s ][ s ] : impossible_transition_log_prob ;
 						if( update_rho )
 						{
 							log_rho[ i ][ s ] += log_p_r_given_pre * p_pre_s;
@@ -546,19 +582,53 @@ model::update(
 
 						if( params.get<0>() && update_tau )
 						{
-							//we don't want to update tau for sure thing transitions from gap bases
-							if( ! map.g( pre_s ) )
-							{
-								//or from the last base
-								if( ! (c_pre_s && 1 == k_pre_s) && ! (! c_pre_s && K == k_pre_s) )
-								{
-									const double a = params.get<1>();
-									const double b = params.get<2>();
-									const unsigned t_k = params.get<3>();
-									var_dist->tau[ t_k ][ 0 ] += p_pre_s * p_s * a;
-									var_dist->tau[ t_k ][ 1 ] += p_pre_s * p_s * ( a + b );
-								}
-							}
+							update_tau_for_transition( K, map, params, pre_s, p_pre_s * p_s, *var_dist );
+						}
+					}
+				}
+			}
+
+			if( 0 != i && sparse_transitions )
+			{
+				//every transition that is not possible contributes the constant, which we can sum in closed form
+				const double_vector & rho_pre = var_dist->rho[ n ][ i-1 ];
+				const double_vector & rho_s = var_dist->rho[ n ][ i ];
+				const double sum_p_pre_s = std::accumulate( rho_pre.begin(), rho_pre.end(), 0.0 );
+				const double sum_p_s = std::accumulate( rho_s.begin(), rho_s.end(), 0.0 );
+				if( update_rho )
+				{
+					for( unsigned s = 0; S != s; ++s )
+					{
+						log_rho[ i ][ s ] += impossible_transition_log_prob * sum_p_pre_s;
+						log_rho[ i-1 ][ s ] += impossible_transition_log_prob * sum_p_s;
+					}
+				}
+				LL += impossible_transition_log_prob * sum_p_pre_s * sum_p_s;
+				VERIFY( ! MY_ISNAN( LL ) );
+
+				//the possible transitions contribute the difference between their log probability and the constant
+				for( unsigned s = 0; S != s; ++s ) //for each state
+				{
+					const double p_s = rho_s[ s ];
+					BOOST_FOREACH( unsigned pre_s, predecessor_states[ s ] ) //for each predecessor state (or equivalently for every transition)
+					{
+						const transition_parameters & params = trans_params[ pre_s ][ s ];
+						VERIFY( params.get<0>() );
+
+						const double p_pre_s = rho_pre[ pre_s ];
+						const double log_p_r_given_pre = log_p_r_given_predecessor[ pre_s ][ s ] - impossible_transition_log_prob;
+						if( update_rho )
+						{
+							log_rho[ i ][ s ] += log_p_r_given_pre * p_pre_s;
+							log_rho[ i-1 ][ pre_s ] += log_p_r_given_pre * p_s;
+						}
+
+						LL += log_p_r_given_pre * p_pre_s * p_s;
+						VERIFY( ! MY_ISNAN( LL ) );
+
+						if( update_tau )
+						{
+							update_tau_for_transition( K, map, params, pre_s, p_pre_s * p_s, *var_dist );
 						}
 					}
 				}
@@ -1,6 +1,7 @@
 
 
 #include "biopsy/gapped_pssm.h"
+#include "biopsy/gapped_pssm_2.h"
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/parameterized_test.hpp>
@@ -11,6 +12,9 @@ using namespace boost::assign;
 using boost::unit_test::test_suite;
 
 #include <iostream>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
 using namespace std;
 
 
@@ -69,6 +73,140 @@ check_gapped_pssm( const string_vec & test_seqs )
 
 
 
+void
+check_gapped_pssm_threads( const string_vec & test_seqs )
+{
+	cout << "******* check_gapped_pssm_threads()" << endl;
+
+	using namespace biopsy;
+	using namespace biopsy::gapped_pssm;
+
+	dna_vec_list seqs( test_seqs.size() );
+	for( unsigned i = 0; test_seqs.size() != i; ++i )
+	{
+		string_to_dna_vec( test_seqs[i], seqs[i] );
+	}
+
+	variational_model serial_model(
+		4,
+		seqs,
+		std::vector< double >( 2, 1.0 ),
+		std::vector< double >( 4, 10.0 ),
+		std::vector< double >( 4, 0.1 ) );
+	variational_model parallel_model( serial_model );
+	parallel_model.num_threads = 3;
+
+	for( unsigned i = 0; 10 != i; ++i )
+	{
+		serial_model.update();
+		parallel_model.update();
+	}
+	BOOST_CHECK_CLOSE( serial_model.log_likelihood(), parallel_model.log_likelihood(), 1e-9 );
+
+	//the same number of threads should always give the same answer
+	variational_model repeat_model( parallel_model );
+	parallel_model.update();
+	repeat_model.update();
+	BOOST_CHECK_EQUAL( parallel_model.log_likelihood(), repeat_model.log_likelihood() );
+}
+
+
+
+/** Check two values agree to within a relative tolerance. */
+void
+check_close( double a, double b )
+{
+	BOOST_CHECK_SMALL( a - b, 1e-9 * std::max( 1.0, std::fabs( a ) ) );
+}
+
+template< typename Vec >
+void
+check_vectors_close( const Vec & a, const Vec & b )
+{
+	BOOST_REQUIRE_EQUAL( a.size(), b.size() );
+	for( unsigned i = 0; a.size() != i; ++i )
+	{
+		check_close( a[i], b[i] );
+	}
+}
+
+void
+check_variational_distributions_close(
+	const biopsy::gapped_pssm_2::variational_distribution & a,
+	const biopsy::gapped_pssm_2::variational_distribution & b )
+{
+	BOOST_REQUIRE_EQUAL( a.alpha.size(), b.alpha.size() );
+	for( unsigned n = 0; a.alpha.size() != n; ++n )
+	{
+		check_vectors_close( a.alpha[n], b.alpha[n] );
+		check_vectors_close( a.beta[n], b.beta[n] );
+		check_vectors_close( a.gamma[n], b.gamma[n] );
+	}
+	check_vectors_close( a.eta, b.eta );
+	BOOST_REQUIRE_EQUAL( a.omega.size(), b.omega.size() );
+	for( unsigned j = 0; a.omega.size() != j; ++j )
+	{
+		check_vectors_close( a.omega[j], b.omega[j] );
+	}
+}
+
+void
+check_gapped_pssm_2_threads( const string_vec & test_seqs )
+{
+	cout << "******* check_gapped_pssm_2_threads()" << endl;
+
+	using namespace biopsy;
+	using namespace biopsy::gapped_pssm;
+
+	dna_vec_list seqs( test_seqs.size() );
+	for( unsigned i = 0; test_seqs.size() != i; ++i )
+	{
+		string_to_dna_vec( test_seqs[i], seqs[i] );
+	}
+
+	const unsigned K = 2;
+	gapped_pssm_2::variational_model serial_model( gapped_pssm_2::observed_data( seqs, K, 1.0, 1.0, 100.0, 0.1 ) );
+	gapped_pssm_2::variational_model parallel_model( serial_model );
+	parallel_model.num_threads = 3;
+
+	for( unsigned i = 0; 10 != i; ++i )
+	{
+		//omega gathers every sequence's statistics, not just the last one's: each site start adds its
+		//probability for each of its K + 1 bases
+		double expected_omega_total = 0.0;
+		for( unsigned j = 0; K + 1 != j; ++j )
+		{
+			const double_vector & prior = ( 0 == j ) ? serial_model.data.V : serial_model.data.W;
+			expected_omega_total += std::accumulate( prior.begin(), prior.end(), 0.0 );
+		}
+		for( unsigned n = 0; seqs.size() != n; ++n )
+		{
+			const double_vector & alpha = parallel_model.var_dist.alpha[n];
+			expected_omega_total += ( K + 1 ) * std::accumulate( alpha.begin(), alpha.end(), 0.0 );
+		}
+
+		serial_model.update();
+		parallel_model.update();
+		check_variational_distributions_close( serial_model.var_dist, parallel_model.var_dist );
+
+		double omega_total = 0.0;
+		for( unsigned j = 0; K + 1 != j; ++j )
+		{
+			omega_total += std::accumulate( parallel_model.var_dist.omega[j].begin(), parallel_model.var_dist.omega[j].end(), 0.0 );
+		}
+		check_close( expected_omega_total, omega_total );
+	}
+
+	//the same number of threads should always give the same answer
+	gapped_pssm_2::variational_model repeat_model( parallel_model );
+	parallel_model.update();
+	repeat_model.update();
+	BOOST_CHECK( parallel_model.var_dist.eta == repeat_model.var_dist.eta );
+	BOOST_CHECK( parallel_model.var_dist.omega == repeat_model.var_dist.omega );
+}
+
+
+
 void
 register_compressed_int_array_tests( boost::unit_test::test_suite * test )
 {
@@ -78,6 +216,18 @@ register_compressed_int_array_tests( boost::unit_test::test_suite * test )
 			test_seqs.begin(),
 			test_seqs.end() ), 
 		0);
+	test->add( 
+		BOOST_PARAM_TEST_CASE( 
+			&check_gapped_pssm_threads,
+			test_seqs.begin(),
+			test_seqs.end() ), 
+		0);
+	test->add( 
+		BOOST_PARAM_TEST_CASE( 
+			&check_gapped_pssm_2_threads,
+			test_seqs.begin(),
+			test_seqs.end() ), 
+		0);
 }
 
 test_suite*
@@ -366,6 +366,10 @@ void export_gapped_pssms()
 			omega,
 			( arg("r"), arg("x") ), 
 			"Variational parameters for background and pss distributions" )
+		.def_readwrite(
+			"num_threads",
+			&variational_model::num_threads,
+			"How many threads to update the sequences on, 0 for one per core" )
 		.def( 
 			"update",
 			&variational_model::update,
@@ -603,6 +607,10 @@ void export_gapped_pssms_2()
 			"var_dist",
 			&variational_model::var_dist,
 			"The variational distribution" )
+		.def_readwrite(
+			"num_threads",
+			&variational_model::num_threads,
+			"How many threads to update the sequences on, 0 for one per core" )
 		.def(
 			"update",
 			&variational_model::update,
@@ -407,7 +407,8 @@ void export_gapped_pssms_hmm()
 		( 
 			arg( "update_rho" ) = true,
 			arg( "update_eta" ) = true,
-			arg( "update_tau" ) = true
+			arg( "update_tau" ) = true,
+			arg( "sparse_transitions" ) = true
 		)
 	)
 	;
@@ -0,0 +1,1225 @@
+/**
+@file
+
+Copyright John Reid 2006, 2007, 2008, 2009, 2010, 2011, 2012, 2013
+
+*/
+# ifdef _MSC_VER
+# pragma warning(disable : 4503)
+# endif //_MSC_VER
+
+#include "biopsy/defs.h"
+#include "biopsy/analyse.h"
+#include "biopsy/pssm.h"
+#include "biopsy/sequence.h"
+#include "biopsy/bifa.h"
+#include "biopsy/pssm_scan.h"
+
+#include "bio/bifa_analysis.h"
+#include "bio/adjust_hits.h"
+#include "bio/biobase_score.h"
+#include "bio/biobase_filter.h"
+#include "bio/binding_model.h"
+#include "bio/biobase_binding_model.h"
+#include "bio/pathway_associations.h"
+#include "bio/parallel.h"
+
+USING_BIO_NS
+
+
+#include "gsl/gsl_math.h"
+
+
+namespace biopsy {
+namespace detail {
+
+binding_hit convert( const BIO_NS::BindingHit< BindingModel > & hit )
+{
+    return
+        binding_hit(
+            hit.get_binder()->get_name(),
+            binding_hit_location(
+                hit.get_position(),
+                hit.get_length(),
+                ! hit.is_complementary()),
+            hit.get_p_binding() );
+}
+
+binding_hit::vec_ptr convert( const bifa_hits_t & bifa_hits )
+{
+    binding_hit::vec_ptr result( new binding_hit::vec );
+    BOOST_FOREACH( const BIO_NS::BindingHit< BindingModel > & hit, bifa_hits )
+    {
+        result->push_back( convert( hit ) );
+    }
+    return result;
+}
+
+} //namespace detail
+
+
+
+
+
+
+/**
+ * Evaluate all the words in the sequence. Returns probability of binding at least once to sequence.
+ * If given a lookahead table, skips the words it shows cannot score min_score: these must be the
+ * words that cannot reach the threshold.
+ */
+template< typename Evaluator >
+double
+evaluate_words_in_sequence(
+    const pssm_info &              info,
+    const std::string &            pssm_name,
+    const encoded_sequence &       seq,
+    double                         threshold,
+    const Evaluator &              evaluator,
+    binding_hit::vec_ptr           result,
+    const pssm_lookahead_table *   lookahead = 0,
+    double                         min_score = 0.
+) {
+    double p_does_not_bind_anywhere = 1.0;
+    const size_t size = info._pssm->size();
+
+    //is there enough sequence to score this pssm?
+    if( seq.size() < size )
+    {
+        return 0.0;
+    }
+
+    const size_t end = seq.size() - size + 1;
+    size_t next_unknown = seq.next_unknown( 0 );
+    for( size_t position = 0; end != position; ++position )
+    {
+        //are there any 'n's before the end of the pssm?
+        if( next_unknown < position )
+        {
+            next_unknown = seq.next_unknown( position );
+        }
+        if( next_unknown < position + size )
+        {
+            continue;
+        }
+
+        const encoded_sequence::code * s = &seq.codes[ position ];
+        for( int i = 0; 2 != i; ++i ) // i=0 for positive strand, i=1 for negative strand
+        {
+            const bool is_positive_strand = (0 == i);
+            if( lookahead && ! lookahead->may_reach( s, is_positive_strand, min_score ) )
+            {
+                continue;
+            }
+            const double p_binding = evaluator( s, is_positive_strand, position );
+            if( p_binding >= threshold )
+            {
+                result->push_back(
+                    binding_hit(
+                        pssm_name,
+                        binding_hit_location(
+                            position,
+                            size,
+                            is_positive_strand ),
+                        p_binding ) );
+
+                p_does_not_bind_anywhere *= ( 1.0 - p_binding );
+            }
+        }
+    }
+
+    const double p_binds_somewhere = 1.0 - p_does_not_bind_anywhere;
+    return p_binds_somewhere;
+}
+
+
+/// Functor that evaluates a word using the older score method.
+struct evaluate_word_using_score {
+
+    const pssm_info &           info;
+    const pssm &                _pssm;
+    const scoring_context &     context;
+    p_binding_table::ptr        table;
+
+    evaluate_word_using_score( const pssm_info & info, const scoring_context & context )
+    : info( info )
+    , _pssm( *info._pssm )
+    , context( context )
+    , table( info.get_p_binding_table( context ) )
+    { }
+
+    // Evaluate the word.
+    double
+    operator()(
+        const encoded_sequence::code * s,
+        bool is_positive_strand,
+        size_t position
+    ) const {
+        const double pssm_score = is_positive_strand ? score( _pssm, s ) : score_complement( _pssm, s );
+        if( ! table->usable() ) {
+            return get_p_binding_from_score( info, pssm_score, context );
+        }
+        return ( *table )( pssm_score );
+    }
+};
+
+
+
+
+/// Functor that evaluates a word using the BiFa method.
+template< typename BgLikelihoods >
+struct evaluate_word_using_bifa {
+
+    typedef pssm_info::matrix_t                                             pssm_t;
+
+    const BgLikelihoods &                                 bg_likelihoods;
+    const pssm_t &                                          pssm_log_likelihoods;
+    typename bifa::PssmTraits< pssm_t >::reverse_complement pssm_rev_comp_log_likelihoods;
+    double                                                  odds_prior;
+
+    evaluate_word_using_bifa(
+        const pssm_info & info,
+        const BgLikelihoods & bg_likelihoods,
+        double odds_prior
+    )
+    : bg_likelihoods( bg_likelihoods )
+    , pssm_log_likelihoods( info.get_log_likelihoods() )
+    , pssm_rev_comp_log_likelihoods( bifa::pssm_reverse_complement( const_cast< pssm_t & >( pssm_log_likelihoods ) ) )
+    , odds_prior( odds_prior )
+    { }
+
+    // Evaluate the word.
+    double
+    operator()(
+        const encoded_sequence::code * s,
+        bool is_positive_strand,
+        size_t position
+    ) const {
+        const double pssm_log_likelihood =
+            is_positive_strand
+                ? bifa::score_word< bifa::DnaAlphabet >( pssm_log_likelihoods, s )
+                : bifa::score_word< bifa::DnaAlphabet >( pssm_rev_comp_log_likelihoods, s )
+            ;
+        const double bg_log_likelihood = bg_likelihoods.get_word_log_likelihood(
+            position,
+            boost::size( pssm_log_likelihoods )
+        );
+
+        // calculate the probability of binding using the odds ratio.
+        return get_p_binding(
+            odds_prior
+            * std::exp( pssm_log_likelihood - bg_log_likelihood )
+        );
+    }
+};
+
+
+
+
+/**
+ * The least BiFa log-likelihood a word needs for its p(binding) to reach the threshold.
+ */
+double
+get_bifa_min_log_likelihood(
+    double threshold,
+    double bg_log_likelihood,
+    double odds_prior
+) {
+    if( 0. >= threshold || 1. <= threshold )
+    {
+        return -std::numeric_limits< double >::infinity();
+    }
+    return bg_log_likelihood + std::log( threshold / ( 1. - threshold ) / odds_prior );
+}
+
+
+/**
+ * The least score a word needs for its p(binding) to reach the threshold according to the table.
+ */
+double
+get_min_score(
+    const p_binding_table & table,
+    double threshold
+) {
+    const size_t size = table.p_binding.size();
+    for( size_t i = 0; size != i; ++i )
+    {
+        if( table.p_binding[ i ] >= threshold )
+        {
+            return double( i ) / double( size );
+        }
+    }
+    return std::numeric_limits< double >::infinity();
+}
+
+
+
+
+/**
+ * Evaluate all the words in the sequence using the BiFa method with a uniform background. Scores
+ * blocks of windows on both strands at once with the vectorised scanning kernel. Gives the same
+ * hits as evaluate_words_in_sequence() with evaluate_word_using_bifa.
+ */
+double
+evaluate_words_using_scan_kernel(
+    const pssm_info &          info,
+    const std::string &        pssm_name,
+    const encoded_sequence &   seq,
+    double                     threshold,
+    binding_hit::vec_ptr       result,
+    double                     odds_prior
+) {
+    static const size_t block_size = 4096;
+
+    const size_t size = info._pssm->size();
+
+    //is there enough sequence to score this pssm?
+    if( seq.size() < size )
+    {
+        return 0.0;
+    }
+
+    const pssm_scan_table table( info.get_log_likelihoods() );
+    const double bg_log_likelihood = bifa::uniform_sequence_likelihoods().get_word_log_likelihood( 0, size );
+    const pssm_scan_kernel kernel = best_pssm_scan_kernel();
+
+    double p_does_not_bind_anywhere = 1.0;
+    const size_t num_windows = seq.size() - size + 1;
+    std::vector< double > positive_scores( std::min( block_size, num_windows ) );
+    std::vector< double > negative_scores( positive_scores.size() );
+    size_t next_unknown = seq.next_unknown( 0 );
+    for( size_t block_start = 0; num_windows > block_start; block_start += block_size )
+    {
+        const size_t num_in_block = std::min( block_size, num_windows - block_start );
+        scan_pssm_log_likelihoods(
+            table,
+            &seq.codes[ block_start ],
+            num_in_block,
+            &positive_scores[ 0 ],
+            &negative_scores[ 0 ],
+            kernel );
+
+        for( size_t i = 0; num_in_block != i; ++i )
+        {
+            const size_t position = block_start + i;
+
+            //are there any 'n's before the end of the pssm?
+            if( next_unknown < position )
+            {
+                next_unknown = seq.next_unknown( position );
+            }
+            if( next_unknown < position + size )
+            {
+                continue;
+            }
+
+            for( int s = 0; 2 != s; ++s ) // s=0 for positive strand, s=1 for negative strand
+            {
+                const bool is_positive_strand = (0 == s);
+                const double pssm_log_likelihood = is_positive_strand ? positive_scores[ i ] : negative_scores[ i ];
+                const double p_binding = get_p_binding( odds_prior * std::exp( pssm_log_likelihood - bg_log_likelihood ) );
+                if( p_binding >= threshold )
+                {
+                    result->push_back(
+                        binding_hit(
+                            pssm_name,
+                            binding_hit_location(
+                                position,
+                                size,
+                                is_positive_strand ),
+                            p_binding ) );
+
+                    p_does_not_bind_anywhere *= ( 1.0 - p_binding );
+                }
+            }
+        }
+    }
+
+    const double p_binds_somewhere = 1.0 - p_does_not_bind_anywhere;
+    return p_binds_somewhere;
+}
+
+
+
+double
+score_pssm_on_sequence(
+    const std::string & pssm_name,
+    const encoded_sequence & seq,
+    double threshold,
+    binding_hit::vec_ptr result,
+    const scoring_context & context
+) {
+    const pssm_info & info = get_pssm( pssm_name );
+
+    if( ! context.use_score && context.use_vectorised_scan )
+    {
+        return evaluate_words_using_scan_kernel( info, pssm_name, seq, threshold, result, context.binding_background_odds_prior );
+    }
+
+    boost::scoped_ptr< pssm_lookahead_table > lookahead;
+    double min_score = 0.;
+    if( context.use_score )
+    {
+        const evaluate_word_using_score evaluator( info, context );
+        if( context.use_lookahead && evaluator.table->usable() )
+        {
+            lookahead.reset( new pssm_lookahead_table( *info._pssm, info._dists ) );
+            min_score = get_min_score( *evaluator.table, threshold );
+        }
+        return evaluate_words_in_sequence( info, pssm_name, seq, threshold, evaluator, result, lookahead.get(), min_score );
+    }
+    else
+    {
+        const bifa::uniform_sequence_likelihoods bg_likelihoods;
+        if( context.use_lookahead )
+        {
+            lookahead.reset( new pssm_lookahead_table( info.get_log_likelihoods(), info._dists ) );
+            min_score =
+                get_bifa_min_log_likelihood(
+                    threshold,
+                    bg_likelihoods.get_word_log_likelihood( 0, info._pssm->size() ),
+                    context.binding_background_odds_prior );
+        }
+        return
+            evaluate_words_in_sequence(
+                info,
+                pssm_name,
+                seq,
+                threshold,
+                evaluate_word_using_bifa< bifa::uniform_sequence_likelihoods >( info, bg_likelihoods, context.binding_background_odds_prior ),
+                result,
+                lookahead.get(),
+                min_score );
+    }
+}
+
+
+double
+score_pssm_on_sequence(
+    const std::string & pssm_name,
+    const encoded_sequence & seq,
+    double threshold,
+    binding_hit::vec_ptr result
+) {
+    return score_pssm_on_sequence( pssm_name, seq, threshold, result, scoring_context::current() );
+}
+
+
+double
+score_pssm_on_sequence(
+    const std::string & pssm_name,
+    const sequence & seq,
+    double threshold,
+    binding_hit::vec_ptr result,
+    const scoring_context & context
+) {
+    return score_pssm_on_sequence( pssm_name, encoded_sequence( seq ), threshold, result, context );
+}
+
+
+double
+score_pssm_on_sequence(
+    const std::string & pssm_name,
+    const sequence & seq,
+    double threshold,
+    binding_hit::vec_ptr result
+) {
+    return score_pssm_on_sequence( pssm_name, encoded_sequence( seq ), threshold, result, scoring_context::current() );
+}
+
+
+
+void
+biobase_score_pssm_on_sequence(
+    const std::string & pssm_name,
+    const encoded_sequence & seq,
+    double threshold,
+    binding_hit::vec_ptr result,
+    const scoring_context & context )
+{
+    const pssm_info & info = get_pssm( pssm_name );
+    const pssm & p = *( info._pssm );
+    const size_t size = p.size();
+
+    //is there enough sequence to score this pssm?
+    if( seq.size() < size )
+    {
+        return;
+    }
+
+    boost::scoped_ptr< pssm_lookahead_table > lookahead;
+    if( context.use_lookahead )
+    {
+        lookahead.reset( new pssm_lookahead_table( p, info._dists ) );
+    }
+
+    const size_t end = seq.size() - size + 1;
+    size_t next_unknown = seq.next_unknown( 0 );
+    for( size_t position = 0; end != position; ++position )
+    {
+        //are there any 'n's before the end of the pssm?
+        if( next_unknown < position )
+        {
+            next_unknown = seq.next_unknown( position );
+        }
+        if( next_unknown < position + size )
+        {
+            continue;
+        }
+
+        const encoded_sequence::code * s = &seq.codes[ position ];
+        for( int i = 0; 2 != i; ++i )
+        {
+            if( lookahead && ! lookahead->may_reach( s, 0 == i, threshold ) )
+            {
+                continue;
+            }
+            const double biobase_score =
+                0 == i
+                    ? score( p, s )
+                    : score_complement( p, s );
+            const bool is_positive_strand = (0 == i);
+            if( biobase_score >= threshold )
+            {
+                result->push_back(
+                    binding_hit(
+                        pssm_name,
+                        binding_hit_location(
+                            position,
+                            size,
+                            is_positive_strand ),
+                        biobase_score ) );
+            }
+        }
+    }
+}
+
+
+void
+biobase_score_pssm_on_sequence(
+    const std::string & pssm_name,
+    const encoded_sequence & seq,
+    double threshold,
+    binding_hit::vec_ptr result )
+{
+    biobase_score_pssm_on_sequence( pssm_name, seq, threshold, result, scoring_context::current() );
+}
+
+
+void
+biobase_score_pssm_on_sequence(
+    const std::string & pssm_name,
+    const sequence & seq,
+    double threshold,
+    binding_hit::vec_ptr result )
+{
+    biobase_score_pssm_on_sequence( pssm_name, encoded_sequence( seq ), threshold, result, scoring_context::current() );
+}
+
+
+namespace detail {
+
+/// Scores one PSSM on an encoded sequence.
+typedef void ( * pssm_scorer )( const std::string &, const encoded_sequence &, double, binding_hit::vec_ptr, const scoring_context & );
+
+void
+score_pssm_on_encoded_sequence(
+    const std::string & pssm_name,
+    const encoded_sequence & seq,
+    double threshold,
+    binding_hit::vec_ptr result,
+    const scoring_context & context
+) {
+    score_pssm_on_sequence( pssm_name, seq, threshold, result, context );
+}
+
+void
+biobase_score_pssm_on_encoded_sequence(
+    const std::string & pssm_name,
+    const encoded_sequence & seq,
+    double threshold,
+    binding_hit::vec_ptr result,
+    const scoring_context & context
+) {
+    biobase_score_pssm_on_sequence( pssm_name, seq, threshold, result, context );
+}
+
+/// Scores the i'th PSSM into its own hit buffer.
+struct score_one_pssm {
+
+    pssm_scorer                            scorer;
+    const string_vec &                     pssm_names;
+    const encoded_sequence &               seq;
+    double                                 threshold;
+    const scoring_context &                context;
+    std::vector< binding_hit::vec_ptr > &  pssm_hits;
+
+    score_one_pssm(
+        pssm_scorer scorer,
+        const string_vec & pssm_names,
+        const encoded_sequence & seq,
+        double threshold,
+        const scoring_context & context,
+        std::vector< binding_hit::vec_ptr > & pssm_hits
+    )
+    : scorer( scorer )
+    , pssm_names( pssm_names )
+    , seq( seq )
+    , threshold( threshold )
+    , context( context )
+    , pssm_hits( pssm_hits )
+    { }
+
+    void operator()( size_t i ) const {
+        scorer( pssm_names[ i ], seq, threshold, pssm_hits[ i ], context );
+    }
+};
+
+/**
+ * Score each PSSM on the sequence under the context using num_threads threads. Each PSSM's
+ * hits are collected separately and then concatenated in the order of the PSSM names so that
+ * the result does not depend on the number of threads.
+ */
+binding_hit::vec_ptr
+score_pssms_in_parallel(
+    pssm_scorer scorer,
+    const string_vec & pssm_names,
+    const sequence & seq,
+    double threshold,
+    const scoring_context & context,
+    unsigned num_threads
+) {
+    const encoded_sequence encoded( seq );
+    std::vector< binding_hit::vec_ptr > pssm_hits( pssm_names.size() );
+    BOOST_FOREACH( binding_hit::vec_ptr & hits, pssm_hits ) {
+        hits.reset( new binding_hit::vec );
+    }
+
+    BIO_NS::parallel_for(
+        pssm_names.size(),
+        num_threads,
+        score_one_pssm( scorer, pssm_names, encoded, threshold, context, pssm_hits ) );
+
+    binding_hit::vec_ptr result( new binding_hit::vec );
+    BOOST_FOREACH( const binding_hit::vec_ptr & hits, pssm_hits ) {
+        result->insert( result->end(), hits->begin(), hits->end() );
+    }
+    return result;
+}
+
+/// Scores all the PSSMs on the i'th sequence on one thread.
+struct score_pssms_on_one_sequence {
+
+    const string_vec &       pssm_names;
+    const sequence_vec &     sequences;
+    double                   threshold;
+    const scoring_context &  context;
+    binding_hits_vec &       hit_array;
+
+    score_pssms_on_one_sequence(
+        const string_vec & pssm_names,
+        const sequence_vec & sequences,
+        double threshold,
+        const scoring_context & context,
+        binding_hits_vec & hit_array
+    )
+    : pssm_names( pssm_names )
+    , sequences( sequences )
+    , threshold( threshold )
+    , context( context )
+    , hit_array( hit_array )
+    { }
+
+    void operator()( size_t i ) const {
+        hit_array[ i ] = score_pssms_in_parallel( score_pssm_on_encoded_sequence, pssm_names, sequences[ i ], threshold, context, 1 );
+    }
+};
+
+/// Scores the PSSMs on the i'th set of phylogenetic sequences.
+struct score_pssms_on_one_phylo_sequence_set {
+
+    string_vec_ptr                               pssm_names;
+    const std::vector< sequence_vec_ptr > &      sequence_sets;
+    double                                       threshold;
+    double                                       phylo_threshold;
+    bool                                         calculate_maximal_chain;
+    const scoring_context &                      context;
+    phylo_sequences_result_vec &                 results;
+
+    score_pssms_on_one_phylo_sequence_set(
+        string_vec_ptr pssm_names,
+        const std::vector< sequence_vec_ptr > & sequence_sets,
+        double threshold,
+        double phylo_threshold,
+        bool calculate_maximal_chain,
+        const scoring_context & context,
+        phylo_sequences_result_vec & results
+    )
+    : pssm_names( pssm_names )
+    , sequence_sets( sequence_sets )
+    , threshold( threshold )
+    , phylo_threshold( phylo_threshold )
+    , calculate_maximal_chain( calculate_maximal_chain )
+    , context( context )
+    , results( results )
+    { }
+
+    void operator()( size_t i ) const {
+        results[ i ] = score_pssms_on_phylo_sequences( pssm_names, sequence_sets[ i ], threshold, phylo_threshold, calculate_maximal_chain, context );
+    }
+};
+
+} //namespace detail
+
+
+binding_hit::vec_ptr
+score_pssms_on_sequence(
+    const string_vec_ptr & pssm_names,
+    const sequence & seq,
+    double threshold,
+    const scoring_context & context )
+{
+    return
+        detail::score_pssms_in_parallel(
+            detail::score_pssm_on_encoded_sequence,
+            *pssm_names,
+            seq,
+            threshold,
+            context,
+            context.num_threads );
+}
+
+
+binding_hit::vec_ptr
+score_pssms_on_sequence(
+    const string_vec_ptr & pssm_names,
+    const sequence & seq,
+    double threshold )
+{
+    return score_pssms_on_sequence( pssm_names, seq, threshold, scoring_context::current() );
+}
+
+
+binding_hits_vec_ptr
+score_pssms_on_sequences(
+    const string_vec_ptr & pssm_names,
+    const sequence_vec & sequences,
+    double threshold,
+    unsigned num_threads,
+    const scoring_context & context )
+{
+    binding_hits_vec_ptr result( new binding_hits_vec( sequences.size() ) );
+    BIO_NS::parallel_for(
+        sequences.size(),
+        num_threads,
+        detail::score_pssms_on_one_sequence( *pssm_names, sequences, threshold, context, *result ) );
+    return result;
+}
+
+
+binding_hits_vec_ptr
+score_pssms_on_sequences(
+    const string_vec_ptr & pssm_names,
+    const sequence_vec & sequences,
+    double threshold,
+    unsigned num_threads )
+{
+    return score_pssms_on_sequences( pssm_names, sequences, threshold, num_threads, scoring_context::current() );
+}
+
+
+binding_hit::vec_ptr
+biobase_score_pssms_on_sequence(
+    const string_vec_ptr & pssm_names,
+    const sequence & seq,
+    double threshold,
+    const scoring_context & context )
+{
+    return
+        detail::score_pssms_in_parallel(
+            detail::biobase_score_pssm_on_encoded_sequence,
+            *pssm_names,
+            seq,
+            threshold,
+            context,
+            context.num_threads );
+}
+
+
+binding_hit::vec_ptr
+biobase_score_pssms_on_sequence(
+    const string_vec_ptr & pssm_names,
+    const sequence & seq,
+    double threshold )
+{
+    return biobase_score_pssms_on_sequence( pssm_names, seq, threshold, scoring_context::current() );
+}
+
+
+/**
+ * Abstract base class for phylogenetic adjusters.
+ */
+struct phylogenetic_adjuster {
+    virtual ~phylogenetic_adjuster();
+
+    /**
+     * Accept the probability that the binder binds at least once to one of the
+     * phylogenetic sequences.
+     */
+    virtual
+    void
+    accept_prob_phylo_binding( double p_binding ) = 0;
+
+
+    /**
+     * Adjust the strength of the hit in the central sequence given the previously accepted
+     * probabilities of binding in the phylogenetic sequences.
+     */
+    virtual
+    double
+    adjust_hit_probability( unsigned num_sequences, double p_central ) = 0;
+};
+
+
+phylogenetic_adjuster::~phylogenetic_adjuster() { }
+
+
+/**
+ * Adjusts the probability of hits in the central sequence by averaging with the
+ * probability that they bind anywhere in the related phylogenetic sequences.
+ */
+struct phylogenetic_adjuster_probability_averager
+: phylogenetic_adjuster
+{
+    double log_sum;
+
+    phylogenetic_adjuster_probability_averager() : log_sum( 0. ) { }
+    virtual ~phylogenetic_adjuster_probability_averager() { }
+
+    /**
+     * Accept the probability that the binder binds at least once to one of the
+     * phylogenetic sequences.
+     */
+    virtual
+    void
+    accept_prob_phylo_binding( double p_binding ) {
+        log_sum += std::log( p_binding );
+    }
+
+
+    /**
+     * Adjust the strength of the hit in the central sequence given the previously accepted
+     * probabilities of binding in the phylogenetic sequences.
+     */
+    virtual
+    double
+    adjust_hit_probability( unsigned num_sequences, double p_central ) {
+        //
+        // Return geometric average of probabilities.
+        //
+        return
+            std::exp(
+                ( std::log( p_central ) + log_sum )
+                / num_sequences
+            );
+    }
+};
+
+
+/**
+ * Adjusts the probability of hits in the central sequence by averaging the weight
+ * of evidence (Bayes factors) with the Bayes factors of the events that they bind
+ * anywhere in the related phylogenetic sequences.
+ */
+struct phylogenetic_adjuster_bayes_averager
+: phylogenetic_adjuster
+{
+    double log_sum; ///< The sum of the Bayes factors.
+    const double prior_log_odds; ///< The prior log-odds of a binding site.
+    const double min_log_bayes_factor; ///< The minimum log-Bayes factor that we will use. Designed to avoid problems with TFBSs missing in related sequences.
+
+    phylogenetic_adjuster_bayes_averager(
+        double log_prior_odds,
+        double central_binding_p, // The probability of binding in the central sequence
+        double min_related_evidence_fraction
+    )
+    : log_sum( 0. )
+    , prior_log_odds( log_prior_odds )
+    , min_log_bayes_factor( calculate_min_log_bayes_factor( log_prior_odds, central_binding_p, min_related_evidence_fraction ) )
+    { }
+    virtual ~phylogenetic_adjuster_bayes_averager() { }
+
+    /** Get the minimum log-Bayes factor we will use for the evidence from
+     * related sequences. This is specified as a fraction of the evidence from
+     * the central sequence.
+     */
+    static
+    double
+    calculate_min_log_bayes_factor( double log_prior_odds, double central_binding_p, double min_related_evidence_fraction ) {
+        BOOST_ASSERT( 0. <= min_related_evidence_fraction );
+        BOOST_ASSERT( min_related_evidence_fraction <= 1. );
+        // if fraction is turned off, then the minimum evidence (log Bayes factor) does not apply
+        if( ! min_related_evidence_fraction ) {
+            return -std::numeric_limits< double >::max();
+        } else {
+            const double central_log_bayes_factor = prob_to_log_odds( central_binding_p ) - log_prior_odds;
+            // if negative evidence in central sequence do not reduce it
+            if( central_log_bayes_factor < 0. ) {
+                return central_log_bayes_factor;
+            } else {
+                return central_log_bayes_factor * min_related_evidence_fraction;
+            }
+        }
+    }
+
+    /**
+     * The log-odds given a probability.
+     */
+    static
+    double
+    prob_to_log_odds( double p ) {
+        return std::log( p / ( 1. - p ) );
+    }
+
+    /**
+     * The probability given the log-odds.
+     */
+    static
+    double
+    log_odds_to_prob( double log_odds ) {
+        const double odds = std::exp( log_odds );
+        BOOST_ASSERT( ! BIO_ISNAN( odds ) );
+        if( BIO_FINITE( odds ) ) {
+            return odds / ( 1. + odds );
+        } else {
+            return 1.;
+        }
+    }
+
+    /**
+     * Accept the probability that the binder binds at least once to one of the
+     * phylogenetic sequences. Here we make an assumption that the length
+     * of the phylogenetic sequence is smaller than 1/prior_odds
+     */
+    virtual
+    void
+    accept_prob_phylo_binding( double p_binding ) {
+        BOOST_ASSERT( ! BIO_ISNAN( p_binding ) );
+        const double posterior_log_odds = prob_to_log_odds( p_binding );
+        const double log_bayes_factor = posterior_log_odds - prior_log_odds;
+        log_sum += std::max( min_log_bayes_factor, log_bayes_factor );
+        // BOOST_ASSERT( BIO_FINITE( log_sum ) );  allow infinite log sums
+    }
+
+
+    /**
+     * Adjust the strength of the hit in the central sequence given the previously accepted
+     * probabilities of binding in the phylogenetic sequences.
+     */
+    virtual
+    double
+    adjust_hit_probability( unsigned num_sequences, double p_central ) {
+        const double central_log_odds = prob_to_log_odds( p_central );
+        const double central_log_bayes_factor = central_log_odds - prior_log_odds;
+        const double avg_log_bayes_factor = ( central_log_bayes_factor + log_sum ) / num_sequences;
+        const double p_adjusted = log_odds_to_prob( prior_log_odds + avg_log_bayes_factor );
+        BOOST_ASSERT( ! BIO_ISNAN( p_adjusted ) );
+        return p_adjusted;
+    }
+};
+
+
+phylo_sequences_result
+score_pssms_on_phylo_sequences(
+    string_vec_ptr pssm_names_arg,
+    sequence_vec_ptr sequences,
+    double threshold,
+    double phylo_threshold,
+    bool calculate_maximal_chain,
+    const scoring_context & context
+) {
+    //
+    // We need at least one sequence
+    //
+    if( sequences->empty() ) {
+        throw std::invalid_argument( "Need at least one sequence to score" );
+    }
+
+    //
+    // the prior odds of a binding site
+    //
+    const double prior_log_odds = std::log( context.binding_background_odds_prior );
+
+    //
+    // make a copy of the pssm names argument
+    //
+    string_vec_ptr pssm_names( new string_vec( *pssm_names_arg ) );
+
+    //
+    // A map from binders to phylogenetic adjusters
+    //
+    std::map< std::string, boost::shared_ptr< phylogenetic_adjuster > > phylo_adjusters;
+
+    //
+    // for each sequence score the pssms we are interested in
+    //
+    binding_hits_vec_ptr hit_array( new binding_hits_vec );
+    bool is_first_sequence = true;
+    BOOST_FOREACH( const sequence & seq, *sequences ) {
+
+        //encode the sequence once for all the pssms
+        const encoded_sequence s( seq );
+
+        //push_back a hit vector for this sequence
+        hit_array->push_back( binding_hit::vec_ptr( new binding_hit::vec ) );
+        binding_hit::vec_ptr hits = hit_array->back();
+        BOOST_FOREACH( const std::string & pssm_name, *pssm_names ) {
+
+            try {
+                const double binding_p =
+                    score_pssm_on_sequence(
+                        pssm_name,
+                        s,
+                        is_first_sequence
+                            ? threshold
+                            : phylo_threshold,
+                        hits,
+                        context
+                    );
+
+                //
+                // Phylogenetic adjustment stuff
+                //
+                if( is_first_sequence ) {
+                    //
+                    // Create a phylogenetic adjuster for this PSSM
+                    //
+                    if( context.avg_phylo_bayes ) {
+                        phylo_adjusters[ pssm_name ].reset(
+                            new phylogenetic_adjuster_bayes_averager(
+                                prior_log_odds,
+                                binding_p,
+                                context.min_related_evidence_fraction ) );
+                    } else {
+                        phylo_adjusters[ pssm_name ].reset( new phylogenetic_adjuster_probability_averager );
+                    }
+                } else {
+                    //
+                    // Pass the probability of binding to the phylogenetic adjuster
+                    //
+                    phylo_adjusters[ pssm_name ]->accept_prob_phylo_binding( binding_p );
+                }
+            } catch( std::exception const & e ) {
+                throw std::logic_error(
+                    BIOPSY_MAKE_STRING(
+                        "Problem scoring PSSM: "<<pssm_name<<": "<<e.what() ) );
+            } catch( ... ) {
+                throw std::logic_error(
+                    BIOPSY_MAKE_STRING(
+                        "Unknown problem scoring PSSM: "<<pssm_name ) );
+            }
+        }
+
+        //
+        // Rebuild set of pssms we are interested in. We will
+        // not bother scoring PSSMs that we do not have hits for
+        // in every sequence so far
+        //
+        pssm_names = get_binder_names( hits );
+
+        // It won't be the first sequence next time around
+        is_first_sequence = false;
+    }
+
+    //remove hits for pssms that are not in all sequences - pssm_names holds those pssms that are
+    BOOST_FOREACH( binding_hit::vec_ptr & hits, *hit_array ) {
+        //create new vector to hold filtered hits
+        binding_hit::vec_ptr filtered_hits( new binding_hit::vec );
+
+        //copy those hits that are in the pssm_names container
+        BOOST_FOREACH( const binding_hit & hit, *hits ) {
+            if( pssm_names->end() != std::find( pssm_names->begin(), pssm_names->end(), hit._binder_name ) ) {
+                filtered_hits->push_back( hit );
+            }
+        }
+
+        //replace original hits with filtered
+        hits.swap( filtered_hits );
+    }
+
+    //calculate the maximal chain if we can and want to
+    binding_hit::vec_ptr mc;
+    if( calculate_maximal_chain ) {
+        if( context.max_chain_use_budget ) {
+            BIO_NS::max_chain_stats stats;
+            mc = analyse_max_chain_within_budget(
+                hit_array,
+                context.max_chain_num_boxes_limit,
+                context.max_chain_max_seconds,
+                stats,
+                context.max_chain_flat_range_tree
+            );
+        } else {
+            mc = analyse_max_chain(
+                hit_array,
+                context.max_chain_num_boxes_limit,
+                context.max_chain_flat_range_tree
+            );
+        }
+    }
+
+    //
+    // Adjust the hits for phylogenetic conservation
+    //
+    if( ! hit_array->empty() ) {
+        BOOST_FOREACH( binding_hit & hit, *hit_array->front() ) {
+            // adjust by estimate that binds in the phylo sequences
+            BOOST_ASSERT( ! BIO_ISNAN( hit._p_binding ) );
+            hit._p_binding = phylo_adjusters[ hit._binder_name ]->
+                adjust_hit_probability( hit_array->size(), hit._p_binding );
+            BOOST_ASSERT( ! BIO_ISNAN( hit._p_binding ) );
+        }
+    }
+
+    phylo_sequences_result result( hit_array->front(), mc, hit_array );
+    return result;
+}
+
+
+phylo_sequences_result
+score_pssms_on_phylo_sequences(
+    string_vec_ptr pssm_names,
+    sequence_vec_ptr sequences,
+    double threshold,
+    double phylo_threshold,
+    bool calculate_maximal_chain
+) {
+    return
+        score_pssms_on_phylo_sequences(
+            pssm_names,
+            sequences,
+            threshold,
+            phylo_threshold,
+            calculate_maximal_chain,
+            scoring_context::current() );
+}
+
+
+phylo_sequences_result_vec_ptr
+score_pssms_on_phylo_sequence_sets(
+    string_vec_ptr pssm_names,
+    const std::vector< sequence_vec_ptr > & sequence_sets,
+    double threshold,
+    double phylo_threshold,
+    bool calculate_maximal_chain,
+    unsigned num_threads,
+    const scoring_context & context
+) {
+    phylo_sequences_result_vec_ptr results( new phylo_sequences_result_vec( sequence_sets.size() ) );
+    BIO_NS::parallel_for(
+        sequence_sets.size(),
+        num_threads,
+        detail::score_pssms_on_one_phylo_sequence_set(
+            pssm_names,
+            sequence_sets,
+            threshold,
+            phylo_threshold,
+            calculate_maximal_chain,
+            context,
+            *results ) );
+    return results;
+}
+
+
+phylo_sequences_result_vec_ptr
+score_pssms_on_phylo_sequence_sets(
+    string_vec_ptr pssm_names,
+    const std::vector< sequence_vec_ptr > & sequence_sets,
+    double threshold,
+    double phylo_threshold,
+    bool calculate_maximal_chain,
+    unsigned num_threads
+) {
+    return
+        score_pssms_on_phylo_sequence_sets(
+            pssm_names,
+            sequence_sets,
+            threshold,
+            phylo_threshold,
+            calculate_maximal_chain,
+            num_threads,
+            scoring_context::current() );
+}
+
+binding_hit::vec_ptr
+analyse(
+    const sequence & seq,
+    double threshold )
+{
+    bifa_hits_t bifa_hits;
+    {
+        BiobasePssmFilter filter;
+        score_all_biobase_pssms(
+            make_sequence_scorer(
+                seq.begin(),
+                seq.end(),
+                threshold,
+                std::inserter( bifa_hits, bifa_hits.begin() )
+            ),
+            filter,
+            Link2BiobaseBindingModel()
+        );
+    }
+
+    return detail::convert( bifa_hits );
+}
+
+
+
+binding_hit::vec_ptr
+analyse_phylo(
+    const sequence & main_seq,
+    const sequence_vec & phylo_seqs,
+    double threshold )
+{
+    bifa_hits_t bifa_hits;
+    {
+        BiobasePssmFilter filter;
+        score_all_biobase_pssms(
+            make_sequence_scorer(
+                main_seq.begin(),
+                main_seq.end(),
+                threshold,
+                std::inserter( bifa_hits, bifa_hits.begin() )
+            ),
+            filter,
+            Link2BiobaseBindingModel()
+        );
+
+        //raise the threshold to the power of the number of sequences
+        const BIO_NS::float_t phylo_threshold = BIO_NS::float_t( gsl_pow_int( threshold, phylo_seqs.size() + 1 ) );
+
+        adjust_hits(
+            bifa_hits,
+            phylo_seqs,
+            phylo_threshold);
+    }
+
+    return detail::convert( bifa_hits );
+
+}
+
+
+
+std::string
+get_pathway_for_pssm( const std::string & pssm_name ) {
+
+/*    binding_hit::vec empty_chain;
+    BiFaDetails details( hits, empty_chain );
+    set_pathways(details);*/
+    return "";
+
+}
+
+
+} //namespace biopsy
+
@@ -0,0 +1,1670 @@
+/**
+@file
+
+Copyright John Reid 2006-2011
+
+*/
+
+#include "biopsy/pssm.h"
+#include "biopsy/custom_pssm.h"
+#include "biopsy/sequence.h"
+#include "biopsy/pssm_binary_cache.h"
+
+#include <bio/biobase_db.h>
+#include <bio/sequence.h>
+#include <bio/cache.h>
+#include <bio/singleton.h>
+#include <bio/serialisable.h>
+#include <bio/environment.h>
+#include <bio/parallel.h>
+
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/crc.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <fstream>
+#include <sstream>
+
+using namespace boost;
+using namespace std;
+
+
+
+namespace biopsy {
+
+
+pssm_parameters::pssm_parameters()
+    : pseudo_counts( 0.25 )
+    , likelihoods_size( 100 )
+    , calculate_likelihoods_map_size( 10000 )
+    , binding_background_odds_prior( 2e-5 )
+    , use_cumulative_dists( true )
+    , use_p_value( false )
+    , use_score( false )
+    , avg_phylo_bayes( true )
+    , max_chain_num_boxes_limit( 50000 )
+    , min_related_evidence_fraction( .5 )
+    , use_vectorised_scan( true )
+    , num_threads( 1 )
+    , use_lookahead( true )
+    , use_likelihoods_lattice( false )
+    , likelihoods_lattice_size( 100000 )
+    , max_chain_flat_range_tree( true )
+    , max_chain_use_budget( false )
+    , max_chain_max_seconds( 0. )
+{
+}
+
+
+scoring_context::scoring_context( const pssm_parameters & params )
+    : binding_background_odds_prior( params.binding_background_odds_prior )
+    , use_cumulative_dists( params.use_cumulative_dists )
+    , use_p_value( params.use_p_value )
+    , use_score( params.use_score )
+    , avg_phylo_bayes( params.avg_phylo_bayes )
+    , min_related_evidence_fraction( params.min_related_evidence_fraction )
+    , use_vectorised_scan( params.use_vectorised_scan )
+    , use_lookahead( params.use_lookahead )
+    , num_threads( params.num_threads )
+    , max_chain_num_boxes_limit( params.max_chain_num_boxes_limit )
+    , max_chain_flat_range_tree( params.max_chain_flat_range_tree )
+    , max_chain_use_budget( params.max_chain_use_budget )
+    , max_chain_max_seconds( params.max_chain_max_seconds )
+{
+}
+
+scoring_context
+scoring_context::current()
+{
+    return scoring_context( pssm_parameters::singleton() );
+}
+
+nucleo_dist::nucleo_dist(
+    double a,
+    double c,
+    double g,
+    double t )
+{
+    _values[ 0 ] = a;
+    _values[ 1 ] = c;
+    _values[ 2 ] = g;
+    _values[ 3 ] = t;
+}
+
+nucleo_dist::vec  operator + (const nucleo_dist::vec & v,double pseudo_count)
+{
+    nucleo_dist::vec retVal;
+
+    BOOST_FOREACH(const nucleo_dist & c, v)
+    {
+        nucleo_dist dist(
+            c.get(0) + pseudo_count,
+            c.get(1) + pseudo_count,
+            c.get(2) + pseudo_count,
+            c.get(3) + pseudo_count);
+        retVal.push_back(dist);
+    }
+    return retVal;
+}
+
+
+
+/** argument is 0 for a, 1 for c, ... */
+double
+nucleo_dist::get( unsigned nucleo ) const
+{
+    return _values[ nucleo ];
+}
+
+void
+nucleo_dist::set( unsigned nucleo, double value )
+{
+    _values[ nucleo ] = value;
+}
+
+double
+nucleo_dist::get_total( ) const
+{
+    return std::accumulate( _values.begin(), _values.end(), 0.0 );
+}
+
+/** argument is 0 for a, 1 for c, ... */
+double
+nucleo_dist::get_freq( unsigned nucleo ) const
+{
+    return get( nucleo ) / get_total();
+}
+
+bool
+nucleo_dist::operator==( const nucleo_dist & rhs ) const
+{
+    return
+        _values == rhs._values;
+}
+
+nucleo_dist
+uniform_nucleo_dist()
+{
+    return nucleo_dist( 0.25, 0.25, 0.25, 0.25 );
+}
+
+nucleo_dist
+get_dist_for_iupac( char s )
+{
+    USING_BIO_NS;
+    IupacCode i( s );
+    return
+        nucleo_dist(
+            i.get_num( 'a' ),
+            i.get_num( 'c' ),
+            i.get_num( 'g' ),
+            i.get_num( 't' ) );
+}
+
+
+
+pssm_ptr
+create_pssm(
+    const nucleo_dist::vec & dists )
+{
+    //from http://nar.oxfordjournals.org/cgi/reprint/31/13/3576
+
+    //first calculate the information vector and the min and max scores possible
+    std::vector< double > infos;
+    std::vector< double > min_freqs;
+    double min_score = 0.0;
+    double max_score = 0.0;
+    BOOST_FOREACH( const nucleo_dist & dist, dists )
+    {
+        double info = 0.0;
+        double min_freq = 1.0;
+        double max_freq = 0.0;
+        for( unsigned i = 0; 4 != i; ++i )
+        {
+            const double fib = dist.get_freq( i );
+            if( 0.0 > fib || fib > 1.0 ) {
+                throw std::logic_error( BIOPSY_MAKE_STRING( "pssm_create(): Frequency is not in [0,1]: "<<fib ) );
+            }
+            min_freq = std::min( fib, min_freq );
+            max_freq = std::max( fib, max_freq );
+            if( 0.0 != fib )
+            {
+                info += fib * std::log( 4.0 * fib );
+            }
+        }
+        //std::cout << info << "\n";
+        min_score += min_freq * info;
+        max_score += max_freq * info;
+        if( info < 0. ) {
+            throw std::logic_error( BIOPSY_MAKE_STRING( "pssm_create(): info < 0.0: "<<info ) );
+        }
+        infos.push_back( info );
+        if( min_freq < 0. ) {
+            throw std::logic_error( BIOPSY_MAKE_STRING( "pssm_create(): min_freq < 0.0: "<<info ) );
+        }
+        min_freqs.push_back( min_freq );
+    }
+
+    if( max_score == min_score ) {
+        throw std::logic_error( BIOPSY_MAKE_STRING( "pssm_create(): max score == min score: "<<min_score ) );
+    }
+    if( max_score < min_score ) {
+        throw std::logic_error( BIOPSY_MAKE_STRING( "pssm_create(): max score < min score: "<<max_score<<" < "<<min_score ) );
+    }
+    const double range = 1.0 / ( max_score - min_score );
+    if( BIOPSY_ISNAN( range ) ) {
+        throw std::logic_error( "pssm_create(): Range is too small to calculate" );
+    }
+
+    //now calculate the scores for each position
+    pssm_ptr result( new pssm );
+    for( unsigned pos = 0; dists.size() != pos; ++pos )
+    {
+        const nucleo_dist scores(
+            infos[ pos ] * ( std::max( 0.0, dists[ pos ].get_freq( 0 ) - min_freqs[ pos ] ) ) * range,
+            infos[ pos ] * ( std::max( 0.0, dists[ pos ].get_freq( 1 ) - min_freqs[ pos ] ) ) * range,
+            infos[ pos ] * ( std::max( 0.0, dists[ pos ].get_freq( 2 ) - min_freqs[ pos ] ) ) * range,
+            infos[ pos ] * ( std::max( 0.0, dists[ pos ].get_freq( 3 ) - min_freqs[ pos ] ) ) * range );
+        for( unsigned b = 0; 4 != b; ++b ) {
+            if( scores.get( b ) < 0.0 ) {
+                throw std::logic_error( BIOPSY_MAKE_STRING( "pssm_create(): Have a negative score in PSSM: "<<scores.get( b ) ) );
+            }
+        }
+        result->push_back( scores );
+    }
+
+    return result;
+}
+
+inline
+unsigned
+get_nucleo_index( const sequence::value_type & c )
+{
+    switch( c )
+    {
+    case 'a':
+    case 'A':
+        return 0;
+    case 'c':
+    case 'C':
+        return 1;
+    case 'g':
+    case 'G':
+        return 2;
+    case 't':
+    case 'T':
+        return 3;
+    }
+
+    throw std::logic_error( BIOPSY_MAKE_STRING( "Not a nucleotide: \"" << c << "\"" ) );
+}
+
+
+double
+score(
+    const pssm & pssm,
+    sequence::const_iterator s_begin )
+{
+    double score = 0.0;
+    for( unsigned pos = 0; pssm.size() != pos; ++pos, ++s_begin )
+    {
+        score += ( pssm [ pos ] ).get( get_nucleo_index( *s_begin ) );
+    }
+
+    return score;
+}
+
+double
+score_complement(
+    const pssm & pssm,
+    sequence::const_iterator s_begin )
+{
+    double score = 0.0;
+    const unsigned size = pssm.size();
+    for( unsigned pos = 0; size != pos; ++pos, ++s_begin )
+    {
+        score += ( pssm [ size - pos - 1 ] ).get( get_nucleo_index( nucleo_complement()( *s_begin ) ) );
+    }
+
+    return score;
+}
+
+double
+score(
+    const pssm & pssm,
+    const encoded_sequence::code * codes )
+{
+    double score = 0.0;
+    const unsigned size = pssm.size();
+    for( unsigned pos = 0; size != pos; ++pos )
+    {
+        score += pssm[ pos ].get( codes[ pos ] );
+    }
+
+    return score;
+}
+
+double
+score_complement(
+    const pssm & pssm,
+    const encoded_sequence::code * codes )
+{
+    double score = 0.0;
+    const unsigned size = pssm.size();
+    for( unsigned pos = 0; size != pos; ++pos )
+    {
+        score += pssm[ size - pos - 1 ].get( complement_code( codes[ pos ] ) );
+    }
+
+    return score;
+}
+
+double
+score_pssm(
+    pssm_ptr pssm,
+    const sequence & s )
+{
+    if( pssm->size() > s.size() )
+    {
+        throw std::logic_error( "Pssm too large for sequence" );
+    }
+
+    return score( *pssm, s.begin() );
+}
+
+
+double
+get_odds_ratio(
+    double p_score_under_binding,
+    double p_score_under_background )
+{
+    return pssm_parameters::singleton().binding_background_odds_prior * p_score_under_binding / p_score_under_background;
+}
+
+
+
+double
+get_odds_ratio(
+    double score,
+    likelihoods_ptr _binding_dist,
+    likelihoods_ptr _background_dist )
+{
+    const double p_score_under_binding = get_likelihood( _binding_dist, score );
+    const double p_score_under_background = get_likelihood( _background_dist, score );
+
+    return get_odds_ratio( p_score_under_binding, p_score_under_background );
+}
+
+
+double
+get_p_binding(
+    double odds_ratio )
+{
+    return odds_ratio / ( 1.0 + odds_ratio );
+}
+
+
+double
+get_odds_ratio_from_p_binding(
+    double p_binding )
+{
+    return p_binding / ( 1.0 - p_binding );
+}
+
+
+namespace detail {
+
+enum pssm_type {
+    PSSM_TRANSFAC,
+    PSSM_CUSTOM,
+    PSSM_UNKNOWN_TYPE
+};
+
+pssm_type get_pssm_type( const std::string & id );
+
+
+struct PssmFromName
+    : std::unary_function< std::string, pssm_info >
+{
+    const static regex transfac_re; /**< Regex to match TRANSFAC PSSM names. */
+    const static regex custom_re; /**< Regex to match custom PSSM names. */
+    pssm_info operator()( const std::string & name ) const
+    {
+        std::cout << "Creating pssm info for: " << name << "\n";
+
+        nucleo_dist::vec counts;
+        int n_sites = 0;
+
+        switch( get_pssm_type( name ) )
+        {
+        case PSSM_TRANSFAC:
+            {
+                //look in transfac
+                USING_BIO_NS;
+                const TableLink link = parse_table_link_accession_number( name );
+
+                switch( link.table_id )
+                {
+                case SITE_DATA:
+                    {
+                        Site::map_t::const_iterator s = BiobaseDb::singleton().get_sites().find( link );
+                        if( BiobaseDb::singleton().get_sites().end() == s )
+                        {
+                            throw std::logic_error( BIOPSY_MAKE_STRING( "Could not find TRANSFAC PSSM id: " << name ) );
+                        }
+                        //std::cout << s->second->sequence << "\n";
+                        BOOST_FOREACH( char c, s->second->sequence )
+                        {
+                            const nucleo_dist count = get_dist_for_iupac( c );
+                            counts.push_back( count );
+                        }
+                        //    These are consensus sequences, so assume they are derived from 
+                        //    12 sites
+                        n_sites = 12;
+                    }
+                    break;
+
+                case MATRIX_DATA:
+                    {
+                        Matrix::map_t::const_iterator m = BiobaseDb::singleton().get_matrices().find( link );
+                        if( BiobaseDb::singleton().get_matrices().end() == m )
+                        {
+                            throw std::logic_error( BIOPSY_MAKE_STRING( "Could not find TRANSFAC PSSM id: " << name ) );
+                        }
+                        BOOST_FOREACH( const PssmEntry & e, m->second->pssm )
+                        {
+                            const nucleo_dist count(
+                                e.get_count( 'a' ),
+                                e.get_count( 'c' ),
+                                e.get_count( 'g' ),
+                                e.get_count( 't' ) );
+                            counts.push_back( count );
+                        }
+                        n_sites =  m->second->number_of_sites;
+                    }
+                    break;
+
+                default:
+                    throw std::logic_error( BIOPSY_MAKE_STRING( "Could not parse TRANSFAC PSSM id: " << name ) );
+                }
+            }
+            break;
+
+        case PSSM_CUSTOM:
+            {
+                //it looks like the name of a custom PSSM
+                custom_pssm::ptr pssm = parse_custom_pssm_file( custom_pssm_filename( name ) ); //the name should be the PSSM id
+                counts = pssm->counts;
+                n_sites = 0;
+            }
+            break;
+
+        default:
+            throw std::logic_error( BIOPSY_MAKE_STRING( "Unknown PSSM name: " << name ) );
+        }
+
+        //add pseudo-counts
+        double max_count = 0;
+        double min_count = 999;
+        double multiplier = 1;
+
+        //    For distributions where the sum adds up to 1, divide the pseudo count by 100;
+        //    Have to check for total less than 1.02 because of rounding errors in the TRANSFAC data
+        //    where it is only given to 2 sig fig
+        double total = 0;
+        BOOST_FOREACH( nucleo_dist & c, counts )
+        {
+            double count = c.get_total();
+            total += count;
+            max_count  = max(max_count,count);
+            min_count  = min(min_count,count);
+        }
+    
+
+        if (n_sites) {
+            double average_count = total/counts.size();
+            //    IF the reported number of sites is out of kilter with the raw count
+            //    data then adjust the pseudo count.
+            if ((n_sites > (1.2 * max_count)) || (n_sites < (0.8 * min_count))) {
+                multiplier = average_count/n_sites;
+            }
+        } else {
+            if (max_count <= min_count * 1.05) {
+                n_sites = max_count;
+            } else if (max_count <= min_count + 1) {
+                n_sites = max_count;
+            }
+
+            //Look to see if the data is non integer implying that we have the equivalent of data from
+            //lots of sites.  If so adjust the pseudo count on the assumption that it is for 100
+            //sites
+
+            for (int i = 0; (i < int(counts.size())) && (multiplier == 1); i++ ) {
+
+                const nucleo_dist & c = counts[i];
+                for (int j = 0;j < 4;j++) {
+
+                    double frac = fmod(c.get(j),1.0);
+                    if ((frac > 0.1) && (frac < 0.9)) {
+                        multiplier = 1.0f/ANALOGUE_SITE_EQUIVALENT;
+                        n_sites = ANALOGUE_SITE_EQUIVALENT;
+                        break;
+                    }
+                }
+            }
+        }
+
+        double pseudo_count = pssm_parameters::singleton().pseudo_counts * multiplier;
+        nucleo_dist::vec dists( counts + pseudo_count );
+        pssm_ptr _pssm = create_pssm( dists );
+
+        return pssm_info(
+            counts,
+            pseudo_count,
+            n_sites,
+            _pssm,
+            calculate_likelihoods_under_pssm( _pssm, dists ),
+            calculate_likelihoods_under_background( _pssm )
+        );
+    }
+};
+
+
+pssm_type
+get_pssm_type( const std::string & id ) {
+    if( regex_match( id, PssmFromName::transfac_re ) ) return PSSM_TRANSFAC;
+    if( regex_match( id, PssmFromName::custom_re ) ) return PSSM_CUSTOM;
+    return PSSM_UNKNOWN_TYPE;
+}
+
+const regex PssmFromName::transfac_re( "[MR][0-9][0-9][0-9][0-9][0-9]" );
+const regex PssmFromName::custom_re( "([A-Z]+)-([0-9]+)" );
+
+boost::filesystem::path
+get_pssm_cache_serialised_file()
+{
+    using namespace boost::filesystem;
+    return
+        path( BIO_NS::BioEnvironment::singleton().get_serialised_dir() )
+        / path( "pssm_cache.txt" );
+}
+
+/**
+ * The journal of PSSMs built since the PSSM cache was last serialised in full.
+ */
+boost::filesystem::path
+get_pssm_cache_journal_file()
+{
+    using namespace boost::filesystem;
+    return
+        path( BIO_NS::BioEnvironment::singleton().get_serialised_dir() )
+        / path( "pssm_cache_journal.txt" );
+}
+
+/**
+ * The memory-mapped binary version of the PSSM cache.
+ */
+boost::filesystem::path
+get_pssm_cache_binary_file()
+{
+    using namespace boost::filesystem;
+    return
+        path( BIO_NS::BioEnvironment::singleton().get_serialised_dir() )
+        / path( "pssm_cache.bin" );
+}
+
+/**
+ * Creates PSSM information that is ready to be read from many threads at once. Decodes it from
+ * the binary cache if it is there.
+ */
+struct PreparedPssmFromName
+    : std::unary_function< std::string, pssm_info >
+{
+    boost::shared_ptr< pssm_binary_cache::ptr > binary; ///< Set once when the PSSM cache is loaded.
+
+    PreparedPssmFromName()
+    : binary( new pssm_binary_cache::ptr )
+    { }
+
+    pssm_info operator()( const std::string & name ) const
+    {
+        pssm_info result;
+        if( *binary && ( *binary )->get( name, result ) )
+        {
+            //    We don't persist the dists because they are derivable from the counts
+            result._dists = result._counts + result._pseudo_count;
+        }
+        else
+        {
+            result = PssmFromName()( name );
+        }
+        result.calculate_derived();
+        return result;
+    }
+};
+
+/**
+ * Our cache of PSSM information
+ */
+struct pssm_cache
+    : BIO_NS::ConcurrentCache< PreparedPssmFromName >
+    , BIO_NS::Singleton< pssm_cache >
+{
+    mutable boost::mutex journal_mutex;
+
+    /** Derive what we don't persist and add to the cache. */
+    void insert_deserialised( const std::string & name, pssm_info & info )
+    {
+        //    We don't persist the dists because they are derivable from the counts
+        info._dists = info._counts + info._pseudo_count;
+        info.calculate_derived();
+        insert( name, info );
+    }
+
+    const pssm_binary_cache::ptr & get_binary() const
+    {
+        return *element_creator.binary;
+    }
+
+    /** Is the PSSM in the cache or the binary cache? */
+    bool has( const std::string & name ) const
+    {
+        return contains( name ) || ( get_binary() && get_binary()->contains( name ) );
+    }
+
+    /** Map the binary cache if there is one. Its entries are decoded as they are asked for. */
+    bool open_binary()
+    {
+        const boost::filesystem::path binary_file = get_pssm_cache_binary_file();
+        if( ! boost::filesystem::exists( binary_file ) )
+        {
+            return false;
+        }
+
+        try
+        {
+            *element_creator.binary = pssm_binary_cache::ptr( new pssm_binary_cache( binary_file ) );
+            return true;
+        }
+        catch( const std::exception & ex )
+        {
+            *( BIO_NS::BioEnvironment::singleton().get_log_stream() )
+                << ex.what() << ": Could not map \"" << binary_file._BOOST_FS_NATIVE() << "\"\n";
+            return false;
+        }
+    }
+
+    void init_singleton()
+    {
+        //the binary cache supersedes the text archive
+        if( ! open_binary() )
+        {
+            map_t elements;
+            BIO_NS::try_to_deserialise< false >( elements, get_pssm_cache_serialised_file() );
+            BOOST_FOREACH(map_t::value_type & t,elements)
+            {
+                insert_deserialised( t.first, t.second );
+            }
+        }
+
+        read_journal();
+    }
+
+    /** Read the entries appended to the journal since the cache was last serialised. */
+    void read_journal()
+    {
+        pssm_journal_entries entries;
+        read_pssm_journal( get_pssm_cache_journal_file()._BOOST_FS_NATIVE(), entries );
+        BOOST_FOREACH( pssm_journal_entries::value_type & e, entries )
+        {
+            insert_deserialised( e.first, e.second );
+        }
+    }
+
+    /** Append the entry to the journal so that it is persisted without serialising the whole cache. */
+    void append_to_journal( const std::string & name, const pssm_info & info ) const
+    {
+        boost::lock_guard< boost::mutex > lock( journal_mutex );
+        append_to_pssm_journal( get_pssm_cache_journal_file()._BOOST_FS_NATIVE(), name, info );
+    }
+
+    /** Everything we have built or loaded together with everything in the binary cache. */
+    map_t get_all_elements() const
+    {
+        map_t result = get_elements();
+        if( get_binary() )
+        {
+            BOOST_FOREACH( const std::string & name, *get_binary()->get_ids() )
+            {
+                if( ! result.count( name ) )
+                {
+                    get_binary()->get( name, result[ name ] );
+                }
+            }
+        }
+        return result;
+    }
+
+    /** Serialise the whole cache, which makes the journal redundant. */
+    void serialise() const
+    {
+        boost::lock_guard< boost::mutex > lock( journal_mutex );
+        BIO_NS::serialise< false >( get_all_elements(), get_pssm_cache_serialised_file() );
+        boost::filesystem::remove( get_pssm_cache_journal_file() );
+    }
+
+    /**
+     * Write the whole cache in the binary format, which makes the journal redundant. We write to a
+     * temporary file and rename it over the binary cache so other processes never see a partial file.
+     */
+    void serialise_binary() const
+    {
+        boost::lock_guard< boost::mutex > lock( journal_mutex );
+        const boost::filesystem::path binary_file = get_pssm_cache_binary_file();
+        const boost::filesystem::path tmp_file( binary_file._BOOST_FS_NATIVE() + ".tmp" );
+        pssm_binary_cache::write( tmp_file, get_all_elements() );
+        boost::filesystem::rename( tmp_file, binary_file );
+        boost::filesystem::remove( get_pssm_cache_journal_file() );
+    }
+};
+
+/**
+ * Builds one PSSM and journals it, or reports why it could not be built.
+ */
+struct precompute_one_pssm
+{
+    const string_vec & ids;
+    std::vector< char > & built;
+
+    precompute_one_pssm( const string_vec & ids, std::vector< char > & built )
+    : ids( ids )
+    , built( built )
+    { }
+
+    void operator()( size_t i ) const {
+        const std::string & id = ids[ i ];
+        try
+        {
+            pssm_cache & cache = pssm_cache::singleton();
+            cache.append_to_journal( id, cache( id ) );
+            built[ i ] = 1;
+        }
+        catch( const std::exception & ex )
+        {
+            *( BIO_NS::BioEnvironment::singleton().get_log_stream() )
+                << "Could not build PSSM " << id << ": " << ex.what() << "\n";
+        }
+    }
+};
+
+} //namespace detail
+
+
+
+
+namespace detail {
+
+/** Calculates the likelihoods with whichever algorithm the pssm parameters ask for. */
+void
+calculate_likelihoods( const pssm & _pssm, const nucleo_dist::vec & dists, likelihoods & result ) {
+    const pssm_parameters & params = pssm_parameters::singleton();
+    if( params.use_likelihoods_lattice )
+    {
+        calculate_pssm_likelihoods_on_lattice( _pssm, dists, result, params.likelihoods_lattice_size );
+    }
+    else
+    {
+        calculate_pssm_likelihoods( _pssm, dists, result, params.calculate_likelihoods_map_size, false );
+    }
+}
+
+} //namespace detail
+
+
+likelihoods_ptr
+calculate_likelihoods_under_pssm( pssm_ptr _pssm, const nucleo_dist::vec & dists ) {
+    likelihoods_ptr under_pssm( new likelihoods( pssm_parameters::singleton().likelihoods_size ) );
+    detail::calculate_likelihoods( *_pssm, dists, *under_pssm );
+    //std::cout << "Under pssm:\n";
+    //BOOST_FOREACH( double p, *under_pssm )
+    //{
+    //    std::cout << p << "\n";
+    //}
+    return under_pssm;
+}
+
+
+likelihoods_ptr
+calculate_likelihoods_under_background( pssm_ptr _pssm ) {
+    likelihoods_ptr under_background( new likelihoods( pssm_parameters::singleton().likelihoods_size ) );
+    const nucleo_dist::vec background_dist =
+        boost::assign::list_of( uniform_nucleo_dist() ).repeat( _pssm->size() - 1, uniform_nucleo_dist() );
+    detail::calculate_likelihoods( *_pssm, background_dist, *under_background );
+    //std::cout << "Under background:\n";
+    //BOOST_FOREACH( double p, *under_background )
+    //{
+    //    std::cout << p << "\n";
+    //}
+    return under_background;
+}
+
+
+
+bool is_transfac_pssm( const std::string & pssm_name )
+{
+    return detail::PSSM_TRANSFAC == detail::get_pssm_type( pssm_name );
+}
+
+
+
+bool
+add_pssm_to_cache( const std::string & name, const pssm_info & pssm ) {
+    pssm_info prepared( pssm );
+    prepared.calculate_derived();
+    return detail::pssm_cache::singleton().insert( name, prepared );
+}
+
+void
+save_pssm_cache_state( )
+{
+    detail::pssm_cache::singleton().serialise();
+}
+
+void
+save_pssm_cache_binary_state( )
+{
+    detail::pssm_cache::singleton().serialise_binary();
+}
+
+void
+append_to_pssm_journal(
+    const std::string & journal_file,
+    const std::string & name,
+    const pssm_info & info )
+{
+    std::ostringstream record;
+    {
+        boost::archive::text_oarchive archive( record );
+        archive << name;
+        archive << info;
+    }
+    const std::string data = record.str();
+    boost::crc_32_type crc;
+    crc.process_bytes( data.data(), data.size() );
+
+    std::ofstream stream( journal_file.c_str(), std::ios::app | std::ios::binary );
+    stream << data.size() << " " << crc.checksum() << "\n";
+    stream.write( data.data(), data.size() );
+    stream << "\n";
+    stream.flush();
+    if( ! stream )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( "Could not append " << name << " to the PSSM journal " << journal_file ) );
+    }
+}
+
+unsigned
+read_pssm_journal(
+    const std::string & journal_file,
+    pssm_journal_entries & entries )
+{
+    if( ! boost::filesystem::exists( journal_file ) )
+    {
+        return 0;
+    }
+    const boost::uintmax_t file_size = boost::filesystem::file_size( journal_file );
+
+    //read records until the end of the file or the first one that is not complete and intact
+    boost::uintmax_t good_size = 0;
+    unsigned num_read = 0;
+    {
+        std::ifstream stream( journal_file.c_str(), std::ios::binary );
+        size_t size;
+        boost::uint32_t checksum;
+        while( stream >> size >> checksum && '\n' == stream.get() )
+        {
+            const boost::uintmax_t data_begin = boost::uintmax_t( stream.tellg() );
+            if( 0 == size || size >= file_size - data_begin )
+            {
+                break;
+            }
+            std::string data( size, '\0' );
+            if( ! stream.read( &data[ 0 ], size ) || '\n' != stream.get() )
+            {
+                break;
+            }
+            boost::crc_32_type crc;
+            crc.process_bytes( data.data(), data.size() );
+            if( checksum != crc.checksum() )
+            {
+                break;
+            }
+
+            pssm_journal_entries::value_type entry;
+            try
+            {
+                std::istringstream record( data );
+                boost::archive::text_iarchive archive( record );
+                archive >> entry.first;
+                archive >> entry.second;
+            }
+            catch( const std::exception & )
+            {
+                break;
+            }
+            entries.push_back( entry );
+            good_size = data_begin + size + 1;
+            ++num_read;
+        }
+    }
+
+    if( good_size != file_size )
+    {
+        *( BIO_NS::BioEnvironment::singleton().get_log_stream() )
+            << "Dropping the torn record after entry " << num_read << " of \"" << journal_file << "\"\n";
+        boost::filesystem::resize_file( journal_file, good_size );
+    }
+
+    return num_read;
+}
+
+unsigned
+precompute_pssm_cache(
+    const string_vec & ids,
+    unsigned num_threads )
+{
+    //only build what we have not got
+    string_vec to_build;
+    BOOST_FOREACH( const std::string & id, ids )
+    {
+        if( ! detail::pssm_cache::singleton().has( id ) )
+        {
+            to_build.push_back( id );
+        }
+    }
+
+    //the workers look TRANSFAC PSSMs up in the biobase tables so load them before they start
+    BOOST_FOREACH( const std::string & id, to_build )
+    {
+        if( is_transfac_pssm( id ) )
+        {
+            BIO_NS::BiobaseDb::singleton().get_matrices();
+            BIO_NS::BiobaseDb::singleton().get_sites();
+            break;
+        }
+    }
+
+    //not a vector< bool > as the workers write to it concurrently
+    std::vector< char > built( to_build.size(), 0 );
+    BIO_NS::parallel_for( to_build.size(), num_threads, detail::precompute_one_pssm( to_build, built ) );
+
+    return unsigned( std::count( built.begin(), built.end(), 1 ) );
+}
+
+void
+clear_pssm_cache( )
+{
+    detail::pssm_cache::singleton().clear();
+}
+
+const pssm_info &
+get_pssm(
+    const std::string & name )
+{
+    return detail::pssm_cache::singleton()( name );
+}
+
+std::string get_pssm_name( const std::string & id )
+{
+    using namespace detail;
+    switch( get_pssm_type( id ) )
+    {
+    case PSSM_TRANSFAC: return BIO_NS::parse_table_link_accession_number( id ).get_name();
+    case PSSM_CUSTOM: return get_custom_pssm( id )->name;
+    default: throw std::logic_error( BIOPSY_MAKE_STRING( "Do not know about PSSM with id: " << id ) );
+    }
+}
+
+std::string get_pssm_url( const std::string & id )
+{
+    using namespace detail;
+    switch( get_pssm_type( id ) )
+    {
+    case PSSM_TRANSFAC: return BIO_NS::parse_table_link_accession_number( id ).get_url();
+    case PSSM_CUSTOM: return get_custom_pssm( id )->url;
+    default: throw std::logic_error( BIOPSY_MAKE_STRING( "Do not know about PSSM with id: " << id ) );
+    }
+}
+
+
+typedef std::vector< double > likelihoods;
+
+double get_likelihood( likelihoods_ptr likelihoods, double score )
+{
+    const unsigned index = get_likelihood_index( likelihoods->size(), score );
+    return ( *likelihoods )[ index ];
+}
+
+
+likelihoods_ptr
+accumulate_likelihoods( likelihoods_ptr ls )
+{
+    const unsigned size = ls->size();
+    likelihoods_ptr result( new likelihoods( size ) );
+    double cum = 0.0;
+    for( unsigned i = 0; size != i; ++i )
+    {
+        const unsigned idx = size - 1 - i;
+        cum += ( *ls )[ idx ];
+        ( *result )[ idx ] = cum;
+    }
+    return result;
+}
+
+
+double
+normalise_likelihoods( likelihoods & result )
+{
+    const double sum = std::accumulate( result.begin(), result.end(), 0.0 );
+    if( 0 >= sum )
+    {
+        throw std::logic_error( BIOPSY_MAKE_STRING( "Cannot normalise likelihood vector with sum < 0: " << sum ) );
+    }
+
+    BOOST_FOREACH( double & p, result )
+    {
+        p /= sum;
+    }
+
+    return sum;
+}
+
+
+void
+calculate_pssm_likelihoods(
+    const pssm & pssm,
+    const nucleo_dist::vec & distribution,
+    likelihoods & result,
+    const size_t max_map_size,
+    bool verbose )
+{
+    using namespace boost::numeric;
+
+    /** Maps scores to probabilities. */
+    typedef std::map< double, double > prob_map;
+    typedef boost::scoped_ptr< prob_map > prob_map_ptr;
+
+    if( pssm.size() != distribution.size() )
+    {
+        BOOST_FOREACH( const nucleo_dist & d, distribution )
+        {
+            std::cout << d.get( 0 ) << "," << d.get( 1 ) << "," << d.get( 2 ) << "," << d.get( 3 ) << "\n";
+        }
+
+        throw
+            std::invalid_argument(
+                BIOPSY_MAKE_STRING(
+                    "pssm and distribution are different sizes: "
+                    << pssm.size() << " != " << distribution.size() ) );
+    }
+
+    if( result.empty() )
+    {
+        throw std::invalid_argument( "result vector is empty" );
+    }
+
+    prob_map_ptr probs1( new prob_map );
+    prob_map_ptr probs2( new prob_map );
+    prob_map * last_probs = probs1.get(); //these alternate
+    prob_map * new_probs = probs2.get();
+    (*last_probs)[0.0] = std::log(1.0); //initialise with score of 0 has likelihood 1.0 at the start of the algorithm
+
+    //for each row
+    for( unsigned base = 0; pssm.size() != base; ++base )
+    {
+        new_probs->clear(); //start afresh
+
+        //go to the next nucleotide if no observations
+        if ( 0 == distribution[ base ].get_total() )
+        {
+            continue;
+        }
+
+        //if we have too many scores we need to quantise them
+        while (last_probs->size() > max_map_size)
+        {
+            if( verbose )
+            {
+                std::cout << "Reducing map size from " <<  last_probs->size();
+            }
+
+            const double min_score = last_probs->begin()->first;
+            const double max_score = last_probs->rbegin()->first;
+            const double quantum = (max_score - min_score) / max_map_size;
+
+            //for each pair of consecutive scores
+            for( prob_map::iterator p1 = last_probs->begin(); last_probs->end() != p1; )
+            {
+                //get the next score
+                prob_map::iterator p2 = p1;
+                ++p2;
+                if( last_probs->end() == p2 )
+                {
+                    break;
+                }
+
+                const double score1 = p1->first;
+                const double score2 = p2->first;
+                BOOST_ASSERT(score2 > score1); //problem if in wrong order...
+
+                //are the two scores close?
+                if( score2 - score1 < quantum )
+                {
+                    //we remove them both and insert a replacement for the average score that is as likely
+                    //as both together
+                    prob_map::iterator to_erase1 = p1;
+                    prob_map::iterator to_erase2 = p2;
+
+                    //insert the new value
+                    const double prob1 = std::exp( p1->second );
+                    const double prob2 = std::exp( p2->second );
+                    const double prob_sum = prob1 + prob2;
+#ifndef NDEBUG
+                    const double relative_prob1 = prob1 / prob_sum;
+#endif
+                    const double relative_prob2 = prob2 / prob_sum;
+                    const double avg_score = score1 + ( score2 - score1 ) * relative_prob2; //had to be careful here with floating point underflow
+                    BOOST_ASSERT( score1 <= avg_score );
+                    BOOST_ASSERT( avg_score <= score2 );
+
+                    //move on before we insert the new value and erase the old
+                    p1 = p2; ++p1;
+
+                    //erase the old values
+                    last_probs->erase(to_erase1);
+                    last_probs->erase(to_erase2);
+
+                    //insert the new value
+                    const double log_prob_sum = std::log( prob_sum );
+                    std::pair< prob_map::iterator, bool > insert_result =
+                        last_probs->insert( prob_map::value_type( avg_score, log_prob_sum ) );
+
+                    //did it actually insert?
+                    if( ! insert_result.second )
+                    {
+                        //no - so update the existing element
+                        insert_result.first->second =
+                            std::log( std::exp( insert_result.first->second ) + std::exp( log_prob_sum ) );
+                    }
+                }
+                else
+                {
+                    //move on
+                    p1 = p2;
+                }
+            }
+
+            if (verbose)
+            {
+                std::cout << " to " <<  last_probs->size() << std::endl;
+            }
+
+        } //while map is too large
+
+        //for each nucleotide
+        for( unsigned i = 0; 4 != i; ++i )
+        {
+            //likelihood in the pssm for this nucleotide in this position? Use a psuedo count of 1
+            const double prob_this_nucleo = distribution[ base ].get_freq( i );
+
+            //if none, cannot contribute to the total probabilities
+            if( 0.0 == prob_this_nucleo )
+            {
+                continue;
+            }
+            //BOOST_ASSERT(0 != entry->get_count(*n)); - this was only true before pseudo counts used
+
+            const double log_prob_this_nucleo = std::log( prob_this_nucleo );
+            const double score_this_nucleo = pssm[ base ].get( i );
+
+            //for each score we have already achieved
+            for( prob_map::const_iterator p = last_probs->begin(); last_probs->end() != p; ++p )
+            {
+                const double new_score = p->first + score_this_nucleo;
+                const double new_log_likelihood = p->second + log_prob_this_nucleo;
+
+                //update the new probability map
+
+                //first try to insert
+                std::pair< prob_map::iterator, bool > insert_result =
+                    new_probs->insert( prob_map::value_type( new_score, new_log_likelihood ) );
+
+                //did it actually insert?
+                if( ! insert_result.second )
+                {
+                    //no - so update the existing element
+                    insert_result.first->second =
+                        std::log( std::exp( insert_result.first->second ) + std::exp( new_log_likelihood ) );
+                }
+            }
+
+        } //for each nucleotide
+
+        if( verbose )
+        {
+            //for debugging
+            double total_prob = 0.0;
+            for( prob_map::const_iterator p = new_probs->begin(); new_probs->end() != p; ++p )
+            {
+                total_prob += std::exp( p->second );
+            }
+            std::cout
+                << "Base " << base << " has prob map size " << new_probs->size()
+                << " and total probability: " << total_prob
+                << std::endl;
+
+        }
+
+        std::swap( new_probs, last_probs );
+
+    } //for each row
+
+    //initialise the result vector
+    std::fill( result.begin(), result.end(), 0.0 );
+
+    //for each score in the last_probs map, place in the likelihoods vector
+    for( prob_map::const_iterator p = last_probs->begin(); last_probs->end() != p; ++p )
+    {
+        //normalise the score
+        BOOST_ASSERT( in( p->first, interval< double >( -0.0001, 1.0001 ) ) );
+        const double score = std::min( 1.0, std::max( 0.0, p->first ) );
+
+        //what is the probability
+        const double log_likelihood = p->second;
+        const double prob = std::exp( log_likelihood );
+
+        result[ get_likelihood_index( result.size(), score ) ] += prob;
+    }
+
+    normalise_likelihoods( result );
+}
+
+void
+calculate_pssm_likelihoods_on_lattice(
+    const pssm & pssm,
+    const nucleo_dist::vec & distribution,
+    likelihoods & result,
+    const size_t lattice_size )
+{
+    if( pssm.size() != distribution.size() )
+    {
+        throw
+            std::invalid_argument(
+                BIOPSY_MAKE_STRING(
+                    "pssm and distribution are different sizes: "
+                    << pssm.size() << " != " << distribution.size() ) );
+    }
+
+    if( result.empty() )
+    {
+        throw std::invalid_argument( "result vector is empty" );
+    }
+
+    if( 0 == lattice_size )
+    {
+        throw std::invalid_argument( "lattice size is 0" );
+    }
+
+    //find the range of scores we can achieve over the rows we will use
+    double min_total = 0.0;
+    double max_total = 0.0;
+    for( unsigned base = 0; pssm.size() != base; ++base )
+    {
+        if( 0 == distribution[ base ].get_total() )
+        {
+            continue;
+        }
+        double min_score = std::numeric_limits< double >::max();
+        double max_score = -std::numeric_limits< double >::max();
+        for( unsigned i = 0; 4 != i; ++i )
+        {
+            min_score = std::min( min_score, pssm[ base ].get( i ) );
+            max_score = std::max( max_score, pssm[ base ].get( i ) );
+        }
+        min_total += min_score;
+        max_total += max_score;
+    }
+    const double step = max_total > min_total ? ( max_total - min_total ) / lattice_size : 1.0;
+
+    //each lattice point holds the probability of reaching it and the probability weighted sum of the
+    //exact scores that reach it, so that we know the mean score each point stands for
+    std::vector< double > last_probs( 1, 1.0 );
+    std::vector< double > last_scores( 1, 0.0 );
+    std::vector< double > new_probs;
+    std::vector< double > new_scores;
+
+    //for each row
+    for( unsigned base = 0; pssm.size() != base; ++base )
+    {
+        //go to the next nucleotide if no observations
+        if ( 0 == distribution[ base ].get_total() )
+        {
+            continue;
+        }
+
+        //where on the lattice does each nucleotide move us?
+        double min_score = std::numeric_limits< double >::max();
+        for( unsigned i = 0; 4 != i; ++i )
+        {
+            min_score = std::min( min_score, pssm[ base ].get( i ) );
+        }
+        boost::array< size_t, 4 > offsets;
+        size_t max_offset = 0;
+        for( unsigned i = 0; 4 != i; ++i )
+        {
+            offsets[ i ] = size_t( ( pssm[ base ].get( i ) - min_score ) / step + 0.5 );
+            max_offset = std::max( max_offset, offsets[ i ] );
+        }
+
+        new_probs.assign( last_probs.size() + max_offset, 0.0 );
+        new_scores.assign( last_scores.size() + max_offset, 0.0 );
+
+        //for each nucleotide
+        for( unsigned i = 0; 4 != i; ++i )
+        {
+            const double prob_this_nucleo = distribution[ base ].get_freq( i );
+
+            //if none, cannot contribute to the total probabilities
+            if( 0.0 == prob_this_nucleo )
+            {
+                continue;
+            }
+
+            const double score_this_nucleo = pssm[ base ].get( i );
+            double * probs = &new_probs[ offsets[ i ] ];
+            double * scores = &new_scores[ offsets[ i ] ];
+            for( size_t k = 0; last_probs.size() != k; ++k )
+            {
+                probs[ k ] += prob_this_nucleo * last_probs[ k ];
+                scores[ k ] += prob_this_nucleo * ( last_scores[ k ] + score_this_nucleo * last_probs[ k ] );
+            }
+        } //for each nucleotide
+
+        std::swap( new_probs, last_probs );
+        std::swap( new_scores, last_scores );
+
+    } //for each row
+
+    //initialise the result vector
+    std::fill( result.begin(), result.end(), 0.0 );
+
+    //place the mean score of each lattice point in the likelihoods vector
+    for( size_t k = 0; last_probs.size() != k; ++k )
+    {
+        const double prob = last_probs[ k ];
+        if( 0.0 == prob )
+        {
+            continue;
+        }
+        const double score = std::min( 1.0, std::max( 0.0, last_scores[ k ] / prob ) );
+        result[ get_likelihood_index( result.size(), score ) ] += prob;
+    }
+
+    normalise_likelihoods( result );
+}
+
+
+double
+get_p_binding_using_p_value(
+    double score,
+    likelihoods_ptr likelihoods )
+{
+    const unsigned idx = get_likelihood_index( likelihoods->size(), score );
+    const double likelihood_under_background = ( *likelihoods )[ idx ];
+    const double likelihood_under_binding = 1.0 / double( likelihoods->size() );
+    return
+        get_p_binding(
+            get_odds_ratio(
+                likelihood_under_binding,
+                likelihood_under_background ) );
+}
+
+double
+get_p_binding_from_score(
+    const pssm_info & p,
+    double score )
+{
+    return get_p_binding_from_score( p, score, scoring_context::current() );
+}
+
+
+double
+get_p_binding_from_score(
+    const pssm_info & p,
+    double score,
+    const scoring_context & context )
+{
+    //same calculations as get_p_binding_using_p_value() and get_odds_ratio() but with the context's prior
+    const bool use_cumulative_dists = context.use_cumulative_dists;
+    if( context.use_p_value )
+    {
+        const likelihoods_ptr background = p.get_dist( false, use_cumulative_dists );
+        const double likelihood_under_background = ( *background )[ get_likelihood_index( background->size(), score ) ];
+        const double likelihood_under_binding = 1.0 / double( background->size() );
+        return get_p_binding( context.binding_background_odds_prior * likelihood_under_binding / likelihood_under_background );
+    }
+    else
+    {
+        const double p_score_under_binding = get_likelihood( p.get_dist( true, use_cumulative_dists ), score );
+        const double p_score_under_background = get_likelihood( p.get_dist( false, use_cumulative_dists ), score );
+        return get_p_binding( context.binding_background_odds_prior * p_score_under_binding / p_score_under_background );
+    }
+}
+
+
+p_binding_table::p_binding_table( const pssm_info & info, const scoring_context & context )
+    : binding_background_odds_prior( context.binding_background_odds_prior )
+    , use_cumulative_dists( context.use_cumulative_dists )
+    , use_p_value( context.use_p_value )
+{
+    //same calculations as get_p_binding_from_score() so we get identical results
+    const likelihoods & background = *info.get_dist( false, use_cumulative_dists );
+    if( use_p_value )
+    {
+        const double likelihood_under_binding = 1.0 / double( background.size() );
+        p_binding.resize( background.size() );
+        for( size_t i = 0; background.size() != i; ++i )
+        {
+            p_binding[ i ] = get_p_binding( binding_background_odds_prior * likelihood_under_binding / background[ i ] );
+        }
+    }
+    else
+    {
+        const likelihoods & binding = *info.get_dist( true, use_cumulative_dists );
+        if( binding.size() == background.size() )
+        {
+            p_binding.resize( background.size() );
+            for( size_t i = 0; background.size() != i; ++i )
+            {
+                p_binding[ i ] = get_p_binding( binding_background_odds_prior * binding[ i ] / background[ i ] );
+            }
+        }
+    }
+}
+
+
+bool
+p_binding_table::matches( const scoring_context & context ) const
+{
+    return
+        binding_background_odds_prior == context.binding_background_odds_prior
+        && use_cumulative_dists == context.use_cumulative_dists
+        && use_p_value == context.use_p_value;
+}
+
+
+p_binding_table::ptr
+pssm_info::get_p_binding_table() const
+{
+    return get_p_binding_table( scoring_context::current() );
+}
+
+
+const size_t p_binding_table::max_tables_per_pssm;
+
+p_binding_table::ptr
+pssm_info::get_p_binding_table( const scoring_context & context ) const
+{
+    //the list of tables is replaced by one with the new table added, so readers never need to lock
+    p_binding_table::vec_ptr tables = boost::atomic_load( &_p_binding_tables );
+    p_binding_table::ptr table;
+    while( true )
+    {
+        if( tables )
+        {
+            BOOST_FOREACH( const p_binding_table::ptr & t, *tables )
+            {
+                if( t->matches( context ) )
+                {
+                    return t;
+                }
+            }
+        }
+
+        if( ! table )
+        {
+            table.reset( new p_binding_table( *this, context ) );
+        }
+        boost::shared_ptr< p_binding_table::vec > with_table( tables ? new p_binding_table::vec( *tables ) : new p_binding_table::vec );
+        if( p_binding_table::max_tables_per_pssm == with_table->size() )
+        {
+            with_table->erase( with_table->begin() );
+        }
+        with_table->push_back( table );
+
+        //if another thread changed the list it may have added a table for this context, so look again
+        if( boost::atomic_compare_exchange( &_p_binding_tables, &tables, p_binding_table::vec_ptr( with_table ) ) )
+        {
+            return table;
+        }
+    }
+}
+
+
+const pssm_info::matrix_t &
+pssm_info::get_log_likelihoods() const {
+
+    // check whether we have calculated them
+    if( ! _log_likelihoods ) {
+        _log_likelihoods.reset( new matrix_t( boost::extents[ boost::size( _dists ) ][ 4 ] ) );
+        for( size_t i = 0; _dists.size() != i; ++i ) {
+            for( size_t b = 0; 4 != b; ++b ) {
+                ( *_log_likelihoods )[ i ][ b ] = std::log( _dists[ i ].get_freq( b ) );
+            }
+        }
+    }
+
+    return *_log_likelihoods;
+}
+
+
+
+void
+pssm_info::calculate_derived() const {
+    if( _binding_dist ) {
+        get_dist( true, true );
+    }
+    if( _background_dist ) {
+        get_dist( false, true );
+    }
+    get_log_likelihoods();
+}
+
+
+
+double
+get_p_binding_on_sequence(
+    const pssm_info & p,
+    sequence::const_iterator s_begin )
+{
+    return get_p_binding_from_score(
+        p,
+        score( *( p._pssm ), s_begin ) );
+}
+
+
+/**
+Scores a pssm on the reverse complement of the sequence and adjusts for distributions.
+*/
+double
+get_p_binding_on_reverse_complement(
+    const pssm_info & p,
+    sequence::const_iterator s_begin )
+{
+    return
+        get_p_binding_from_score(
+            p,
+            score_complement( *( p._pssm ), s_begin ) );
+}
+
+
+double
+get_p_binding_on_sequence(
+    const pssm_info & p,
+    const encoded_sequence::code * codes )
+{
+    return get_p_binding_from_score(
+        p,
+        score( *( p._pssm ), codes ) );
+}
+
+
+double
+get_p_binding_on_reverse_complement(
+    const pssm_info & p,
+    const encoded_sequence::code * codes )
+{
+    return
+        get_p_binding_from_score(
+            p,
+            score_complement( *( p._pssm ), codes ) );
+}
+
+
+pssm_info::pssm_info(
+    const nucleo_dist::vec & counts,
+    double pseudo_count,
+    int number_of_sites,
+    pssm_ptr p,
+    likelihoods_ptr binding_dist,
+    likelihoods_ptr background_dist )
+    : _counts( counts )
+    , _dists( counts + pseudo_count )
+    , _pseudo_count( pseudo_count )
+    , _number_of_sites( number_of_sites )
+    , _pssm( p )
+    , _binding_dist( binding_dist )
+    , _background_dist( background_dist )
+{
+}
+
+likelihoods_ptr
+pssm_info::get_dist( bool binding, bool cumulative ) const
+{
+    if( cumulative )
+    {
+        if( binding )
+        {
+            if( ! _cumulative_binding_dist )
+            {
+                _cumulative_binding_dist = accumulate_likelihoods( get_dist( binding, false ) );
+            }
+            return _cumulative_binding_dist;
+        }
+        else
+        {
+            if( ! _cumulative_background_dist )
+            {
+                _cumulative_background_dist = accumulate_likelihoods( get_dist( binding, false ) );
+            }
+            return _cumulative_background_dist;
+        }
+    }
+    else
+    {
+        if( binding )
+        {
+            if( ! _binding_dist )
+            {
+                throw std::logic_error( "Do not have binding distribution." );
+            }
+            return _binding_dist;
+        }
+        else
+        {
+            if( ! _background_dist )
+            {
+                throw std::logic_error( "Do not have background distribution." );
+            }
+            return _background_dist;
+        }
+    }
+}
+
+
+/** Convert a biopsy pssm to a bio pssm. */
+BIO_NS::Pssm make_transfac_pssm( const pssm & _pssm )
+{
+    BIO_NS::Pssm result;
+    BOOST_FOREACH( const nucleo_dist & dist, _pssm )
+        result.push_back( BIO_NS::PssmEntry( (BIO_NS::float_t)(10*dist.get(0)),(BIO_NS::float_t)(10*dist.get(1)), 
+         (BIO_NS::float_t)(10*dist.get(2)), (BIO_NS::float_t)(10*dist.get(3))) );
+    return result;
+}
+
+
+
+
+} //namespace biopsy
@@ -0,0 +1,331 @@
+/**
+@file
+
+Copyright John Reid 2013
+
+*/
+
+#include "biopsy/pssm_binary_cache.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <fstream>
+#include <cstring>
+
+namespace biopsy {
+
+
+namespace detail {
+
+const char pssm_binary_cache_magic[ 8 ] = { 'B', 'I', 'F', 'A', 'P', 'S', 'S', 'M' };
+const boost::uint32_t pssm_binary_cache_version = 1;
+const boost::uint32_t pssm_binary_cache_byte_order = 0x01020304;
+
+/** Precedes the blocks of doubles for each PSSM. */
+struct pssm_binary_entry
+{
+    boost::uint64_t num_counts;        ///< The number of nucleo_dists of counts.
+    boost::uint64_t num_scores;        ///< The number of nucleo_dists of pssm scores.
+    boost::uint64_t num_binding;       ///< The size of the binding likelihoods.
+    boost::uint64_t num_background;    ///< The size of the background likelihoods.
+    boost::int64_t number_of_sites;
+    double pseudo_count;
+};
+
+/**
+ * Takes a block of size values of the given width from the doubles that are available. Returns false if
+ * they are not all there. Each block is checked on its own so corrupt sizes cannot wrap around.
+ */
+bool take_doubles( boost::uint64_t & available, boost::uint64_t size, boost::uint64_t width )
+{
+    if( size > available / width )
+    {
+        return false;
+    }
+    available -= size * width;
+    return true;
+}
+
+void write_nucleo_dists( std::ostream & stream, const nucleo_dist::vec & dists )
+{
+    BOOST_FOREACH( const nucleo_dist & dist, dists )
+    {
+        for( unsigned b = 0; 4 != b; ++b )
+        {
+            const double value = dist.get( b );
+            stream.write( reinterpret_cast< const char * >( &value ), sizeof( value ) );
+        }
+    }
+}
+
+void write_likelihoods( std::ostream & stream, const likelihoods_ptr & ls )
+{
+    if( ls && ! ls->empty() )
+    {
+        stream.write( reinterpret_cast< const char * >( &( *ls )[ 0 ] ), sizeof( double ) * ls->size() );
+    }
+}
+
+const double * read_nucleo_dists( const double * values, boost::uint64_t size, nucleo_dist::vec & dists )
+{
+    dists.clear();
+    dists.reserve( size_t( size ) );
+    for( boost::uint64_t i = 0; size != i; ++i, values += 4 )
+    {
+        dists.push_back( nucleo_dist( values[ 0 ], values[ 1 ], values[ 2 ], values[ 3 ] ) );
+    }
+    return values;
+}
+
+const double * read_likelihoods( const double * values, boost::uint64_t size, likelihoods_ptr & ls )
+{
+    ls.reset();
+    if( size )
+    {
+        ls.reset( new likelihoods( values, values + size ) );
+    }
+    return values + size;
+}
+
+} //namespace detail
+
+
+
+struct pssm_binary_cache::header
+{
+    char magic[ 8 ];
+    boost::uint32_t version;
+    boost::uint32_t byte_order;
+    boost::uint64_t num_entries;
+    boost::uint64_t index_offset;  ///< Where the index starts.
+};
+
+struct pssm_binary_cache::index_entry
+{
+    boost::uint64_t id_offset;     ///< Where the id's characters start.
+    boost::uint64_t id_length;
+    boost::uint64_t entry_offset;  ///< Where the entry starts.
+};
+
+
+pssm_binary_cache::pssm_binary_cache( const boost::filesystem::path & file )
+    : _mapping( file._BOOST_FS_NATIVE().c_str(), boost::interprocess::read_only )
+    , _region( _mapping, boost::interprocess::read_only )
+    , _begin( static_cast< const char * >( _region.get_address() ) )
+{
+    const size_t file_size = _region.get_size();
+    if( file_size < sizeof( header ) )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( file._BOOST_FS_NATIVE() << " is too small to be a binary PSSM cache" ) );
+    }
+
+    const header & h = *reinterpret_cast< const header * >( _begin );
+    if( std::memcmp( h.magic, detail::pssm_binary_cache_magic, sizeof( h.magic ) ) )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( file._BOOST_FS_NATIVE() << " is not a binary PSSM cache" ) );
+    }
+    if( detail::pssm_binary_cache_version != h.version )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( file._BOOST_FS_NATIVE() << " has unknown binary PSSM cache version " << h.version ) );
+    }
+    if( detail::pssm_binary_cache_byte_order != h.byte_order )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( file._BOOST_FS_NATIVE() << " was written on a machine with a different byte order" ) );
+    }
+    if( h.index_offset > file_size || h.num_entries > ( file_size - h.index_offset ) / sizeof( index_entry ) )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( file._BOOST_FS_NATIVE() << " has a truncated index" ) );
+    }
+
+    _index_begin = reinterpret_cast< const index_entry * >( _begin + h.index_offset );
+    _index_end = _index_begin + h.num_entries;
+    for( const index_entry * e = _index_begin; _index_end != e; ++e )
+    {
+        if( e->id_offset > file_size || e->id_length > file_size - e->id_offset
+            || e->entry_offset > file_size || sizeof( detail::pssm_binary_entry ) > file_size - e->entry_offset )
+        {
+            throw std::runtime_error( BIOPSY_MAKE_STRING( file._BOOST_FS_NATIVE() << " has an index entry that points outside the file" ) );
+        }
+    }
+}
+
+
+size_t
+pssm_binary_cache::size() const
+{
+    return _index_end - _index_begin;
+}
+
+
+const pssm_binary_cache::index_entry *
+pssm_binary_cache::find( const std::string & id ) const
+{
+    //binary search the index, which is sorted by id
+    const index_entry * first = _index_begin;
+    size_t count = size();
+    while( count )
+    {
+        const size_t step = count / 2;
+        const index_entry * middle = first + step;
+        const std::string middle_id( _begin + middle->id_offset, size_t( middle->id_length ) );
+        if( middle_id < id )
+        {
+            first = middle + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    if( _index_end == first || std::string( _begin + first->id_offset, size_t( first->id_length ) ) != id )
+    {
+        return 0;
+    }
+    return first;
+}
+
+
+bool
+pssm_binary_cache::contains( const std::string & id ) const
+{
+    return 0 != find( id );
+}
+
+
+bool
+pssm_binary_cache::get( const std::string & id, pssm_info & info ) const
+{
+    const index_entry * e = find( id );
+    if( ! e )
+    {
+        return false;
+    }
+
+    const size_t file_size = _region.get_size();
+    if( e->entry_offset > file_size || sizeof( detail::pssm_binary_entry ) > file_size - e->entry_offset )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( "Binary PSSM cache entry for " << id << " points outside the file" ) );
+    }
+
+    const detail::pssm_binary_entry & entry = *reinterpret_cast< const detail::pssm_binary_entry * >( _begin + e->entry_offset );
+    boost::uint64_t available = ( file_size - e->entry_offset - sizeof( entry ) ) / sizeof( double );
+    if( ! detail::take_doubles( available, entry.num_counts, 4 )
+        || ! detail::take_doubles( available, entry.num_scores, 4 )
+        || ! detail::take_doubles( available, entry.num_binding, 1 )
+        || ! detail::take_doubles( available, entry.num_background, 1 ) )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( "Binary PSSM cache entry for " << id << " is truncated" ) );
+    }
+
+    const double * values = reinterpret_cast< const double * >( &entry + 1 );
+    values = detail::read_nucleo_dists( values, entry.num_counts, info._counts );
+    info._pssm.reset();
+    if( entry.num_scores )
+    {
+        info._pssm.reset( new pssm );
+        values = detail::read_nucleo_dists( values, entry.num_scores, *info._pssm );
+    }
+    values = detail::read_likelihoods( values, entry.num_binding, info._binding_dist );
+    values = detail::read_likelihoods( values, entry.num_background, info._background_dist );
+    info._number_of_sites = int( entry.number_of_sites );
+    info._pseudo_count = entry.pseudo_count;
+
+    return true;
+}
+
+
+string_vec_ptr
+pssm_binary_cache::get_ids() const
+{
+    string_vec_ptr result( new string_vec );
+    result->reserve( size() );
+    for( const index_entry * e = _index_begin; _index_end != e; ++e )
+    {
+        result->push_back( std::string( _begin + e->id_offset, size_t( e->id_length ) ) );
+    }
+    return result;
+}
+
+
+void
+pssm_binary_cache::write( const boost::filesystem::path & file, const map_t & infos )
+{
+    std::ofstream stream( file._BOOST_FS_NATIVE().c_str(), std::ios::binary | std::ios::trunc );
+    if( ! stream )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( "Could not open " << file._BOOST_FS_NATIVE() << " to write binary PSSM cache" ) );
+    }
+
+    //we fill the header in at the end
+    header h;
+    std::memset( &h, 0, sizeof( h ) );
+    stream.write( reinterpret_cast< const char * >( &h ), sizeof( h ) );
+
+    //the entries, in id order
+    std::vector< index_entry > index;
+    index.reserve( infos.size() );
+    BOOST_FOREACH( const map_t::value_type & value, infos )
+    {
+        const pssm_info & info = value.second;
+
+        index_entry e;
+        e.entry_offset = boost::uint64_t( stream.tellp() );
+        index.push_back( e );
+
+        detail::pssm_binary_entry entry;
+        entry.num_counts = info._counts.size();
+        entry.num_scores = info._pssm ? info._pssm->size() : 0;
+        entry.num_binding = info._binding_dist ? info._binding_dist->size() : 0;
+        entry.num_background = info._background_dist ? info._background_dist->size() : 0;
+        entry.number_of_sites = info._number_of_sites;
+        entry.pseudo_count = info._pseudo_count;
+        stream.write( reinterpret_cast< const char * >( &entry ), sizeof( entry ) );
+
+        detail::write_nucleo_dists( stream, info._counts );
+        if( info._pssm )
+        {
+            detail::write_nucleo_dists( stream, *info._pssm );
+        }
+        detail::write_likelihoods( stream, info._binding_dist );
+        detail::write_likelihoods( stream, info._background_dist );
+    }
+
+    //the ids
+    std::vector< index_entry >::iterator e = index.begin();
+    BOOST_FOREACH( const map_t::value_type & value, infos )
+    {
+        e->id_offset = boost::uint64_t( stream.tellp() );
+        e->id_length = value.first.size();
+        stream.write( value.first.data(), value.first.size() );
+        ++e;
+    }
+
+    //the index, aligned so it can be read in place
+    while( boost::uint64_t( stream.tellp() ) % sizeof( boost::uint64_t ) )
+    {
+        stream.put( 0 );
+    }
+    h.index_offset = boost::uint64_t( stream.tellp() );
+    if( ! index.empty() )
+    {
+        stream.write( reinterpret_cast< const char * >( &index[ 0 ] ), sizeof( index_entry ) * index.size() );
+    }
+
+    std::memcpy( h.magic, detail::pssm_binary_cache_magic, sizeof( h.magic ) );
+    h.version = detail::pssm_binary_cache_version;
+    h.byte_order = detail::pssm_binary_cache_byte_order;
+    h.num_entries = index.size();
+    stream.seekp( 0 );
+    stream.write( reinterpret_cast< const char * >( &h ), sizeof( h ) );
+
+    if( ! stream )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( "Could not write binary PSSM cache to " << file._BOOST_FS_NATIVE() ) );
+    }
+}
+
+
+} //namespace biopsy
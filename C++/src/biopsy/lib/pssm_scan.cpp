@@ -0,0 +1,375 @@
+/**
+@file
+
+Copyright John Reid 2013
+
+*/
+
+#include "biopsy/pssm_scan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//
+// On x86 with gcc/clang we compile the SSE2 and AVX2 kernels using function target
+// attributes and choose between them at run time. Elsewhere we use whatever the
+// compiler has been told the target supports.
+//
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+# define BIOPSY_PSSM_SCAN_X86_DISPATCH
+# define BIOPSY_PSSM_SCAN_SSE2
+# define BIOPSY_PSSM_SCAN_AVX2
+# define BIOPSY_TARGET( x ) __attribute__(( target( x ) ))
+# include <immintrin.h>
+#else
+# if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#  define BIOPSY_PSSM_SCAN_SSE2
+#  include <emmintrin.h>
+# endif
+# if defined( __AVX2__ )
+#  define BIOPSY_PSSM_SCAN_AVX2
+#  include <immintrin.h>
+# endif
+# define BIOPSY_TARGET( x )
+#endif
+
+
+namespace biopsy {
+
+
+pssm_scan_table::pssm_scan_table( const pssm_info::matrix_t & log_likelihoods )
+    : size( log_likelihoods.size() )
+    , positive( 4 * size )
+    , negative( 4 * size )
+{
+    for( size_t j = 0; size != j; ++j )
+    {
+        for( size_t b = 0; 4 != b; ++b )
+        {
+            positive[ 4 * j + b ] = log_likelihoods[ j ][ b ];
+            negative[ 4 * j + b ] = log_likelihoods[ size - 1 - j ][ 3 - b ];
+        }
+    }
+}
+
+
+namespace detail {
+
+void
+scan_scalar(
+    const pssm_scan_table & table,
+    const encoded_sequence::code * codes,
+    size_t num_windows,
+    double * positive_scores,
+    double * negative_scores )
+{
+    const double * positive = &table.positive[ 0 ];
+    const double * negative = &table.negative[ 0 ];
+    for( size_t i = 0; num_windows != i; ++i )
+    {
+        const encoded_sequence::code * word = codes + i;
+        double p = 0.;
+        double n = 0.;
+        for( size_t j = 0; table.size != j; ++j )
+        {
+            p += positive[ 4 * j + word[ j ] ];
+            n += negative[ 4 * j + word[ j ] ];
+        }
+        positive_scores[ i ] = p;
+        negative_scores[ i ] = n;
+    }
+}
+
+
+#ifdef BIOPSY_PSSM_SCAN_SSE2
+
+/** Scores 2 windows at a time. */
+BIOPSY_TARGET( "sse2" )
+void
+scan_sse2(
+    const pssm_scan_table & table,
+    const encoded_sequence::code * codes,
+    size_t num_windows,
+    double * positive_scores,
+    double * negative_scores )
+{
+    const double * positive = &table.positive[ 0 ];
+    const double * negative = &table.negative[ 0 ];
+    size_t i = 0;
+    for( ; i + 2 <= num_windows; i += 2 )
+    {
+        const encoded_sequence::code * word = codes + i;
+        __m128d p = _mm_setzero_pd();
+        __m128d n = _mm_setzero_pd();
+        for( size_t j = 0; table.size != j; ++j )
+        {
+            const size_t c0 = 4 * j + word[ j ];
+            const size_t c1 = 4 * j + word[ j + 1 ];
+            p = _mm_add_pd( p, _mm_set_pd( positive[ c1 ], positive[ c0 ] ) );
+            n = _mm_add_pd( n, _mm_set_pd( negative[ c1 ], negative[ c0 ] ) );
+        }
+        _mm_storeu_pd( positive_scores + i, p );
+        _mm_storeu_pd( negative_scores + i, n );
+    }
+    scan_scalar( table, codes + i, num_windows - i, positive_scores + i, negative_scores + i );
+}
+
+#endif //BIOPSY_PSSM_SCAN_SSE2
+
+
+#ifdef BIOPSY_PSSM_SCAN_AVX2
+
+/** Loads 4 consecutive base codes as 32-bit gather indices. */
+BIOPSY_TARGET( "avx2" )
+inline
+__m128i
+load_4_codes( const encoded_sequence::code * codes )
+{
+    int packed;
+    std::memcpy( &packed, codes, sizeof( packed ) );
+    return _mm_cvtepu8_epi32( _mm_cvtsi32_si128( packed ) );
+}
+
+/** Scores 8 windows at a time using gathers from the flat tables. */
+BIOPSY_TARGET( "avx2" )
+void
+scan_avx2(
+    const pssm_scan_table & table,
+    const encoded_sequence::code * codes,
+    size_t num_windows,
+    double * positive_scores,
+    double * negative_scores )
+{
+    const double * positive = &table.positive[ 0 ];
+    const double * negative = &table.negative[ 0 ];
+    size_t i = 0;
+    for( ; i + 8 <= num_windows; i += 8 )
+    {
+        const encoded_sequence::code * word = codes + i;
+        __m256d p_lo = _mm256_setzero_pd();
+        __m256d p_hi = _mm256_setzero_pd();
+        __m256d n_lo = _mm256_setzero_pd();
+        __m256d n_hi = _mm256_setzero_pd();
+        for( size_t j = 0; table.size != j; ++j )
+        {
+            const __m128i idx_lo = load_4_codes( word + j );
+            const __m128i idx_hi = load_4_codes( word + j + 4 );
+            const double * pos_column = positive + 4 * j;
+            const double * neg_column = negative + 4 * j;
+            p_lo = _mm256_add_pd( p_lo, _mm256_i32gather_pd( pos_column, idx_lo, 8 ) );
+            p_hi = _mm256_add_pd( p_hi, _mm256_i32gather_pd( pos_column, idx_hi, 8 ) );
+            n_lo = _mm256_add_pd( n_lo, _mm256_i32gather_pd( neg_column, idx_lo, 8 ) );
+            n_hi = _mm256_add_pd( n_hi, _mm256_i32gather_pd( neg_column, idx_hi, 8 ) );
+        }
+        _mm256_storeu_pd( positive_scores + i, p_lo );
+        _mm256_storeu_pd( positive_scores + i + 4, p_hi );
+        _mm256_storeu_pd( negative_scores + i, n_lo );
+        _mm256_storeu_pd( negative_scores + i + 4, n_hi );
+    }
+    scan_scalar( table, codes + i, num_windows - i, positive_scores + i, negative_scores + i );
+}
+
+#endif //BIOPSY_PSSM_SCAN_AVX2
+
+} //namespace detail
+
+
+
+pssm_scan_kernel
+best_pssm_scan_kernel()
+{
+#if defined( BIOPSY_PSSM_SCAN_X86_DISPATCH )
+    static const pssm_scan_kernel best =
+        __builtin_cpu_supports( "avx2" )
+            ? PSSM_SCAN_AVX2
+            : ( __builtin_cpu_supports( "sse2" ) ? PSSM_SCAN_SSE2 : PSSM_SCAN_SCALAR );
+    return best;
+#elif defined( BIOPSY_PSSM_SCAN_AVX2 )
+    return PSSM_SCAN_AVX2;
+#elif defined( BIOPSY_PSSM_SCAN_SSE2 )
+    return PSSM_SCAN_SSE2;
+#else
+    return PSSM_SCAN_SCALAR;
+#endif
+}
+
+
+const char *
+pssm_scan_kernel_name( pssm_scan_kernel kernel )
+{
+    switch( kernel )
+    {
+    case PSSM_SCAN_SCALAR: return "scalar";
+    case PSSM_SCAN_SSE2: return "SSE2";
+    case PSSM_SCAN_AVX2: return "AVX2";
+    }
+    throw std::invalid_argument( BIOPSY_MAKE_STRING( "Unknown PSSM scan kernel: " << int( kernel ) ) );
+}
+
+
+void
+scan_pssm_log_likelihoods(
+    const pssm_scan_table & table,
+    const encoded_sequence::code * codes,
+    size_t num_windows,
+    double * positive_scores,
+    double * negative_scores,
+    pssm_scan_kernel kernel )
+{
+    if( 0 == num_windows || 0 == table.size )
+    {
+        std::fill( positive_scores, positive_scores + num_windows, 0. );
+        std::fill( negative_scores, negative_scores + num_windows, 0. );
+        return;
+    }
+
+    switch( kernel )
+    {
+#ifdef BIOPSY_PSSM_SCAN_AVX2
+    case PSSM_SCAN_AVX2:
+        detail::scan_avx2( table, codes, num_windows, positive_scores, negative_scores );
+        return;
+#endif //BIOPSY_PSSM_SCAN_AVX2
+#ifdef BIOPSY_PSSM_SCAN_SSE2
+    case PSSM_SCAN_SSE2:
+        detail::scan_sse2( table, codes, num_windows, positive_scores, negative_scores );
+        return;
+#endif //BIOPSY_PSSM_SCAN_SSE2
+    default:
+        detail::scan_scalar( table, codes, num_windows, positive_scores, negative_scores );
+        return;
+    }
+}
+
+
+namespace detail {
+
+/** The information content of each column's distribution. */
+std::vector< double >
+column_information( const nucleo_dist::vec & dists, size_t size )
+{
+    std::vector< double > result( size, 0. );
+    for( size_t j = 0; std::min( size, dists.size() ) != j; ++j )
+    {
+        for( unsigned b = 0; 4 != b; ++b )
+        {
+            const double f = dists[ j ].get_freq( b );
+            if( 0. < f )
+            {
+                result[ j ] += f * std::log( 4. * f );
+            }
+        }
+    }
+    return result;
+}
+
+/** Orders offsets by decreasing information. */
+struct more_informative
+{
+    const std::vector< double > & information;
+
+    more_informative( const std::vector< double > & information ) : information( information ) { }
+
+    bool operator()( unsigned lhs, unsigned rhs ) const
+    {
+        return information[ lhs ] > information[ rhs ];
+    }
+};
+
+/** Lay out the scores in the order given and calculate the bounds on the remaining scores. */
+void
+order_lookahead_scores(
+    const pssm_lookahead_table::table_t & scores,
+    const std::vector< double > & information,
+    pssm_lookahead_table::order_t & order,
+    pssm_lookahead_table::table_t & ordered,
+    pssm_lookahead_table::table_t & bound )
+{
+    const size_t size = information.size();
+    order.resize( size );
+    for( size_t j = 0; size != j; ++j )
+    {
+        order[ j ] = unsigned( j );
+    }
+    std::stable_sort( order.begin(), order.end(), more_informative( information ) );
+
+    ordered.resize( 4 * size );
+    bound.assign( size + 1, 0. );
+    for( size_t k = 0; size != k; ++k )
+    {
+        std::copy( &scores[ 4 * order[ k ] ], &scores[ 4 * order[ k ] ] + 4, &ordered[ 4 * k ] );
+    }
+    for( size_t k = size; 0 != k; --k )
+    {
+        bound[ k - 1 ] = bound[ k ] + *std::max_element( &ordered[ 4 * ( k - 1 ) ], &ordered[ 4 * k ] );
+    }
+}
+
+} //namespace detail
+
+
+pssm_lookahead_table::pssm_lookahead_table( const pssm_info::matrix_t & log_likelihoods, const nucleo_dist::vec & dists )
+{
+    table_t scores( 4 * log_likelihoods.size() );
+    for( size_t j = 0; log_likelihoods.size() != j; ++j )
+    {
+        for( unsigned b = 0; 4 != b; ++b )
+        {
+            scores[ 4 * j + b ] = log_likelihoods[ j ][ b ];
+        }
+    }
+    init( scores, dists );
+}
+
+
+pssm_lookahead_table::pssm_lookahead_table( const pssm & _pssm, const nucleo_dist::vec & dists )
+{
+    table_t scores( 4 * _pssm.size() );
+    for( size_t j = 0; _pssm.size() != j; ++j )
+    {
+        for( unsigned b = 0; 4 != b; ++b )
+        {
+            scores[ 4 * j + b ] = _pssm[ j ].get( b );
+        }
+    }
+    init( scores, dists );
+}
+
+
+void
+pssm_lookahead_table::init( const table_t & scores, const nucleo_dist::vec & dists )
+{
+    size = scores.size() / 4;
+
+    //the negative strand reads the reverse complement
+    table_t complement_scores( scores.size() );
+    for( size_t j = 0; size != j; ++j )
+    {
+        for( unsigned b = 0; 4 != b; ++b )
+        {
+            complement_scores[ 4 * j + b ] = scores[ 4 * ( size - 1 - j ) + complement_code( b ) ];
+        }
+    }
+    const std::vector< double > information = detail::column_information( dists, size );
+    const std::vector< double > complement_information( information.rbegin(), information.rend() );
+
+    detail::order_lookahead_scores( scores, information, positive_order, positive, positive_bound );
+    detail::order_lookahead_scores( complement_scores, complement_information, negative_order, negative, negative_bound );
+
+    //summing in a different order can change the last bits of the total
+    double magnitude = 1.;
+    for( size_t j = 0; size != j; ++j )
+    {
+        double column_magnitude = 0.;
+        for( unsigned b = 0; 4 != b; ++b )
+        {
+            column_magnitude = std::max( column_magnitude, std::fabs( scores[ 4 * j + b ] ) );
+        }
+        magnitude += column_magnitude;
+    }
+    slack = 1e-9 * magnitude;
+}
+
+
+} //namespace biopsy
@@ -0,0 +1,320 @@
+/**
+@file
+
+Copyright John Reid 2013
+
+*/
+
+#include "biopsy/remome_store.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+namespace biopsy {
+namespace remo {
+
+
+namespace detail {
+
+const char remome_store_magic[ 8 ] = { 'B', 'I', 'F', 'A', 'R', 'E', 'M', 'O' };
+const boost::uint32_t remome_store_version = 1;
+const boost::uint32_t remome_store_byte_order = 0x01020304;
+
+/** Reads a block of memory as a stream without copying it. */
+struct memory_streambuf
+    : std::streambuf
+{
+    memory_streambuf( const char * begin, size_t size )
+    {
+        char * b = const_cast< char * >( begin );
+        setg( b, b, b + size );
+    }
+};
+
+/** Orders indices by the keys they index. */
+struct key_less
+{
+    const string_vec & keys;
+
+    key_less( const string_vec & keys ) : keys( keys ) { }
+
+    bool operator()( size_t i, size_t j ) const
+    {
+        return keys[ i ] < keys[ j ];
+    }
+};
+
+} //namespace detail
+
+
+
+struct remome_store::header
+{
+    char magic[ 8 ];
+    boost::uint32_t version;
+    boost::uint32_t byte_order;
+    boost::uint64_t num_entries;
+    boost::uint64_t index_offset;  ///< Where the index starts.
+};
+
+struct remome_store::index_entry
+{
+    boost::uint64_t key_offset;    ///< Where the centre sequence id's characters start.
+    boost::uint64_t key_length;
+    boost::uint64_t record_offset; ///< Where the archive of the aligned sequences and remos starts.
+    boost::uint64_t record_length;
+};
+
+
+remome_store::remome_store( const std::string & path )
+    : _mapping( path.c_str(), boost::interprocess::read_only )
+    , _region( _mapping, boost::interprocess::read_only )
+    , _begin( static_cast< const char * >( _region.get_address() ) )
+{
+    const size_t file_size = _region.get_size();
+    if( file_size < sizeof( header ) )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( path << " is too small to be a remome store" ) );
+    }
+
+    const header & h = *reinterpret_cast< const header * >( _begin );
+    if( std::memcmp( h.magic, detail::remome_store_magic, sizeof( h.magic ) ) )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( path << " is not a remome store" ) );
+    }
+    if( detail::remome_store_version != h.version )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( path << " has unknown remome store version " << h.version ) );
+    }
+    if( detail::remome_store_byte_order != h.byte_order )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( path << " was written on a machine with a different byte order" ) );
+    }
+    if( h.index_offset > file_size || h.num_entries > ( file_size - h.index_offset ) / sizeof( index_entry ) )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( path << " has a truncated index" ) );
+    }
+
+    _index_begin = reinterpret_cast< const index_entry * >( _begin + h.index_offset );
+    _index_end = _index_begin + h.num_entries;
+    for( const index_entry * e = _index_begin; _index_end != e; ++e )
+    {
+        if( e->key_offset > file_size || e->key_length > file_size - e->key_offset
+            || e->record_offset > file_size || e->record_length > file_size - e->record_offset )
+        {
+            throw std::runtime_error( BIOPSY_MAKE_STRING( path << " has an index entry that points outside the file" ) );
+        }
+    }
+}
+
+
+size_t
+remome_store::size() const
+{
+    return _index_end - _index_begin;
+}
+
+
+std::string
+remome_store::get_key( const index_entry * e ) const
+{
+    return std::string( _begin + e->key_offset, size_t( e->key_length ) );
+}
+
+
+const remome_store::index_entry *
+remome_store::find( const std::string & key ) const
+{
+    //binary search the index, which is sorted by key
+    const index_entry * first = _index_begin;
+    size_t count = size();
+    while( count )
+    {
+        const size_t step = count / 2;
+        const index_entry * middle = first + step;
+        if( get_key( middle ) < key )
+        {
+            first = middle + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    if( _index_end == first || get_key( first ) != key )
+    {
+        return _index_end;
+    }
+    return first;
+}
+
+
+void
+remome_store::decode( const index_entry * e, remome::remo_map & remos ) const
+{
+    detail::memory_streambuf buffer( _begin + e->record_offset, size_t( e->record_length ) );
+    std::istream stream( &buffer );
+    remos.insert( deserialise_remos( stream ) );
+}
+
+
+string_vec_ptr
+remome_store::get_centre_sequence_ids() const
+{
+    string_vec_ptr result( new string_vec );
+    result->reserve( size() );
+    for( const index_entry * e = _index_begin; _index_end != e; ++e )
+    {
+        result->push_back( get_key( e ) );
+    }
+    return result;
+}
+
+
+remome::ptr
+remome_store::get_remome_for( alignment_sequence_id::ptr centre_sequence ) const
+{
+    remome::ptr result( new remome );
+    result->_remos.reset( new remome::remo_map );
+
+    const std::string key = centre_sequence->str();
+    for( const index_entry * e = find( key ); _index_end != e && get_key( e ) == key; ++e )
+    {
+        decode( e, *result->_remos );
+    }
+    return result;
+}
+
+
+remo_locator
+remome_store::get_remo_from_id( const std::string & id ) const
+{
+    alignment_sequence_id::ptr centre_sequence;
+    location l;
+    parse_remo_id( id, centre_sequence, l );
+
+    const remo_locator result = get_remome_for( centre_sequence )->get_index()->find( centre_sequence, l );
+    if( ! result.get< 0 >() )
+    {
+        throw std::logic_error( BIOPSY_MAKE_STRING( "Could not find remo for id: " << id ) );
+    }
+    return result;
+}
+
+
+remome::ptr
+remome_store::load() const
+{
+    remome::ptr result( new remome );
+    result->_remos.reset( new remome::remo_map );
+    for( const index_entry * e = _index_begin; _index_end != e; ++e )
+    {
+        decode( e, *result->_remos );
+    }
+    return result;
+}
+
+
+void
+remome_store::write( const std::string & path, const remome & r )
+{
+    const std::string tmp_path = path + ".tmp";
+    try
+    {
+        write_file( tmp_path, r );
+        boost::filesystem::rename( tmp_path, path );
+    }
+    catch( ... )
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove( tmp_path, ec );
+        throw;
+    }
+}
+
+
+void
+remome_store::write_file( const std::string & path, const remome & r )
+{
+    std::ofstream stream( path.c_str(), std::ios::binary | std::ios::trunc );
+    if( ! stream )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( "Could not open " << path << " to write remome store" ) );
+    }
+
+    //we fill the header in at the end
+    header h;
+    std::memset( &h, 0, sizeof( h ) );
+    stream.write( reinterpret_cast< const char * >( &h ), sizeof( h ) );
+
+    //the records, in the remome's order
+    std::vector< index_entry > index;
+    string_vec keys;
+    index.reserve( r._remos->size() );
+    keys.reserve( r._remos->size() );
+    BOOST_FOREACH( const remome::remo_map::value_type & v, *r._remos )
+    {
+        index_entry e;
+        e.record_offset = boost::uint64_t( stream.tellp() );
+        serialise_remos( stream, v.first, v.second );
+        e.record_length = boost::uint64_t( stream.tellp() ) - e.record_offset;
+        index.push_back( e );
+        keys.push_back( v.first->_centre_sequence->str() );
+    }
+
+    //the keys
+    for( size_t i = 0; index.size() != i; ++i )
+    {
+        index[ i ].key_offset = boost::uint64_t( stream.tellp() );
+        index[ i ].key_length = keys[ i ].size();
+        stream.write( keys[ i ].data(), keys[ i ].size() );
+    }
+
+    //the index, sorted by key and otherwise in the remome's order
+    std::vector< size_t > order( index.size() );
+    for( size_t i = 0; order.size() != i; ++i )
+    {
+        order[ i ] = i;
+    }
+    std::stable_sort( order.begin(), order.end(), detail::key_less( keys ) );
+    std::vector< index_entry > sorted_index;
+    sorted_index.reserve( index.size() );
+    BOOST_FOREACH( size_t i, order )
+    {
+        sorted_index.push_back( index[ i ] );
+    }
+
+    //aligned so it can be read in place
+    while( boost::uint64_t( stream.tellp() ) % sizeof( boost::uint64_t ) )
+    {
+        stream.put( 0 );
+    }
+    h.index_offset = boost::uint64_t( stream.tellp() );
+    if( ! sorted_index.empty() )
+    {
+        stream.write( reinterpret_cast< const char * >( &sorted_index[ 0 ] ), sizeof( index_entry ) * sorted_index.size() );
+    }
+
+    std::memcpy( h.magic, detail::remome_store_magic, sizeof( h.magic ) );
+    h.version = detail::remome_store_version;
+    h.byte_order = detail::remome_store_byte_order;
+    h.num_entries = sorted_index.size();
+    stream.seekp( 0 );
+    stream.write( reinterpret_cast< const char * >( &h ), sizeof( h ) );
+    stream.close();
+
+    if( ! stream )
+    {
+        throw std::runtime_error( BIOPSY_MAKE_STRING( "Could not write remome store to " << path ) );
+    }
+}
+
+
+} //namespace remo
+} //namespace biopsy
@@ -0,0 +1,162 @@
+/**
+@file
+
+Copyright John Reid 2013
+
+*/
+
+#include "biopsy/stream_scan.h"
+#include "biopsy/pssm.h"
+
+#include "bio/fasta.h"
+
+#include <boost/filesystem/fstream.hpp>
+
+namespace biopsy {
+
+
+stream_scan_stats::stream_scan_stats()
+	: num_sequences( 0 )
+	, num_bases( 0 )
+	, num_batches( 0 )
+	, num_hits( 0 )
+{
+}
+
+
+namespace detail {
+
+/**
+Scores each chunk of a fasta stream together with the tail of the previous chunk.
+*/
+struct stream_scanner
+	: BIO_NS::FastaChunkHandler
+{
+	const string_vec_ptr & pssm_names;
+	const binding_hit_sink & sink;
+	double threshold;
+	size_t overlap;            ///< The number of bases we keep from one batch to the next.
+	stream_scan_stats & stats;
+
+	std::string id;            ///< The current sequence.
+	sequence buffer;           ///< The bases we are scoring: the kept bases then the new chunk.
+	size_t buffer_start;       ///< The position of the buffer in the current sequence.
+	size_t num_kept;           ///< The number of bases at the start of the buffer that were in the last batch.
+
+	stream_scanner(
+		const string_vec_ptr & pssm_names,
+		const binding_hit_sink & sink,
+		double threshold,
+		size_t batch_size,
+		stream_scan_stats & stats )
+		: pssm_names( pssm_names )
+		, sink( sink )
+		, threshold( threshold )
+		, overlap( 0 )
+		, stats( stats )
+		, buffer_start( 0 )
+		, num_kept( 0 )
+	{
+		BOOST_FOREACH( const std::string & name, *pssm_names )
+		{
+			const pssm_info & info = get_pssm( name );
+			const size_t length = info._pssm ? info._pssm->size() : info._counts.size();
+			if( length > overlap + 1 )
+			{
+				overlap = length - 1;
+			}
+		}
+		buffer.reserve( overlap + batch_size );
+	}
+
+	void begin_sequence( const std::string & sequence_id )
+	{
+		id = sequence_id;
+		buffer.clear();
+		buffer_start = 0;
+		num_kept = 0;
+		++stats.num_sequences;
+	}
+
+	void handle_chunk( const BIO_NS::seq_t & chunk )
+	{
+		buffer.append( chunk );
+		stats.num_bases += chunk.size();
+		++stats.num_batches;
+
+		const binding_hit::vec_ptr hits = score_pssms_on_sequence( pssm_names, buffer, threshold );
+		BOOST_FOREACH( binding_hit & hit, *hits )
+		{
+			//windows entirely in the kept bases were scored with the last batch
+			if( size_t( hit._location._position + hit._location._length ) <= num_kept )
+			{
+				continue;
+			}
+			hit._location._position += int( buffer_start );
+			sink( id, hit );
+			++stats.num_hits;
+		}
+
+		//keep the bases that a window starting in this batch may extend over
+		const size_t keep = std::min( overlap, buffer.size() );
+		buffer_start += buffer.size() - keep;
+		buffer.erase( 0, buffer.size() - keep );
+		num_kept = keep;
+	}
+
+	void end_sequence()
+	{
+	}
+};
+
+} //namespace detail
+
+
+stream_scan_stats
+score_pssms_on_fasta_stream(
+	const string_vec_ptr & pssm_names,
+	std::istream & stream,
+	const binding_hit_sink & sink,
+	double threshold,
+	size_t batch_size )
+{
+	if( 0 == batch_size )
+	{
+		throw std::invalid_argument( "Batch size must be positive" );
+	}
+
+	stream_scan_stats stats;
+	detail::stream_scanner scanner( pssm_names, sink, threshold, batch_size, stats );
+	BIO_NS::parse_fasta_in_chunks( stream, scanner, batch_size );
+	return stats;
+}
+
+
+stream_scan_stats
+score_pssms_on_chromosomes(
+	const string_vec_ptr & pssm_names,
+	const BIO_NS::ChromosomesFileSet & chromosomes,
+	const binding_hit_sink & sink,
+	double threshold,
+	size_t batch_size )
+{
+	stream_scan_stats result;
+	BOOST_FOREACH( const boost::filesystem::path & file, chromosomes.files )
+	{
+		boost::filesystem::ifstream stream( file );
+		if( ! stream )
+		{
+			throw std::logic_error( BIOPSY_MAKE_STRING( "Could not open " << file._BOOST_FS_NATIVE() ) );
+		}
+
+		const stream_scan_stats stats = score_pssms_on_fasta_stream( pssm_names, stream, sink, threshold, batch_size );
+		result.num_sequences += stats.num_sequences;
+		result.num_bases += stats.num_bases;
+		result.num_batches += stats.num_batches;
+		result.num_hits += stats.num_hits;
+	}
+	return result;
+}
+
+
+} //namespace biopsy
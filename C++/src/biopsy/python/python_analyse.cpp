@@ -8,10 +8,13 @@ Copyright John Reid 2006-2010
 #include <boost/python.hpp>
 #include "biopsy/python.h"
 #include "biopsy/analyse.h"
+#include "biopsy/pssm.h"
 #include "biopsy/convert_hit_to_bio.h"
 
 #include <bio/svg_match.h>
 
+#include <boost/python/stl_iterator.hpp>
+
 
 
 using namespace boost;
@@ -48,6 +51,156 @@ build_analysis_svg(
 }
 
 
+boost::python::tuple
+analyse_max_chain_within_budget_py(
+    binding_hits_vec_ptr hit_array,
+    unsigned max_box_limit,
+    double max_seconds,
+    bool use_flat_range_tree
+)
+{
+    BIO_NS::max_chain_stats stats;
+    binding_hit::vec_ptr mc;
+    {
+        release_gil no_gil;
+        mc = analyse_max_chain_within_budget( hit_array, max_box_limit, max_seconds, stats, use_flat_range_tree );
+    }
+    return boost::python::make_tuple( mc, stats );
+}
+
+
+//
+// Wrappers that release the GIL while the C++ works.
+//
+binding_hit::vec_ptr
+analyse_py( const sequence & seq, double threshold )
+{
+    release_gil no_gil;
+    return analyse( seq, threshold );
+}
+
+binding_hit::vec_ptr
+analyse_phylo_py( const sequence & main_seq, const sequence_vec & phylo_seqs, double threshold )
+{
+    release_gil no_gil;
+    return analyse_phylo( main_seq, phylo_seqs, threshold );
+}
+
+binding_hit::vec_ptr
+analyse_max_chain_py( binding_hits_vec_ptr hit_array, unsigned max_box_limit, bool use_flat_range_tree )
+{
+    release_gil no_gil;
+    return analyse_max_chain( hit_array, max_box_limit, use_flat_range_tree );
+}
+
+/** A copy of the scoring context or of the current pssm parameters if it is None. Taken while we hold the GIL. */
+scoring_context
+extract_scoring_context( boost::python::object context )
+{
+    if( Py_None == context.ptr() ) {
+        return scoring_context::current();
+    }
+    return boost::python::extract< scoring_context >( context );
+}
+
+double
+score_pssm_on_sequence_py( const std::string & pssm_name, const sequence & seq, double threshold, binding_hit::vec_ptr result, boost::python::object context )
+{
+    const scoring_context c = extract_scoring_context( context );
+    release_gil no_gil;
+    return score_pssm_on_sequence( pssm_name, seq, threshold, result, c );
+}
+
+binding_hit::vec_ptr
+score_pssms_on_sequence_py( const string_vec_ptr & pssm_names, const sequence & seq, double threshold, boost::python::object context )
+{
+    const scoring_context c = extract_scoring_context( context );
+    release_gil no_gil;
+    return score_pssms_on_sequence( pssm_names, seq, threshold, c );
+}
+
+binding_hit::vec_ptr
+biobase_score_pssms_on_sequence_py( const string_vec_ptr & pssm_names, const sequence & seq, double threshold, boost::python::object context )
+{
+    const scoring_context c = extract_scoring_context( context );
+    release_gil no_gil;
+    return biobase_score_pssms_on_sequence( pssm_names, seq, threshold, c );
+}
+
+phylo_sequences_result
+score_pssms_on_phylo_sequences_py(
+    string_vec_ptr pssm_names,
+    sequence_vec_ptr sequences,
+    double threshold,
+    double phylo_threshold,
+    bool calculate_maximal_chain,
+    boost::python::object context
+)
+{
+    const scoring_context c = extract_scoring_context( context );
+    release_gil no_gil;
+    return score_pssms_on_phylo_sequences( pssm_names, sequences, threshold, phylo_threshold, calculate_maximal_chain, c );
+}
+
+
+/** Copy the sequences out of any iterable of sequences. */
+sequence_vec_ptr
+extract_sequences( boost::python::object sequences )
+{
+    sequence_vec_ptr result( new sequence_vec );
+    result->insert(
+        result->end(),
+        boost::python::stl_input_iterator< sequence >( sequences ),
+        boost::python::stl_input_iterator< sequence >() );
+    return result;
+}
+
+binding_hits_vec_ptr
+score_pssms_on_sequences_py(
+    const string_vec_ptr & pssm_names,
+    boost::python::object sequences,
+    double threshold,
+    unsigned num_threads,
+    boost::python::object context
+)
+{
+    sequence_vec_ptr seqs = extract_sequences( sequences );
+    const scoring_context c = extract_scoring_context( context );
+    release_gil no_gil;
+    return score_pssms_on_sequences( pssm_names, *seqs, threshold, num_threads, c );
+}
+
+boost::python::list
+score_pssms_on_phylo_sequence_sets_py(
+    string_vec_ptr pssm_names,
+    boost::python::object sequence_sets,
+    double threshold,
+    double phylo_threshold,
+    bool calculate_maximal_chain,
+    unsigned num_threads,
+    boost::python::object context
+)
+{
+    std::vector< sequence_vec_ptr > sets;
+    for( boost::python::stl_input_iterator< boost::python::object > s( sequence_sets ), end; end != s; ++s ) {
+        sets.push_back( extract_sequences( *s ) );
+    }
+    const scoring_context c = extract_scoring_context( context );
+
+    phylo_sequences_result_vec_ptr results;
+    {
+        release_gil no_gil;
+        results = score_pssms_on_phylo_sequence_sets( pssm_names, sets, threshold, phylo_threshold, calculate_maximal_chain, num_threads, c );
+    }
+
+    boost::python::list result;
+    BOOST_FOREACH( const phylo_sequences_result & r, *results ) {
+        result.append( r );
+    }
+    return result;
+}
+
+
 void export_analyse()
 {
     using boost::python::arg;
@@ -71,13 +224,13 @@ void export_analyse()
 
     def(
         "analyse",
-        analyse,
+        analyse_py,
         ( arg( "sequence" ), arg( "threshold" ) = BIOPSY_ANALYSE_THRESHOLD_DEFAULT ),
         "Analyses a sequence" );
 
     def(
         "analyse_phylo",
-        analyse_phylo,
+        analyse_phylo_py,
         (
             arg( "centre_sequence" ),
             arg( "phylo_sequences" ),
@@ -86,39 +239,77 @@ void export_analyse()
 
     def(
         "analyse_max_chain",
-        analyse_max_chain,
+        analyse_max_chain_py,
         (
             arg( "hit_array" ),
-            arg( "max_box_limit" ) = 50000 ),
+            arg( "max_box_limit" ) = 50000,
+            arg( "use_flat_range_tree" ) = true ),
         "Calculates the maximal chain across the hit vectors." );
 
+    class_< BIO_NS::max_chain_stats >( "MaxChainStats", "What a run of the maximal chain algorithm within a budget did." )
+        .def_readonly( "num_sequences", &BIO_NS::max_chain_stats::num_sequences )
+        .def_readonly( "num_characters", &BIO_NS::max_chain_stats::num_characters, "Binders with hits in every sequence." )
+        .def_readonly( "num_values", &BIO_NS::max_chain_stats::num_values, "Hits of those binders." )
+        .def_readonly( "num_possible_boxes", &BIO_NS::max_chain_stats::num_possible_boxes, "Boxes without pruning." )
+        .def_readonly( "num_runs", &BIO_NS::max_chain_stats::num_runs, "How many times the algorithm was run with more boxes." )
+        .def_readonly( "num_values_used", &BIO_NS::max_chain_stats::num_values_used, "Hits left after pruning in the run that found the chain." )
+        .def_readonly( "num_boxes_used", &BIO_NS::max_chain_stats::num_boxes_used, "Boxes in the run that found the chain." )
+        .def_readonly( "pruned", &BIO_NS::max_chain_stats::pruned, "Were any boxes pruned in the run that found the chain?" )
+        .def_readonly( "seconds", &BIO_NS::max_chain_stats::seconds, "Wall-clock time taken." )
+        ;
+
+    def(
+        "analyse_max_chain_within_budget",
+        analyse_max_chain_within_budget_py,
+        (
+            arg( "hit_array" ),
+            arg( "max_box_limit" ) = 50000,
+            arg( "max_seconds" ) = 0.,
+            arg( "use_flat_range_tree" ) = true ),
+        "Calculates the best maximal chain across the hit vectors within a budget of boxes and seconds. Returns: (max_chain, stats)." );
+
     def(
         "score_pssm_on_sequence",
-        score_pssm_on_sequence,
+        score_pssm_on_sequence_py,
         (
             arg( "pssm_name" ),
             arg( "sequence" ),
             arg( "threshold" ) = BIOPSY_ANALYSE_THRESHOLD_DEFAULT,
-            arg( "result" ) ),
-        "Scores a pssm on a sequence. Returns estimate that pssm binds there." );
+            arg( "result" ),
+            arg( "context" ) = object() ),
+        "Scores a pssm on a sequence under the ScoringContext (the PssmParameters if None). Returns estimate that pssm binds there." );
 
     def(
         "score_pssms_on_sequence",
-        score_pssms_on_sequence,
+        score_pssms_on_sequence_py,
         (
             arg( "pssm_names" ),
             arg( "sequence" ),
-            arg( "threshold" ) = BIOPSY_ANALYSE_THRESHOLD_DEFAULT ),
-        "Scores a pssm on a sequence. Returns hit results." );
+            arg( "threshold" ) = BIOPSY_ANALYSE_THRESHOLD_DEFAULT,
+            arg( "context" ) = object() ),
+        "Scores a pssm on a sequence under the ScoringContext (the PssmParameters if None). Returns hit results." );
+
+    def(
+        "score_pssms_on_sequences",
+        score_pssms_on_sequences_py,
+        (
+            arg( "pssm_names" ),
+            arg( "sequences" ),
+            arg( "threshold" ) = BIOPSY_ANALYSE_THRESHOLD_DEFAULT,
+            arg( "num_threads" ) = 0,
+            arg( "context" ) = object() ),
+        "Scores the pssms on each of the sequences on num_threads threads (0 for one per core) under the ScoringContext (the PssmParameters if None). "
+        "Returns the hit results for each sequence." );
 
     def(
         "biobase_score_pssms_on_sequence",
-        biobase_score_pssms_on_sequence,
+        biobase_score_pssms_on_sequence_py,
         (
             arg( "pssm_names" ),
             arg( "sequence" ),
-            arg( "threshold" ) = BIOPSY_BIOBASE_SCORE_THRESHOLD_DEFAULT ),
-        "Biobase scores for a pssm on a sequence. Returns hit results." );
+            arg( "threshold" ) = BIOPSY_BIOBASE_SCORE_THRESHOLD_DEFAULT,
+            arg( "context" ) = object() ),
+        "Biobase scores for a pssm on a sequence under the ScoringContext (the PssmParameters if None). Returns hit results." );
 
     def(
         "get_pathway_for_pssm",
@@ -129,15 +320,32 @@ void export_analyse()
 
     def(
         "score_pssms_on_phylo_sequences",
-        score_pssms_on_phylo_sequences,
+        score_pssms_on_phylo_sequences_py,
         (
             arg( "pssm_names" ),
             arg( "sequences" ),
             arg( "threshold" ) = BIOPSY_ANALYSE_THRESHOLD_DEFAULT,
             arg( "phylo_threshold" ) = BIOPSY_ANALYSE_THRESHOLD_DEFAULT,
-            arg( "calculate_maximal_chain" ) = true
+            arg( "calculate_maximal_chain" ) = true,
+            arg( "context" ) = object()
+        ),
+        "Scores a pssm on sequences under the ScoringContext (the PssmParameters if None). Centre sequence is the first one. "
+        "Returns: (hits, max_chain, unadjusted_hits)." );
+
+    def(
+        "score_pssms_on_phylo_sequence_sets",
+        score_pssms_on_phylo_sequence_sets_py,
+        (
+            arg( "pssm_names" ),
+            arg( "sequence_sets" ),
+            arg( "threshold" ) = BIOPSY_ANALYSE_THRESHOLD_DEFAULT,
+            arg( "phylo_threshold" ) = BIOPSY_ANALYSE_THRESHOLD_DEFAULT,
+            arg( "calculate_maximal_chain" ) = true,
+            arg( "num_threads" ) = 0,
+            arg( "context" ) = object()
         ),
-        "Scores a pssm on sequences. Centre sequence is the first one. Returns: (hits, max_chain, unadjusted_hits)." );
+        "Scores the pssms on each set of sequences on num_threads threads (0 for one per core) as score_pssms_on_phylo_sequences does. "
+        "Returns a list of (hits, max_chain, unadjusted_hits) for each set." );
 
     to_python_converter< phylo_sequences_result, tupleconverter< phylo_sequences_result > >();
 
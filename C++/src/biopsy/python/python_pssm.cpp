@@ -35,6 +35,16 @@ struct value_traits<biopsy::pssm_ptr> : value_traits< int >
 
 namespace biopsy {
 
+namespace detail {
+
+boost::shared_ptr< scoring_context >
+current_scoring_context()
+{
+	return boost::shared_ptr< scoring_context >( new scoring_context( scoring_context::current() ) );
+}
+
+} //namespace detail
+
 
 void export_pssm()
 {
@@ -59,7 +69,8 @@ void export_pssm()
 	def( "get_likelihood", get_likelihood );
 	def( "get_odds_ratio", get_odds_ratio );
 	def( "get_p_binding", get_p_binding );
-	def( "get_p_binding_from_score", get_p_binding_from_score );
+	def( "get_p_binding_from_score", ( double ( * )( const pssm_info &, double ) ) get_p_binding_from_score );
+	def( "get_p_binding_from_score", ( double ( * )( const pssm_info &, double, const scoring_context & ) ) get_p_binding_from_score );
 	def( "get_p_binding_using_p_value", get_p_binding_using_p_value );
 	def( "get_odds_ratio_from_p_binding", get_odds_ratio_from_p_binding );
 
@@ -99,7 +110,13 @@ void export_pssm()
 	def( "calculate_likelihoods_under_background", calculate_likelihoods_under_background );
 	def( "add_pssm_to_cache", add_pssm_to_cache );
 	def( "save_pssm_cache_state", save_pssm_cache_state );
+	def( "save_pssm_cache_binary_state", save_pssm_cache_binary_state );
 	def( "clear_pssm_cache", clear_pssm_cache );
+	def(
+		"precompute_pssm_cache",
+		precompute_pssm_cache,
+		( arg( "ids" ), arg( "num_threads" ) = 0 ),
+		"Builds the PSSMs not already in the cache in parallel and journals them. Returns how many were built." );
 	def( "get_pssm", get_pssm, return_value_policy< return_by_value >() );
 	def( "get_pssm_name", get_pssm_name );
 	def( "get_pssm_url", get_pssm_url );
@@ -116,6 +133,39 @@ void export_pssm()
 		ADD_STATIC_PROPERTY(pssm_parameters,avg_phylo_bayes)
 		ADD_STATIC_PROPERTY(pssm_parameters,max_chain_num_boxes_limit)
 		ADD_STATIC_PROPERTY(pssm_parameters,min_related_evidence_fraction)
+		ADD_STATIC_PROPERTY(pssm_parameters,use_vectorised_scan)
+		ADD_STATIC_PROPERTY(pssm_parameters,num_threads)
+		ADD_STATIC_PROPERTY(pssm_parameters,use_lookahead)
+		ADD_STATIC_PROPERTY(pssm_parameters,use_likelihoods_lattice)
+		ADD_STATIC_PROPERTY(pssm_parameters,likelihoods_lattice_size)
+		ADD_STATIC_PROPERTY(pssm_parameters,max_chain_flat_range_tree)
+		ADD_STATIC_PROPERTY(pssm_parameters,max_chain_use_budget)
+		ADD_STATIC_PROPERTY(pssm_parameters,max_chain_max_seconds)
+		;
+
+	/**
+	The settings scoring depends on. Pass one to the scoring functions to score with settings of their own
+	rather than the PssmParameters. The functions copy it so changing it does not affect calls already running.
+	*/
+	class_< scoring_context >(
+		"ScoringContext",
+		"The settings scoring depends on. Created as a copy of the current PssmParameters.",
+		no_init
+	)
+		.def( "__init__", make_constructor( detail::current_scoring_context ) )
+		.def_readwrite( "binding_background_odds_prior", &scoring_context::binding_background_odds_prior )
+		.def_readwrite( "use_cumulative_dists", &scoring_context::use_cumulative_dists )
+		.def_readwrite( "use_p_value", &scoring_context::use_p_value )
+		.def_readwrite( "use_score", &scoring_context::use_score )
+		.def_readwrite( "avg_phylo_bayes", &scoring_context::avg_phylo_bayes )
+		.def_readwrite( "min_related_evidence_fraction", &scoring_context::min_related_evidence_fraction )
+		.def_readwrite( "use_vectorised_scan", &scoring_context::use_vectorised_scan )
+		.def_readwrite( "use_lookahead", &scoring_context::use_lookahead )
+		.def_readwrite( "num_threads", &scoring_context::num_threads )
+		.def_readwrite( "max_chain_num_boxes_limit", &scoring_context::max_chain_num_boxes_limit )
+		.def_readwrite( "max_chain_flat_range_tree", &scoring_context::max_chain_flat_range_tree )
+		.def_readwrite( "max_chain_use_budget", &scoring_context::max_chain_use_budget )
+		.def_readwrite( "max_chain_max_seconds", &scoring_context::max_chain_max_seconds )
 		;
 
 
@@ -7,6 +7,7 @@ Copyright John Reid 2006
 
 #include "biopsy/python.h"
 #include "biopsy/remo.h"
+#include "biopsy/remome_store.h"
 
 
 
@@ -20,6 +21,29 @@ using namespace std;
 namespace biopsy {
 
 
+list
+remo_locators_to_list( remo::remo_locator_list_ptr locators )
+{
+	list result;
+	BOOST_FOREACH( const remo::remo_locator & locator, *locators )
+	{
+		result.append( locator );
+	}
+	return result;
+}
+
+list
+get_remos_for_gene( remo::remome::ptr _remome, const remo::ensembl_id & gene )
+{
+	return remo_locators_to_list( remo::get_remos_for_gene( _remome, gene ) );
+}
+
+list
+get_remos_overlapping( remo::remome::ptr _remome, remo::alignment_sequence_id::ptr centre_sequence, const remo::location & interval )
+{
+	return remo_locators_to_list( remo::get_remos_overlapping( _remome, centre_sequence, interval ) );
+}
+
 
 void export_remo()
 {
@@ -272,6 +296,34 @@ void export_remo()
 			"get_remo_from_id",
 			get_remo_from_id,
 			"Get the remo from the id" )
+		.def(
+			"get_remos_for_gene",
+			biopsy::get_remos_for_gene,
+			"Get the (remo, aligned sequences) tuples for the remos with a sequence from the gene" )
+		.def(
+			"get_remos_overlapping",
+			biopsy::get_remos_overlapping,
+			"Get the (remo, aligned sequences) tuples for the remos whose locations in the centre sequence overlap the interval" )
+		;
+
+	class_<
+		remome_store,
+		remome_store::ptr,
+		noncopyable
+	>(
+		"Store",
+		"A memory-mapped remome file that only decodes the aligned sequences and remos that are asked for",
+		init< std::string >( "Map the remome store file" ) )
+		.def( "__len__", &remome_store::size )
+		.def( "get_centre_sequence_ids", &remome_store::get_centre_sequence_ids )
+		.def(
+			"get_remome_for",
+			&remome_store::get_remome_for,
+			"Get a remome of the aligned sequences in the store with the centre sequence" )
+		.def( "get_remo_from_id", &remome_store::get_remo_from_id, "Get the remo from the id" )
+		.def( "load", &remome_store::load, "Decode the whole remome" )
+		.def( "write", &remome_store::write, "Write a remome to a store file" )
+		.staticmethod( "write" )
 		;
 
 	to_python_converter< remo_locator, tupleconverter< remo_locator > >();
@@ -0,0 +1,95 @@
+/**
+ * Copyright John Reid 2013
+ *
+ * @file Micro-benchmark of the vectorised PSSM scanning kernel and the lookahead against the scalar paths.
+ */
+
+#include <biopsy/init.h>
+#include <biopsy/analyse.h>
+#include <biopsy/pssm.h>
+#include <biopsy/pssm_scan.h>
+#include <biopsy/sequence.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <iostream>
+
+
+namespace {
+
+using namespace biopsy;
+
+/** Score the PSSMs on the sequence and report how long it took. */
+binding_hit::vec_ptr
+time_scan(
+    const char * label,
+    const string_vec_ptr & pssm_names,
+    const sequence & seq,
+    bool use_vectorised_scan,
+    bool use_lookahead = false
+) {
+    namespace pt = boost::posix_time;
+    pssm_parameters::singleton().use_vectorised_scan = use_vectorised_scan;
+    pssm_parameters::singleton().use_lookahead = use_lookahead;
+    const pt::ptime start = pt::microsec_clock::universal_time();
+    binding_hit::vec_ptr hits = score_pssms_on_sequence( pssm_names, seq );
+    const pt::time_duration elapsed = pt::microsec_clock::universal_time() - start;
+    std::cout
+        << label << ": " << elapsed.total_milliseconds() << " ms, "
+        << hits->size() << " hits\n";
+    return hits;
+}
+
+/** Check the hits are identical. */
+void
+check_same_hits( const char * what, const binding_hit::vec_ptr & expected, const binding_hit::vec_ptr & actual ) {
+    if( expected->size() != actual->size() ) {
+        throw std::logic_error( BIOPSY_MAKE_STRING( what << " found a different number of hits." ) );
+    }
+    for( size_t i = 0; expected->size() != i; ++i ) {
+        const binding_hit & e = ( *expected )[ i ];
+        const binding_hit & a = ( *actual )[ i ];
+        if( e != a || e._p_binding != a._p_binding ) {
+            throw std::logic_error( BIOPSY_MAKE_STRING( what << " hit differs: " << e << " != " << a ) );
+        }
+    }
+}
+
+} //namespace
+
+
+int
+main( int argc, char * argv [] ) {
+    using namespace biopsy;
+
+    init();
+    pssm_parameters::singleton().use_score = false;
+
+    string_vec_ptr pssm_names( new string_vec );
+    pssm_names->push_back( "M00023" );
+    pssm_names->push_back( "M00436" );
+    pssm_names->push_back( "M00716" );
+    pssm_names->push_back( "M00803" );
+    pssm_names->push_back( "M00938" );
+    pssm_names->push_back( "R04653" );
+
+    // make sure the PSSMs are built before we time anything
+    BOOST_FOREACH( const std::string & pssm_name, *pssm_names ) {
+        get_pssm( pssm_name ).get_log_likelihoods();
+    }
+
+    const sequence seq = generate_random_sequence( 1000000, 1 );
+    std::cout
+        << "Scanning " << pssm_names->size() << " PSSMs over " << seq.size() << " bases using the "
+        << pssm_scan_kernel_name( best_pssm_scan_kernel() ) << " kernel.\n";
+
+    const binding_hit::vec_ptr scalar_hits = time_scan( "scalar", pssm_names, seq, false );
+    check_same_hits( "Vectorised kernel", scalar_hits, time_scan( "vectorised", pssm_names, seq, true ) );
+    check_same_hits( "Lookahead", scalar_hits, time_scan( "scalar with lookahead", pssm_names, seq, false, true ) );
+
+    pssm_parameters::singleton().use_score = true;
+    const binding_hit::vec_ptr score_hits = time_scan( "score", pssm_names, seq, false );
+    check_same_hits( "Lookahead on score", score_hits, time_scan( "score with lookahead", pssm_names, seq, false, true ) );
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright John Reid 2013
+ *
+ * @file Code to test that scoring on several threads before the TRANSFAC tables are loaded gives the same hits as scoring on one.
+ */
+
+#define BOOST_TEST_MODULE cold_db_scan
+#include <boost/test/unit_test.hpp>
+
+#include <biopsy/init.h>
+#include <biopsy/analyse.h>
+#include <biopsy/pssm.h>
+#include <bio/parallel.h>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+
+/** Looks up the name of each PSSM, which needs the TRANSFAC tables. */
+struct get_names
+{
+    const biopsy::string_vec & ids;
+    biopsy::string_vec & names;
+
+    get_names( const biopsy::string_vec & ids, biopsy::string_vec & names ) : ids( ids ), names( names ) { }
+
+    void operator()( size_t i ) const
+    {
+        names[ i ] = biopsy::get_pssm_name( ids[ i ] );
+    }
+};
+
+} //namespace
+
+
+BOOST_AUTO_TEST_CASE( test_cold_db_scan )
+{
+    using namespace biopsy;
+
+    init();
+
+    // matrices and sites so that both tables are loaded by whichever worker needs them first
+    const string_vec_ptr pssm_names( new string_vec );
+    for( unsigned i = 1; 21 != i; ++i )
+    {
+        pssm_names->push_back( BIOPSY_MAKE_STRING( "M" << std::setw( 5 ) << std::setfill( '0' ) << i ) );
+        if( 0 == i % 2 )
+        {
+            pssm_names->push_back( BIOPSY_MAKE_STRING( "R" << std::setw( 5 ) << std::setfill( '0' ) << i ) );
+        }
+    }
+
+    boost::variate_generator< boost::mt19937, boost::uniform_int<> > base( boost::mt19937( 5 ), boost::uniform_int<>( 0, 3 ) );
+    sequence_vec sequences( 16 );
+    BOOST_FOREACH( sequence & seq, sequences )
+    {
+        for( unsigned i = 0; 300 != i; ++i )
+        {
+            seq.push_back( "acgt"[ base() ] );
+        }
+    }
+
+    // this is the first use of the tables in this process
+    const unsigned num_threads = 8;
+    const binding_hits_vec_ptr threaded = score_pssms_on_sequences( pssm_names, sequences, .05, num_threads );
+    string_vec threaded_names( pssm_names->size() );
+    BIO_NS::parallel_for( pssm_names->size(), num_threads, get_names( *pssm_names, threaded_names ) );
+
+    const binding_hits_vec_ptr serial = score_pssms_on_sequences( pssm_names, sequences, .05, 1 );
+    BOOST_REQUIRE_EQUAL( serial->size(), threaded->size() );
+    size_t num_hits = 0;
+    for( size_t i = 0; serial->size() != i; ++i )
+    {
+        binding_hit::vec expected( ( *serial )[ i ]->begin(), ( *serial )[ i ]->end() );
+        binding_hit::vec hits( ( *threaded )[ i ]->begin(), ( *threaded )[ i ]->end() );
+        std::sort( expected.begin(), expected.end() );
+        std::sort( hits.begin(), hits.end() );
+        BOOST_CHECK( expected == hits );
+        num_hits += hits.size();
+    }
+    BOOST_CHECK( 0 != num_hits );
+
+    for( size_t i = 0; pssm_names->size() != i; ++i )
+    {
+        BOOST_CHECK_EQUAL( get_pssm_name( ( *pssm_names )[ i ] ), threaded_names[ i ] );
+    }
+}
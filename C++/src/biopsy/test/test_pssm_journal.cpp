@@ -0,0 +1,118 @@
+/**
+ * Copyright John Reid 2013
+ *
+ * @file Code to test that the PSSM journal round trips and recovers from a torn record.
+ */
+
+#define BOOST_TEST_MODULE pssm_journal
+#include <boost/test/unit_test.hpp>
+
+#include <biopsy/pssm.h>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <fstream>
+
+namespace {
+
+biopsy::pssm_info
+make_info( double skew )
+{
+    using namespace biopsy;
+
+    nucleo_dist::vec counts;
+    counts.push_back( nucleo_dist( 10, 0, skew, 0 ) );
+    counts.push_back( nucleo_dist( 0, 8, 2, skew ) );
+    counts.push_back( nucleo_dist( skew, 3, 3, 3 ) );
+    const nucleo_dist::vec dists = counts + .25;
+    const pssm_ptr _pssm = create_pssm( dists );
+    return pssm_info(
+        counts,
+        .25,
+        11,
+        _pssm,
+        calculate_likelihoods_under_pssm( _pssm, dists ),
+        calculate_likelihoods_under_background( _pssm ) );
+}
+
+void
+check_entry( const biopsy::pssm_journal_entries::value_type & entry, const std::string & name, const biopsy::pssm_info & info )
+{
+    BOOST_CHECK_EQUAL( name, entry.first );
+    BOOST_CHECK_EQUAL( info._number_of_sites, entry.second._number_of_sites );
+    BOOST_CHECK_EQUAL( info._pseudo_count, entry.second._pseudo_count );
+    BOOST_REQUIRE_EQUAL( info._counts.size(), entry.second._counts.size() );
+    for( unsigned i = 0; info._counts.size() != i; ++i )
+    {
+        for( unsigned b = 0; 4 != b; ++b )
+        {
+            BOOST_CHECK_EQUAL( info._counts[ i ].get( b ), entry.second._counts[ i ].get( b ) );
+        }
+    }
+}
+
+} //namespace
+
+
+BOOST_AUTO_TEST_CASE( test_journal_torn_tail )
+{
+    using namespace biopsy;
+    namespace fs = boost::filesystem;
+
+    const fs::path journal = fs::temp_directory_path() / fs::unique_path( "pssm-journal-%%%%-%%%%.txt" );
+    const std::string journal_file = journal.string();
+
+    const pssm_info info1 = make_info( 1. );
+    const pssm_info info2 = make_info( 2. );
+    const pssm_info info3 = make_info( 3. );
+
+    // a missing journal has no entries
+    {
+        pssm_journal_entries entries;
+        BOOST_CHECK_EQUAL( 0u, read_pssm_journal( journal_file, entries ) );
+        BOOST_CHECK( entries.empty() );
+    }
+
+    // complete records round trip in order
+    append_to_pssm_journal( journal_file, "R00001", info1 );
+    append_to_pssm_journal( journal_file, "R00002", info2 );
+    const boost::uintmax_t good_size = fs::file_size( journal );
+    {
+        pssm_journal_entries entries;
+        BOOST_REQUIRE_EQUAL( 2u, read_pssm_journal( journal_file, entries ) );
+        check_entry( entries[ 0 ], "R00001", info1 );
+        check_entry( entries[ 1 ], "R00002", info2 );
+        BOOST_CHECK_EQUAL( good_size, fs::file_size( journal ) );
+    }
+
+    // tear a record as an interrupted run would: write all but the end of it
+    append_to_pssm_journal( journal_file, "R00003", info3 );
+    fs::resize_file( journal, ( good_size + fs::file_size( journal ) ) / 2 );
+    {
+        pssm_journal_entries entries;
+        BOOST_CHECK_EQUAL( 2u, read_pssm_journal( journal_file, entries ) );
+        BOOST_CHECK_EQUAL( good_size, fs::file_size( journal ) );
+    }
+
+    // a record appended after the recovery is read
+    append_to_pssm_journal( journal_file, "R00003", info3 );
+    {
+        pssm_journal_entries entries;
+        BOOST_REQUIRE_EQUAL( 3u, read_pssm_journal( journal_file, entries ) );
+        check_entry( entries[ 2 ], "R00003", info3 );
+    }
+
+    // a record whose contents do not match its checksum is dropped with everything after it
+    {
+        std::fstream stream( journal_file.c_str(), std::ios::in | std::ios::out | std::ios::binary );
+        stream.seekp( std::streamoff( good_size ) + 40 );
+        stream.put( '#' );
+    }
+    {
+        pssm_journal_entries entries;
+        BOOST_CHECK_EQUAL( 2u, read_pssm_journal( journal_file, entries ) );
+        BOOST_CHECK_EQUAL( good_size, fs::file_size( journal ) );
+    }
+
+    fs::remove( journal );
+}
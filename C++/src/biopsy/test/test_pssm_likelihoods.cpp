@@ -0,0 +1,154 @@
+/**
+ * Copyright John Reid 2013
+ *
+ * @file Code to test the lattice calculation of PSSM score likelihoods against the map calculation.
+ */
+
+#define BOOST_TEST_MODULE pssm_likelihoods
+#include <boost/test/unit_test.hpp>
+
+#include <biopsy/pssm.h>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+
+BOOST_AUTO_TEST_CASE( test_lattice_likelihoods )
+{
+    using namespace biopsy;
+
+    boost::variate_generator< boost::mt19937, boost::uniform_real<> > rng( boost::mt19937( 1 ), boost::uniform_real<>() );
+
+    for( unsigned pssm_size = 1; 30 >= pssm_size; ++pssm_size )
+    {
+        // a pssm with skewed random distributions and the uniform background
+        nucleo_dist::vec dists;
+        for( unsigned i = 0; pssm_size != i; ++i )
+        {
+            dists.push_back( nucleo_dist( rng() + .05, rng() * rng() + .05, rng() * rng() * rng() + .05, rng() + .05 ) );
+        }
+        const pssm_ptr _pssm = create_pssm( dists );
+        const nucleo_dist::vec background( pssm_size, uniform_nucleo_dist() );
+
+        for( unsigned under_background = 0; 2 != under_background; ++under_background )
+        {
+            const nucleo_dist::vec & dist = under_background ? background : dists;
+            likelihoods from_map( 100 );
+            likelihoods from_lattice( 100 );
+            calculate_pssm_likelihoods( *_pssm, dist, from_map, 10000 );
+            calculate_pssm_likelihoods_on_lattice( *_pssm, dist, from_lattice, 100000 );
+
+            double total_difference = 0.;
+            for( unsigned i = 0; from_map.size() != i; ++i )
+            {
+                const double difference = std::fabs( from_map[ i ] - from_lattice[ i ] );
+                BOOST_CHECK_SMALL( difference, 1e-3 );
+                total_difference += difference;
+            }
+            BOOST_CHECK_SMALL( total_difference, 1e-2 );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_p_binding_table )
+{
+    using namespace biopsy;
+
+    nucleo_dist::vec counts;
+    counts.push_back( nucleo_dist( 10, 0, 1, 0 ) );
+    counts.push_back( nucleo_dist( 0, 8, 2, 1 ) );
+    counts.push_back( nucleo_dist( 3, 3, 3, 3 ) );
+    counts.push_back( nucleo_dist( 0, 0, 0, 11 ) );
+    const nucleo_dist::vec dists = counts + .25;
+    const pssm_ptr _pssm = create_pssm( dists );
+    const pssm_info info(
+        counts,
+        .25,
+        11,
+        _pssm,
+        calculate_likelihoods_under_pssm( _pssm, dists ),
+        calculate_likelihoods_under_background( _pssm ) );
+
+    pssm_parameters & params = pssm_parameters::singleton();
+    for( unsigned use_p_value = 0; 2 != use_p_value; ++use_p_value )
+    {
+        params.use_p_value = ( 1 == use_p_value );
+        for( unsigned prior = 0; 2 != prior; ++prior )
+        {
+            params.binding_background_odds_prior = prior ? 1e-3 : 2e-5;
+
+            // the table should be rebuilt for the new parameters and agree exactly with the direct calculation
+            const p_binding_table::ptr table = info.get_p_binding_table();
+            const scoring_context context( params );
+            BOOST_CHECK( table->matches( context ) );
+            for( unsigned i = 0; 1000 >= i; ++i )
+            {
+                const double score = i / 1000.;
+                BOOST_CHECK_EQUAL( get_p_binding_from_score( info, score ), ( *table )( score ) );
+                BOOST_CHECK_EQUAL( get_p_binding_from_score( info, score, context ), ( *table )( score ) );
+            }
+        }
+    }
+
+    // a scoring context keeps its settings when the parameters change
+    const scoring_context context( params );
+    const double p_binding = get_p_binding_from_score( info, .5, context );
+    params.binding_background_odds_prior *= 10.;
+    BOOST_CHECK_EQUAL( p_binding, get_p_binding_from_score( info, .5, context ) );
+    BOOST_CHECK( p_binding != get_p_binding_from_score( info, .5 ) );
+    BOOST_CHECK( ! info.get_p_binding_table()->matches( context ) );
+    BOOST_CHECK( info.get_p_binding_table( context )->matches( context ) );
+}
+
+BOOST_AUTO_TEST_CASE( test_p_binding_table_per_context )
+{
+    using namespace biopsy;
+
+    nucleo_dist::vec counts;
+    counts.push_back( nucleo_dist( 10, 0, 1, 0 ) );
+    counts.push_back( nucleo_dist( 0, 8, 2, 1 ) );
+    counts.push_back( nucleo_dist( 3, 3, 3, 3 ) );
+    const nucleo_dist::vec dists = counts + .25;
+    const pssm_ptr _pssm = create_pssm( dists );
+    const pssm_info info(
+        counts,
+        .25,
+        11,
+        _pssm,
+        calculate_likelihoods_under_pssm( _pssm, dists ),
+        calculate_likelihoods_under_background( _pssm ) );
+
+    // two contexts that differ in each of the settings the table depends on
+    pssm_parameters params;
+    params.binding_background_odds_prior = 2e-5;
+    params.use_cumulative_dists = false;
+    params.use_p_value = false;
+    const scoring_context context_1( params );
+    params.binding_background_odds_prior = 1e-3;
+    params.use_cumulative_dists = true;
+    params.use_p_value = true;
+    const scoring_context context_2( params );
+
+    // alternating between them gets the same tables rather than rebuilding them each time
+    const p_binding_table::ptr table_1 = info.get_p_binding_table( context_1 );
+    const p_binding_table::ptr table_2 = info.get_p_binding_table( context_2 );
+    BOOST_CHECK( table_1->matches( context_1 ) );
+    BOOST_CHECK( table_2->matches( context_2 ) );
+    BOOST_CHECK( table_1 != table_2 );
+    for( unsigned i = 0; 10 != i; ++i )
+    {
+        BOOST_CHECK( table_1 == info.get_p_binding_table( context_1 ) );
+        BOOST_CHECK( table_2 == info.get_p_binding_table( context_2 ) );
+    }
+
+    // only the contexts asked for most recently are kept
+    for( unsigned i = 0; p_binding_table::max_tables_per_pssm != i; ++i )
+    {
+        params.binding_background_odds_prior = 1e-2 + i * 1e-3;
+        info.get_p_binding_table( scoring_context( params ) );
+    }
+    const p_binding_table::ptr rebuilt = info.get_p_binding_table( context_1 );
+    BOOST_CHECK( table_1 != rebuilt );
+    BOOST_CHECK( rebuilt->matches( context_1 ) );
+    BOOST_CHECK_EQUAL( table_1->p_binding.size(), rebuilt->p_binding.size() );
+}
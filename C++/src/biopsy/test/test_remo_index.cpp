@@ -0,0 +1,236 @@
+/**
+ * Copyright John Reid 2013
+ *
+ * @file Code to test that the remo index finds the same remos as a linear scan of the remome.
+ */
+
+#define BOOST_TEST_MODULE remo_index
+#include <boost/test/unit_test.hpp>
+
+#include <biopsy/remo.h>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#include <algorithm>
+
+using namespace biopsy::remo;
+
+namespace {
+
+typedef boost::variate_generator< boost::mt19937 &, boost::uniform_int<> > int_generator;
+
+alignment_sequence_id::ptr
+make_sequence_id( const std::string & species, unsigned gene )
+{
+    return alignment_sequence_id::ptr(
+        new alignment_sequence_id(
+            ensembl_id( "ENSG", gene ),
+            ensembl_id( "ENST", gene ),
+            ensembl_database_id( species, 1, 1, "a" ),
+            1 ) );
+}
+
+/** Add a remo with the given location on the centre sequence and an arbitrary one on the other sequences. */
+void
+add_remo( aligned_sequence_set::ptr aligned_seqs, module::list & remos, const location & l )
+{
+    module::ptr remo( new module );
+    BOOST_FOREACH( const aligned_sequence_set::alignment_sequence_info_map::value_type & s, aligned_seqs->_sequences )
+    {
+        remo_sequence::list_ptr sequences( new remo_sequence::list );
+        const location seq_l = s.first == aligned_seqs->_centre_sequence ? l : location( 0, l._end - l._start );
+        sequences->push_back( remo_sequence::ptr( new remo_sequence( "", "", seq_l, seq_l, 0, 0, 0. ) ) );
+        remo->_sequences[ s.first ] = sequences;
+    }
+    remos.push_back( remo );
+}
+
+location
+centre_location( const remo_locator & locator )
+{
+    return ( *( locator.get< 0 >()->get_sequences( locator.get< 1 >()->_centre_sequence ) ) )[ 0 ]->_location;
+}
+
+remo_locator
+scan_find( const remome & _remome, alignment_sequence_id::ptr centre_sequence, const location & l )
+{
+    BOOST_FOREACH( const remome::remo_map::value_type & v, *( _remome._remos ) )
+    {
+        if( *( v.first->_centre_sequence ) == *centre_sequence )
+        {
+            BOOST_FOREACH( module::ptr remo, *( v.second ) )
+            {
+                const remo_locator locator( remo, v.first );
+                if( l == centre_location( locator ) )
+                {
+                    return locator;
+                }
+            }
+        }
+    }
+    return remo_locator();
+}
+
+remo_locator_list
+scan_for_gene( const remome & _remome, const ensembl_id & gene )
+{
+    remo_locator_list result;
+    BOOST_FOREACH( const remome::remo_map::value_type & v, *( _remome._remos ) )
+    {
+        BOOST_FOREACH( module::ptr remo, *( v.second ) )
+        {
+            BOOST_FOREACH( const module::sequence_remo_map::value_type & s, remo->_sequences )
+            {
+                if( gene == s.first->_gene_id )
+                {
+                    result.push_back( remo_locator( remo, v.first ) );
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+remo_locator_list
+scan_overlapping( const remome & _remome, alignment_sequence_id::ptr centre_sequence, const location & interval )
+{
+    remo_locator_list result;
+    BOOST_FOREACH( const remome::remo_map::value_type & v, *( _remome._remos ) )
+    {
+        if( *( v.first->_centre_sequence ) == *centre_sequence )
+        {
+            BOOST_FOREACH( module::ptr remo, *( v.second ) )
+            {
+                const remo_locator locator( remo, v.first );
+                const location l = centre_location( locator );
+                if( l._start <= interval._end && l._end >= interval._start )
+                {
+                    result.push_back( locator );
+                }
+            }
+        }
+    }
+    return result;
+}
+
+bool
+same_locator( const remo_locator & lhs, const remo_locator & rhs )
+{
+    return lhs.get< 0 >() == rhs.get< 0 >() && lhs.get< 1 >() == rhs.get< 1 >();
+}
+
+bool
+locator_less( const remo_locator & lhs, const remo_locator & rhs )
+{
+    if( lhs.get< 0 >().get() < rhs.get< 0 >().get() ) return true;
+    if( rhs.get< 0 >().get() < lhs.get< 0 >().get() ) return false;
+    return lhs.get< 1 >().get() < rhs.get< 1 >().get();
+}
+
+/** Are the lists the same? In the same order if ordered, otherwise as sets. */
+bool
+same_locators( remo_locator_list lhs, remo_locator_list rhs, bool ordered )
+{
+    if( ! ordered )
+    {
+        std::sort( lhs.begin(), lhs.end(), locator_less );
+        std::sort( rhs.begin(), rhs.end(), locator_less );
+    }
+    return lhs.size() == rhs.size() && std::equal( lhs.begin(), lhs.end(), rhs.begin(), same_locator );
+}
+
+} //namespace
+
+
+BOOST_AUTO_TEST_CASE( test_remo_index_matches_scan )
+{
+    boost::mt19937 rng( 7 );
+    int_generator position( rng, boost::uniform_int<>( 0, 300 ) );
+    int_generator length( rng, boost::uniform_int<>( 0, 40 ) );
+
+    // two centre sequences, the first aligned twice, sharing a gene with the other species' sequences
+    const alignment_sequence_id::ptr centres[] = { make_sequence_id( "mouse", 1 ), make_sequence_id( "mouse", 2 ) };
+    const alignment_sequence_id::ptr others[] = { make_sequence_id( "human", 1 ), make_sequence_id( "human", 3 ), make_sequence_id( "fugu", 2 ) };
+    const unsigned centre_of[] = { 0, 0, 1 };
+
+    const remome::ptr _remome( new remome );
+    _remome->_remos.reset( new remome::remo_map );
+    for( unsigned a = 0; 3 != a; ++a )
+    {
+        aligned_sequence_set::ptr aligned_seqs( new aligned_sequence_set );
+        aligned_seqs->_centre_sequence = centres[ centre_of[ a ] ];
+        aligned_seqs->_sequences[ aligned_seqs->_centre_sequence ].reset( new alignment_sequence_info );
+        aligned_seqs->_sequences[ others[ a ] ].reset( new alignment_sequence_info );
+
+        module::list_ptr remos( new module::list );
+        for( unsigned i = 0; 60 != i; ++i )
+        {
+            const int start = position();
+            add_remo( aligned_seqs, *remos, location( start, start + length() ) );
+        }
+        // duplicate locations, one of them in the other aligned set for the same centre sequence
+        add_remo( aligned_seqs, *remos, location( 100, 120 ) );
+        add_remo( aligned_seqs, *remos, location( 100, 120 ) );
+        ( *_remome->_remos )[ aligned_seqs ] = remos;
+    }
+
+    const boost::shared_ptr< const remo_index > index = _remome->get_index();
+
+    // every remo is found by its location and unknown locations and sequences are not
+    BOOST_FOREACH( const remome::remo_map::value_type & v, *( _remome->_remos ) )
+    {
+        BOOST_FOREACH( module::ptr remo, *( v.second ) )
+        {
+            const location l = centre_location( remo_locator( remo, v.first ) );
+            const remo_locator found = index->find( v.first->_centre_sequence, l );
+            BOOST_REQUIRE( found.get< 0 >() );
+            BOOST_CHECK( same_locator( scan_find( *_remome, v.first->_centre_sequence, l ), found ) );
+        }
+    }
+    BOOST_CHECK( ! index->find( centres[ 0 ], location( 1000, 1001 ) ).get< 0 >() );
+    BOOST_CHECK( ! index->find( others[ 0 ], location( 100, 120 ) ).get< 0 >() );
+
+    // genes with remos from one or more aligned sets and a gene with none
+    for( unsigned gene = 0; 5 != gene; ++gene )
+    {
+        const ensembl_id id( "ENSG", gene );
+        const remo_locator_list expected = scan_for_gene( *_remome, id );
+        BOOST_CHECK( same_locators( expected, *( index->get_remos_for_gene( id ) ), true ) );
+        BOOST_CHECK( same_locators( expected, *( get_remos_for_gene( _remome, id ) ), true ) );
+    }
+    BOOST_CHECK( ! scan_for_gene( *_remome, ensembl_id( "ENSG", 1 ) ).empty() );
+    BOOST_CHECK( scan_for_gene( *_remome, ensembl_id( "ENSG", 4 ) ).empty() );
+
+    // random intervals and intervals that just touch or just miss the ends of each remo
+    std::vector< location > intervals;
+    for( unsigned i = 0; 200 != i; ++i )
+    {
+        const int start = position() - 20;
+        intervals.push_back( location( start, start + length() ) );
+    }
+    BOOST_FOREACH( const remome::remo_map::value_type & v, *( _remome->_remos ) )
+    {
+        BOOST_FOREACH( module::ptr remo, *( v.second ) )
+        {
+            const location l = centre_location( remo_locator( remo, v.first ) );
+            intervals.push_back( location( l._end, l._end ) );
+            intervals.push_back( location( l._end + 1, l._end + 10 ) );
+            intervals.push_back( location( l._start - 10, l._start ) );
+            intervals.push_back( location( l._start - 10, l._start - 1 ) );
+            intervals.push_back( l );
+        }
+    }
+    intervals.push_back( location( -1000, 1000 ) );
+    BOOST_FOREACH( const alignment_sequence_id::ptr & centre, centres )
+    {
+        BOOST_FOREACH( const location & interval, intervals )
+        {
+            BOOST_CHECK( same_locators( scan_overlapping( *_remome, centre, interval ), *( index->get_remos_overlapping( centre, interval ) ), false ) );
+        }
+    }
+    BOOST_CHECK( index->get_remos_overlapping( others[ 0 ], location( -1000, 1000 ) )->empty() );
+    BOOST_CHECK_EQUAL( 2u * 62u, index->get_remos_overlapping( centres[ 0 ], location( -1000, 1000 ) )->size() );
+}
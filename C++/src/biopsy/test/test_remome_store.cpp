@@ -0,0 +1,170 @@
+/**
+ * Copyright John Reid 2013
+ *
+ * @file Code to test that a remome written to a store is read back through the memory map unchanged.
+ */
+
+#define BOOST_TEST_MODULE remome_store
+#include <boost/test/unit_test.hpp>
+
+#include <biopsy/remome_store.h>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/algorithm/string/join.hpp>
+
+#include <sstream>
+#include <algorithm>
+
+using namespace biopsy;
+using namespace biopsy::remo;
+
+namespace {
+
+alignment_sequence_id::ptr
+make_sequence_id( const std::string & species, unsigned gene )
+{
+    return alignment_sequence_id::ptr(
+        new alignment_sequence_id(
+            ensembl_id( "ENSG", gene ),
+            ensembl_id( "ENST", gene ),
+            ensembl_database_id( species, 50, 37, "a" ),
+            0 ) );
+}
+
+/** A remome with the given number of remos on each of a few sets of aligned sequences. */
+remome::ptr
+make_remome( unsigned num_remos )
+{
+    remome::ptr result( new remome );
+    result->_remos.reset( new remome::remo_map );
+
+    // the first centre sequence is aligned twice
+    const alignment_sequence_id::ptr centres[] = { make_sequence_id( "mus_musculus", 1 ), make_sequence_id( "mus_musculus", 2 ) };
+    const unsigned centre_of[] = { 0, 0, 1 };
+    for( unsigned a = 0; 3 != a; ++a )
+    {
+        aligned_sequence_set::ptr aligned_seqs( new aligned_sequence_set );
+        aligned_seqs->_centre_sequence = centres[ centre_of[ a ] ];
+        aligned_seqs->_sequences[ aligned_seqs->_centre_sequence ].reset( new alignment_sequence_info( 1000, false, 0, exon::list_ptr( new exon::list ), region_upstream ) );
+        aligned_seqs->_sequences[ make_sequence_id( "homo_sapiens", 10 + a ) ].reset( new alignment_sequence_info( 800 + a, true, 12345, exon::list_ptr( new exon::list ), region_gene ) );
+
+        module::list_ptr remos( new module::list );
+        for( unsigned i = 0; num_remos != i; ++i )
+        {
+            module::ptr remo( new module );
+            BOOST_FOREACH( const aligned_sequence_set::alignment_sequence_info_map::value_type & s, aligned_seqs->_sequences )
+            {
+                const location l( 10 * i + a, 10 * i + a + 7 + s.second->_length % 5 );
+                remo_sequence::list_ptr sequences( new remo_sequence::list );
+                sequences->push_back( remo_sequence::ptr( new remo_sequence( "acgtnacg", "acgtaacg", l, l, 70 + i, i, .5 * i ) ) );
+                remo->_sequences[ s.first ] = sequences;
+            }
+            remos->push_back( remo );
+        }
+        ( *result->_remos )[ aligned_seqs ] = remos;
+    }
+    return result;
+}
+
+/**
+Describe everything in the remome that the store should keep. Sets of aligned sequences are ordered by
+the addresses of their sequence ids, so their descriptions are sorted.
+*/
+std::string
+describe( const remome & r )
+{
+    string_vec descriptions;
+    BOOST_FOREACH( const remome::remo_map::value_type & v, *r._remos )
+    {
+        std::ostringstream os;
+        os << "centre: " << *v.first->_centre_sequence << "\n";
+        BOOST_FOREACH( const aligned_sequence_set::alignment_sequence_info_map::value_type & s, v.first->_sequences )
+        {
+            os << " " << *s.first << " " << s.second->_length << " " << s.second->_has_position << " " << s.second->_position << " " << s.second->_region << "\n";
+        }
+        BOOST_FOREACH( module::ptr remo, *v.second )
+        {
+            os << " remo: " << get_remo_id( v.first, remo ) << "\n";
+            BOOST_FOREACH( const module::sequence_remo_map::value_type & s, remo->_sequences )
+            {
+                BOOST_FOREACH( remo_sequence::ptr seq, *s.second )
+                {
+                    os
+                        << "  " << *s.first << " " << seq->_location << " " << seq->_target_location
+                        << " " << seq->_masked_sequence << " " << seq->_unmasked_sequence
+                        << " " << seq->_conservation << " " << seq->_repeat_ratio << " " << seq->_belief << "\n";
+                }
+            }
+        }
+        descriptions.push_back( os.str() );
+    }
+    std::sort( descriptions.begin(), descriptions.end() );
+    return boost::algorithm::join( descriptions, "" );
+}
+
+/** The part of the remome with the centre sequence. */
+std::string
+describe_for( const remome & r, alignment_sequence_id::ptr centre_sequence )
+{
+    remome part;
+    part._remos.reset( new remome::remo_map );
+    BOOST_FOREACH( const remome::remo_map::value_type & v, *r._remos )
+    {
+        if( *v.first->_centre_sequence == *centre_sequence )
+        {
+            part._remos->insert( v );
+        }
+    }
+    return describe( part );
+}
+
+} //namespace
+
+
+BOOST_AUTO_TEST_CASE( test_remome_store_round_trip )
+{
+    namespace fs = boost::filesystem;
+
+    const fs::path store_path = fs::temp_directory_path() / fs::unique_path( "remome-store-%%%%-%%%%.bin" );
+    const std::string store_file = store_path.string();
+
+    const remome::ptr original = make_remome( 5 );
+    remome_store::write( store_file, *original );
+    BOOST_CHECK( ! fs::exists( store_file + ".tmp" ) );
+
+    const remome_store store( store_file );
+    BOOST_CHECK_EQUAL( original->_remos->size(), store.size() );
+    BOOST_CHECK_EQUAL( describe( *original ), describe( *store.load() ) );
+
+    // each centre sequence decodes just its own sets of aligned sequences
+    const string_vec_ptr centre_ids = store.get_centre_sequence_ids();
+    BOOST_CHECK_EQUAL( 3u, centre_ids->size() );
+    BOOST_FOREACH( const remome::remo_map::value_type & v, *original->_remos )
+    {
+        BOOST_CHECK( std::binary_search( centre_ids->begin(), centre_ids->end(), v.first->_centre_sequence->str() ) );
+        BOOST_CHECK_EQUAL( describe_for( *original, v.first->_centre_sequence ), describe( *store.get_remome_for( v.first->_centre_sequence ) ) );
+        BOOST_FOREACH( module::ptr remo, *v.second )
+        {
+            const std::string id = get_remo_id( v.first, remo );
+            const remo_locator found = store.get_remo_from_id( id );
+            BOOST_REQUIRE( found.get< 0 >() );
+            BOOST_CHECK_EQUAL( id, get_remo_id( found.get< 1 >(), found.get< 0 >() ) );
+        }
+    }
+    BOOST_CHECK( store.get_remome_for( make_sequence_id( "mus_musculus", 3 ) )->_remos->empty() );
+
+    // rewriting the file leaves the store that has it mapped reading the old remome
+    const remome::ptr rewritten = make_remome( 2 );
+    remome_store::write( store_file, *rewritten );
+    BOOST_CHECK_EQUAL( describe( *original ), describe( *store.load() ) );
+    BOOST_CHECK_EQUAL( describe( *rewritten ), describe( *remome_store( store_file ).load() ) );
+
+    // a write that fails leaves the existing file alone
+    fs::create_directory( store_file + ".tmp" );
+    fs::create_directory( fs::path( store_file + ".tmp" ) / "keep" );
+    BOOST_CHECK_THROW( remome_store::write( store_file, *original ), std::exception );
+    BOOST_CHECK_EQUAL( describe( *rewritten ), describe( *remome_store( store_file ).load() ) );
+
+    fs::remove_all( store_file + ".tmp" );
+    fs::remove( store_path );
+}
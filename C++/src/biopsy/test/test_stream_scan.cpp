@@ -0,0 +1,153 @@
+/**
+ * Copyright John Reid 2013
+ *
+ * @file Code to test that scanning a fasta stream in batches finds the same hits as scanning each whole sequence.
+ */
+
+#define BOOST_TEST_MODULE stream_scan
+#include <boost/test/unit_test.hpp>
+
+#include <biopsy/stream_scan.h>
+#include <biopsy/pssm.h>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#include <sstream>
+#include <algorithm>
+
+namespace {
+
+typedef std::map< std::string, biopsy::binding_hit::vec > hits_by_sequence;
+
+/** Collects the hits for each sequence. */
+struct collect_hits
+{
+    hits_by_sequence & hits;
+
+    collect_hits( hits_by_sequence & hits ) : hits( hits ) { }
+
+    void operator()( const std::string & sequence_id, const biopsy::binding_hit & hit ) const
+    {
+        hits[ sequence_id ].push_back( hit );
+    }
+};
+
+/** Add a PSSM with the given consensus to the cache. */
+void
+add_test_pssm( const std::string & name, const std::string & consensus )
+{
+    using namespace biopsy;
+
+    nucleo_dist::vec counts;
+    BOOST_FOREACH( char c, consensus )
+    {
+        nucleo_dist count( 1, 1, 1, 1 );
+        count.set( std::string( "acgt" ).find( c ), 9 );
+        counts.push_back( count );
+    }
+    const nucleo_dist::vec dists = counts + .25;
+    const pssm_ptr _pssm = create_pssm( dists );
+    add_pssm_to_cache(
+        name,
+        pssm_info(
+            counts,
+            .25,
+            12,
+            _pssm,
+            calculate_likelihoods_under_pssm( _pssm, dists ),
+            calculate_likelihoods_under_background( _pssm ) ) );
+}
+
+} //namespace
+
+
+BOOST_AUTO_TEST_CASE( test_stream_scan_matches_whole_sequences )
+{
+    using namespace biopsy;
+
+    const std::string consensus_1 = "tgacgtca";
+    const std::string consensus_2 = "ggggaattcccc";
+    add_test_pssm( "STREAMTEST-1", consensus_1 );
+    add_test_pssm( "STREAMTEST-2", consensus_2 );
+    const string_vec_ptr pssm_names( new string_vec( boost::assign::list_of( "STREAMTEST-1" )( "STREAMTEST-2" ) ) );
+    const double threshold = .05;
+
+    // random sequences with the consensuses planted over the line boundaries and runs of n
+    const unsigned line_length = 7;
+    boost::variate_generator< boost::mt19937, boost::uniform_int<> > base( boost::mt19937( 3 ), boost::uniform_int<>( 0, 3 ) );
+    const string_vec ids = boost::assign::list_of( "first" )( "second" )( "third" );
+    std::map< std::string, sequence > sequences;
+    BOOST_FOREACH( const std::string & id, ids )
+    {
+        sequence & seq = sequences[ id ];
+        for( unsigned i = 0; 400 != i; ++i )
+        {
+            seq.push_back( "acgt"[ base() ] );
+        }
+        for( unsigned start = 3; start + consensus_2.size() < seq.size(); start += 50 )
+        {
+            const std::string & consensus = ( start / 50 ) % 2 ? consensus_1 : consensus_2;
+            seq.replace( start, consensus.size(), consensus );
+        }
+        seq.replace( 120, 30, std::string( 30, 'n' ) );
+        seq.replace( 300, 9, std::string( 9, 'n' ) );
+    }
+    sequences[ "third" ].resize( 17 ); // shorter than one batch
+
+    std::ostringstream fasta;
+    BOOST_FOREACH( const std::string & id, ids )
+    {
+        fasta << ">" << id << "\n";
+        for( size_t i = 0; sequences[ id ].size() > i; i += line_length )
+        {
+            fasta << sequences[ id ].substr( i, line_length ) << "\n";
+        }
+    }
+
+    hits_by_sequence expected;
+    BOOST_FOREACH( const std::string & id, ids )
+    {
+        binding_hit::vec & hits = expected[ id ];
+        const binding_hit::vec_ptr whole = score_pssms_on_sequence( pssm_names, sequences[ id ], threshold );
+        hits.assign( whole->begin(), whole->end() );
+        std::sort( hits.begin(), hits.end() );
+    }
+    BOOST_REQUIRE( ! expected[ "first" ].empty() );
+
+    const std::vector< size_t > batch_sizes = boost::assign::list_of( 1 )( 5 )( 8 )( 13 )( 50 )( 10000 );
+    BOOST_FOREACH( size_t batch_size, batch_sizes )
+    {
+        BOOST_TEST_MESSAGE( "Batch size: " << batch_size );
+
+        hits_by_sequence streamed;
+        std::istringstream stream( fasta.str() );
+        const stream_scan_stats stats = score_pssms_on_fasta_stream( pssm_names, stream, collect_hits( streamed ), threshold, batch_size );
+        BOOST_CHECK_EQUAL( ids.size(), stats.num_sequences );
+        BOOST_CHECK_EQUAL( 400u + 400u + 17u, stats.num_bases );
+
+        size_t num_hits = 0;
+        BOOST_FOREACH( const std::string & id, ids )
+        {
+            binding_hit::vec & hits = streamed[ id ];
+            std::sort( hits.begin(), hits.end() );
+            BOOST_CHECK( expected[ id ] == hits );
+            num_hits += hits.size();
+        }
+        BOOST_CHECK_EQUAL( num_hits, stats.num_hits );
+
+        // the lines are the batches when they are smaller, so some hits must have spanned a batch boundary
+        if( batch_size <= line_length )
+        {
+            bool spans_boundary = false;
+            BOOST_FOREACH( const binding_hit & hit, streamed[ "first" ] )
+            {
+                const int begin = hit._location._position;
+                spans_boundary = spans_boundary || ( begin / int( line_length ) != ( hit._location.get_end() - 1 ) / int( line_length ) );
+            }
+            BOOST_CHECK( spans_boundary );
+        }
+    }
+}
@@ -53,6 +53,7 @@ void register_factor_synonym_tests( test_suite * test );
 void register_fasta_tests( test_suite * test );
 void register_hidden_markov_model_tests( test_suite * test );
 void register_hmm_dna_tests( test_suite * test );
+void register_hit_pairs_tests( test_suite * test );
 void register_kegg_tests( test_suite * test );
 void register_markov_model_tests( test_suite * test );
 void register_math_tests( test_suite * test );
@@ -65,6 +66,7 @@ void register_pssm_match_tests( test_suite * test );
 void register_pssm_motif_tests( test_suite * test );
 void register_pssm_pathway_map_tests( test_suite * test );
 void register_random_tests( test_suite * test );
+void register_remo_analysis_tests( test_suite * test );
 void register_remo_parse_tests( test_suite * test );
 void register_remos_tests( test_suite * test );
 void register_score_map_tests( test_suite * test );
@@ -97,6 +99,8 @@ init_unit_test_suite( int argc, char * argv [] )
         //unit_test_monitor.register_exception_translator<string>(&translate_string_exception);
         //unit_test_monitor.register_exception_translator<const char *>(&translate_char_exception);
 
+        //before the other tests create the binding models it analyses with
+        register_remo_analysis_tests( test );
         register_adjust_phylo_tests( test );
         //register_binding_max_chain_tests( test );
         register_binding_model_tests( test );
@@ -123,6 +127,7 @@ init_unit_test_suite( int argc, char * argv [] )
         register_species_file_sets_tests( test );
         register_svg_tests( test );
         register_remos_tests( test );
+        register_hit_pairs_tests( test );
         register_site_data_tests( test );
         register_matrix_match_map_tests( test );
         register_multi_seq_match_tests( test );
@@ -6,12 +6,17 @@
 USING_BIO_NS;
 using namespace BIO_NS::spirit;
 
+#include <bio/parallel.h>
+
 #include <boost/progress.hpp>
 #include <boost/test/unit_test.hpp>
 using namespace boost;
 using boost::unit_test::test_suite;
 
 #include <fstream>
+#include <sstream>
+#include <set>
+#include <algorithm>
 using namespace std;
 
 
@@ -54,6 +59,29 @@ check_biobase_table_parse()
 	BOOST_CHECK_EQUAL(map.size(), traits_t::get_num_data());
 }
 
+template <TransData type>
+void
+check_biobase_table_chunked_parse()
+{
+	typedef DataTraits<type> traits_t;
+
+	cout << "******* check_biobase_table_chunked_parse(): " << traits_t::get_name() << endl;
+
+	//parsing in chunks on several threads should give the same entries as parsing the whole file
+	typename traits_t::entry_t::map_t whole, chunked;
+	parse<type>(whole, traits_t::get_biobase_file(), 1);
+	parse<type>(chunked, traits_t::get_biobase_file(), 4);
+	BOOST_CHECK_EQUAL(whole.size(), chunked.size());
+	typename traits_t::entry_t::map_t::const_iterator c = chunked.begin();
+	BOOST_FOREACH( const typename traits_t::entry_t::map_t::value_type & w, whole )
+	{
+		if( chunked.end() == c ) break;
+		BOOST_CHECK_EQUAL(w.first, c->first);
+		BOOST_CHECK_EQUAL(w.second->get_name(), c->second->get_name());
+		++c;
+	}
+}
+
 //make sure the template functions are instantiated
 void check_parse_all_tables()
 {
@@ -69,6 +97,116 @@ void check_parse_all_tables()
 
 
 
+/** Do the entries have the same accession number? */
+template< typename Map >
+bool same_key( const typename Map::value_type & lhs, const typename Map::value_type & rhs )
+{
+	return lhs.first == rhs.first;
+}
+
+/** Records the threads it is called on. */
+struct record_thread
+{
+	std::set< boost::thread::id > & ids;
+	boost::mutex & mutex;
+
+	record_thread( std::set< boost::thread::id > & ids, boost::mutex & mutex ) : ids( ids ), mutex( mutex ) { }
+
+	void operator()( size_t ) const
+	{
+		boost::lock_guard< boost::mutex > lock( mutex );
+		ids.insert( boost::this_thread::get_id() );
+	}
+};
+
+void check_biobase_load_single_threaded()
+{
+	cout << "******* check_biobase_load_single_threaded()\n";
+
+	unsigned tables_at_once;
+	unsigned threads_per_table;
+
+	//threads are never divided into more than were asked for
+	for( unsigned num_threads = 1; 17 != num_threads; ++num_threads )
+	{
+		for( size_t num_tables = 1; 9 != num_tables; ++num_tables )
+		{
+			divide_num_threads( num_threads, num_tables, tables_at_once, threads_per_table );
+			BOOST_CHECK( tables_at_once <= num_tables );
+			BOOST_CHECK( 1 <= threads_per_table );
+			BOOST_CHECK( tables_at_once * threads_per_table <= num_threads );
+		}
+	}
+
+	//one thread is not divided further between the tables and the chunks of their files
+	divide_num_threads( 1, 6, tables_at_once, threads_per_table );
+	BOOST_CHECK_EQUAL( tables_at_once, 1u );
+	BOOST_CHECK_EQUAL( threads_per_table, 1u );
+
+	//the tables are then loaded on the calling thread...
+	std::set< boost::thread::id > ids;
+	boost::mutex mutex;
+	parallel_for( 6, tables_at_once, record_thread( ids, mutex ) );
+	BOOST_CHECK_EQUAL( ids.size(), 1u );
+	BOOST_CHECK( boost::this_thread::get_id() == *ids.begin() );
+
+	//...and each file is parsed in one chunk
+	typedef DataTraits< MATRIX_DATA > traits_t;
+	std::ifstream input( traits_t::get_biobase_file().c_str(), std::ios::binary );
+	std::ostringstream contents;
+	contents << input.rdbuf();
+	std::vector< biobase_chunk > chunks;
+	split_biobase_text( contents.str(), threads_per_table, chunks );
+	BOOST_CHECK_EQUAL( chunks.size(), 1u );
+}
+
+
+
+/** Gets tables from the db and records what it got for each call. */
+struct get_tables
+{
+	const BiobaseDb & db;
+	std::vector< const Matrix::map_t * > & matrices;
+	std::vector< const Site::map_t * > & sites;
+
+	get_tables( const BiobaseDb & db, std::vector< const Matrix::map_t * > & matrices, std::vector< const Site::map_t * > & sites )
+		: db( db ), matrices( matrices ), sites( sites )
+	{
+	}
+
+	void operator()( size_t i ) const
+	{
+		matrices[ i ] = &db.get_matrices();
+		sites[ i ] = &db.get_sites();
+	}
+};
+
+void check_biobase_concurrent_load()
+{
+	cout << "******* check_biobase_concurrent_load()\n";
+
+	//a db of our own so its tables are not loaded yet when many threads ask for them at once
+	BiobaseDb db;
+	const size_t num_calls = 32;
+	std::vector< const Matrix::map_t * > matrices( num_calls );
+	std::vector< const Site::map_t * > sites( num_calls );
+	parallel_for( num_calls, 8, get_tables( db, matrices, sites ) );
+
+	const Matrix::map_t & expected_matrices = BiobaseDb::singleton().get_matrices();
+	const Site::map_t & expected_sites = BiobaseDb::singleton().get_sites();
+	for( size_t i = 0; num_calls != i; ++i )
+	{
+		BOOST_CHECK( &db.get_matrices() == matrices[ i ] );
+		BOOST_CHECK( &db.get_sites() == sites[ i ] );
+	}
+	BOOST_CHECK_EQUAL( expected_matrices.size(), db.get_matrices().size() );
+	BOOST_CHECK_EQUAL( expected_sites.size(), db.get_sites().size() );
+	BOOST_CHECK( std::equal( expected_matrices.begin(), expected_matrices.end(), db.get_matrices().begin(), same_key< Matrix::map_t > ) );
+	BOOST_CHECK( std::equal( expected_sites.begin(), expected_sites.end(), db.get_sites().begin(), same_key< Site::map_t > ) );
+}
+
+
+
 void check_biobase_load_all()
 {
 	cout << "******* check_biobase_load_all()\n";
@@ -90,6 +228,11 @@ register_biobase_parse_tests(boost::unit_test::test_suite * test)
 	test->add( BOOST_TEST_CASE( &check_biobase_table_parse< PATHWAY_DATA > ), 0);
 	test->add( BOOST_TEST_CASE( &check_biobase_table_parse< MOLECULE_DATA > ), 0);
 
+	test->add( BOOST_TEST_CASE( &check_biobase_table_chunked_parse< MATRIX_DATA > ), 0);
+	test->add( BOOST_TEST_CASE( &check_biobase_table_chunked_parse< SITE_DATA > ), 0);
+
+	test->add( BOOST_TEST_CASE( &check_biobase_load_single_threaded ), 0);
+	test->add( BOOST_TEST_CASE( &check_biobase_concurrent_load ), 0);
 	test->add( BOOST_TEST_CASE( &check_biobase_load_all ), 0);
 
 #if 0
@@ -9,11 +9,15 @@ USING_BIO_NS
 #include <boost/test/parameterized_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
 #include <boost/assign/list_of.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
 using namespace boost;
 using namespace boost::assign;
 using boost::unit_test::test_suite;
 
 #include <iostream>
+#include <numeric>
 using namespace std;
 
 
@@ -80,8 +84,72 @@ check_cache()
 
 
 
+/** Counts how many times it creates each element. */
+struct CountingCacheElementFactory
+	: std::unary_function< int, CacheElement::ptr_t >
+{
+	boost::shared_ptr< boost::atomic< int > > num_created;
+
+	CountingCacheElementFactory()
+		: num_created( new boost::atomic< int >( 0 ) )
+	{
+	}
+
+	CacheElement::ptr_t operator()( int i ) const
+	{
+		++*num_created;
+		boost::this_thread::yield();
+		return CacheElement::ptr_t( new CacheElement( i ) );
+	}
+};
+
+typedef ConcurrentCache< CountingCacheElementFactory > CountingConcurrentCache;
+
+void
+use_concurrent_cache( const CountingConcurrentCache & cache, int num_keys, int * num_wrong )
+{
+	for( int i = 0; num_keys != i; ++i )
+	{
+		if( i != cache( i )->i )
+		{
+			++*num_wrong;
+		}
+	}
+}
+
+void
+check_concurrent_cache()
+{
+	cout << "******* check_concurrent_cache()" << endl;
+
+	const int num_keys = 1000;
+	const int num_threads = 8;
+
+	CountingCacheElementFactory factory;
+	CountingConcurrentCache cache( factory );
+	std::vector< int > num_wrong( num_threads, 0 );
+	boost::thread_group threads;
+	for( int t = 0; num_threads != t; ++t )
+	{
+		threads.create_thread( boost::bind( use_concurrent_cache, boost::cref( cache ), num_keys, &num_wrong[ t ] ) );
+	}
+	threads.join_all();
+
+	//each element should have been created exactly once
+	BOOST_CHECK_EQUAL( num_keys, int( *factory.num_created ) );
+	BOOST_CHECK_EQUAL( 0, std::accumulate( num_wrong.begin(), num_wrong.end(), 0 ) );
+	BOOST_CHECK_EQUAL( size_t( num_keys ), cache.get_elements().size() );
+
+	cache.erase( 0 );
+	BOOST_CHECK_EQUAL( 0, cache( 0 )->i );
+	BOOST_CHECK_EQUAL( num_keys + 1, int( *factory.num_created ) );
+}
+
+
+
 void
 register_cache_tests(boost::unit_test::test_suite * test)
 {
 	test->add( BOOST_TEST_CASE( &check_cache ), 0);
+	test->add( BOOST_TEST_CASE( &check_concurrent_cache ), 0);
 }
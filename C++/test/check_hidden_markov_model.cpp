@@ -675,6 +675,86 @@ check_viterbi()
 
 
 
+/** Check the compiled algorithms give the same results as the originals and time them. */
+void
+check_compiled_hmm()
+{
+	ensure_hmm_built();
+	ensure_hmm_test_seqs_created();
+
+	cout << "******* check_compiled_hmm(): " << test_seqs.size() << " artificial sequences" << endl;
+
+	CompiledHmm<NucleoCode> compiled(hmm);
+	compiled.compile_logs();
+
+	ForwardBackwardAlgorithm<true> fw;
+	CompiledForwardBackwardAlgorithm<true> compiled_fw;
+	for (SeqList::const_iterator i = test_seqs.begin(); test_seqs.end() != i; ++i) {
+
+		fw.forward(hmm, i->begin(), i->end());
+		fw.backward(hmm, i->rbegin(), i->rend());
+		compiled_fw.forward(compiled, i->begin(), i->end());
+		compiled_fw.backward(compiled);
+		BOOST_CHECK_EQUAL(fw.get_log_probability(), compiled_fw.get_log_probability());
+		for (size_t t = 0; fw.beta.size() != t; ++t) {
+			for (size_t j = 0; hmm.states.size() != j; ++j) {
+				BOOST_CHECK_EQUAL(fw.beta[t][j], compiled_fw.beta[t][j]);
+			}
+		}
+
+		BaumWelchAlgorithm<true> bw;
+		CompiledBaumWelchAlgorithm<true> compiled_bw;
+		bw.calculate_estimates(hmm, i->begin(), i->end(), i->rbegin(), i->rend());
+		compiled_bw.calculate_estimates(compiled, i->begin(), i->end());
+		BOOST_CHECK(bw.pi == compiled_bw.pi);
+		BOOST_CHECK(bw.transition_probs == compiled_bw.transition_probs);
+		BOOST_CHECK(bw.gamma_sum_obs_v == compiled_bw.gamma_sum_obs_v);
+
+		index_list_t state_indices;
+		ViterbiAlgorithm<true>().viterbi(hmm, i->size(), i->begin(), i->end(), front_inserter(state_indices));
+		index_list_t compiled_state_indices;
+		CompiledViterbiAlgorithm<true>().viterbi(compiled, i->begin(), i->end(), front_inserter(compiled_state_indices));
+		BOOST_CHECK_EQUAL(state_indices, compiled_state_indices);
+	}
+
+	//time both on the longest sequence with a larger model
+	SeqList::const_iterator longest = test_seqs.begin();
+	for (SeqList::const_iterator i = test_seqs.begin(); test_seqs.end() != i; ++i) {
+		if (i->size() > longest->size()) {
+			longest = i;
+		}
+	}
+	const seq_t & seq = *longest;
+	const hmm_t large_hmm(20);
+	const unsigned num_repeats = 50;
+	double original_elapsed;
+	{
+		boost::timer timer;
+		for (unsigned r = 0; num_repeats != r; ++r) {
+			fw.forward(large_hmm, seq.begin(), seq.end());
+			fw.backward(large_hmm, seq.rbegin(), seq.rend());
+		}
+		original_elapsed = timer.elapsed();
+	}
+	double compiled_elapsed;
+	{
+		boost::timer timer;
+		compiled.compile(large_hmm);
+		for (unsigned r = 0; num_repeats != r; ++r) {
+			compiled_fw.forward(compiled, seq.begin(), seq.end());
+			compiled_fw.backward(compiled);
+		}
+		compiled_elapsed = timer.elapsed();
+	}
+	BOOST_CHECK_EQUAL(fw.get_log_probability(), compiled_fw.get_log_probability());
+	cout
+		<< "Forward-backward on a " << large_hmm.states.size() << " state model and a sequence of length " << seq.size()
+		<< ": original " << original_elapsed << "s, compiled " << compiled_elapsed << "s"
+		<< endl;
+}
+
+
+
 /** Check the Baum-Welch algorithm on the long sequence. */
 void
 check_long_test_seq()
@@ -803,6 +883,24 @@ check_baum_welch_multiple(const SeqList & seqs)
 		last_multiple_log_prob = new_log_prob;
 	}
 
+	//the E-step on several threads should give the same estimates up to rounding
+	hmm_t hmm_serial(hmm_multiple);
+	hmm_t hmm_parallel(hmm_multiple);
+	baum_welch_multiple(hmm_serial, seqs.begin(), seqs.end(), 1);
+	baum_welch_multiple(hmm_parallel, seqs.begin(), seqs.end(), 4);
+	for (size_t i = 0; hmm_serial.states.size() != i; ++i)
+	{
+		BOOST_CHECK_CLOSE(hmm_serial.states[i].initial_prob, hmm_parallel.states[i].initial_prob, 1e-6);
+		for (size_t j = 0; hmm_serial.states.size() != j; ++j)
+		{
+			BOOST_CHECK_CLOSE(hmm_serial.states[i].transition_probs[j], hmm_parallel.states[i].transition_probs[j], 1e-6);
+		}
+		for (size_t l = 0; hmm_serial.states[i].emission_probs.size() != l; ++l)
+		{
+			BOOST_CHECK_CLOSE(hmm_serial.states[i].emission_probs[l], hmm_parallel.states[i].emission_probs[l], 1e-6);
+		}
+	}
+
 #ifdef VERBOSE_CHECKING
 	cout
 		<< "Log prob of combined seq after training one at a time: "
@@ -881,6 +979,7 @@ void register_hidden_markov_model_tests(test_suite * test)
 	ensure_hmm_test_seqs_created();
 
 	test->add(BOOST_TEST_CASE(&check_forward_backward), 0);
+	test->add(BOOST_TEST_CASE(&check_compiled_hmm), 0);
 	test->add(BOOST_PARAM_TEST_CASE(&check_baum_welch, test_seqs.begin(), test_seqs.end()), 0);
 	test->add(BOOST_TEST_CASE(&check_hmm_overfitting), 0);
 	test->add(BOOST_TEST_CASE(&check_long_test_seq), 0);
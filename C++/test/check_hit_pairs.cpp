@@ -0,0 +1,150 @@
+#include <bio/hit_pairs.h>
+#include <bio/pair_analysis.h>
+#include <bio/random.h>
+USING_BIO_NS
+
+#include <boost/test/unit_test.hpp>
+using boost::unit_test::test_suite;
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+
+namespace {
+
+struct test_hit
+{
+	int position;
+	int length;
+
+	int get_position() const { return position; }
+	int get_end() const { return position + length; }
+
+	bool operator<(const test_hit & rhs) const
+	{
+		return position < rhs.position || (position == rhs.position && length < rhs.length);
+	}
+};
+
+typedef std::pair< const test_hit *, const test_hit * > hit_pair;
+
+struct test_binder
+{
+	unsigned id;
+};
+
+typedef PairStatistics< test_binder > test_statistics;
+typedef std::vector< test_statistics::hit_t > test_hit_vec;
+typedef RemoHits< test_hit_vec::const_iterator > test_remo_hits;
+
+struct collect_pairs
+{
+	std::vector< hit_pair > & pairs;
+
+	collect_pairs(std::vector< hit_pair > & pairs) : pairs(pairs) { }
+
+	void operator()(const test_hit & h1, const test_hit & h2) const
+	{
+		pairs.push_back(hit_pair(&h1, &h2));
+	}
+};
+
+} //namespace
+
+
+void
+check_hit_pairs()
+{
+	cout << "******* check_hit_pairs()" << endl;
+
+	seed_default_rng(1);
+	for (unsigned trial = 0; 500 != trial; ++trial)
+	{
+		std::vector< test_hit > hits(get_uniform_index(60));
+		for (size_t i = 0; hits.size() != i; ++i)
+		{
+			hits[i].position = int(get_uniform_index(200));
+			hits[i].length = 1 + int(get_uniform_index(20));
+		}
+		std::sort(hits.begin(), hits.end());
+		const int min_gap = int(get_uniform_index(3));
+		const int max_gap = int(get_uniform_index(30)) - 2;
+
+		//the pairs we should find by comparing every hit with those after it
+		std::vector< hit_pair > expected;
+		for (size_t i = 0; hits.size() != i; ++i)
+		{
+			for (size_t j = i + 1; hits.size() != j; ++j)
+			{
+				const int gap = hits[j].position - hits[i].get_end();
+				if (min_gap <= gap && gap <= max_gap)
+				{
+					expected.push_back(hit_pair(&hits[i], &hits[j]));
+				}
+			}
+		}
+
+		std::vector< hit_pair > found;
+		for_each_hit_pair(hits.begin(), hits.end(), min_gap, max_gap, collect_pairs(found));
+		BOOST_CHECK(expected == found);
+	}
+}
+
+void
+check_add_remo_hits()
+{
+	cout << "******* check_add_remo_hits()" << endl;
+
+	seed_default_rng(2);
+	std::vector< test_binder > binders(8);
+	for (unsigned b = 0; binders.size() != b; ++b)
+	{
+		binders[b].id = b;
+	}
+
+	//some sequence groups have more than one remo so their lengths are added up
+	std::vector< test_hit_vec > hits(300);
+	std::vector< test_remo_hits > remos;
+	for (size_t r = 0; hits.size() != r; ++r)
+	{
+		const unsigned seq_length = 50 + unsigned(get_uniform_index(250));
+		hits[r].resize(get_uniform_index(40));
+		BOOST_FOREACH(test_statistics::hit_t & hit, hits[r])
+		{
+			hit.binder = &binders[get_uniform_index(binders.size())];
+			hit.position = int(get_uniform_index(seq_length));
+			hit.length = 1 + unsigned(get_uniform_index(15));
+		}
+		std::sort(hits[r].begin(), hits[r].end());
+		remos.push_back(test_remo_hits(BIO_MAKE_STRING("group " << get_uniform_index(100)), hits[r].begin(), hits[r].end(), seq_length));
+	}
+
+	const unsigned distance = 20;
+	test_statistics serial(distance);
+	BOOST_FOREACH(const test_remo_hits & remo, remos)
+	{
+		serial.add_hits(remo.sequence_group_name, remo.results_begin, remo.results_end, remo.seq_length);
+	}
+	BOOST_CHECK(! serial.pair_counts.empty());
+	BOOST_CHECK(! serial.distances_map.empty());
+
+	const unsigned thread_counts[] = { 1, 2, 3, 8 };
+	BOOST_FOREACH(unsigned num_threads, thread_counts)
+	{
+		test_statistics parallel(distance);
+		add_remo_hits(parallel, remos, num_threads);
+		BOOST_CHECK(serial.binder_counts == parallel.binder_counts);
+		BOOST_CHECK(serial.pair_counts == parallel.pair_counts);
+		BOOST_CHECK(serial.distances_map == parallel.distances_map);
+		BOOST_CHECK(serial.sequence_counts == parallel.sequence_counts);
+		BOOST_CHECK(serial.seq_lengths == parallel.seq_lengths);
+	}
+}
+
+void register_hit_pairs_tests(test_suite * test)
+{
+	test->add(BOOST_TEST_CASE(&check_hit_pairs), 0);
+	test->add(BOOST_TEST_CASE(&check_add_remo_hits), 0);
+}
@@ -20,6 +20,7 @@ Copyright John Reid 2006, 2007, 2013
 #include <boost/test/floating_point_comparison.hpp>
 #include <boost/assign/list_of.hpp>
 #include <boost/range/algorithm/equal.hpp>
+#include <boost/function_output_iterator.hpp>
 
 using namespace boost;
 using namespace boost::assign;
@@ -725,6 +726,39 @@ get_lcs_using_max_chain_d( const v_array & sequences, bool print = false )
 	}
 	BOOST_CHECK_CLOSE( _max_chain.maximal_weight, weight, 0.001 );
 
+	//the flat range tree must find exactly the same chain
+	typedef MaxChain< d, VBox< d >, traits, range_tree_ns::flat_range_tree< traits > > flat_max_chain;
+	flat_max_chain _flat_max_chain( boxes );
+	BOOST_CHECK( _max_chain.maximal_chain == _flat_max_chain.maximal_chain );
+	BOOST_CHECK_EQUAL( _max_chain.maximal_weight, _flat_max_chain.maximal_weight );
+
+	//as must the algorithm for run-time dimensions
+	if( 2 <= d )
+	{
+		typedef max_chain_ns::DynamicMaxChainBox< const V *, int, double > dynamic_box;
+		typename dynamic_box::traits::box_vec dynamic_boxes;
+		auto dynamic_values = box_generator< VTraits >::template boxes_from_sequences< typename dynamic_box::traits >(
+			sequences,
+			std::back_inserter( dynamic_boxes ),
+			50000
+		);
+		DynamicMaxChain< dynamic_box, typename dynamic_box::traits > _dynamic_max_chain( dynamic_boxes, d );
+		BOOST_CHECK_EQUAL( _max_chain.maximal_chain.size(), _dynamic_max_chain.maximal_chain.size() );
+		typename traits::box_ptr_list::const_iterator b = _max_chain.maximal_chain.begin();
+		BOOST_FOREACH( const dynamic_box * dynamic_b, _dynamic_max_chain.maximal_chain )
+		{
+			if( _max_chain.maximal_chain.end() == b )
+			{
+				break;
+			}
+			BOOST_CHECK( std::equal( ( *b )->_start.begin(), ( *b )->_start.end(), dynamic_b->_start.begin() ) );
+			BOOST_CHECK( std::equal( ( *b )->_end.begin(), ( *b )->_end.end(), dynamic_b->_end.begin() ) );
+			BOOST_CHECK_EQUAL( ( *b )->_data->_c, dynamic_b->_data->_c );
+			++b;
+		}
+		BOOST_CHECK_EQUAL( _max_chain.maximal_weight, _dynamic_max_chain.maximal_weight );
+	}
+
 	return std::make_pair( _longest, _max_chain.maximal_weight );
 }
 
@@ -872,6 +906,59 @@ check_random_lcs_test_cases( )
 	}
 }
 
+/** The character, start and end of a value in a chain. */
+typedef boost::tuple< char, int, int > chain_link;
+typedef std::vector< chain_link > chain_links;
+
+/** Collects the values of the boxes in a chain. Copies them as they only live as long as the algorithm runs. */
+struct chain_link_collector
+{
+	chain_links & _links;
+	chain_link_collector( chain_links & links ) : _links( links ) { }
+	template< typename BoxPtr >
+	void operator()( BoxPtr b ) const { _links.push_back( chain_link( b->_data->_c, b->_data->_start, b->_data->_end ) ); }
+};
+
+void
+check_max_chain_within_budget()
+{
+	cout << "******* check_max_chain_within_budget()\n";
+
+	generate_lcs_test_case gen;
+	for( unsigned num_seqs = 2; 6 != num_seqs; ++num_seqs )
+	{
+		for( unsigned i = 0; 50 != i; ++i )
+		{
+			v_array sequences( gen( num_seqs, 15, 100, 4 ) );
+
+			//without limits we must get the same chain as max_chain()
+			chain_links chain;
+			max_chain< VTraits >( sequences, boost::make_function_output_iterator( chain_link_collector( chain ) ) );
+			chain_links budget_chain;
+			const max_chain_stats stats = max_chain_within_budget< VTraits >(
+				sequences,
+				boost::make_function_output_iterator( chain_link_collector( budget_chain ) ),
+				0 );
+			BOOST_CHECK( chain == budget_chain );
+			BOOST_CHECK_EQUAL( stats.num_sequences, num_seqs );
+			BOOST_CHECK_EQUAL( stats.num_runs, stats.num_characters ? 1u : 0u );
+			BOOST_CHECK( ! stats.pruned );
+
+			//with a small budget we must still get a chain from fewer boxes
+			chain_links small_chain;
+			const max_chain_stats small_stats = max_chain_within_budget< VTraits >(
+				sequences,
+				boost::make_function_output_iterator( chain_link_collector( small_chain ) ),
+				20 );
+			BOOST_CHECK_EQUAL( small_stats.num_runs, small_stats.num_characters ? 1u : 0u );
+			BOOST_CHECK( double( small_stats.num_boxes_used ) <= small_stats.num_possible_boxes );
+			BOOST_CHECK( small_stats.num_values_used <= small_stats.num_values );
+			BOOST_CHECK( small_chain.size() <= chain.size() );
+			BOOST_CHECK( chain.empty() || ! small_chain.empty() );
+		}
+	}
+}
+
 void
 check_lcs( const lcs_test_case & test_case )
 {
@@ -1035,6 +1122,7 @@ register_lcs_tests( boost::unit_test::test_suite * test )
     test->add( BOOST_TEST_CASE( &check_random_lcs_test_cases ) );
 	test->add( BOOST_PARAM_TEST_CASE( &check_lcs, test_cases.begin(), test_cases.end() ) );
 	test->add( BOOST_PARAM_TEST_CASE( &check_max_chain, test_cases.begin(), test_cases.end() ) );
+	test->add( BOOST_TEST_CASE( &check_max_chain_within_budget ) );
     test->add( BOOST_TEST_CASE( &range_tree::generate_and_check ) );
 #ifdef TEST_AGAINST_CGAL
 	test->add( BOOST_TEST_CASE( &check_cgal_range_tree ) );
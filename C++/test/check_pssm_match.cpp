@@ -95,6 +95,38 @@ check_deaf_match()
 }
 
 
+void
+check_compiled_pssm()
+{
+    cout << "******* check_compiled_pssm()" << endl;
+
+    vector<TableLink> matrices = boost::assign::list_of
+        ( TableLink(MATRIX_DATA, 260) )
+        ( TableLink(MATRIX_DATA, 930) )
+        ( TableLink(MATRIX_DATA, 1001) )
+        ;
+
+    const seq_t seq = "actgactgacnacagctagtagctgacnactgatcgatcgatgcnatcgatcgatgcatgcatgcnNNNNACGTacgt";
+
+    BOOST_FOREACH( TableLink link, matrices )
+    {
+        const Pssm pssm = make_pssm( link );
+        const CompiledPssm compiled( pssm );
+        BOOST_CHECK_EQUAL( pssm.size(), compiled.size() );
+
+        for (seq_t::const_iterator s = seq.begin(); size_t(seq.end() - s) >= pssm.size(); ++s)
+        {
+            BOOST_CHECK_EQUAL( pssm.score( s, false ), compiled.score( s, false ) );
+            BOOST_CHECK_EQUAL( pssm.score( s, true ), compiled.score( s, true ) );
+        }
+
+        const seq_t bad_seq( pssm.size(), 'x' );
+        BOOST_CHECK_THROW( compiled.score( bad_seq.begin(), false ), std::logic_error );
+        BOOST_CHECK_THROW( compiled.score( bad_seq.begin(), true ), std::logic_error );
+    }
+}
+
+
 void
 check_pssm_match()
 {
@@ -377,6 +409,7 @@ void
 register_pssm_match_tests(boost::unit_test::test_suite * test)
 {
     test->add( BOOST_TEST_CASE( &check_deaf_match ), 0);
+    test->add( BOOST_TEST_CASE( &check_compiled_pssm ), 0);
     test->add(
         BOOST_PARAM_TEST_CASE(
             &check_bayesian_result_calculator,
@@ -0,0 +1,177 @@
+#include <bio/remo_analysis.h>
+#include <bio/parallel.h>
+#include <bio/random.h>
+USING_BIO_NS
+
+#include <boost/test/unit_test.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/foreach.hpp>
+using boost::unit_test::test_suite;
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+using namespace std;
+
+
+namespace {
+
+typedef std::vector< ReMoSequenceGroup::ptr_t > sequence_group_vec;
+
+seq_t
+random_sequence(size_t length)
+{
+	seq_t result;
+	for (size_t i = 0; length != i; ++i)
+	{
+		result.push_back("acgt"[get_uniform_index(4)]);
+	}
+	return result;
+}
+
+/** The sequence with about one base in ten changed. */
+seq_t
+mutate(seq_t sequence)
+{
+	BOOST_FOREACH(char & base, sequence)
+	{
+		if (0 == get_uniform_index(10))
+		{
+			base = "acgt"[get_uniform_index(4)];
+		}
+	}
+	return sequence;
+}
+
+ReMo::ptr_t
+make_remo(const ReMoRange & range, const seq_t & sequence)
+{
+	ReMo::ptr_t remo(new ReMo);
+	remo->range = range;
+	remo->target_range = range;
+	remo->masked_sequence = sequence;
+	remo->unmasked_sequence = sequence;
+	return remo;
+}
+
+/** A small extraction: sequence groups of a mouse sequence with remos conserved in a human sequence. */
+sequence_group_vec
+make_sequence_groups(unsigned num_groups)
+{
+	sequence_group_vec groups;
+	for (unsigned g = 0; num_groups != g; ++g)
+	{
+		ReMoSequenceGroup::ptr_t group(new ReMoSequenceGroup);
+		const std::string ids[] = {
+			BIO_MAKE_STRING("mouse_" << g),
+			BIO_MAKE_STRING("human_" << g)
+		};
+		const ReMoSpecies species[] = { REMO_SPECIES_MOUSE, REMO_SPECIES_HUMAN };
+		for (unsigned s = 0; 2 != s; ++s)
+		{
+			ReMoSequence::ptr_t sequence(new ReMoSequence);
+			sequence->id = ids[s];
+			sequence->length = 1000;
+			sequence->location = ReMoLocation(g % 3);
+			sequence->species = species[s];
+			group->sequences.push_back(sequence);
+		}
+
+		for (unsigned r = 0; 3 != r; ++r)
+		{
+			const ReMoRange range(200 * r, 200 * r + 149);
+			const seq_t centre = random_sequence(150);
+			ReMoBundle::ptr_t bundle(new ReMoBundle);
+			bundle->centre_sequence = ids[0];
+			bundle->remos[ids[0]].push_back(make_remo(range, centre));
+			bundle->remos[ids[1]].push_back(make_remo(range, mutate(centre)));
+			group->remo_bundles[ReMoSubSequence(ids[0], range)] = bundle;
+		}
+		groups.push_back(group);
+	}
+	return groups;
+}
+
+/** Analyses the i'th sequence group into its own map as main-remo-analyse-extraction does. */
+struct analyse_group
+{
+	const sequence_group_vec & groups;
+	std::vector< ReMoAnalysis::map_t > & analysis_maps;
+	const BiobasePssmFilter & filter;
+
+	analyse_group(const sequence_group_vec & groups, std::vector< ReMoAnalysis::map_t > & analysis_maps, const BiobasePssmFilter & filter)
+		: groups(groups), analysis_maps(analysis_maps), filter(filter)
+	{
+	}
+
+	void operator()(size_t i) const
+	{
+		ReMoAnalysis::analyse(*groups[i], analysis_maps[i], filter, 0.05f, 0.05f, true);
+	}
+};
+
+/** Analyse the groups on the threads and return the archive main-remo-analyse-extraction would write. */
+std::string
+analyse_to_archive(const sequence_group_vec & groups, unsigned num_threads, size_t & num_remos, size_t & num_hits)
+{
+	const BiobasePssmFilter filter;
+	std::vector< ReMoAnalysis::map_t > analysis_maps(groups.size());
+	parallel_for(groups.size(), num_threads, analyse_group(groups, analysis_maps, filter));
+
+	ReMoAnalysis::map_t analysis_map;
+	BOOST_FOREACH(ReMoAnalysis::map_t & group_analysis, analysis_maps)
+	{
+		BOOST_CHECK_EQUAL(0u, ReMoAnalysis::merge(group_analysis, analysis_map));
+	}
+
+	num_remos = 0;
+	num_hits = 0;
+	BOOST_FOREACH(const ReMoAnalysis::map_t::value_type & s, analysis_map)
+	{
+		BOOST_FOREACH(const ReMoAnalysis::location_map_t::value_type & l, s.second)
+		{
+			BOOST_FOREACH(const ReMoAnalysis::sequence_map_t::value_type & r, l.second)
+			{
+				++num_remos;
+				num_hits += r.second->results.size();
+			}
+		}
+	}
+
+	std::ostringstream stream;
+	{
+		boost::archive::binary_oarchive(stream) << const_cast<const ReMoAnalysis::map_t &>(analysis_map);
+	}
+	return stream.str();
+}
+
+} //namespace
+
+
+void
+check_remo_analysis_threads()
+{
+	cout << "******* check_remo_analysis_threads()" << endl;
+
+	seed_default_rng(3);
+	const sequence_group_vec groups = make_sequence_groups(8);
+
+	//on many threads first so that they create the binding models between them
+	size_t num_threaded_remos = 0, num_threaded_hits = 0;
+	const std::string threaded = analyse_to_archive(groups, 8, num_threaded_remos, num_threaded_hits);
+	size_t num_serial_remos = 0, num_serial_hits = 0;
+	const std::string serial = analyse_to_archive(groups, 1, num_serial_remos, num_serial_hits);
+
+	BOOST_CHECK_EQUAL(8u * 3u, num_serial_remos);
+	BOOST_CHECK_EQUAL(num_serial_remos, num_threaded_remos);
+	BOOST_CHECK_EQUAL(num_serial_hits, num_threaded_hits);
+	BOOST_CHECK(0 != num_serial_hits);
+	BOOST_CHECK(serial == threaded);
+}
+
+
+void
+register_remo_analysis_tests(test_suite * test)
+{
+	test->add(BOOST_TEST_CASE(&check_remo_analysis_threads), 0);
+}